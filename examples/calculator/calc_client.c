@@ -8,6 +8,7 @@
 
 #define MAX_INPUT 1024
 #define MAX_NUMBERS 100
+#define STREAM_CHUNK 256
 
 static void print_result(cJSON *result)
 {
@@ -59,6 +60,43 @@ static void calculate_stats(sockrpc_client *client, double *numbers, int count)
     print_result(result);
 }
 
+// Uploads numbers read from a file in chunks as they are parsed
+static void stream_stats(sockrpc_client *client, FILE *input)
+{
+    sockrpc_upload *upload = sockrpc_client_upload_begin(client, "stream_stats", NULL);
+    if (!upload)
+    {
+        printf("Error: Operation failed\n");
+        return;
+    }
+
+    cJSON *chunk = cJSON_CreateArray();
+    int in_chunk = 0, total = 0;
+    double value;
+    while (chunk && fscanf(input, "%lf", &value) == 1)
+    {
+        cJSON_AddItemToArray(chunk, cJSON_CreateNumber(value));
+        total++;
+        if (++in_chunk == STREAM_CHUNK)
+        {
+            if (sockrpc_upload_send(upload, chunk) == -1)
+            {
+                chunk = NULL;
+                break;
+            }
+            chunk = cJSON_CreateArray();
+            in_chunk = 0;
+        }
+    }
+    if (chunk && in_chunk)
+        sockrpc_upload_send(upload, chunk);
+    else
+        cJSON_Delete(chunk);
+
+    printf("\nCalculating statistics for %d streamed numbers:\n", total);
+    print_result(sockrpc_upload_finish(upload));
+}
+
 static void interactive_mode(sockrpc_client *client)
 {
     char input[MAX_INPUT];
@@ -162,11 +200,13 @@ int main(int argc, char *argv[])
     if (argc > 1)
     {
         // Command line mode
-        if (argc < 4 || (!strcmp(argv[1], "help") || !strcmp(argv[1], "--help")))
+        int streaming = !strcmp(argv[1], "stream-stats");
+        if ((argc < 4 && !streaming) || (!strcmp(argv[1], "help") || !strcmp(argv[1], "--help")))
         {
             printf("Usage:\n");
             printf("  %s calculate <operation> <a> <b>\n", argv[0]);
             printf("  %s stats <number1> [number2 ...]\n", argv[0]);
+            printf("  %s stream-stats < numbers.txt\n", argv[0]);
             printf("\nOperations: add, subtract, multiply, divide, power\n");
             sockrpc_client_destroy(client);
             return 1;
@@ -176,6 +216,10 @@ int main(int argc, char *argv[])
         {
             calculate(client, argv[2], atof(argv[3]), atof(argv[4]));
         }
+        else if (streaming)
+        {
+            stream_stats(client, stdin);
+        }
         else if (!strcmp(argv[1], "stats"))
         {
             double numbers[MAX_NUMBERS];
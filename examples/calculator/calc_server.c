@@ -127,13 +127,61 @@ static cJSON *array_stats(cJSON *params)
     return result;
 }
 
+// Statistics over numbers uploaded in chunks, without holding them all
+static cJSON *stream_stats(cJSON *params, sockrpc_stream *stream)
+{
+    (void)params;
+    double count = 0, mean = 0, m2 = 0;
+    double min = INFINITY, max = -INFINITY;
+
+    // Welford's online algorithm keeps the variance numerically stable
+    cJSON *chunk;
+    while ((chunk = sockrpc_stream_next(stream)))
+    {
+        cJSON *item;
+        cJSON_ArrayForEach(item, chunk)
+        {
+            if (!cJSON_IsNumber(item))
+                continue;
+            double val = item->valuedouble;
+            count++;
+            double delta = val - mean;
+            mean += delta / count;
+            m2 += delta * (val - mean);
+            min = fmin(min, val);
+            max = fmax(max, val);
+        }
+        cJSON_Delete(chunk);
+    }
+
+    if (sockrpc_stream_failed(stream))
+        return NULL;
+
+    cJSON *result = cJSON_CreateObject();
+    if (count == 0)
+    {
+        cJSON_AddStringToObject(result, "error", "Invalid or empty array");
+        return result;
+    }
+
+    double variance = m2 / count;
+    cJSON_AddNumberToObject(result, "count", count);
+    cJSON_AddNumberToObject(result, "sum", mean * count);
+    cJSON_AddNumberToObject(result, "mean", mean);
+    cJSON_AddNumberToObject(result, "variance", variance);
+    cJSON_AddNumberToObject(result, "stddev", sqrt(variance));
+    cJSON_AddNumberToObject(result, "min", min);
+    cJSON_AddNumberToObject(result, "max", max);
+    return result;
+}
+
 static void handle_signal(int sig)
 {
     (void)sig;
     running = 0;
 }
 
-int main()
+int main(int argc, char *argv[])
 {
     signal(SIGINT, handle_signal);
     signal(SIGTERM, handle_signal);
@@ -149,11 +197,31 @@ int main()
     sockrpc_server_register(server, "calculate", calculate);
     sockrpc_server_register(server, "stats", array_stats);
 
+    // Stream handlers wait for chunks, so they run on their own threads
+    sockrpc_group_config uploads = {.threads = 2};
+    if (sockrpc_server_add_group(server, "uploads", &uploads) == 0)
+        sockrpc_server_register_stream(server, "stream_stats", stream_stats, "uploads");
+
+    // kill -USR2 <pid> captures the last requests for tools/sockrpc_frdump
+    sockrpc_server_set_dump_signal(server, "/tmp/calc_server.fr");
+
+    // --capture <file> records incoming requests for tools/sockrpc_replay
+    if (argc == 3 && strcmp(argv[1], "--capture") == 0)
+    {
+        sockrpc_capture_config capture = {.path = argv[2]};
+        if (sockrpc_server_set_capture(server, &capture) == 0)
+            printf("Capturing requests to %s\n", argv[2]);
+        else
+            fprintf(stderr, "Cannot capture to %s\n", argv[2]);
+    }
+
     sockrpc_server_start(server);
     printf("Calculator server started. Press Ctrl+C to exit.\n");
     printf("Available operations:\n");
     printf("  - calculate: Basic arithmetic (add, subtract, multiply, divide, power)\n");
     printf("  - stats: Statistical operations on arrays\n");
+    printf("  - stream_stats: Statistics over an uploaded stream of numbers\n");
+    printf("Send SIGUSR2 to dump recent requests to /tmp/calc_server.fr\n");
 
     while (running)
     {
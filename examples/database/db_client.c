@@ -5,6 +5,7 @@
 #include "sockrpc/sockrpc.h"
 
 #define MAX_INPUT 1024
+#define IMPORT_CHUNK 64
 
 static void print_result(cJSON *result)
 {
@@ -140,6 +141,51 @@ static void interactive_mode(sockrpc_client *client)
     }
 }
 
+// Upload "key value" lines from a file, IMPORT_CHUNK records per chunk
+static void db_import(sockrpc_client *client, FILE *input)
+{
+    sockrpc_upload *upload = sockrpc_client_upload_begin(client, "import", NULL);
+    if (!upload)
+    {
+        printf("Error: Operation failed\n");
+        return;
+    }
+
+    char line[MAX_INPUT];
+    cJSON *chunk = cJSON_CreateArray();
+    int in_chunk = 0;
+    while (chunk && fgets(line, sizeof(line), input))
+    {
+        line[strcspn(line, "\n")] = 0;
+        char *value = strchr(line, ' ');
+        if (!value)
+            continue;
+        *value++ = 0;
+
+        cJSON *record = cJSON_CreateObject();
+        cJSON_AddStringToObject(record, "key", line);
+        cJSON_AddStringToObject(record, "value", value);
+        cJSON_AddItemToArray(chunk, record);
+        if (++in_chunk == IMPORT_CHUNK)
+        {
+            if (sockrpc_upload_send(upload, chunk) == -1)
+            {
+                chunk = NULL;
+                break;
+            }
+            chunk = cJSON_CreateArray();
+            in_chunk = 0;
+        }
+    }
+    if (chunk && in_chunk)
+        sockrpc_upload_send(upload, chunk);
+    else
+        cJSON_Delete(chunk);
+
+    printf("\nImporting records:\n");
+    print_result(sockrpc_upload_finish(upload));
+}
+
 int main(int argc, char *argv[])
 {
     sockrpc_client *client = sockrpc_client_create("/tmp/db_rpc.sock");
@@ -149,6 +195,9 @@ int main(int argc, char *argv[])
         return 1;
     }
 
+    // Listings of many keys compress well; calls work uncompressed otherwise
+    sockrpc_client_enable_compression(client, NULL, 0);
+
     if (argc > 1)
     {
         // Command line mode
@@ -161,6 +210,7 @@ int main(int argc, char *argv[])
             printf("  %s get <key>\n", argv[0]);
             printf("  %s delete <key>\n", argv[0]);
             printf("  %s list\n", argv[0]);
+            printf("  %s import < records.txt   (one \"key value\" per line)\n", argv[0]);
             sockrpc_client_destroy(client);
             return 1;
         }
@@ -181,6 +231,10 @@ int main(int argc, char *argv[])
         {
             db_operation(client, "list", NULL, NULL);
         }
+        else if (!strcmp(operation, "import") && argc == 2)
+        {
+            db_import(client, stdin);
+        }
         else
         {
             fprintf(stderr, "Invalid command line arguments\n");
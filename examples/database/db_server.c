@@ -19,7 +19,7 @@ typedef struct
 } Record;
 
 static Record *database = NULL;
-static pthread_mutex_t db_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_rwlock_t db_lock = PTHREAD_RWLOCK_INITIALIZER;
 static volatile int running = 1;
 
 // Database persistence
@@ -29,9 +29,9 @@ static void load_database()
     if (!fp)
         return;
 
-    pthread_mutex_lock(&db_mutex);
+    pthread_rwlock_wrlock(&db_lock);
     fread(database, sizeof(Record), MAX_RECORDS, fp);
-    pthread_mutex_unlock(&db_mutex);
+    pthread_rwlock_unlock(&db_lock);
 
     fclose(fp);
 }
@@ -45,9 +45,9 @@ static void save_database()
         return;
     }
 
-    pthread_mutex_lock(&db_mutex);
+    pthread_rwlock_rdlock(&db_lock);
     fwrite(database, sizeof(Record), MAX_RECORDS, fp);
-    pthread_mutex_unlock(&db_mutex);
+    pthread_rwlock_unlock(&db_lock);
 
     fclose(fp);
 }
@@ -77,17 +77,9 @@ static int validate_params(cJSON *params, const char **key, const char **value)
     return 1;
 }
 
-// Set key-value
-static cJSON *db_set(cJSON *params)
+// Store a record, replacing an existing key (write lock held)
+static int put_record(const char *key, const char *value)
 {
-    const char *key, *value;
-    if (!validate_params(params, &key, &value))
-    {
-        return cJSON_CreateString("Invalid parameters");
-    }
-
-    pthread_mutex_lock(&db_mutex);
-
     // Find empty slot or existing key
     int slot = -1;
     for (int i = 0; i < MAX_RECORDS; i++)
@@ -105,44 +97,134 @@ static cJSON *db_set(cJSON *params)
     }
 
     if (slot == -1)
-    {
-        pthread_mutex_unlock(&db_mutex);
-        return cJSON_CreateString("Database full");
-    }
+        return -1;
 
     strncpy(database[slot].key, key, MAX_KEY_LENGTH - 1);
     strncpy(database[slot].value, value, MAX_VALUE_LENGTH - 1);
     database[slot].valid = 1;
+    return 0;
+}
 
-    pthread_mutex_unlock(&db_mutex);
-    save_database();
+// Set key-value
+static cJSON *db_set(cJSON *params)
+{
+    const char *key, *value;
+    if (!validate_params(params, &key, &value))
+    {
+        return cJSON_CreateString("Invalid parameters");
+    }
 
+    pthread_rwlock_wrlock(&db_lock);
+    int rc = put_record(key, value);
+    pthread_rwlock_unlock(&db_lock);
+
+    if (rc == -1)
+        return cJSON_CreateString("Database full");
+
+    save_database();
     return cJSON_CreateString("OK");
 }
 
-// Get value by key
-static cJSON *db_get(cJSON *params)
+// Import records uploaded as chunks of [{"key": k, "value": v}, ...]
+static cJSON *db_import(cJSON *params, sockrpc_stream *stream)
+{
+    (void)params;
+    int imported = 0, rejected = 0;
+
+    cJSON *chunk;
+    while ((chunk = sockrpc_stream_next(stream)))
+    {
+        // Each chunk is applied under one lock, other calls run in between
+        pthread_rwlock_wrlock(&db_lock);
+        cJSON *record;
+        cJSON_ArrayForEach(record, chunk)
+        {
+            const char *key, *value;
+            if (validate_params(record, &key, &value) && put_record(key, value) == 0)
+                imported++;
+            else
+                rejected++;
+        }
+        pthread_rwlock_unlock(&db_lock);
+        cJSON_Delete(chunk);
+    }
+
+    if (imported)
+        save_database();
+
+    cJSON *result = cJSON_CreateObject();
+    cJSON_AddNumberToObject(result, "imported", imported);
+    cJSON_AddNumberToObject(result, "rejected", rejected);
+    cJSON_AddBoolToObject(result, "complete", !sockrpc_stream_failed(stream));
+    return result;
+}
+
+// Check that a value can be sent as a JSON string without escaping
+static int is_plain_string(const char *value)
+{
+    for (const unsigned char *p = (const unsigned char *)value; *p; p++)
+    {
+        if (*p < 0x20 || *p == '"' || *p == '\\')
+            return 0;
+    }
+    return 1;
+}
+
+// Release the read lock held while a stored value is being sent
+static void unlock_database(void *ctx)
+{
+    (void)ctx;
+    pthread_rwlock_unlock(&db_lock);
+}
+
+// Answer with a short string constant
+static sockrpc_response *string_response(const char *text)
+{
+    sockrpc_response *response = sockrpc_response_create();
+    sockrpc_response_add_static(response, text, strlen(text));
+    return response;
+}
+
+// Get value by key, sending the stored value without copying it
+static sockrpc_response *db_get(cJSON *params)
 {
     const char *key;
     if (!validate_params(params, &key, NULL))
     {
-        return cJSON_CreateString("Invalid parameters");
+        return string_response("\"Invalid parameters\"");
     }
 
-    pthread_mutex_lock(&db_mutex);
+    pthread_rwlock_rdlock(&db_lock);
 
     for (int i = 0; i < MAX_RECORDS; i++)
     {
         if (database[i].valid && strcmp(database[i].key, key) == 0)
         {
-            cJSON *result = cJSON_CreateString(database[i].value);
-            pthread_mutex_unlock(&db_mutex);
-            return result;
+            sockrpc_response *response = sockrpc_response_create();
+            if (!response)
+                break;
+
+            if (is_plain_string(database[i].value))
+            {
+                // The read lock is held until the value has been written
+                sockrpc_response_add_static(response, "\"", 1);
+                sockrpc_response_add_borrowed(response, database[i].value,
+                                              strlen(database[i].value),
+                                              unlock_database, NULL);
+                sockrpc_response_add_static(response, "\"", 1);
+                return response;
+            }
+
+            cJSON *value = cJSON_CreateString(database[i].value);
+            pthread_rwlock_unlock(&db_lock);
+            sockrpc_response_add_json(response, value);
+            cJSON_Delete(value);
+            return response;
         }
     }
 
-    pthread_mutex_unlock(&db_mutex);
-    return cJSON_CreateString("Not found");
+    pthread_rwlock_unlock(&db_lock);
+    return string_response("\"Not found\"");
 }
 
 // Delete key
@@ -154,20 +236,20 @@ static cJSON *db_delete(cJSON *params)
         return cJSON_CreateString("Invalid parameters");
     }
 
-    pthread_mutex_lock(&db_mutex);
+    pthread_rwlock_wrlock(&db_lock);
 
     for (int i = 0; i < MAX_RECORDS; i++)
     {
         if (database[i].valid && strcmp(database[i].key, key) == 0)
         {
             database[i].valid = 0;
-            pthread_mutex_unlock(&db_mutex);
+            pthread_rwlock_unlock(&db_lock);
             save_database();
             return cJSON_CreateString("OK");
         }
     }
 
-    pthread_mutex_unlock(&db_mutex);
+    pthread_rwlock_unlock(&db_lock);
     return cJSON_CreateString("Not found");
 }
 
@@ -177,7 +259,7 @@ static cJSON *db_list(cJSON *params)
     (void)params;
     cJSON *list = cJSON_CreateArray();
 
-    pthread_mutex_lock(&db_mutex);
+    pthread_rwlock_rdlock(&db_lock);
 
     for (int i = 0; i < MAX_RECORDS; i++)
     {
@@ -190,7 +272,7 @@ static cJSON *db_list(cJSON *params)
         }
     }
 
-    pthread_mutex_unlock(&db_mutex);
+    pthread_rwlock_unlock(&db_lock);
     return list;
 }
 
@@ -226,10 +308,18 @@ int main()
     }
 
     sockrpc_server_register(server, "set", db_set);
-    sockrpc_server_register(server, "get", db_get);
+    sockrpc_server_register_response(server, "get", db_get, NULL);
     sockrpc_server_register(server, "delete", db_delete);
     sockrpc_server_register(server, "list", db_list);
 
+    // Imports wait for uploaded chunks, so they get a thread of their own
+    sockrpc_group_config imports = {.threads = 1};
+    if (sockrpc_server_add_group(server, "imports", &imports) == 0)
+        sockrpc_server_register_stream(server, "import", db_import, "imports");
+
+    // Compress even modest listings for clients that negotiate it
+    sockrpc_server_set_compression(server, "list", 256);
+
     sockrpc_server_start(server);
     printf("Database server started. Press Ctrl+C to exit.\n");
     printf("Available operations:\n");
@@ -237,6 +327,7 @@ int main()
     printf("  - get: Get value by key\n");
     printf("  - delete: Delete key-value pair\n");
     printf("  - list: List all entries\n");
+    printf("  - import: Load key-value pairs uploaded as a stream\n");
 
     while (running)
     {
@@ -4,18 +4,35 @@
 #include <stddef.h>
 #include <cjson/cJSON.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 /**
  * @mainpage SockRPC Library
  *
  * SockRPC is a lightweight RPC library for Linux that enables inter-process
- * communication using Unix domain sockets. It provides both synchronous and
- * asynchronous operations with JSON-based message passing.
+ * communication using Unix domain sockets, or TCP between hosts. It
+ * provides both synchronous and asynchronous operations with JSON-based
+ * message passing.
+ *
+ * Addresses accepted wherever a socket path is expected:
+ * - "/tmp/x.sock" or "unix:///tmp/x.sock": Unix domain socket
+ * - "@name" or "unix://@name": Linux abstract-namespace socket
+ * - "unixpacket:///tmp/x.sock": Unix SOCK_SEQPACKET socket
+ * - "tcp://127.0.0.1:9000" or "tcp://[::1]:9000": TCP socket
  *
  * Key features:
  * - Thread-safe client operations
  * - Multi-threaded server with worker pool
+ * - Dedicated worker groups for expensive methods
+ * - Hot-reloadable handler modules
+ * - Negotiated LZ4/Zstandard compression of large messages
+ * - Zero-copy responses assembled from borrowed buffers
  * - JSON message format
  * - Synchronous and asynchronous calls
+ * - Deferred handlers awaiting downstream calls without blocking
+ * - C++20 coroutine bindings in sockrpc/sockrpc.hpp
  * - Automatic resource management
  */
 
@@ -76,7 +93,7 @@ typedef cJSON *(*rpc_handler)(cJSON *params);
  * @brief Structure for registering RPC methods
  *
  * This structure associates a method name with its handler function.
- * The server maintains an array of these structures for method dispatch.
+ * Handler modules export an array of these structures (sockrpc_module).
  *
  * Thread safety:
  * - Registration is thread-safe
@@ -92,6 +109,310 @@ typedef struct {
     rpc_handler handler; /**< Function pointer to method handler */
 } rpc_method;
 
+/**
+ * @brief Response assembled from fragments and sent without copying
+ *
+ * The fragments, concatenated in order, form the JSON text of the
+ * response's "result". The server writes the frame header, envelope and
+ * all fragments with one sendmsg call whenever the socket buffer allows
+ * it, so large values a handler
+ * already holds in memory (e.g. stored records) reach the socket without
+ * being copied into a contiguous buffer first.
+ *
+ * Fragments are not validated; the handler is responsible for producing
+ * valid JSON.
+ *
+ * @see rpc_response_handler
+ */
+typedef struct sockrpc_response sockrpc_response;
+
+/**
+ * @brief Callback releasing a borrowed response fragment
+ * @param ctx Context passed with the fragment
+ *
+ * Called once the response has been written (or dropped because the
+ * client disconnected), on the thread that ran the handler.
+ */
+typedef void (*sockrpc_release_fn)(void *ctx);
+
+/**
+ * @brief Function pointer type for handlers building a sockrpc_response
+ * @param params JSON object containing the method parameters
+ * @return Response, or NULL on error ("Handler failed" is sent)
+ *
+ * Same contract as rpc_handler, except that the result is returned as
+ * fragments. The server takes ownership of the response and destroys it
+ * after sending.
+ *
+ * Example:
+ * @code
+ * sockrpc_response* get_blob(cJSON* params) {
+ *     blob* b = store_lookup_and_ref(params);
+ *     sockrpc_response* response = sockrpc_response_create();
+ *     sockrpc_response_add_static(response, "{\"data\":", 8);
+ *     sockrpc_response_add_borrowed(response, b->json, b->json_len,
+ *                                   blob_unref, b);
+ *     sockrpc_response_add_static(response, "}", 1);
+ *     return response;
+ * }
+ * @endcode
+ *
+ * @see sockrpc_server_register_response
+ */
+typedef sockrpc_response *(*rpc_response_handler)(cJSON *params);
+
+/**
+ * @brief Chunks of a client-streaming call, consumed by its handler
+ *
+ * @see rpc_stream_handler
+ */
+typedef struct sockrpc_stream sockrpc_stream;
+
+/**
+ * @brief Function pointer type for handlers of client-streaming calls
+ * @param params JSON parameters sent when the upload began
+ * @param stream Chunks uploaded by the client, see sockrpc_stream_next
+ * @return Result (ownership transferred) or NULL ("Handler failed")
+ *
+ * The handler runs as soon as the upload begins and pulls chunks while
+ * the client is still sending, so it never needs the whole input in
+ * memory. It may return before consuming every chunk; the remaining
+ * ones are discarded.
+ *
+ * Example:
+ * @code
+ * cJSON* sum(cJSON* params, sockrpc_stream* stream) {
+ *     double total = 0;
+ *     cJSON* chunk;
+ *     while ((chunk = sockrpc_stream_next(stream))) {
+ *         cJSON* n;
+ *         cJSON_ArrayForEach(n, chunk) total += n->valuedouble;
+ *         cJSON_Delete(chunk);
+ *     }
+ *     return sockrpc_stream_failed(stream) ? NULL : cJSON_CreateNumber(total);
+ * }
+ * @endcode
+ *
+ * @see sockrpc_server_register_stream
+ */
+typedef cJSON *(*rpc_stream_handler)(cJSON *params, sockrpc_stream *stream);
+
+/**
+ * @brief Client-streaming call in progress on a client
+ *
+ * @see sockrpc_client_upload_begin
+ */
+typedef struct sockrpc_upload sockrpc_upload;
+
+/**
+ * @brief Call answered after its handler returned
+ *
+ * @see rpc_deferred_handler
+ */
+typedef struct sockrpc_call sockrpc_call;
+
+/**
+ * @brief Function pointer type for handlers completing calls later
+ * @param params JSON parameters, valid until the call is completed
+ * @param call Call to answer with sockrpc_call_complete, exactly once
+ * @param ctx Context passed to sockrpc_server_register_deferred
+ *
+ * The handler runs on the I/O worker that owns the connection and
+ * returns without waiting: it submits calls on clients obtained with
+ * sockrpc_call_client() and completes the call from their completion
+ * callbacks, which run on the same worker. The worker keeps serving
+ * other requests meanwhile, so one thread fans out to many downstream
+ * services at once.
+ *
+ * Example:
+ * @code
+ * static void on_user(cJSON* result, void* ctx) {
+ *     sockrpc_call_complete(ctx, result);  // NULL sends "Handler failed"
+ * }
+ *
+ * void get_user(cJSON* params, sockrpc_call* call, void* ctx) {
+ *     sockrpc_client* users = sockrpc_call_client(call, "/tmp/users.sock");
+ *     if (sockrpc_call_submit(call, users, "get", cJSON_Duplicate(params, 1),
+ *                             on_user, call) == -1)
+ *         sockrpc_call_complete(call, NULL);
+ * }
+ * @endcode
+ *
+ * @see sockrpc_server_register_deferred
+ */
+typedef void (*rpc_deferred_handler)(cJSON *params, sockrpc_call *call, void *ctx);
+
+/**
+ * @brief Default smallest message compressed on negotiated connections
+ *
+ * Below this size compression saves too little to pay for its CPU cost.
+ */
+#define SOCKRPC_COMPRESS_THRESHOLD 1024
+
+/**
+ * @brief ABI version of the handler module interface
+ */
+#define SOCKRPC_MODULE_ABI_VERSION 1
+
+/**
+ * @brief Name of the symbol a handler module exports
+ */
+#define SOCKRPC_MODULE_SYMBOL "sockrpc_module_info"
+
+/**
+ * @brief Registration table exported by a handler module
+ *
+ * A handler module is a shared object exporting a sockrpc_module named
+ * SOCKRPC_MODULE_SYMBOL, normally defined with SOCKRPC_MODULE. Its
+ * methods are registered when the module is loaded with
+ * sockrpc_server_load_module.
+ *
+ * Example:
+ * @code
+ * static const rpc_method methods[] = {
+ *     {"echo", handle_echo},
+ *     {NULL, NULL}
+ * };
+ *
+ * SOCKRPC_MODULE(methods);
+ * @endcode
+ */
+typedef struct
+{
+    int abi_version;           /**< Must be SOCKRPC_MODULE_ABI_VERSION */
+    const rpc_method *methods; /**< Methods, terminated by {NULL, NULL} */
+} sockrpc_module;
+
+/**
+ * @brief Defines the registration table of a handler module
+ * @param table Array of rpc_method terminated by {NULL, NULL}
+ *
+ * In C++ the symbol gets C linkage, so modules may be written in C++
+ * (e.g. with the typed methods of sockrpc.hpp).
+ */
+#ifdef __cplusplus
+#define SOCKRPC_MODULE(table) \
+    extern "C" const sockrpc_module sockrpc_module_info = {SOCKRPC_MODULE_ABI_VERSION, table}
+#else
+#define SOCKRPC_MODULE(table) \
+    const sockrpc_module sockrpc_module_info = {SOCKRPC_MODULE_ABI_VERSION, table}
+#endif
+
+/**
+ * @brief Socket type used for the connection between client and server
+ *
+ * - SOCKRPC_SOCK_STREAM: byte stream (default), messages are read
+ *   until the socket has no more data
+ * - SOCKRPC_SOCK_SEQPACKET: the kernel preserves message boundaries,
+ *   each recv returns exactly one message without reassembly
+ *
+ * Client and server must use the same socket type.
+ */
+typedef enum
+{
+    SOCKRPC_SOCK_STREAM = 0,   /**< SOCK_STREAM connections */
+    SOCKRPC_SOCK_SEQPACKET = 1 /**< SOCK_SEQPACKET connections */
+} sockrpc_socket_type;
+
+/**
+ * @brief Configuration of a dedicated worker group
+ *
+ * Methods bound to a group run on the group's own threads instead of the
+ * server's I/O workers, so slow or CPU-heavy methods cannot delay
+ * latency-sensitive ones.
+ *
+ * - threads: number of threads running the group's handlers
+ * - cpus/num_cpus: CPUs the threads are pinned to (NULL/0 for no pinning)
+ * - queue_limit: requests that may wait for a free thread; further
+ *   requests get a "Server busy" error response (0 for no limit)
+ */
+typedef struct
+{
+    int threads;        /**< Number of threads, 1 to MAX_GROUP_THREADS */
+    const int *cpus;    /**< CPU numbers to pin threads to, or NULL */
+    size_t num_cpus;    /**< Number of entries in cpus */
+    size_t queue_limit; /**< Maximum queued requests, 0 for no limit */
+} sockrpc_group_config;
+
+/**
+ * @brief Default number of events queued per subscriber connection
+ */
+#define SOCKRPC_SUBSCRIBER_QUEUE 256
+
+/**
+ * @brief What happens to an event published to a full subscriber queue
+ *
+ * - SOCKRPC_OVERFLOW_DROP_OLDEST: the oldest queued event is discarded
+ *   (default), so slow subscribers see the most recent events
+ * - SOCKRPC_OVERFLOW_DROP_NEWEST: the new event is discarded
+ * - SOCKRPC_OVERFLOW_COALESCE: a queued event of the same topic is
+ *   replaced by the new one, full or not; for topics whose latest event
+ *   supersedes earlier ones (configuration, cache invalidation).
+ *   Otherwise the oldest event is discarded.
+ */
+typedef enum
+{
+    SOCKRPC_OVERFLOW_DROP_OLDEST = 0, /**< Discard the oldest queued event */
+    SOCKRPC_OVERFLOW_DROP_NEWEST = 1, /**< Discard the new event */
+    SOCKRPC_OVERFLOW_COALESCE = 2     /**< Replace a queued event of the topic */
+} sockrpc_overflow_policy;
+
+/**
+ * @brief Callback receiving events of a subscribed topic
+ * @param topic Topic name
+ * @param event Event payload (ownership transferred)
+ * @param ctx Context passed to sockrpc_client_subscribe
+ */
+typedef void (*sockrpc_event_callback)(const char *topic, cJSON *event, void *ctx);
+
+/**
+ * @brief Callback completing a call submitted on a non-blocking client
+ * @param result Call result (ownership transferred), or NULL if the
+ *        server answered with an error or the connection failed
+ * @param ctx Context passed to sockrpc_client_submit
+ */
+typedef void (*sockrpc_completion_callback)(cJSON *result, void *ctx);
+
+/**
+ * @brief Buffer size needed for a W3C traceparent string
+ */
+#define SOCKRPC_TRACEPARENT_SIZE 56
+
+/**
+ * @brief Configuration of request tracing on a server
+ *
+ * - path: file spans are appended to, one OTLP JSON export request
+ *   ({"resourceSpans": [...]}) per line
+ * - service: service.name resource attribute (NULL for "sockrpc")
+ * - sample_rate: fraction of requests without incoming trace context
+ *   that start a sampled trace, 0 to 1; requests with context keep the
+ *   caller's decision
+ * - batch_size: spans written per line (0 for 64)
+ * - flush_ms: longest a finished span waits for its batch (0 for 1000)
+ */
+typedef struct
+{
+    const char *path;      /**< Span file, opened for appending */
+    const char *service;   /**< Service name, or NULL */
+    double sample_rate;    /**< Fraction of new traces sampled */
+    size_t batch_size;     /**< Spans per write, 0 for the default */
+    unsigned int flush_ms; /**< Longest wait for a batch, 0 for the default */
+} sockrpc_trace_config;
+
+/**
+ * @brief Configuration of traffic capture on a server
+ *
+ * - path: capture file, created or truncated
+ * - buffer_size: bytes of each of the two memory buffers requests are
+ *   copied into before a background thread writes them (0 for 1 MiB);
+ *   a request larger than this is not captured
+ */
+typedef struct
+{
+    const char *path;   /**< Capture file */
+    size_t buffer_size; /**< Bytes per buffer, 0 for the default */
+} sockrpc_capture_config;
+
 /**
  * @brief Opaque server context structure
  *
@@ -123,7 +444,9 @@ typedef struct sockrpc_client sockrpc_client;
 
 /**
  * @brief Create a new RPC server instance
- * @param socket_path Path where the Unix domain socket will be created
+ * @param socket_path Path where the Unix domain socket will be created,
+ *        "@name" for a Linux abstract-namespace socket, or a transport
+ *        URL such as "tcp://0.0.0.0:9000"
  * @return Pointer to server context or NULL on error
  *
  * Creates and initializes a new server instance with:
@@ -136,73 +459,803 @@ typedef struct sockrpc_client sockrpc_client;
  * - Not thread-safe
  * - Create server before spawning any threads
  *
- * Error conditions (returns NULL):
- * - Invalid socket_path
- * - Memory allocation failure
- * - System resource limits reached
+ * Error conditions (returns NULL):
+ * - Invalid socket_path
+ * - Memory allocation failure
+ * - System resource limits reached
+ *
+ * @note The server is not started automatically
+ * @note The path length must not exceed sizeof(sun_path) - 1 bytes
+ * @note Any existing socket file will be removed on server start
+ * @note Abstract names ("@name") create no file and need no cleanup
+ *
+ * Example:
+ * @code
+ * sockrpc_server* server = sockrpc_server_create("/tmp/my_server.sock");
+ * if (!server) {
+ *     // Handle error
+ *     return -1;
+ * }
+ * @endcode
+ *
+ * @see sockrpc_server_start
+ * @see sockrpc_server_destroy
+ */
+sockrpc_server *sockrpc_server_create(const char *socket_path);
+
+/**
+ * @brief Select the socket type the server listens with
+ * @param server Server context
+ * @param type SOCKRPC_SOCK_STREAM (default) or SOCKRPC_SOCK_SEQPACKET
+ *
+ * With SOCKRPC_SOCK_SEQPACKET the server reads exactly one request per
+ * recv and message size is not limited by the receive buffer.
+ *
+ * Thread safety:
+ * - Not thread-safe
+ * - Call before sockrpc_server_start
+ *
+ * @note Ignored by sockrpc_server_start_from_fd, which uses the type of
+ *       the socket it is given
+ *
+ * Example:
+ * @code
+ * sockrpc_server* server = sockrpc_server_create("@my_service");
+ * sockrpc_server_set_socket_type(server, SOCKRPC_SOCK_SEQPACKET);
+ * sockrpc_server_start(server);
+ * @endcode
+ *
+ * @see sockrpc_client_create_ex
+ */
+void sockrpc_server_set_socket_type(sockrpc_server *server, sockrpc_socket_type type);
+
+/**
+ * @brief Enable adaptive busy-polling on the I/O workers
+ * @param server Server context
+ * @param spin_us Longest time a worker spins on its epoll set before
+ *        blocking, in microseconds; 0 disables spinning (default)
+ * @return 0 on success, -1 on error
+ *
+ * After handling events, a worker keeps polling for new ones without
+ * sleeping, pausing the CPU between polls, before it falls back to a
+ * blocking epoll_wait. This saves the wakeup latency of the next
+ * request at the cost of CPU time. The spin adapts: phases that find
+ * nothing halve it (down to spin_us / 16), phases that find events
+ * double it again. Only worthwhile when workers have dedicated cores.
+ *
+ * Spin hit rate and the CPU time spent spinning are reported in the
+ * "busy_poll" section of sockrpc_server_get_stats.
+ *
+ * Thread safety:
+ * - Not thread-safe, call before sockrpc_server_start
+ *
+ * Error conditions (returns -1):
+ * - NULL server
+ * - Server already started
+ */
+int sockrpc_server_set_busy_poll(sockrpc_server *server, unsigned int spin_us);
+
+/**
+ * @brief Set how long responses to pipelined requests are corked
+ * @param server Server context
+ * @param max_us Longest time a batch collects responses before writing
+ *        them, in microseconds (default 200); 0 writes them only when
+ *        the batch ends or the 64 KiB cork buffer fills
+ * @return 0 on success, -1 on error
+ *
+ * A shorter deadline lets long batches stream out sooner, a longer one
+ * saves writes on slow hosts.
+ *
+ * Thread safety:
+ * - Not thread-safe, call before sockrpc_server_start
+ *
+ * Error conditions (returns -1):
+ * - NULL server
+ * - Server already started
+ */
+int sockrpc_server_set_cork_deadline(sockrpc_server *server, unsigned int max_us);
+
+/**
+ * @brief Register an RPC method with the server
+ * @param server Server context
+ * @param name Method name
+ * @param handler Function pointer to method handler
+ *
+ * Thread safety:
+ * - Thread-safe
+ * - Can be called before or after server start
+ * - Can be called from multiple threads
+ *
+ * Memory management:
+ * - Server takes ownership of method name (creates copy)
+ * - Handler function pointer must remain valid
+ * - Previous handler for same name is replaced
+ *
+ * Error conditions (silently returns):
+ * - NULL server
+ * - NULL name
+ * - NULL handler
+ * - Maximum methods exceeded
+ *
+ * @note Method names are case-sensitive
+ * @note Maximum methods limited by MAX_METHODS constant
+ *
+ * Example:
+ * @code
+ * // Register a method
+ * sockrpc_server_register(server, "echo", handle_echo);
+ *
+ * // Replace existing method
+ * sockrpc_server_register(server, "echo", handle_echo_v2);
+ * @endcode
+ *
+ * @see rpc_handler
+ */
+void sockrpc_server_register(sockrpc_server *server, const char *name, rpc_handler handler);
+
+/**
+ * @brief Register an RPC method whose handler builds a sockrpc_response
+ * @param server Server context
+ * @param name Method name
+ * @param handler Handler returning the result as fragments
+ * @param group Name of a worker group, or NULL to run the method on the
+ *        I/O workers
+ * @return 0 on success, -1 on error
+ *
+ * Same as sockrpc_server_register_in_group otherwise. On connections
+ * that negotiated compression, responses at or above the method's
+ * compression threshold are gathered into one buffer and compressed;
+ * all others are written straight from the fragments.
+ *
+ * Thread safety:
+ * - Thread-safe
+ * - Can be called before or after server start
+ *
+ * Error conditions (returns -1):
+ * - NULL server, name or handler
+ * - Unknown group
+ * - Maximum methods exceeded
+ *
+ * @see rpc_response_handler
+ */
+int sockrpc_server_register_response(sockrpc_server *server, const char *name,
+                                     rpc_response_handler handler, const char *group);
+
+/**
+ * @brief Register a method receiving a client-streaming upload
+ * @param server Server context
+ * @param name Method name
+ * @param handler Handler pulling the uploaded chunks
+ * @param group Name of the worker group running the handler
+ * @return 0 on success, -1 on error
+ *
+ * Stream handlers wait for chunks, so they must not block an I/O
+ * worker: they always run on a worker group, whose threads bound the
+ * number of uploads processed at once. Calling the method without
+ * streaming runs the handler with an empty stream.
+ *
+ * Thread safety:
+ * - Thread-safe
+ * - Can be called before or after server start
+ *
+ * Error conditions (returns -1):
+ * - NULL server, name, handler or group
+ * - Unknown group
+ * - Maximum methods exceeded
+ *
+ * @see sockrpc_client_upload_begin
+ */
+int sockrpc_server_register_stream(sockrpc_server *server, const char *name,
+                                   rpc_stream_handler handler, const char *group);
+
+/**
+ * @brief Wait for the next chunk of an upload
+ * @param stream Stream passed to the handler
+ * @return Chunk (caller frees with cJSON_Delete), or NULL once the
+ *         upload has ended
+ *
+ * Blocks until the client sends a chunk or ends the upload. Consuming
+ * chunks lets the client send more; at most a small window of chunks
+ * is buffered per stream.
+ *
+ * Thread safety:
+ * - Call only from the handler the stream was passed to
+ */
+cJSON *sockrpc_stream_next(sockrpc_stream *stream);
+
+/**
+ * @brief Tell whether an upload ended abnormally
+ * @param stream Stream passed to the handler
+ * @return 1 if the client disconnected or broke flow control before
+ *         ending the upload, 0 otherwise
+ *
+ * Check after sockrpc_stream_next returned NULL to distinguish a
+ * complete upload from a truncated one.
+ */
+int sockrpc_stream_failed(sockrpc_stream *stream);
+
+/**
+ * @brief Register a method whose handler completes calls later
+ * @param server Server context
+ * @param name Method name
+ * @param handler Handler starting the call
+ * @param ctx Passed to every invocation of handler
+ * @return 0 on success, -1 on error
+ *
+ * Deferred handlers run on the I/O workers. Responses may be sent out
+ * of order relative to other requests on the connection; clients match
+ * them by id.
+ *
+ * Thread safety:
+ * - Thread-safe
+ * - Can be called before or after server start
+ *
+ * Error conditions (returns -1):
+ * - NULL server, name or handler
+ * - Maximum methods exceeded
+ *
+ * @see rpc_deferred_handler
+ */
+int sockrpc_server_register_deferred(sockrpc_server *server, const char *name,
+                                     rpc_deferred_handler handler, void *ctx);
+
+/**
+ * @brief Answer a deferred call
+ * @param call Call passed to a deferred handler
+ * @param result Result (ownership transferred), or NULL to send
+ *        "Handler failed"
+ *
+ * Sends the response and frees the call; the handler's params are
+ * freed with it. Every call must be completed exactly once, before the
+ * server is destroyed.
+ *
+ * Thread safety:
+ * - May be called from any thread
+ */
+void sockrpc_call_complete(sockrpc_call *call, cJSON *result);
+
+/**
+ * @brief Get a non-blocking client driven by the worker serving a call
+ * @param call Call passed to a deferred handler
+ * @param address Server address to call
+ * @return Client created by sockrpc_client_create_nonblocking, or NULL
+ *
+ * Each worker connects once per address and keeps the client for every
+ * call it serves. The worker writes submitted requests after its
+ * current batch of events and runs completion callbacks when responses
+ * arrive. If the connection fails, outstanding calls complete with
+ * NULL and the next sockrpc_call_client reconnects.
+ *
+ * The worker never waits on the network: the client is returned while
+ * its connection is still being established, requests submitted in the
+ * meantime are written once it completes, and they complete with NULL
+ * if it fails. Host names are not looked up on the worker, so TCP
+ * addresses must use a numeric host ("tcp://10.0.0.7:9000").
+ *
+ * Memory management:
+ * - The server owns the client: do not destroy it or drive its events
+ *
+ * Thread safety:
+ * - Call from the worker serving the call: in the handler, or in a
+ *   completion callback of a client returned here for the same worker
+ *
+ * Error conditions (returns NULL):
+ * - NULL call or address
+ * - TCP host name, socket failure, or 16 addresses already in use on
+ *   the worker
+ * - Server being destroyed (outstanding calls are completed with NULL)
+ */
+sockrpc_client *sockrpc_call_client(sockrpc_call *call, const char *address);
+
+/**
+ * @brief Queue a downstream call on behalf of a deferred call
+ * @param call Call passed to a deferred handler
+ * @param client Client returned by sockrpc_call_client for the call
+ * @param method Method name to call
+ * @param params JSON parameters (ownership transferred)
+ * @param callback Receives the result, may be NULL
+ * @param ctx Passed to callback
+ * @return 0 on success, -1 on error
+ *
+ * Same as sockrpc_client_submit, but the request carries the call's
+ * trace context wherever it is submitted from. sockrpc_client_submit
+ * only sends the thread's current context, which is the call's while
+ * its handler runs but not in completion callbacks, so calls chained
+ * from a callback would start a new trace.
+ *
+ * Memory management:
+ * - Takes ownership of params (freed even on error)
+ * - Callback takes ownership of result
+ *
+ * Thread safety:
+ * - Same as sockrpc_call_client
+ *
+ * Error conditions (returns -1, callback not invoked):
+ * - NULL call, and the conditions of sockrpc_client_submit
+ */
+int sockrpc_call_submit(sockrpc_call *call, sockrpc_client *client, const char *method,
+                        cJSON *params, sockrpc_completion_callback callback, void *ctx);
+
+/**
+ * @brief Create an empty response
+ * @return Response or NULL on allocation failure
+ *
+ * Memory management:
+ * - Returned from an rpc_response_handler, the server destroys it
+ * - Otherwise free with sockrpc_response_destroy
+ */
+sockrpc_response *sockrpc_response_create(void);
+
+/**
+ * @brief Append a fragment that outlives the response
+ * @param response Response
+ * @param data JSON text, e.g. a string literal; not copied
+ * @param len Length of data in bytes
+ * @return 0 on success, -1 on error
+ *
+ * Error conditions (returns -1):
+ * - NULL response or data
+ * - Memory allocation failure
+ *
+ * @note After any failed append the response is marked invalid and the
+ *       client receives "Handler failed" if it is returned anyway
+ */
+int sockrpc_response_add_static(sockrpc_response *response, const char *data, size_t len);
+
+/**
+ * @brief Append a borrowed fragment released after sending
+ * @param response Response
+ * @param data JSON text; not copied, must stay valid until release
+ * @param len Length of data in bytes
+ * @param release Called with ctx once data is no longer needed, or NULL
+ * @param ctx Context for release
+ * @return 0 on success, -1 on error
+ *
+ * release is called exactly once, even if the append fails (in that
+ * case before returning) or the response is never sent.
+ *
+ * Error conditions (returns -1):
+ * - NULL response or data
+ * - Memory allocation failure
+ */
+int sockrpc_response_add_borrowed(sockrpc_response *response, const char *data, size_t len,
+                                  sockrpc_release_fn release, void *ctx);
+
+/**
+ * @brief Append the JSON text of a cJSON item
+ * @param response Response
+ * @param item Item to print; not modified, may be freed after the call
+ * @return 0 on success, -1 on error
+ *
+ * For the small, dynamic parts of a response; the printed text is
+ * owned by the response.
+ *
+ * Error conditions (returns -1):
+ * - NULL response or item
+ * - Memory allocation failure
+ */
+int sockrpc_response_add_json(sockrpc_response *response, const cJSON *item);
+
+/**
+ * @brief Destroy a response, releasing its borrowed fragments
+ * @param response Response, may be NULL
+ */
+void sockrpc_response_destroy(sockrpc_response *response);
+
+/**
+ * @brief Create a named worker group
+ * @param server Server context
+ * @param name Group name used by sockrpc_server_register_in_group
+ * @param config Thread count, CPU set and queue limit
+ * @return 0 on success, -1 on error
+ *
+ * The group's threads start immediately and run until the server is
+ * destroyed. Requests for methods bound to the group are parsed on the
+ * I/O workers and queued to the group in arrival order.
+ *
+ * Thread safety:
+ * - Thread-safe
+ * - Can be called before or after server start
+ *
+ * Error conditions (returns -1):
+ * - NULL server, name or config
+ * - threads out of range or invalid CPU number
+ * - A group with the same name exists
+ * - Maximum groups (MAX_GROUPS) exceeded
+ * - Thread creation or pinning failure
+ *
+ * Example:
+ * @code
+ * int cpus[] = {2, 3};
+ * sockrpc_group_config heavy = {.threads = 2, .cpus = cpus,
+ *                               .num_cpus = 2, .queue_limit = 64};
+ * sockrpc_server_add_group(server, "heavy", &heavy);
+ * sockrpc_server_register_in_group(server, "multiply", handle_multiply, "heavy");
+ * @endcode
+ *
+ * @see sockrpc_group_config
+ */
+int sockrpc_server_add_group(sockrpc_server *server, const char *name,
+                             const sockrpc_group_config *config);
+
+/**
+ * @brief Register an RPC method bound to a worker group
+ * @param server Server context
+ * @param name Method name
+ * @param handler Function pointer to method handler
+ * @param group Name of a group created with sockrpc_server_add_group,
+ *        or NULL to run the method on the I/O workers
+ * @return 0 on success, -1 on error
+ *
+ * Same as sockrpc_server_register otherwise. Responses to grouped
+ * methods may overtake or be overtaken by responses to other requests
+ * on the same connection; they are matched by id.
+ *
+ * Thread safety:
+ * - Thread-safe
+ * - Can be called before or after server start
+ *
+ * Error conditions (returns -1):
+ * - NULL server, name or handler
+ * - Unknown group
+ * - Maximum methods exceeded
+ *
+ * @see sockrpc_server_add_group
+ */
+int sockrpc_server_register_in_group(sockrpc_server *server, const char *name,
+                                     rpc_handler handler, const char *group);
+
+/**
+ * @brief Load or reload a handler module
+ * @param server Server context
+ * @param path Path to a shared object exporting a sockrpc_module
+ * @return 0 on success, -1 on error
+ *
+ * Registers every method in the module's table. If a module was already
+ * loaded from the same path, it is replaced atomically: new requests go
+ * to the new version, methods the new version no longer exports are
+ * removed, and calls already running finish on the old version. The old
+ * shared object is unloaded once its last call returns. Connections are
+ * not affected.
+ *
+ * Thread safety:
+ * - Thread-safe
+ * - Can be called before or after server start
+ *
+ * Memory management:
+ * - Each load uses a private copy of the file, so the file may be
+ *   overwritten in place and reloaded
+ * - Results returned by module handlers must not point into the module
+ *
+ * Error conditions (returns -1, previous version stays installed):
+ * - NULL server or path
+ * - File not found or dlopen failure
+ * - Missing SOCKRPC_MODULE_SYMBOL or ABI version mismatch
+ * - Maximum methods or modules exceeded
+ *
+ * @note Methods keep the worker group they were registered in
+ * @note A method registered again after the module was loaded, e.g. with
+ *       sockrpc_server_register, belongs to the new registration: a
+ *       reload does not take it back and unloading does not remove it
+ *
+ * Example:
+ * @code
+ * // On deploy, e.g. from a SIGHUP handler thread
+ * if (sockrpc_server_load_module(server, "/opt/svc/handlers.so") == -1) {
+ *     // Old handlers remain active
+ * }
+ * @endcode
+ *
+ * @see sockrpc_module
+ */
+int sockrpc_server_load_module(sockrpc_server *server, const char *path);
+
+/**
+ * @brief Unload a handler module
+ * @param server Server context
+ * @param path Path the module was loaded from
+ * @return 0 on success, -1 if no module was loaded from path
+ *
+ * Removes the module's methods. The shared object is unloaded once calls
+ * already running have returned.
+ *
+ * Thread safety:
+ * - Thread-safe
+ */
+int sockrpc_server_unload_module(sockrpc_server *server, const char *path);
+
+/**
+ * @brief Set the smallest response compressed for a method
+ * @param server Server context
+ * @param method Registered method name, or NULL for the server default
+ * @param threshold Size in bytes (default SOCKRPC_COMPRESS_THRESHOLD),
+ *        0 to never compress
+ * @return 0 on success, -1 if method is not registered
+ *
+ * Compression only happens on connections where the client called
+ * sockrpc_client_enable_compression and both sides support a common
+ * codec. Responses that do not shrink are sent uncompressed. Use
+ * sockrpc_server_get_stats to see which methods benefit.
+ *
+ * Thread safety:
+ * - Thread-safe
+ * - Can be called before or after server start
+ *
+ * Example:
+ * @code
+ * // Large, repetitive listings compress well
+ * sockrpc_server_set_compression(server, "db_list", 256);
+ * // Already compressed blobs do not
+ * sockrpc_server_set_compression(server, "get_image", 0);
+ * @endcode
+ */
+int sockrpc_server_set_compression(sockrpc_server *server, const char *method, size_t threshold);
+
+/**
+ * @brief Set a Zstandard dictionary for compressed connections
+ * @param server Server context
+ * @param data Dictionary bytes, e.g. from "zstd --train" (copied)
+ * @param size Dictionary size
+ * @return 0 on success, -1 on error
+ *
+ * Small messages with repetitive keys compress much better with a
+ * dictionary. It is used on connections whose client passed the same
+ * dictionary to sockrpc_client_enable_compression.
+ *
+ * Thread safety:
+ * - Not thread-safe
+ * - Call before sockrpc_server_start
+ *
+ * Error conditions (returns -1):
+ * - NULL server or data, or size 0
+ * - Server already started
+ * - Library built without Zstandard support
+ */
+int sockrpc_server_set_compression_dictionary(sockrpc_server *server, const void *data,
+                                              size_t size);
+
+/**
+ * @brief Publish an event to every client subscribed to a topic
+ * @param server Server context
+ * @param topic Topic name
+ * @param event Event payload (not modified, not taken over)
+ * @return Number of subscribed connections, or -1 on error
+ *
+ * The event is serialized once into a shared frame that is queued to
+ * each subscriber and written without blocking the caller. Frames a
+ * socket cannot take right away are sent by the connection's I/O
+ * worker when it becomes writable. Each connection queues at most
+ * the limit set with sockrpc_server_set_subscriber_queue; beyond that
+ * the topic's overflow policy decides which event is lost. Events are
+ * never compressed, and a subscriber receives the events of one topic
+ * in publishing order.
+ *
+ * Thread safety:
+ * - Thread-safe, may be called from handlers
+ * - Publishes are serialized with each other
+ *
+ * Error conditions (returns -1):
+ * - NULL server, topic or event
+ * - Memory allocation failure
+ *
+ * Example:
+ * @code
+ * cJSON *event = cJSON_CreateObject();
+ * cJSON_AddStringToObject(event, "key", "users:42");
+ * sockrpc_server_publish(server, "invalidate", event);
+ * cJSON_Delete(event);
+ * @endcode
+ */
+int sockrpc_server_publish(sockrpc_server *server, const char *topic, const cJSON *event);
+
+/**
+ * @brief Set what happens to a topic's events when a queue is full
+ * @param server Server context
+ * @param topic Topic name
+ * @param policy Overflow policy (default SOCKRPC_OVERFLOW_DROP_OLDEST)
+ * @return 0 on success, -1 on error
+ *
+ * Thread safety:
+ * - Thread-safe
+ *
+ * Error conditions (returns -1):
+ * - NULL server or topic, unknown policy
+ * - Memory allocation failure
+ */
+int sockrpc_server_set_topic_policy(sockrpc_server *server, const char *topic,
+                                    sockrpc_overflow_policy policy);
+
+/**
+ * @brief Set how many events may wait on one subscriber connection
+ * @param server Server context
+ * @param limit Queue limit (default SOCKRPC_SUBSCRIBER_QUEUE)
+ * @return 0 on success, -1 on error
+ *
+ * Thread safety:
+ * - Not thread-safe
+ * - Call before sockrpc_server_start
+ *
+ * Error conditions (returns -1):
+ * - NULL server or limit 0
+ * - Server already started
+ */
+int sockrpc_server_set_subscriber_queue(sockrpc_server *server, size_t limit);
+
+/**
+ * @brief Record sampled requests as spans and export them to a file
+ * @param server Server context
+ * @param config Tracing configuration (copied)
+ * @return 0 on success, -1 on error
+ *
+ * Requests may carry trace context in a "trace" member (W3C
+ * traceparent). Whether or not tracing is enabled, the server continues
+ * that context while the handler runs, so client calls the handler
+ * makes on its thread carry the trace on to the next server. With
+ * tracing enabled, requests without context start a new trace, and
+ * sampled requests are recorded as server spans with the time spent
+ * queued, in the handler and sending the response. A background thread
+ * writes spans in batches; request threads never wait for the file,
+ * and spans are dropped if it falls far behind (see the "tracing" stats
+ * section).
+ *
+ * Thread safety:
+ * - Not thread-safe
+ * - Call before sockrpc_server_start
+ *
+ * Error conditions (returns -1):
+ * - NULL server, config or path, sample_rate outside 0 to 1
+ * - Server already started or tracing already enabled
+ * - The file cannot be opened
+ *
+ * @see sockrpc_trace_current
+ */
+int sockrpc_server_set_tracing(sockrpc_server *server, const sockrpc_trace_config *config);
+
+/**
+ * @brief Get the trace context of the call running on this thread
+ * @param buffer Receives the traceparent, e.g. for log correlation
+ * @param size Buffer size, at least SOCKRPC_TRACEPARENT_SIZE
+ * @return 0 on success, -1 outside a traced call or if the buffer is
+ *         too small
+ *
+ * Thread safety:
+ * - Thread-safe, reports the calling thread's context
+ */
+int sockrpc_trace_current(char *buffer, size_t size);
+
+/**
+ * @brief Capture incoming requests to a file for replay
+ * @param server Server context
+ * @param config Capture configuration (copied)
+ * @return 0 on success, -1 on error
+ *
+ * Every request frame the server receives is recorded, after
+ * decompression, with its arrival time and connection, so
+ * tools/sockrpc_replay can drive another server with the same traffic
+ * at its original pacing, scaled pacing or full speed. Requests are
+ * copied into memory buffers that a background thread writes out;
+ * request threads never wait for the file, and requests arriving while
+ * both buffers are full are left out (see the "capture" stats
+ * section). The file holds request contents: treat it as sensitive.
+ *
+ * Thread safety:
+ * - Not thread-safe
+ * - Call before sockrpc_server_start
+ *
+ * Error conditions (returns -1):
+ * - NULL server, config or path
+ * - Server already started or capture already enabled
+ * - The file cannot be created
+ */
+int sockrpc_server_set_capture(sockrpc_server *server, const sockrpc_capture_config *config);
+
+/**
+ * @brief Write the server's flight recorder to a file
+ * @param server Server context
+ * @param path Output file, replaced atomically
+ * @return Number of requests written, or -1 on error
+ *
+ * Every I/O worker and worker group thread keeps its last 4096
+ * completed requests in a fixed ring: method, connection, status,
+ * request and response sizes, dispatch time and the time spent before
+ * the handler, in it and sending the response. Recording takes no lock
+ * and allocates nothing, so it is always on. The dump is a compact
+ * binary file sorted by dispatch time; tools/sockrpc_frdump prints the
+ * slowest requests and per-method breakdowns from it.
  *
- * @note The server is not started automatically
- * @note The path length must not exceed sizeof(sun_path) - 1 bytes
- * @note Any existing socket file will be removed on server start
+ * Thread safety:
+ * - Thread-safe, requests recorded while dumping may be missing
  *
- * Example:
- * @code
- * sockrpc_server* server = sockrpc_server_create("/tmp/my_server.sock");
- * if (!server) {
- *     // Handle error
- *     return -1;
- * }
- * @endcode
+ * Error conditions (returns -1):
+ * - NULL server or path
+ * - The file cannot be written
  *
- * @see sockrpc_server_start
- * @see sockrpc_server_destroy
+ * @see sockrpc_server_set_dump_signal
  */
-sockrpc_server *sockrpc_server_create(const char *socket_path);
+int sockrpc_server_dump_requests(sockrpc_server *server, const char *path);
 
 /**
- * @brief Register an RPC method with the server
+ * @brief Dump the flight recorder to a file whenever SIGUSR2 arrives
  * @param server Server context
- * @param name Method name
- * @param handler Function pointer to method handler
+ * @param path Output file (copied), replaced on each dump
+ * @return 0 on success, -1 on error
+ *
+ * Installs a process-wide SIGUSR2 handler that only wakes a worker,
+ * which writes the file as sockrpc_server_dump_requests does, so a
+ * latency spike can be captured from outside with kill -USR2. Several
+ * servers of one process may enable it; a signal dumps all of them.
  *
  * Thread safety:
- * - Thread-safe
- * - Can be called before or after server start
- * - Can be called from multiple threads
+ * - Not thread-safe
+ * - Call before sockrpc_server_start
  *
- * Memory management:
- * - Server takes ownership of method name (creates copy)
- * - Handler function pointer must remain valid
- * - Previous handler for same name is replaced
+ * Error conditions (returns -1):
+ * - NULL server or path
+ * - Server already started or dumping already enabled
+ * - More than 16 servers dumping in the process
+ */
+int sockrpc_server_set_dump_signal(sockrpc_server *server, const char *path);
+
+/**
+ * @brief Collect server metrics
+ * @param server Server context
+ * @return New JSON object (caller frees with cJSON_Delete) or NULL
  *
- * Error conditions (silently returns):
- * - NULL server
- * - NULL name
- * - NULL handler
- * - Maximum methods exceeded
+ * Reports compression and buffer pool usage:
+ * @code
+ * {"compression": {
+ *     "requests": {"compressed": 0, "raw_bytes": 0, "wire_bytes": 0,
+ *                  "decompress_us": 0},
+ *     "methods": {"db_list": {"responses": 10, "compressed": 10,
+ *                             "raw_bytes": 81920, "wire_bytes": 9100,
+ *                             "ratio": 9.0, "compress_us": 310.5}}},
+ *  "buffers": {"hits": 980, "misses": 20, "hit_rate": 0.98, "huge": 0,
+ *              "in_use_bytes": 4096, "cached_bytes": 77824,
+ *              "resident_bytes": 81920},
+ *  "connections": {"open": 3, "accepted": 120},
+ *  "corking": {"responses": 4800, "writes": 75},
+ *  "busy_poll": {"spins": 500, "hits": 480, "hit_rate": 0.96,
+ *                "spin_us": 1200.5, "wasted_us": 310.0},
+ *  "pubsub": {"topics": 2, "subscriptions": 40, "published": 12,
+ *             "delivered": 470, "coalesced": 3, "dropped": 10,
+ *             "sent": 455},
+ *  "tracing": {"sample_rate": 0.01, "spans": 120, "exported": 118,
+ *              "dropped": 0, "batches": 9},
+ *  "recorder": {"threads": 6, "capacity": 24576, "recorded": 90210},
+ *  "capture": {"requests": 5000, "bytes": 412000, "dropped": 0,
+ *              "writes": 3}}
+ * @endcode
  *
- * @note Method names are case-sensitive
- * @note Maximum methods limited by MAX_METHODS constant
+ * The "tracing" section is present once tracing is enabled; spans not
+ * yet exported are still queued. "recorder" counts the flight
+ * recorder's rings, the requests they hold at most and the requests
+ * recorded since the server started. The "capture" section is present
+ * while requests are captured; "bytes" counts bytes written so far.
  *
- * Example:
- * @code
- * // Register a method
- * sockrpc_server_register(server, "echo", handle_echo);
+ * Method entries count responses sent on connections that negotiated
+ * compression, compressed or not. "corking" counts responses to
+ * pipelined requests that were collected and written together, and the
+ * writes that carried them.
  *
- * // Replace existing method
- * sockrpc_server_register(server, "echo", handle_echo_v2);
- * @endcode
+ * Buffers come from per-worker pools with 4 KiB, 64 KiB and 1 MiB size
+ * classes; larger ones ("huge") are mapped on demand and unmapped after
+ * use. A connection only holds an input buffer while part of a request
+ * is pending, so idle connections hold none. resident_bytes is the
+ * memory held by the pools, in use or cached for reuse.
  *
- * @see rpc_handler
+ * Thread safety:
+ * - Thread-safe
  */
-void sockrpc_server_register(sockrpc_server *server, const char *name, rpc_handler handler);
+cJSON *sockrpc_server_get_stats(sockrpc_server *server);
 
 /**
  * @brief Start the RPC server
  * @param server Server context
  *
  * Server startup process:
- * - Creates Unix domain socket
+ * - Uses an inherited LISTEN_FDS socket if present
+ * - Otherwise creates the Unix domain socket, or for TCP one
+ *   SO_REUSEPORT listener per worker thread
  * - Starts worker threads (NUM_WORKERS)
  * - Begins accepting client connections
  * - Returns immediately (server runs in background)
@@ -216,6 +1269,8 @@ void sockrpc_server_register(sockrpc_server *server, const char *name, rpc_handl
  * - Returns silently on socket creation failure
  * - Returns silently on bind failure
  * - Returns silently on thread creation failure
+ * - Does nothing in a "make EMBEDDED=1" build, which has no server
+ *   threads; use sockrpc_server_start_embedded() there
  *
  * @note Register methods before or after server start
  * @note Existing socket file is removed before binding
@@ -236,6 +1291,129 @@ void sockrpc_server_register(sockrpc_server *server, const char *name, rpc_handl
  */
 void sockrpc_server_start(sockrpc_server *server);
 
+/**
+ * @brief Start the RPC server on an already listening socket
+ * @param server Server context
+ * @param listen_fd Bound, listening Unix domain socket
+ * @return 0 on success, -1 on error
+ *
+ * Lets a supervisor pre-create the socket and start the server lazily.
+ * Connections made before the server starts wait in the kernel backlog
+ * and are served once the acceptor runs.
+ *
+ * sockrpc_server_start() calls this automatically when the process was
+ * started with LISTEN_PID/LISTEN_FDS set (socket activation), using the
+ * first passed descriptor (fd 3).
+ *
+ * The descriptor's flags, such as O_NONBLOCK, are left as they are,
+ * since a supervisor may still be accepting on the same socket. A
+ * blocking socket is accepted on once per readiness notification.
+ * If another process takes the connection in between, the acceptor
+ * waits in accept() for the next one.
+ *
+ * Thread safety:
+ * - Not thread-safe
+ * - Call only once per server instance, instead of sockrpc_server_start
+ *
+ * Memory management:
+ * - Server takes ownership of listen_fd and closes it on destroy
+ * - The socket file is never unlinked by the server
+ *
+ * Error conditions (returns -1):
+ * - NULL server or negative listen_fd
+ * - listen_fd is not a listening socket
+ * - Server already started
+ *
+ * Example:
+ * @code
+ * // fd received from a supervisor
+ * if (sockrpc_server_start_from_fd(server, fd) == -1) {
+ *     // Handle error
+ * }
+ * @endcode
+ *
+ * @see sockrpc_server_start
+ */
+int sockrpc_server_start_from_fd(sockrpc_server *server, int listen_fd);
+
+/**
+ * @brief Start the RPC server without threads, for an application's event loop
+ * @param server Server context
+ * @return 0 on success, -1 on error
+ *
+ * Opens the listener like sockrpc_server_start() (including an
+ * inherited LISTEN_FDS socket) but starts no worker or acceptor
+ * threads. The application watches sockrpc_server_get_fd() for
+ * readability in its own loop and calls sockrpc_server_process(),
+ * which accepts, reads, runs handlers and writes responses on the
+ * calling thread.
+ *
+ * Methods bound to worker groups still run on the groups' threads.
+ * Busy polling does not apply.
+ *
+ * A library built with "make EMBEDDED=1" (SOCKRPC_EMBEDDED_ONLY) only
+ * offers this mode: the server's locks are compiled out,
+ * sockrpc_server_start_from_fd() and sockrpc_server_add_group() return
+ * -1, and sockrpc_server_start() does nothing, as silently as its other
+ * failures.
+ *
+ * Thread safety:
+ * - Not thread-safe
+ * - Call only once per server instance, instead of sockrpc_server_start
+ * - In an EMBEDDED=1 build, call every server function from the thread
+ *   that calls sockrpc_server_process()
+ *
+ * Error conditions (returns -1):
+ * - NULL server or server already started
+ * - Address cannot be resolved, bound or listened on
+ *
+ * Example:
+ * @code
+ * sockrpc_server_start_embedded(server);
+ * struct pollfd pfd = {.fd = sockrpc_server_get_fd(server), .events = POLLIN};
+ * while (poll(&pfd, 1, -1) >= 0) {
+ *     sockrpc_server_process(server, 64);
+ * }
+ * @endcode
+ *
+ * @see sockrpc_server_process
+ */
+int sockrpc_server_start_embedded(sockrpc_server *server);
+
+/**
+ * @brief Returns the descriptor to poll for an embedded server
+ * @param server Server context started with sockrpc_server_start_embedded
+ * @return Descriptor that is readable while there is work, or -1 if the
+ *         server is not in embedded mode
+ *
+ * The descriptor is an epoll instance holding the listener and every
+ * connection; it can be added to poll, select or another epoll set.
+ * It stays valid until sockrpc_server_destroy(). Do not read from or
+ * close it.
+ */
+int sockrpc_server_get_fd(sockrpc_server *server);
+
+/**
+ * @brief Serves ready connections of an embedded server without blocking
+ * @param server Server context started with sockrpc_server_start_embedded
+ * @param max_events Most ready descriptors (listener or connections) to
+ *        handle in this call, at least 1
+ * @return Number of events handled, 0 if there was no work, -1 on error
+ *
+ * For each ready connection, every request received so far is read,
+ * dispatched and answered before moving on, exactly as on a worker
+ * thread; max_events bounds the connections served per call. Work left
+ * over keeps the descriptor readable, so the application's loop returns
+ * to it on the next iteration.
+ *
+ * Thread safety:
+ * - Call from one thread at a time; handlers run on the calling thread
+ *
+ * Error conditions (returns -1):
+ * - NULL server, server not in embedded mode, max_events < 1
+ */
+int sockrpc_server_process(sockrpc_server *server, int max_events);
+
 /**
  * @brief Destroy an RPC server instance
  * @param server Server context
@@ -244,7 +1422,8 @@ void sockrpc_server_start(sockrpc_server *server);
  * - Stops accepting new connections
  * - Waits for worker threads to finish
  * - Closes all client connections
- * - Removes socket file
+ * - Runs requests still queued to worker groups, then stops the groups
+ * - Removes socket file (unless the socket was inherited)
  * - Frees all allocated memory
  *
  * Thread safety:
@@ -275,7 +1454,9 @@ void sockrpc_server_destroy(sockrpc_server *server);
 
 /**
  * @brief Create a new RPC client instance
- * @param socket_path Path to the server's Unix domain socket
+ * @param socket_path Path to the server's Unix domain socket, "@name"
+ *        for a Linux abstract-namespace socket, or a transport URL such
+ *        as "tcp://127.0.0.1:9000"
  * @return Pointer to client context or NULL on error
  *
  * Initialization process:
@@ -295,6 +1476,7 @@ void sockrpc_server_destroy(sockrpc_server *server);
  *
  * @note Connection maintained until client destroyed
  * @note No automatic reconnection on failure
+ * @note TCP connections use TCP_NODELAY and keepalive probes
  *
  * Example:
  * @code
@@ -309,6 +1491,208 @@ void sockrpc_server_destroy(sockrpc_server *server);
  */
 sockrpc_client *sockrpc_client_create(const char *socket_path);
 
+/**
+ * @brief Create a new RPC client instance with an explicit socket type
+ * @param socket_path Path to the server's socket, or "@name"
+ * @param type Socket type, must match the server's
+ * @return Pointer to client context or NULL on error
+ *
+ * Same as sockrpc_client_create, which uses SOCKRPC_SOCK_STREAM.
+ *
+ * Example:
+ * @code
+ * sockrpc_client* client =
+ *     sockrpc_client_create_ex("@my_service", SOCKRPC_SOCK_SEQPACKET);
+ * @endcode
+ *
+ * @see sockrpc_server_set_socket_type
+ */
+sockrpc_client *sockrpc_client_create_ex(const char *socket_path, sockrpc_socket_type type);
+
+/**
+ * @brief Negotiate compression with the server
+ * @param client Client context
+ * @param dictionary Zstandard dictionary the server also uses, or NULL
+ * @param size Dictionary size
+ * @return 0 if a codec was agreed, -1 otherwise
+ *
+ * After a successful negotiation, requests of SOCKRPC_COMPRESS_THRESHOLD
+ * bytes or more are compressed and the server may compress responses.
+ * Fails if the library or the server was built without LZ4 and
+ * Zstandard support, or if the client is connected through
+ * sockrpc_proxy; calls keep working uncompressed in that case.
+ *
+ * Thread safety:
+ * - Thread-safe
+ * - Call once, right after sockrpc_client_create
+ *
+ * Example:
+ * @code
+ * sockrpc_client* client = sockrpc_client_create("/tmp/db.sock");
+ * sockrpc_client_enable_compression(client, NULL, 0);
+ * @endcode
+ */
+int sockrpc_client_enable_compression(sockrpc_client *client, const void *dictionary, size_t size);
+
+/**
+ * @brief Enable adaptive busy-polling while waiting for responses
+ * @param client Client context
+ * @param spin_us Longest time a call spins on the socket before blocking
+ *        in read, in microseconds; 0 disables spinning (default)
+ * @return 0 on success, -1 on error
+ *
+ * Same adaptive scheme as sockrpc_server_set_busy_poll. Pair with a
+ * busy-polling server on dedicated cores for the lowest round-trip
+ * latency.
+ *
+ * Thread safety:
+ * - Thread-safe
+ *
+ * Error conditions (returns -1):
+ * - NULL client
+ */
+int sockrpc_client_set_busy_poll(sockrpc_client *client, unsigned int spin_us);
+
+/**
+ * @brief Gather bursts of async calls into single writes
+ * @param client Client context
+ * @param window_us Longest time, in microseconds, a call made with
+ *        sockrpc_client_call_async waits for more calls to join its
+ *        batch; 0 stops coalescing (default)
+ * @param max_bytes Request bytes that send a batch before its window
+ *        closes, 0 for no limit
+ * @param max_calls Calls that send a batch before its window closes,
+ *        0 for no limit
+ * @return 0 on success, -1 on error
+ *
+ * Instead of a thread per call, async calls are handed to one
+ * coalescing thread per client. The first call of a batch opens the
+ * window; when it closes or a limit is reached, every gathered request
+ * is written with one call. The next batch does not wait for the
+ * responses: whichever thread reads a response matches it to its call
+ * by id, and the callbacks run on the coalescing thread in the order
+ * the responses arrive. Calls made meanwhile gather in the next batch.
+ * Call sites of sockrpc_client_call_async stay the same.
+ *
+ * A lone call waits up to window_us longer than before, so keep the
+ * window short (tens of microseconds) for latency-sensitive callers.
+ * Sync calls are not coalesced.
+ *
+ * Thread safety:
+ * - Not thread-safe with concurrent sockrpc_client_call_async; call
+ *   before making async calls, or while none are being made
+ * - Stopping waits until the gathered calls have been answered
+ * - Callbacks run on the coalescing thread; they may make calls on the
+ *   client and change the window or limits, but must not destroy the
+ *   client or stop coalescing
+ *
+ * Error conditions (returns -1):
+ * - NULL client
+ * - Non-blocking client (sockrpc_client_submit already writes together
+ *   the calls submitted between wakeups)
+ * - Seqpacket client, where every request is its own packet
+ * - window_us of 0 from a callback, on the coalescing thread
+ * - Thread creation failure
+ *
+ * Example:
+ * @code
+ * // Up to 50 us or 64 calls per write
+ * sockrpc_client_set_coalescing(client, 50, 0, 64);
+ * for (int i = 0; i < 1000; i++)
+ *     sockrpc_client_call_async(client, "log", make_entry(i), NULL);
+ * @endcode
+ *
+ * @see sockrpc_client_get_stats
+ */
+int sockrpc_client_set_coalescing(sockrpc_client *client, unsigned int window_us,
+                                  size_t max_bytes, unsigned int max_calls);
+
+/**
+ * @brief Collect client metrics
+ * @param client Client context
+ * @return New JSON object (caller frees with cJSON_Delete) or NULL
+ *
+ * @code
+ * {"busy_poll": {"spins": 100, "hits": 97, "hit_rate": 0.97,
+ *                "spin_us": 410.2, "wasted_us": 30.1},
+ *  "coalescing": {"calls": 1000, "batches": 16, "calls_per_write": 62.5}}
+ * @endcode
+ *
+ * The "coalescing" section is present while coalescing is enabled.
+ *
+ * Thread safety:
+ * - Thread-safe
+ */
+cJSON *sockrpc_client_get_stats(sockrpc_client *client);
+
+/**
+ * @brief Subscribe to a topic published by the server
+ * @param client Client context
+ * @param topic Topic name
+ * @param callback Function receiving the topic's events
+ * @param ctx Passed to callback
+ * @return 0 on success, -1 on error
+ *
+ * Events arrive on the client's connection at any time. They are read
+ * while a call waits for its response and by
+ * sockrpc_client_process_events, and delivered after the reading
+ * thread has released the connection, so callbacks may make calls.
+ * Callbacks of one client run one at a time, in arrival order.
+ * Subscribing again to a topic replaces its callback.
+ *
+ * Thread safety:
+ * - Thread-safe
+ *
+ * Memory management:
+ * - Topic copied internally
+ * - Callback takes ownership of each event
+ *
+ * Error conditions (returns -1):
+ * - NULL client, topic or callback
+ * - Connection failure or the server rejected the subscription
+ *
+ * Example:
+ * @code
+ * void on_invalidate(const char *topic, cJSON *event, void *ctx) {
+ *     cache_drop(ctx, cJSON_GetObjectItem(event, "key")->valuestring);
+ *     cJSON_Delete(event);
+ * }
+ *
+ * sockrpc_client_subscribe(client, "invalidate", on_invalidate, cache);
+ * while (running)
+ *     sockrpc_client_process_events(client, 1000);
+ * @endcode
+ */
+int sockrpc_client_subscribe(sockrpc_client *client, const char *topic,
+                             sockrpc_event_callback callback, void *ctx);
+
+/**
+ * @brief Unsubscribe from a topic
+ * @param client Client context
+ * @param topic Topic name
+ * @return 0 on success, -1 if not subscribed or on connection failure
+ *
+ * Events of the topic that were already received are discarded.
+ *
+ * Thread safety:
+ * - Thread-safe
+ */
+int sockrpc_client_unsubscribe(sockrpc_client *client, const char *topic);
+
+/**
+ * @brief Wait for events and deliver them to the subscription callbacks
+ * @param client Client context
+ * @param timeout_ms Longest wait in milliseconds, -1 to wait forever
+ * @return Number of events delivered, or -1 if the connection failed
+ *
+ * Returns after the first batch of events that arrived, or after the
+ * timeout. Calls made meanwhile from other threads proceed normally.
+ *
+ * Thread safety:
+ * - Thread-safe
+ */
+int sockrpc_client_process_events(sockrpc_client *client, int timeout_ms);
+
 /**
  * @brief Make a synchronous RPC call
  * @param client Client context
@@ -335,6 +1719,8 @@ sockrpc_client *sockrpc_client_create(const char *socket_path);
  *
  * @note Blocks until response received
  * @note Timeout depends on system socket timeout
+ * @note Called from a handler, the request carries the trace context of
+ *       the handler's call (see sockrpc_server_set_tracing)
  *
  * Example:
  * @code
@@ -362,7 +1748,9 @@ cJSON *sockrpc_client_call_sync(sockrpc_client *client, const char *method, cJSO
  * Thread safety:
  * - Thread-safe
  * - Multiple async calls can be active
- * - Callback runs in separate thread
+ * - Callback runs in separate thread, or on the coalescing thread
+ *   with sockrpc_client_set_coalescing
+ * - The calling thread's trace context goes with the request
  *
  * Memory management:
  * - Takes ownership of params (freed even on error)
@@ -400,6 +1788,188 @@ cJSON *sockrpc_client_call_sync(sockrpc_client *client, const char *method, cJSO
 void sockrpc_client_call_async(sockrpc_client *client, const char *method, cJSON *params,
                                void (*callback)(cJSON *result));
 
+/**
+ * @brief Create a client driven by the application's event loop
+ * @param socket_path Path to the server's socket, "@name", or a
+ *        unix:// or tcp:// URL
+ * @return Pointer to client context or NULL on error
+ *
+ * The socket is non-blocking from the start. A Unix connection is made
+ * before returning; a TCP connection usually is still being established
+ * and completes when the socket first becomes writable
+ * (sockrpc_client_wants_write() is true until then), so the caller
+ * never waits for an unreachable peer. Calls may be submitted at once.
+ * Host names in tcp:// URLs are looked up before returning, which may
+ * block; numeric addresses never do.
+ *
+ * Calls are queued with sockrpc_client_submit; the application watches
+ * sockrpc_client_fd() and calls sockrpc_client_on_readable() when it is
+ * readable and sockrpc_client_on_writable() when it is writable while
+ * sockrpc_client_wants_write() is true. Any number of calls may be
+ * outstanding; the client starts no threads and takes no locks.
+ *
+ * The blocking functions (sockrpc_client_call_sync, call_async,
+ * upload_begin, subscribe, process_events, enable_compression) fail on
+ * such a client. Published events are not delivered.
+ *
+ * Thread safety:
+ * - Not thread-safe: use each non-blocking client from one thread
+ *
+ * Error conditions (returns NULL):
+ * - Invalid address or seqpacket address
+ * - Unix connection failure, or TCP connection refused at once
+ *
+ * A TCP connection that fails later is reported like any connection
+ * failure: sockrpc_client_on_writable() or sockrpc_client_on_readable()
+ * returns -1 and every submitted call completes with NULL.
+ *
+ * Example:
+ * @code
+ * sockrpc_client *client = sockrpc_client_create_nonblocking("/tmp/db.sock");
+ * for (int i = 0; i < 1000; i++)
+ *     sockrpc_client_submit(client, "get", make_params(i), on_result, &items[i]);
+ *
+ * struct pollfd pfd = {.fd = sockrpc_client_fd(client)};
+ * while (waiting) {
+ *     pfd.events = POLLIN | (sockrpc_client_wants_write(client) ? POLLOUT : 0);
+ *     poll(&pfd, 1, -1);
+ *     if (pfd.revents & POLLOUT)
+ *         sockrpc_client_on_writable(client);
+ *     if (pfd.revents & (POLLIN | POLLHUP | POLLERR))
+ *         sockrpc_client_on_readable(client);
+ * }
+ * @endcode
+ *
+ * @see sockrpc_client_submit
+ */
+sockrpc_client *sockrpc_client_create_nonblocking(const char *socket_path);
+
+/**
+ * @brief Get the socket a non-blocking client's event loop watches
+ * @param client Client created by sockrpc_client_create_nonblocking
+ * @return Socket descriptor, or -1 for other clients
+ *
+ * Register it with the loop; do not read, write or close it.
+ */
+int sockrpc_client_fd(sockrpc_client *client);
+
+/**
+ * @brief Queue a call on a non-blocking client
+ * @param client Client created by sockrpc_client_create_nonblocking
+ * @param method Method name to call
+ * @param params JSON parameters (ownership transferred)
+ * @param callback Receives the result, may be NULL
+ * @param ctx Passed to callback
+ * @return 0 on success, -1 on error
+ *
+ * Frames the request into the client's output buffer without writing
+ * it, so requests submitted together go out in as few writes as
+ * possible. sockrpc_client_on_writable() sends them; calling it right
+ * after a batch of submits avoids waiting for a loop iteration.
+ *
+ * The callback runs from sockrpc_client_on_readable() once the response
+ * arrives, or with NULL when the connection fails or the client is
+ * destroyed. Callbacks may submit further calls, but must not destroy
+ * the client or call on_readable.
+ *
+ * Memory management:
+ * - Takes ownership of params (freed even on error)
+ * - Callback takes ownership of result
+ *
+ * Error conditions (returns -1, callback not invoked):
+ * - NULL client or method, client not in non-blocking mode
+ * - Connection already failed
+ * - Memory allocation failure
+ */
+int sockrpc_client_submit(sockrpc_client *client, const char *method, cJSON *params,
+                          sockrpc_completion_callback callback, void *ctx);
+
+/**
+ * @brief Check whether a non-blocking client has requests left to write
+ * @param client Client context
+ * @return Non-zero while the connection is being established or
+ *         submitted requests are not fully written
+ *
+ * Watch the socket for writability only while this is true.
+ */
+int sockrpc_client_wants_write(sockrpc_client *client);
+
+/**
+ * @brief Write submitted requests of a non-blocking client
+ * @param client Client created by sockrpc_client_create_nonblocking
+ * @return 0 once all requests are written, 1 if the socket filled up
+ *         first, -1 if the connection failed
+ *
+ * On failure every outstanding call completes with NULL.
+ */
+int sockrpc_client_on_writable(sockrpc_client *client);
+
+/**
+ * @brief Read responses of a non-blocking client and complete their calls
+ * @param client Client created by sockrpc_client_create_nonblocking
+ * @return Number of calls completed, or -1 if the connection failed
+ *
+ * Reads until the socket has no more data and runs the callback of
+ * every call whose response arrived, in arrival order. On EOF, a
+ * socket error or a malformed frame, every outstanding call completes
+ * with NULL and -1 is returned; the client stays usable only for
+ * sockrpc_client_destroy().
+ */
+int sockrpc_client_on_readable(sockrpc_client *client);
+
+/**
+ * @brief Begin a client-streaming call
+ * @param client Client context
+ * @param method Method registered with sockrpc_server_register_stream
+ * @param params JSON parameters (ownership transferred, may be NULL)
+ * @return Upload handle or NULL on error
+ *
+ * Send the input with sockrpc_upload_send and collect the result with
+ * sockrpc_upload_finish. The server handler starts right away and
+ * processes chunks as they arrive.
+ *
+ * Thread safety:
+ * - The connection is reserved for the upload: other calls on the
+ *   client wait until sockrpc_upload_finish returns
+ * - Send and finish from the thread that began the upload
+ *
+ * Error conditions (returns NULL):
+ * - NULL client or method
+ * - Connection failure
+ * - Memory allocation failure
+ *
+ * Example:
+ * @code
+ * sockrpc_upload* upload = sockrpc_client_upload_begin(client, "sum", NULL);
+ * while (read_batch(input, &batch))
+ *     if (sockrpc_upload_send(upload, batch_to_json(&batch)) == -1)
+ *         break;
+ * cJSON* result = sockrpc_upload_finish(upload);
+ * @endcode
+ */
+sockrpc_upload *sockrpc_client_upload_begin(sockrpc_client *client, const char *method,
+                                            cJSON *params);
+
+/**
+ * @brief Send one chunk of an upload
+ * @param upload Upload handle
+ * @param chunk Chunk (ownership transferred, freed even on error)
+ * @return 0 on success, -1 if the upload failed or the server already
+ *         answered
+ *
+ * Blocks while the server has not yet consumed a window of earlier
+ * chunks. After -1, call sockrpc_upload_finish for the result or error.
+ */
+int sockrpc_upload_send(sockrpc_upload *upload, cJSON *chunk);
+
+/**
+ * @brief End an upload and wait for the result
+ * @param upload Upload handle (freed)
+ * @return Result (caller frees) or NULL on error responses and
+ *         connection failures
+ */
+cJSON *sockrpc_upload_finish(sockrpc_upload *upload);
+
 /**
  * @brief Destroy an RPC client instance
  * @param client Client context
@@ -430,4 +2000,8 @@ void sockrpc_client_call_async(sockrpc_client *client, const char *method, cJSON
  */
 void sockrpc_client_destroy(sockrpc_client *client);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif /* SOCKRPC_H */
\ No newline at end of file
@@ -0,0 +1,882 @@
+#ifndef SOCKRPC_HPP
+#define SOCKRPC_HPP
+
+#include <cmath>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "sockrpc/sockrpc.h"
+
+/**
+ * @file sockrpc.hpp
+ * @brief Header-only C++20 bindings of SockRPC: coroutines and typed methods
+ *
+ * Calls on non-blocking clients become awaitable, and server methods
+ * can be coroutines that await downstream calls:
+ *
+ * @code
+ * sockrpc::task profile(sockrpc::context ctx, cJSON* params) {
+ *     // Both requests are in flight before the first co_await
+ *     auto user = ctx.call("/tmp/users.sock", "get", sockrpc::json(cJSON_Duplicate(params, 1)));
+ *     auto orders = ctx.call("/tmp/orders.sock", "list", sockrpc::json(cJSON_Duplicate(params, 1)));
+ *
+ *     sockrpc::json result(cJSON_CreateObject());
+ *     cJSON_AddItemToObject(result.get(), "user", (co_await user).release());
+ *     cJSON_AddItemToObject(result.get(), "orders", (co_await orders).release());
+ *     co_return result;
+ * }
+ *
+ * sockrpc::register_coroutine<profile>(server, "profile");
+ * @endcode
+ *
+ * Method coroutines are deferred handlers (see rpc_deferred_handler):
+ * they start on the I/O worker that owns the connection and are resumed
+ * on that worker whenever a downstream response arrives, so no thread
+ * ever blocks on a call and the frame is the only per-call state.
+ *
+ * On the client side a sockrpc::client wraps a non-blocking client
+ * driven by the application's event loop; sockrpc::job coroutines
+ * await its calls and resume from client::on_readable().
+ *
+ * Typed methods turn plain functions into handlers. The parameter
+ * decoding, validation and result encoding are generated for the
+ * function's signature and its field names, hashed at compile time:
+ *
+ * @code
+ * int add(int a, int b) { return a + b; }
+ * std::string greet(std::string name, std::optional<int> times);
+ *
+ * static constexpr rpc_method methods[] = {
+ *     sockrpc::typed_method<"add", add, "a", "b">(),
+ *     sockrpc::typed_method<"greet", greet, "name", "times">(),
+ *     {nullptr, nullptr}};
+ *
+ * sockrpc::register_methods(server, methods);  // or SOCKRPC_MODULE(methods)
+ * @endcode
+ *
+ * Ownership follows the C API: every cJSON tree handed over or returned
+ * is a sockrpc::json, which deletes it unless released.
+ */
+
+namespace sockrpc
+{
+
+/**
+ * @brief Deleter of cJSON trees owned by sockrpc::json
+ */
+struct json_deleter
+{
+    /** @brief Deletes a tree, NULL is ignored */
+    void operator()(cJSON *item) const noexcept
+    {
+        cJSON_Delete(item);
+    }
+};
+
+/**
+ * @brief Owned cJSON tree
+ */
+using json = std::unique_ptr<cJSON, json_deleter>;
+
+/**
+ * @brief Call in flight on a non-blocking client, awaited for its result
+ *
+ * The request is submitted when the pending call is created, so calls
+ * started one after another run concurrently and are awaited later in
+ * any order. Awaiting yields the result, or an empty json if the server
+ * answered with an error, the connection failed or the call could not
+ * be submitted. Abandoning a pending call without awaiting it discards
+ * its result when it arrives.
+ */
+class pending
+{
+public:
+    /**
+     * @brief Submits a call
+     * @param client Non-blocking client, NULL fails the call
+     * @param method Method name
+     * @param params Parameters, may be empty
+     */
+    pending(sockrpc_client *client, const char *method, json params)
+        : state_(new state)
+    {
+        if (sockrpc_client_submit(client, method, params.release(), complete, state_) == -1)
+            state_->done = true;
+    }
+
+    /**
+     * @brief Submits a downstream call carrying a deferred call's trace
+     * @param call Deferred call the downstream call serves
+     * @param client Client from sockrpc_call_client, NULL fails the call
+     * @param method Method name
+     * @param params Parameters, may be empty
+     */
+    pending(sockrpc_call *call, sockrpc_client *client, const char *method, json params)
+        : state_(new state)
+    {
+        if (sockrpc_call_submit(call, client, method, params.release(), complete, state_) == -1)
+            state_->done = true;
+    }
+
+    pending(pending &&other) noexcept : state_(std::exchange(other.state_, nullptr))
+    {
+    }
+
+    pending &operator=(pending &&) = delete;
+
+    ~pending()
+    {
+        if (state_ && !state_->done)
+            state_->abandoned = true; // Freed by the completion
+        else
+            delete state_;
+    }
+
+    /** @brief True once the result arrived */
+    bool await_ready() const noexcept
+    {
+        return state_->done;
+    }
+
+    /** @brief Resumes the coroutine from the completion callback */
+    void await_suspend(std::coroutine_handle<> waiter) noexcept
+    {
+        state_->waiter = waiter;
+    }
+
+    /** @brief Takes the result, empty on failure */
+    json await_resume() noexcept
+    {
+        return std::move(state_->result);
+    }
+
+private:
+    /**
+     * @brief Result shared by the awaiter and the completion callback
+     */
+    struct state
+    {
+        json result;                    /**< Result once done */
+        std::coroutine_handle<> waiter; /**< Coroutine to resume, if awaiting */
+        bool done = false;              /**< Completion ran or submit failed */
+        bool abandoned = false;         /**< Awaiter is gone, free on completion */
+    };
+
+    static void complete(cJSON *result, void *ctx)
+    {
+        state *s = static_cast<state *>(ctx);
+        if (s->abandoned)
+        {
+            cJSON_Delete(result);
+            delete s;
+            return;
+        }
+
+        s->result.reset(result);
+        s->done = true;
+        if (s->waiter)
+            s->waiter.resume();
+    }
+
+    state *state_;
+};
+
+/**
+ * @brief Owned non-blocking client, driven by the application's loop
+ *
+ * Register fd() with the loop, call on_writable() while wants_write()
+ * and on_readable() when the socket is readable; coroutines awaiting
+ * calls resume from on_readable(). Destroying the client resumes them
+ * with empty results.
+ */
+class client
+{
+public:
+    /**
+     * @brief Connects to a server
+     * @param address Server address, as for sockrpc_client_create
+     * @throws std::runtime_error if the address is invalid or the
+     *         connection fails at once; a TCP connection failing while
+     *         it is established resumes the calls with empty results
+     */
+    explicit client(const char *address) : client_(sockrpc_client_create_nonblocking(address))
+    {
+        if (!client_)
+            throw std::runtime_error(std::string("sockrpc: cannot connect to ") + address);
+    }
+
+    /** @brief Starts a call, see sockrpc::pending */
+    pending call(const char *method, json params = nullptr)
+    {
+        return pending(client_.get(), method, std::move(params));
+    }
+
+    /** @brief Socket for the event loop */
+    int fd() const noexcept
+    {
+        return sockrpc_client_fd(client_.get());
+    }
+
+    /** @brief True while requests are waiting to be written */
+    bool wants_write() const noexcept
+    {
+        return sockrpc_client_wants_write(client_.get()) != 0;
+    }
+
+    /** @brief See sockrpc_client_on_writable */
+    int on_writable() noexcept
+    {
+        return sockrpc_client_on_writable(client_.get());
+    }
+
+    /** @brief See sockrpc_client_on_readable; resumes awaiting coroutines */
+    int on_readable() noexcept
+    {
+        return sockrpc_client_on_readable(client_.get());
+    }
+
+    /** @brief The underlying C client */
+    sockrpc_client *get() const noexcept
+    {
+        return client_.get();
+    }
+
+private:
+    struct deleter
+    {
+        void operator()(sockrpc_client *c) const noexcept
+        {
+            sockrpc_client_destroy(c);
+        }
+    };
+
+    std::unique_ptr<sockrpc_client, deleter> client_;
+};
+
+/**
+ * @brief Fire-and-forget coroutine, e.g. a client-side request flow
+ *
+ * Starts running when called and frees itself when it finishes. An
+ * exception escaping it terminates the program.
+ */
+struct job
+{
+    /** @brief Coroutine promise of sockrpc::job */
+    struct promise_type
+    {
+        job get_return_object() noexcept
+        {
+            return {};
+        }
+        std::suspend_never initial_suspend() noexcept
+        {
+            return {};
+        }
+        std::suspend_never final_suspend() noexcept
+        {
+            return {};
+        }
+        void return_void() noexcept
+        {
+        }
+        void unhandled_exception() noexcept
+        {
+            std::terminate();
+        }
+    };
+};
+
+/**
+ * @brief Server call being answered by a method coroutine
+ *
+ * Cheap to copy; valid until the coroutine returns.
+ */
+class context
+{
+public:
+    /** @brief Wraps a call passed to a deferred handler */
+    explicit context(sockrpc_call *call) noexcept : call_(call)
+    {
+    }
+
+    /**
+     * @brief Starts a call on the worker's client for an address
+     * @param address Downstream server address
+     * @param method Method name
+     * @param params Parameters, may be empty
+     * @return Pending call, resumed on this worker
+     *
+     * See sockrpc_call_client; a connection failure or a TCP host
+     * name yields an empty result when awaited.
+     */
+    pending call(const char *address, const char *method, json params = nullptr) const
+    {
+        return pending(call_, sockrpc_call_client(call_, address), method, std::move(params));
+    }
+
+    /** @brief The underlying C call */
+    sockrpc_call *get() const noexcept
+    {
+        return call_;
+    }
+
+private:
+    sockrpc_call *call_;
+};
+
+/**
+ * @brief Coroutine answering a server call with its co_return value
+ *
+ * Returning an empty json, or letting an exception escape, sends
+ * "Handler failed".
+ */
+class task
+{
+public:
+    /** @brief Coroutine promise of sockrpc::task */
+    struct promise_type
+    {
+        sockrpc_call *call = nullptr; /**< Call to answer, set before the start */
+
+        task get_return_object() noexcept
+        {
+            return task(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        std::suspend_always initial_suspend() noexcept
+        {
+            return {};
+        }
+        std::suspend_never final_suspend() noexcept
+        {
+            return {};
+        }
+        void return_value(json result) noexcept
+        {
+            sockrpc_call_complete(call, result.release());
+        }
+        void unhandled_exception() noexcept
+        {
+            sockrpc_call_complete(call, nullptr);
+        }
+    };
+
+    task(task &&other) noexcept : handle_(std::exchange(other.handle_, nullptr))
+    {
+    }
+
+    task &operator=(task &&) = delete;
+
+    ~task()
+    {
+        if (handle_)
+            handle_.destroy();
+    }
+
+    /**
+     * @brief Runs the coroutine for a call until its first suspension
+     * @param call Call the co_return value answers
+     *
+     * The frame frees itself when the coroutine finishes.
+     */
+    void start(sockrpc_call *call) noexcept
+    {
+        std::coroutine_handle<promise_type> handle = std::exchange(handle_, nullptr);
+        handle.promise().call = call;
+        handle.resume();
+    }
+
+private:
+    explicit task(std::coroutine_handle<promise_type> handle) noexcept : handle_(handle)
+    {
+    }
+
+    std::coroutine_handle<promise_type> handle_;
+};
+
+/**
+ * @brief Signature of method coroutines
+ */
+using coroutine_handler = task (*)(context ctx, cJSON *params);
+
+namespace detail
+{
+
+/**
+ * @brief Deferred handler starting the coroutine Handler
+ */
+template <coroutine_handler Handler>
+void run_coroutine(cJSON *params, sockrpc_call *call, void *) noexcept
+{
+    try
+    {
+        Handler(context(call), params).start(call);
+    }
+    catch (...)
+    {
+        // The frame could not be allocated
+        sockrpc_call_complete(call, nullptr);
+    }
+}
+
+} // namespace detail
+
+/**
+ * @brief Registers a method coroutine
+ * @tparam Handler Coroutine answering the method
+ * @param server Server context
+ * @param name Method name
+ * @return 0 on success, -1 on error, as sockrpc_server_register_deferred
+ */
+template <coroutine_handler Handler>
+int register_coroutine(sockrpc_server *server, const char *name)
+{
+    return sockrpc_server_register_deferred(server, name, detail::run_coroutine<Handler>, nullptr);
+}
+
+/**
+ * @brief String literal usable as a template argument
+ */
+template <std::size_t N>
+struct fixed_string
+{
+    char value[N]; /**< Characters including the terminating NUL */
+
+    /** @brief Copies a string literal */
+    constexpr fixed_string(const char (&text)[N]) noexcept
+    {
+        for (std::size_t i = 0; i < N; i++)
+            value[i] = text[i];
+    }
+};
+
+/**
+ * @brief FNV-1a hash of a NUL-terminated name, at compile or run time
+ * @param name Name
+ * @return 32-bit hash
+ */
+constexpr std::uint32_t hash_name(const char *name) noexcept
+{
+    std::uint32_t hash = 2166136261u;
+    for (; *name; name++)
+        hash = (hash ^ static_cast<unsigned char>(*name)) * 16777619u;
+    return hash;
+}
+
+/**
+ * @brief Conversion between a C++ type and JSON, specialized per type
+ *
+ * Each specialization provides
+ * - bool decode(const cJSON *item, T &out): false if item does not hold
+ *   a valid T (wrong JSON type, out of range, not an integer)
+ * - cJSON *encode(const T &value): new item, NULL on allocation failure
+ *
+ * Supported: bool, integers, floating point, std::string,
+ * std::string_view and const char * (borrowed from the request),
+ * const cJSON * (any value, borrowed), sockrpc::json (result only),
+ * std::optional and std::vector of supported types. Specialize it for
+ * application types.
+ */
+template <typename T, typename = void>
+struct value_traits;
+
+/** @brief JSON true or false */
+template <>
+struct value_traits<bool>
+{
+    static bool decode(const cJSON *item, bool &out) noexcept
+    {
+        out = cJSON_IsTrue(item);
+        return cJSON_IsBool(item);
+    }
+    static cJSON *encode(bool value) noexcept
+    {
+        return cJSON_CreateBool(value);
+    }
+};
+
+/** @brief JSON number without fraction, within the range of T */
+template <typename T>
+struct value_traits<T, std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool>>>
+{
+    static bool decode(const cJSON *item, T &out) noexcept
+    {
+        if (!cJSON_IsNumber(item))
+            return false;
+        double value = item->valuedouble;
+        if (value != std::trunc(value) || value < static_cast<double>(std::numeric_limits<T>::min()) ||
+            value > static_cast<double>(std::numeric_limits<T>::max()))
+            return false;
+        out = static_cast<T>(value);
+        return true;
+    }
+    static cJSON *encode(T value) noexcept
+    {
+        return cJSON_CreateNumber(static_cast<double>(value));
+    }
+};
+
+/** @brief Any JSON number */
+template <typename T>
+struct value_traits<T, std::enable_if_t<std::is_floating_point_v<T>>>
+{
+    static bool decode(const cJSON *item, T &out) noexcept
+    {
+        out = static_cast<T>(item ? item->valuedouble : 0);
+        return cJSON_IsNumber(item);
+    }
+    static cJSON *encode(T value) noexcept
+    {
+        return cJSON_CreateNumber(static_cast<double>(value));
+    }
+};
+
+/** @brief JSON string, copied */
+template <>
+struct value_traits<std::string>
+{
+    static bool decode(const cJSON *item, std::string &out)
+    {
+        if (!cJSON_IsString(item))
+            return false;
+        out = item->valuestring;
+        return true;
+    }
+    static cJSON *encode(const std::string &value) noexcept
+    {
+        return cJSON_CreateString(value.c_str());
+    }
+};
+
+/** @brief JSON string, borrowed from the request */
+template <>
+struct value_traits<std::string_view>
+{
+    static bool decode(const cJSON *item, std::string_view &out) noexcept
+    {
+        if (!cJSON_IsString(item))
+            return false;
+        out = item->valuestring;
+        return true;
+    }
+    static cJSON *encode(std::string_view value)
+    {
+        return value_traits<std::string>::encode(std::string(value));
+    }
+};
+
+/** @brief JSON string, borrowed from the request; NULL encodes as null */
+template <>
+struct value_traits<const char *>
+{
+    static bool decode(const cJSON *item, const char *&out) noexcept
+    {
+        out = cJSON_IsString(item) ? item->valuestring : nullptr;
+        return out != nullptr;
+    }
+    static cJSON *encode(const char *value) noexcept
+    {
+        return value ? cJSON_CreateString(value) : cJSON_CreateNull();
+    }
+};
+
+/** @brief Any JSON value, borrowed from the request; encoded as a copy */
+template <>
+struct value_traits<const cJSON *>
+{
+    static bool decode(const cJSON *item, const cJSON *&out) noexcept
+    {
+        out = item;
+        return item != nullptr;
+    }
+    static cJSON *encode(const cJSON *value) noexcept
+    {
+        return cJSON_Duplicate(value, 1);
+    }
+};
+
+/** @brief Result tree built by the function; empty fails the call */
+template <>
+struct value_traits<json>
+{
+    static cJSON *encode(json &value) noexcept
+    {
+        return value.release();
+    }
+};
+
+/** @brief Missing field or JSON null as std::nullopt */
+template <typename T>
+struct value_traits<std::optional<T>>
+{
+    static bool decode(const cJSON *item, std::optional<T> &out)
+    {
+        if (!item || cJSON_IsNull(item))
+        {
+            out.reset();
+            return true;
+        }
+        return value_traits<T>::decode(item, out.emplace());
+    }
+    static cJSON *encode(const std::optional<T> &value)
+    {
+        return value ? value_traits<T>::encode(*value) : cJSON_CreateNull();
+    }
+};
+
+/** @brief JSON array whose elements all hold a T */
+template <typename T>
+struct value_traits<std::vector<T>>
+{
+    static bool decode(const cJSON *item, std::vector<T> &out)
+    {
+        if (!cJSON_IsArray(item))
+            return false;
+        out.resize(static_cast<std::size_t>(cJSON_GetArraySize(item)));
+        std::size_t i = 0;
+        for (const cJSON *element = item->child; element; element = element->next)
+        {
+            if (!value_traits<T>::decode(element, out[i++]))
+                return false;
+        }
+        return true;
+    }
+    static cJSON *encode(const std::vector<T> &value)
+    {
+        cJSON *array = cJSON_CreateArray();
+        for (std::size_t i = 0; array && i < value.size(); i++)
+        {
+            cJSON *element = value_traits<T>::encode(value[i]);
+            if (!element || !cJSON_AddItemToArray(array, element))
+            {
+                cJSON_Delete(element);
+                cJSON_Delete(array);
+                return nullptr;
+            }
+        }
+        return array;
+    }
+};
+
+namespace detail
+{
+
+/**
+ * @brief Result and decayed parameter types of a function pointer
+ */
+template <typename F>
+struct function_traits;
+
+template <typename R, typename... A>
+struct function_traits<R (*)(A...)>
+{
+    using result = R;
+    using args = std::tuple<std::remove_cvref_t<A>...>;
+    static constexpr std::size_t arity = sizeof...(A);
+};
+
+template <typename R, typename... A>
+struct function_traits<R (*)(A...) noexcept> : function_traits<R (*)(A...)>
+{
+};
+
+/**
+ * @brief Hash of a field name, computed once at compile time
+ */
+template <fixed_string Name>
+inline constexpr std::uint32_t name_hash = hash_name(Name.value);
+
+/**
+ * @brief Checks that field names hash to distinct values
+ */
+template <fixed_string... Names>
+consteval bool distinct_hashes()
+{
+    std::uint32_t hashes[] = {0, name_hash<Names>...};
+    for (std::size_t i = 1; i < sizeof(hashes) / sizeof(hashes[0]); i++)
+    {
+        for (std::size_t j = 1; j < i; j++)
+        {
+            if (hashes[i] == hashes[j])
+                return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Stores a params member in the slot of the field it names
+ * @param member Member of the params object
+ * @param hash hash_name of its key
+ * @param items Slot per field
+ */
+template <fixed_string... Names, std::size_t... I>
+void match_field(const cJSON *member, std::uint32_t hash, const cJSON **items,
+                 std::index_sequence<I...>) noexcept
+{
+    // Only a hash match costs a string comparison
+    (void)((hash == name_hash<Names> && std::strcmp(member->string, Names.value) == 0 &&
+            (items[I] = member, true)) ||
+           ...);
+}
+
+/**
+ * @brief Finds the fields of a call in one pass over its params
+ * @param params Object (fields by name) or array (fields by position)
+ * @param items Set to each field's item, NULL where missing
+ * @return false if params is neither, or an array with extra elements
+ *
+ * Object members are matched by key, case-sensitively; unknown members
+ * are ignored.
+ */
+template <fixed_string... Names>
+bool collect_fields(const cJSON *params, const cJSON **items) noexcept
+{
+    constexpr std::size_t count = sizeof...(Names);
+    if (cJSON_IsArray(params))
+    {
+        std::size_t i = 0;
+        for (const cJSON *element = params->child; element; element = element->next)
+        {
+            if (i == count)
+                return false;
+            items[i++] = element;
+        }
+        return true;
+    }
+
+    if (cJSON_IsObject(params))
+    {
+        for (const cJSON *member = params->child; member; member = member->next)
+        {
+            if (member->string)
+                match_field<Names...>(member, hash_name(member->string), items,
+                                      std::make_index_sequence<count>());
+        }
+        return true;
+    }
+
+    return !params || cJSON_IsNull(params);
+}
+
+/**
+ * @brief Decodes every field into the argument tuple
+ * @return false if a field is missing (and not optional) or invalid
+ */
+template <typename Args, std::size_t... I>
+bool decode_fields(Args &args, const cJSON *const *items, std::index_sequence<I...>)
+{
+    return (value_traits<std::tuple_element_t<I, Args>>::decode(items[I], std::get<I>(args)) &&
+            ...);
+}
+
+/**
+ * @brief rpc_handler generated for a function and its field names
+ *
+ * Returns NULL ("Handler failed") if params do not validate, the
+ * function throws, or the result cannot be encoded. A void function
+ * answers null.
+ */
+template <auto Fn, fixed_string... Names>
+cJSON *typed_handler(cJSON *params) noexcept
+{
+    using traits = function_traits<decltype(Fn)>;
+    using result = typename traits::result;
+    static_assert(sizeof...(Names) == traits::arity, "one field name per parameter");
+    static_assert(distinct_hashes<Names...>(), "field names must have distinct hashes");
+
+    const cJSON *items[sizeof...(Names) + 1] = {};
+    if (!collect_fields<Names...>(params, items))
+        return nullptr;
+
+    try
+    {
+        typename traits::args args;
+        if (!decode_fields(args, items, std::make_index_sequence<traits::arity>()))
+            return nullptr;
+
+        if constexpr (std::is_void_v<result>)
+        {
+            std::apply(Fn, std::move(args));
+            return cJSON_CreateNull();
+        }
+        else
+        {
+            std::remove_cvref_t<result> value = std::apply(Fn, std::move(args));
+            return value_traits<std::remove_cvref_t<result>>::encode(value);
+        }
+    }
+    catch (...)
+    {
+        return nullptr;
+    }
+}
+
+} // namespace detail
+
+/**
+ * @brief Method table entry for a typed function
+ * @tparam Name Method name
+ * @tparam Fn Function (pointer); parameters and result need value_traits
+ * @tparam Fields Name of each parameter, in order
+ * @return Entry usable in a constexpr rpc_method table
+ *
+ * Params may be an object with the named fields or an array in
+ * parameter order. Missing fields are only accepted for std::optional
+ * parameters. Invalid params answer "Handler failed".
+ */
+template <fixed_string Name, auto Fn, fixed_string... Fields>
+constexpr rpc_method typed_method() noexcept
+{
+    return {Name.value, detail::typed_handler<Fn, Fields...>};
+}
+
+/**
+ * @brief Registers a typed function as a method
+ * @tparam Fn Function (pointer)
+ * @tparam Fields Name of each parameter, in order
+ * @param server Server context
+ * @param name Method name
+ * @param group Worker group, or NULL to run on the I/O workers
+ * @return 0 on success, -1 on error, as sockrpc_server_register_in_group
+ */
+template <auto Fn, fixed_string... Fields>
+int register_typed(sockrpc_server *server, const char *name, const char *group = nullptr)
+{
+    return sockrpc_server_register_in_group(server, name, detail::typed_handler<Fn, Fields...>,
+                                            group);
+}
+
+/**
+ * @brief Registers every method of a table terminated by {NULL, NULL}
+ * @param server Server context
+ * @param methods Method table, e.g. of typed_method entries
+ * @param group Worker group, or NULL to run on the I/O workers
+ * @return 0 on success, -1 if any registration failed
+ */
+inline int register_methods(sockrpc_server *server, const rpc_method *methods,
+                            const char *group = nullptr)
+{
+    int rc = 0;
+    for (; methods && methods->name; methods++)
+    {
+        if (sockrpc_server_register_in_group(server, methods->name, methods->handler, group) == -1)
+            rc = -1;
+    }
+    return rc;
+}
+
+} // namespace sockrpc
+
+#endif /* SOCKRPC_HPP */
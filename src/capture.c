@@ -0,0 +1,288 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "capture.h"
+
+/**
+ * @file capture.c
+ * @brief Implementation of the traffic capture writer
+ */
+
+/**
+ * @brief Default size of each of the two capture buffers
+ */
+#define CAPTURE_DEFAULT_BUFFER (1024 * 1024)
+
+/**
+ * @brief Longest time a captured request stays in memory, in milliseconds
+ */
+#define CAPTURE_FLUSH_MS 200
+
+_Static_assert(sizeof(capture_header) == 24, "capture_header layout");
+_Static_assert(sizeof(capture_record) == 24, "capture_record layout");
+
+struct capture_writer
+{
+    int fd;                 /**< Capture file */
+    char *buffers[2];       /**< Filling and writing buffers */
+    size_t size;            /**< Capacity of each buffer */
+    int active;             /**< Buffer requests are copied into */
+    size_t used;            /**< Bytes in the active buffer */
+    int pending;            /**< Buffer handed to the writer, or -1 */
+    size_t pending_len;     /**< Bytes in the pending buffer */
+    unsigned long start_ns; /**< Monotonic time capturing started */
+    unsigned long requests; /**< Requests captured */
+    unsigned long bytes;    /**< Bytes written to the file */
+    unsigned long dropped;  /**< Requests left out while both buffers were full */
+    unsigned long writes;   /**< Buffers written */
+    int failed;             /**< A write failed, later requests are dropped */
+    int stopping;           /**< Destroy requested */
+    pthread_t thread;       /**< Writer thread */
+    pthread_mutex_t mutex;  /**< Protects the buffers, counters and stopping */
+    pthread_cond_t cond;    /**< Signals a pending buffer and stopping */
+};
+
+/**
+ * @brief Returns the monotonic clock in nanoseconds
+ * @return Nanoseconds
+ */
+static unsigned long monotonic_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long)ts.tv_sec * 1000000000ul + (unsigned long)ts.tv_nsec;
+}
+
+/**
+ * @brief Writes a whole buffer to a file
+ * @param fd File
+ * @param data Bytes
+ * @param len Number of bytes
+ * @return 0 on success, -1 on error
+ */
+static int write_all(int fd, const char *data, size_t len)
+{
+    while (len)
+    {
+        ssize_t n = write(fd, data, len);
+        if (n == -1 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return -1;
+        data += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+/**
+ * @brief Hands the active buffer to the writer thread
+ * @param writer Writer (mutex held, no buffer pending)
+ */
+static void swap_buffers(capture_writer *writer)
+{
+    writer->pending = writer->active;
+    writer->pending_len = writer->used;
+    writer->active ^= 1;
+    writer->used = 0;
+}
+
+/**
+ * @brief Writer thread main function
+ * @param arg Writer
+ * @return NULL
+ *
+ * Writes buffers as they fill up. A partly filled buffer is written
+ * after CAPTURE_FLUSH_MS, so a capture of light traffic stays current;
+ * with nothing buffered the thread waits without a timeout.
+ */
+static void *writer_routine(void *arg)
+{
+    capture_writer *writer = arg;
+
+    pthread_mutex_lock(&writer->mutex);
+    while (1)
+    {
+        while (writer->pending == -1 && !writer->used && !writer->stopping)
+            pthread_cond_wait(&writer->cond, &writer->mutex);
+
+        if (writer->pending == -1 && !writer->stopping)
+        {
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_nsec += CAPTURE_FLUSH_MS * 1000000L;
+            if (deadline.tv_nsec >= 1000000000)
+            {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000;
+            }
+            while (writer->pending == -1 && !writer->stopping)
+            {
+                if (pthread_cond_timedwait(&writer->cond, &writer->mutex, &deadline) == ETIMEDOUT)
+                    break;
+            }
+        }
+
+        if (writer->pending == -1)
+        {
+            if (!writer->used)
+                break;
+            swap_buffers(writer);
+        }
+
+        const char *data = writer->buffers[writer->pending];
+        size_t len = writer->pending_len;
+        pthread_mutex_unlock(&writer->mutex);
+
+        int ok = write_all(writer->fd, data, len) == 0;
+
+        pthread_mutex_lock(&writer->mutex);
+        writer->pending = -1;
+        writer->failed |= !ok;
+        if (ok)
+        {
+            writer->bytes += len;
+            writer->writes++;
+        }
+    }
+    pthread_mutex_unlock(&writer->mutex);
+
+    return NULL;
+}
+
+/**
+ * @brief Creates the file and starts the writer thread
+ * @param config Capture configuration
+ * @return Writer or NULL if the file cannot be created
+ */
+capture_writer *capture_create(const sockrpc_capture_config *config)
+{
+    capture_writer *writer = calloc(1, sizeof(capture_writer));
+    if (!writer)
+        return NULL;
+
+    writer->size = config->buffer_size ? config->buffer_size : CAPTURE_DEFAULT_BUFFER;
+    writer->buffers[0] = malloc(writer->size);
+    writer->buffers[1] = malloc(writer->size);
+    writer->fd = open(config->path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    writer->pending = -1;
+    writer->start_ns = monotonic_ns();
+
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    capture_header header = {.magic = CAPTURE_MAGIC, .version = CAPTURE_VERSION,
+                             .record_size = sizeof(capture_record),
+                             .start_unix_ns = (uint64_t)now.tv_sec * 1000000000ull +
+                                              (uint64_t)now.tv_nsec};
+    if (!writer->buffers[0] || !writer->buffers[1] || writer->fd == -1 ||
+        write_all(writer->fd, (const char *)&header, sizeof(header)) == -1)
+        goto fail;
+
+    pthread_mutex_init(&writer->mutex, NULL);
+    pthread_cond_init(&writer->cond, NULL);
+    if (pthread_create(&writer->thread, NULL, writer_routine, writer) != 0)
+    {
+        pthread_cond_destroy(&writer->cond);
+        pthread_mutex_destroy(&writer->mutex);
+        goto fail;
+    }
+    return writer;
+
+fail:
+    if (writer->fd != -1)
+        close(writer->fd);
+    free(writer->buffers[0]);
+    free(writer->buffers[1]);
+    free(writer);
+    return NULL;
+}
+
+/**
+ * @brief Copies a received request into the capture
+ * @param writer Writer
+ * @param worker Worker owning the connection
+ * @param connection Connection handle
+ * @param payload Request JSON
+ * @param len Payload length
+ *
+ * The arrival time is taken under the mutex, so records are in time
+ * order.
+ */
+void capture_request(capture_writer *writer, int worker, uint64_t connection,
+                     const char *payload, size_t len)
+{
+    size_t need = sizeof(capture_record) + len;
+
+    pthread_mutex_lock(&writer->mutex);
+    if (writer->used + need > writer->size && need <= writer->size && writer->pending == -1)
+    {
+        swap_buffers(writer);
+        pthread_cond_signal(&writer->cond);
+    }
+    if (writer->failed || writer->used + need > writer->size)
+    {
+        writer->dropped++;
+        pthread_mutex_unlock(&writer->mutex);
+        return;
+    }
+
+    capture_record record = {.offset_ns = monotonic_ns() - writer->start_ns,
+                             .connection = connection,
+                             .length = (uint32_t)len,
+                             .worker = (uint16_t)worker};
+    char *out = writer->buffers[writer->active] + writer->used;
+    memcpy(out, &record, sizeof(record));
+    memcpy(out + sizeof(record), payload, len);
+    if (!writer->used)
+        pthread_cond_signal(&writer->cond);
+    writer->used += need;
+    writer->requests++;
+    pthread_mutex_unlock(&writer->mutex);
+}
+
+/**
+ * @brief Reports capture counters
+ * @param writer Writer
+ * @return Counters as JSON or NULL
+ */
+cJSON *capture_stats(capture_writer *writer)
+{
+    cJSON *stats = cJSON_CreateObject();
+    if (!stats)
+        return NULL;
+
+    pthread_mutex_lock(&writer->mutex);
+    cJSON_AddNumberToObject(stats, "requests", writer->requests);
+    cJSON_AddNumberToObject(stats, "bytes", writer->bytes);
+    cJSON_AddNumberToObject(stats, "dropped", writer->dropped);
+    cJSON_AddNumberToObject(stats, "writes", writer->writes);
+    pthread_mutex_unlock(&writer->mutex);
+    return stats;
+}
+
+/**
+ * @brief Writes the buffered requests, stops the thread and closes the file
+ * @param writer Writer, may be NULL
+ */
+void capture_destroy(capture_writer *writer)
+{
+    if (!writer)
+        return;
+
+    pthread_mutex_lock(&writer->mutex);
+    writer->stopping = 1;
+    pthread_cond_signal(&writer->cond);
+    pthread_mutex_unlock(&writer->mutex);
+    pthread_join(writer->thread, NULL);
+
+    pthread_cond_destroy(&writer->cond);
+    pthread_mutex_destroy(&writer->mutex);
+    close(writer->fd);
+    free(writer->buffers[0]);
+    free(writer->buffers[1]);
+    free(writer);
+}
@@ -0,0 +1,95 @@
+#ifndef SOCKRPC_CAPTURE_H
+#define SOCKRPC_CAPTURE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "sockrpc/sockrpc.h"
+
+/**
+ * @file capture.h
+ * @brief Internal traffic capture for replay benchmarks
+ *
+ * A capturing server copies every request it receives, after
+ * decompression, into one of two memory buffers. A writer thread
+ * writes a full buffer to the file while the other one fills, so
+ * request threads never wait for the disk: when both buffers are full,
+ * requests are left out of the capture and counted.
+ *
+ * File layout (host byte order, little-endian on supported platforms):
+ * a capture_header, then for each request a capture_record followed by
+ * record.length payload bytes. Records are in arrival order.
+ * tools/sockrpc_replay reads it.
+ */
+
+/**
+ * @brief First bytes of a capture file
+ */
+#define CAPTURE_MAGIC "SRPCCAP"
+
+/**
+ * @brief Version of the capture file layout
+ */
+#define CAPTURE_VERSION 1
+
+/**
+ * @brief Capture file header (24 bytes)
+ */
+typedef struct
+{
+    char magic[8];          /**< CAPTURE_MAGIC */
+    uint32_t version;       /**< CAPTURE_VERSION */
+    uint32_t record_size;   /**< sizeof(capture_record) */
+    uint64_t start_unix_ns; /**< Wall clock when capturing started */
+} capture_header;
+
+/**
+ * @brief Header of one captured request (24 bytes)
+ */
+typedef struct
+{
+    uint64_t offset_ns;  /**< Arrival, nanoseconds after capturing started */
+    uint64_t connection; /**< Connection handle, unique per worker */
+    uint32_t length;     /**< Payload bytes that follow */
+    uint16_t worker;     /**< Worker owning the connection */
+    uint16_t reserved;   /**< Zero */
+} capture_record;
+
+/**
+ * @brief Double-buffered capture file writer
+ */
+typedef struct capture_writer capture_writer;
+
+/**
+ * @brief Creates the file and starts the writer thread
+ * @param config Capture configuration
+ * @return Writer or NULL if the file cannot be created
+ */
+capture_writer *capture_create(const sockrpc_capture_config *config);
+
+/**
+ * @brief Copies a received request into the capture
+ * @param writer Writer
+ * @param worker Worker owning the connection
+ * @param connection Connection handle
+ * @param payload Request JSON
+ * @param len Payload length
+ *
+ * Never blocks on I/O; the request is dropped if no buffer has room.
+ */
+void capture_request(capture_writer *writer, int worker, uint64_t connection,
+                     const char *payload, size_t len);
+
+/**
+ * @brief Reports capture counters
+ * @param writer Writer
+ * @return {"requests", "bytes", "dropped", "writes"} or NULL
+ */
+cJSON *capture_stats(capture_writer *writer);
+
+/**
+ * @brief Writes the buffered requests, stops the thread and closes the file
+ * @param writer Writer, may be NULL
+ */
+void capture_destroy(capture_writer *writer);
+
+#endif /* SOCKRPC_CAPTURE_H */
@@ -1,17 +1,30 @@
+#define _GNU_SOURCE
 #include <sys/socket.h>
 #include <sys/un.h>
+#include <sys/eventfd.h>
 #include <pthread.h>
 #include <unistd.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
 #include "sockrpc/sockrpc.h"
+#include "transport.h"
+#include "frame.h"
+#include "compress.h"
+#include "spin.h"
+#include "pubsub.h"
+#include "stream.h"
+#include "trace.h"
 
 /**
  * @file client.c
  * @brief Implementation of the SockRPC client component
  *
- * This file implements a thread-safe RPC client using Unix domain sockets.
+ * This file implements a thread-safe RPC client using Unix domain or TCP
+ * sockets.
  * The client supports both synchronous and asynchronous RPC calls, with
  * proper resource management and error handling.
  *
@@ -20,15 +33,108 @@
  * - Synchronous and asynchronous calls
  * - Automatic resource cleanup
  * - JSON message serialization
+ * - Optional negotiated compression of large messages
+ * - Optional adaptive busy-polling while waiting for responses
+ * - Topic subscriptions with events delivered to callbacks
+ * - Client-streaming uploads paced by server acknowledgements
+ * - Trace context of the calling handler propagated with each request
+ * - Non-blocking mode driven by the application's event loop, without
+ *   threads or locks
+ * - Optional coalescing of bursts of async calls into one write, with
+ *   responses matched to their calls through the pending-call table
  *
  * @note The client uses JSON for message serialization via the cJSON library
  */
 
 /**
- * @brief Maximum size for message buffers
- * @note Should match server's BUFFER_SIZE for optimal operation
+ * @brief Callback registered for a topic
  */
-#define BUFFER_SIZE 4096
+typedef struct client_subscription
+{
+    char *topic;                      /**< Topic name */
+    sockrpc_event_callback callback;  /**< Event callback */
+    void *ctx;                        /**< Context for callback */
+    struct client_subscription *next; /**< Next subscription */
+} client_subscription;
+
+/**
+ * @brief Received event waiting for delivery
+ */
+typedef struct pending_event
+{
+    char *payload;              /**< Event JSON */
+    struct pending_event *next; /**< Next event in arrival order */
+} pending_event;
+
+/**
+ * @brief Call awaiting its response, submitted in non-blocking mode or
+ *        sent by the coalescing thread
+ */
+typedef struct
+{
+    unsigned int id;                      /**< Request id */
+    int used;                             /**< Slot holds a call */
+    sockrpc_completion_callback callback; /**< Completion, may be NULL */
+    void *ctx;                            /**< Context for callback */
+} pending_call;
+
+struct coalescer;
+
+/**
+ * @brief Async call gathered by the coalescing window
+ */
+typedef struct coalesced_call
+{
+    unsigned int id;                 /**< Request id */
+    char *payload;                   /**< Request JSON, freed once written */
+    size_t len;                      /**< Payload length */
+    void (*callback)(cJSON *result); /**< Result callback, may be NULL */
+    cJSON *result;                   /**< Result once answered */
+    int answered;                    /**< Response received or call failed */
+    struct coalescer *owner;         /**< Coalescer running the callback */
+    struct coalesced_call *next;     /**< Next call of the batch, then of the done list */
+} coalesced_call;
+
+/**
+ * @brief Batches async calls of a client into single writes
+ *
+ * The first call of a batch opens the window; the coalescing thread
+ * sends the batch when the window closes or a limit is reached and
+ * enters its calls in the client's pending-call table. Whichever
+ * thread reads a response under the client mutex completes its call
+ * there, and the coalescing thread runs the callback. Batches are
+ * therefore written while earlier responses are still in flight.
+ */
+typedef struct coalescer
+{
+    pthread_t thread;              /**< Coalescing thread */
+    pthread_mutex_t mutex;         /**< Guards the fields below */
+    int wake_fd;                   /**< eventfd written on the first call, at a limit and on completions */
+    coalesced_call *head;          /**< Oldest call of the open batch */
+    coalesced_call *tail;          /**< Newest call of the open batch */
+    unsigned int count;            /**< Calls in the open batch */
+    size_t bytes;                  /**< Payload bytes in the open batch */
+    struct timespec opened;        /**< When the open batch got its first call */
+    unsigned long window_ns;       /**< Longest a call waits for others */
+    size_t max_bytes;              /**< Send once this many bytes are gathered, 0 = no limit */
+    unsigned int max_calls;        /**< Send once this many calls are gathered, 0 = no limit */
+    int stopping;                  /**< Send what is left and exit once answered */
+    unsigned int in_flight;        /**< Sent calls without a response */
+    coalesced_call *done_head;     /**< Oldest answered call awaiting its callback */
+    coalesced_call *done_tail;     /**< Newest answered call awaiting its callback */
+    unsigned long calls;           /**< Calls sent so far */
+    unsigned long batches;         /**< Writes that carried them */
+} coalescer;
+
+/**
+ * @brief Slots in a non-blocking client's call table after the first submit
+ */
+#define PENDING_CALLS_INITIAL 64
+
+/**
+ * @brief Initial buffer size of a non-blocking client in each direction
+ */
+#define NONBLOCKING_BUFFER_SIZE 16384
 
 /**
  * @brief Client context structure
@@ -40,11 +146,61 @@
  * - Multiple threads can safely share a client instance
  * - Each RPC call is atomic
  * - Async calls create their own thread
+ * - Events read by any thread are queued and delivered by one thread
+ *   at a time, outside the mutex
+ *
+ * A client created by sockrpc_client_create_nonblocking belongs to one
+ * thread, the application's event loop. Its requests are framed into
+ * the out buffer by sockrpc_client_submit and written when the socket
+ * is writable; responses are reassembled in the in buffer and matched
+ * to their calls by id. That mode takes no locks and starts no threads.
+ * Coalesced async calls of a blocking client use the same table, under
+ * the mutex.
  */
 struct sockrpc_client
 {
-    int fd;                /**< Socket file descriptor */
-    pthread_mutex_t mutex; /**< Mutex for thread safety */
+    int fd;                     /**< Socket file descriptor */
+    int socktype;               /**< SOCK_STREAM or SOCK_SEQPACKET */
+    unsigned int next_id;       /**< Id for the next request (atomic) */
+    compress_context *compress; /**< Negotiated compression or NULL */
+    compress_dict *dict;        /**< Compression dictionary or NULL */
+    spin_state spin;            /**< Busy-poll budget and counters (under mutex) */
+    client_subscription *subscriptions; /**< Topic callbacks (under mutex) */
+    pending_event *events_head; /**< Oldest undelivered event (under mutex) */
+    pending_event *events_tail; /**< Newest undelivered event (under mutex) */
+    int delivering;             /**< A thread is delivering events (under mutex) */
+    pthread_mutex_t mutex;      /**< Mutex for thread safety */
+    int nonblocking;            /**< Created by sockrpc_client_create_nonblocking */
+    int failed;                 /**< Non-blocking connection failed */
+    int connecting;             /**< Non-blocking connect not completed yet */
+    char *out;                  /**< Framed requests not yet written */
+    size_t out_len;             /**< Bytes in out */
+    size_t out_sent;            /**< Bytes of out already written */
+    size_t out_capacity;        /**< Capacity of out */
+    char *in;                   /**< Received bytes not yet dispatched */
+    size_t in_len;              /**< Bytes in in */
+    size_t in_capacity;         /**< Capacity of in */
+    pending_call *calls;        /**< Calls awaiting responses, slot id & (calls_capacity - 1) */
+    size_t calls_capacity;      /**< Slots in calls, a power of two or 0 */
+    size_t calls_pending;       /**< Used slots in calls */
+    coalescer *coalescer;       /**< Async call batching or NULL */
+};
+
+/**
+ * @brief Client-streaming call in progress
+ *
+ * The client mutex is held from sockrpc_client_upload_begin until
+ * sockrpc_upload_finish, so the upload's frames are never interleaved
+ * with other calls.
+ */
+struct sockrpc_upload
+{
+    sockrpc_client *client; /**< Client reserved for the upload */
+    unsigned int id;        /**< Request id, also the stream id */
+    unsigned long sent;     /**< Chunks sent */
+    unsigned long acked;    /**< Chunks the server reported consumed */
+    cJSON *response;        /**< Response envelope once received */
+    int failed;             /**< Connection failed */
 };
 
 /**
@@ -65,6 +221,7 @@ struct async_call_data
     char *method;                    /**< Method name (owned) */
     cJSON *params;                   /**< Parameters (transferred) */
     void (*callback)(cJSON *result); /**< Result callback */
+    trace_context trace;             /**< Trace context of the caller */
 };
 
 /**
@@ -72,34 +229,416 @@ struct async_call_data
  * @param socket_path Path to server's Unix domain socket
  * @return New client context or NULL on error
  *
+ * Connects with a SOCK_STREAM socket.
+ *
+ * @see sockrpc_client_create_ex
+ */
+sockrpc_client *sockrpc_client_create(const char *socket_path)
+{
+    return sockrpc_client_create_ex(socket_path, SOCKRPC_SOCK_STREAM);
+}
+
+/**
+ * @brief Creates a new client instance with an explicit socket type
+ * @param socket_path Path to server's socket, "@name" for the abstract
+ *        namespace, or a transport URL
+ * @param type Stream or seqpacket socket
+ * @return New client context or NULL on error
+ *
  * Initialization process:
- * 1. Allocates client context
- * 2. Creates Unix domain socket
- * 3. Connects to server
+ * 1. Resolves the path or URL (unix://, unixpacket://, tcp://)
+ * 2. Allocates client context
+ * 3. Creates and connects a socket of the requested type
  * 4. Initializes synchronization primitives
  *
  * Error handling:
  * - Returns NULL if memory allocation fails
+ * - Returns NULL if the socket name is invalid
  * - Returns NULL if socket creation fails
  * - Returns NULL if connection fails
  *
  * @note The client must be destroyed using sockrpc_client_destroy()
  */
-sockrpc_client *sockrpc_client_create(const char *socket_path)
+sockrpc_client *sockrpc_client_create_ex(const char *socket_path, sockrpc_socket_type type)
 {
+    transport_address address;
+    int socktype = type == SOCKRPC_SOCK_SEQPACKET ? SOCK_SEQPACKET : SOCK_STREAM;
+    if (transport_resolve(socket_path, socktype, &address) == -1)
+        return NULL;
+
     sockrpc_client *client = calloc(1, sizeof(sockrpc_client));
+    if (!client)
+        return NULL;
 
-    client->fd = socket(AF_UNIX, SOCK_STREAM, 0);
-    struct sockaddr_un addr = {
-        .sun_family = AF_UNIX};
-    strncpy(addr.sun_path, socket_path, sizeof(addr.sun_path) - 1);
+    client->socktype = address.socktype;
+    client->fd = transport_connect(&address);
+    if (client->fd == -1)
+    {
+        free(client);
+        return NULL;
+    }
 
-    connect(client->fd, (struct sockaddr *)&addr, sizeof(addr));
     pthread_mutex_init(&client->mutex, NULL);
 
     return client;
 }
 
+/**
+ * @brief Extracts the result from a response envelope
+ * @param envelope Parsed response (ownership transferred, may be NULL)
+ * @param id Id the response must carry
+ * @return Result (caller frees) or NULL on error responses
+ *
+ * Error responses ({"error": ...}) and responses for another request
+ * both map to NULL, matching the documented sync call behavior.
+ */
+static cJSON *unwrap_response(cJSON *envelope, unsigned int id)
+{
+    if (!envelope)
+        return NULL;
+
+    cJSON *id_item = cJSON_GetObjectItem(envelope, "id");
+    cJSON *result = NULL;
+    if (cJSON_IsNumber(id_item) && (unsigned int)id_item->valuedouble == id)
+        result = cJSON_DetachItemFromObject(envelope, "result");
+
+    cJSON_Delete(envelope);
+    return result;
+}
+
+/**
+ * @brief Adds the calling thread's trace context to a request
+ * @param request Request object
+ *
+ * Set while a server handler runs, so calls made from handlers continue
+ * the handler's trace.
+ */
+static void add_trace(cJSON *request)
+{
+    const trace_context *trace = trace_current();
+    if (!trace->valid)
+        return;
+
+    char parent[TRACEPARENT_LEN + 1];
+    trace_format(trace, parent);
+    cJSON_AddStringToObject(request, TRACE_FIELD, parent);
+}
+
+/**
+ * @brief Sends a request frame, compressed if negotiated and worthwhile
+ * @param client Client context (mutex held)
+ * @param payload Request JSON
+ * @param len Payload length
+ * @return 0 on success, -1 on error
+ */
+static int send_request(sockrpc_client *client, const char *payload, size_t len)
+{
+    if (client->compress && len >= SOCKRPC_COMPRESS_THRESHOLD)
+    {
+        size_t packed_len;
+        char *packed = compress_encode(client->compress, payload, len, &packed_len);
+        if (packed)
+        {
+            int rc = frame_send(client->fd, client->socktype, packed, packed_len,
+                                compress_context_codec(client->compress));
+            free(packed);
+            return rc;
+        }
+    }
+
+    return frame_send(client->fd, client->socktype, payload, len, 0);
+}
+
+/**
+ * @brief Checks whether the response has started to arrive
+ * @param ctx Client context
+ * @return Non-zero once data, EOF or an error is pending
+ */
+static int poll_response(void *ctx)
+{
+    sockrpc_client *client = ctx;
+    char byte;
+    ssize_t n = recv(client->fd, &byte, 1, MSG_PEEK | MSG_DONTWAIT);
+    return n >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR);
+}
+
+/**
+ * @brief Receives a frame and decompresses it if needed
+ * @param client Client context (mutex held)
+ * @param status Set to the result of the receive
+ * @return NUL-terminated payload (caller frees) or NULL on error
+ */
+static char *recv_frame(sockrpc_client *client, frame_status *status)
+{
+    size_t len;
+    uint32_t flags;
+    char *payload = frame_recv(client->fd, client->socktype, &len, &flags, status);
+    if (!payload || flags == 0)
+        return payload;
+
+    char *plain = NULL;
+    if (client->compress && flags == compress_context_codec(client->compress))
+        plain = compress_decode(client->compress, payload, len, FRAME_MAX_PAYLOAD, &len);
+    free(payload);
+    return plain;
+}
+
+/**
+ * @brief Checks whether a payload is a published event
+ * @param payload NUL-terminated payload
+ * @return Non-zero for events
+ */
+static int is_event(const char *payload)
+{
+    return strncmp(payload, PUBSUB_EVENT_PREFIX, strlen(PUBSUB_EVENT_PREFIX)) == 0;
+}
+
+/**
+ * @brief Queues a received event for delivery
+ * @param client Client context (mutex held)
+ * @param payload Event JSON (ownership transferred)
+ */
+static void queue_event(sockrpc_client *client, char *payload)
+{
+    pending_event *event = malloc(sizeof(pending_event));
+    if (!event)
+    {
+        free(payload);
+        return;
+    }
+
+    event->payload = payload;
+    event->next = NULL;
+    if (client->events_tail)
+        client->events_tail->next = event;
+    else
+        client->events_head = event;
+    client->events_tail = event;
+}
+
+/**
+ * @brief Moves the calls into a table with free slots for new ids
+ * @param client Client (mutex held in blocking mode)
+ * @return 0 on success, -1 on allocation failure
+ *
+ * Ids are consecutive, so slots only collide when calls older than the
+ * table size are still outstanding. The table doubles until every
+ * outstanding id has a slot of its own.
+ */
+static int grow_calls(sockrpc_client *client)
+{
+    size_t capacity = client->calls_capacity ? client->calls_capacity : PENDING_CALLS_INITIAL / 2;
+    while (1)
+    {
+        capacity *= 2;
+        pending_call *calls = calloc(capacity, sizeof(pending_call));
+        if (!calls)
+            return -1;
+
+        int collided = 0;
+        for (size_t i = 0; i < client->calls_capacity && !collided; i++)
+        {
+            pending_call *call = &client->calls[i];
+            if (!call->used)
+                continue;
+            pending_call *slot = &calls[call->id & (capacity - 1)];
+            collided = slot->used;
+            *slot = *call;
+        }
+
+        if (!collided)
+        {
+            free(client->calls);
+            client->calls = calls;
+            client->calls_capacity = capacity;
+            return 0;
+        }
+        free(calls);
+    }
+}
+
+/**
+ * @brief Returns the free slot for a new call's id
+ * @param client Client (mutex held in blocking mode)
+ * @param id Request id
+ * @return Slot or NULL on allocation failure
+ */
+static pending_call *reserve_call(sockrpc_client *client, unsigned int id)
+{
+    while (!client->calls_capacity || client->calls[id & (client->calls_capacity - 1)].used)
+    {
+        if (grow_calls(client) == -1)
+            return NULL;
+    }
+    return &client->calls[id & (client->calls_capacity - 1)];
+}
+
+/**
+ * @brief Completes the call a response belongs to
+ * @param client Client (mutex held in blocking mode)
+ * @param payload NUL-terminated response JSON
+ * @return 1 if a call was completed, 0 if the frame matched none
+ *
+ * Published events and responses of unknown ids are left to the caller.
+ */
+static int complete_call(sockrpc_client *client, const char *payload)
+{
+    if (is_event(payload))
+        return 0;
+
+    cJSON *envelope = cJSON_Parse(payload);
+    cJSON *id_item = cJSON_GetObjectItem(envelope, "id");
+    pending_call *slot = NULL;
+    if (cJSON_IsNumber(id_item) && client->calls_capacity)
+    {
+        unsigned int id = (unsigned int)id_item->valuedouble;
+        slot = &client->calls[id & (client->calls_capacity - 1)];
+        if (!slot->used || slot->id != id)
+            slot = NULL;
+    }
+    if (!slot)
+    {
+        cJSON_Delete(envelope);
+        return 0;
+    }
+
+    // The callback may submit, which can move the table
+    pending_call call = *slot;
+    slot->used = 0;
+    client->calls_pending--;
+    cJSON *result = cJSON_DetachItemFromObject(envelope, "result");
+    cJSON_Delete(envelope);
+    if (call.callback)
+        call.callback(result, call.ctx);
+    else
+        cJSON_Delete(result);
+    return 1;
+}
+
+/**
+ * @brief Completes every call in the table with NULL
+ * @param client Client (mutex held in blocking mode)
+ *
+ * Each outstanding callback gets NULL, so the caller can release its
+ * context.
+ */
+static void abandon_calls(sockrpc_client *client)
+{
+    for (size_t i = 0; i < client->calls_capacity; i++)
+    {
+        pending_call call = client->calls[i];
+        client->calls[i].used = 0;
+        if (call.used && call.callback)
+            call.callback(NULL, call.ctx);
+    }
+    client->calls_pending = 0;
+}
+
+/**
+ * @brief Receives the response frame of the current call
+ * @param client Client context (mutex held)
+ * @return NUL-terminated response JSON (caller frees) or NULL on error
+ *
+ * Events arriving before the response are queued for delivery, and
+ * responses of coalesced calls still in flight complete those calls.
+ * With busy-polling enabled, spins on the socket before blocking in
+ * read, so a fast response is picked up without a sleep and wakeup.
+ */
+static char *recv_response(sockrpc_client *client)
+{
+    if (client->spin.max_ns)
+        spin_wait(&client->spin, poll_response, client);
+
+    while (1)
+    {
+        frame_status status;
+        char *payload = recv_frame(client, &status);
+        if (!payload)
+            return NULL;
+        if (is_event(payload))
+            queue_event(client, payload);
+        else if (client->calls_pending && complete_call(client, payload))
+            free(payload);
+        else
+            return payload;
+    }
+}
+
+/**
+ * @brief Finds the subscription of a topic
+ * @param client Client context (mutex held)
+ * @param topic Topic name
+ * @return Link pointing to the subscription, or to the list end
+ */
+static client_subscription **find_subscription(sockrpc_client *client, const char *topic)
+{
+    client_subscription **link = &client->subscriptions;
+    while (*link && strcmp((*link)->topic, topic) != 0)
+        link = &(*link)->next;
+    return link;
+}
+
+/**
+ * @brief Delivers queued events to their callbacks
+ * @param client Client context (mutex not held)
+ * @return Number of events delivered by this call
+ *
+ * Only one thread delivers at a time, so callbacks of a client run in
+ * arrival order; a thread finding delivery in progress leaves its
+ * events to the delivering thread. Callbacks run without the mutex and
+ * may make calls on the client.
+ */
+static int deliver_events(sockrpc_client *client)
+{
+    int delivered = 0;
+
+    pthread_mutex_lock(&client->mutex);
+    if (client->delivering)
+    {
+        pthread_mutex_unlock(&client->mutex);
+        return 0;
+    }
+
+    client->delivering = 1;
+    while (client->events_head)
+    {
+        pending_event *event = client->events_head;
+        client->events_head = event->next;
+        if (!client->events_head)
+            client->events_tail = NULL;
+        pthread_mutex_unlock(&client->mutex);
+
+        cJSON *envelope = cJSON_Parse(event->payload);
+        const char *topic = cJSON_GetStringValue(cJSON_GetObjectItem(envelope, "topic"));
+        free(event->payload);
+        free(event);
+
+        sockrpc_event_callback callback = NULL;
+        void *ctx = NULL;
+        pthread_mutex_lock(&client->mutex);
+        client_subscription *subscription = topic ? *find_subscription(client, topic) : NULL;
+        if (subscription)
+        {
+            callback = subscription->callback;
+            ctx = subscription->ctx;
+        }
+        pthread_mutex_unlock(&client->mutex);
+
+        if (callback)
+        {
+            callback(topic, cJSON_DetachItemFromObject(envelope, "event"), ctx);
+            delivered++;
+        }
+        cJSON_Delete(envelope);
+
+        pthread_mutex_lock(&client->mutex);
+    }
+    client->delivering = 0;
+    pthread_mutex_unlock(&client->mutex);
+
+    return delivered;
+}
+
 /**
  * @brief Makes a synchronous RPC call
  * @param client Client context
@@ -108,10 +647,11 @@ sockrpc_client *sockrpc_client_create(const char *socket_path)
  * @return JSON result or NULL on error
  *
  * Call process:
- * 1. Creates JSON request object
- * 2. Sends request to server
- * 3. Waits for response
- * 4. Parses response
+ * 1. Creates JSON request object with a fresh id
+ * 2. Sends request frame to server
+ * 3. Waits for the response frame, queueing events received meanwhile
+ * 4. Delivers those events to their subscription callbacks
+ * 5. Parses response and extracts the result
  *
  * Thread safety:
  * - Safe to call from multiple threads
@@ -127,6 +667,13 @@ sockrpc_client *sockrpc_client_create(const char *socket_path)
  */
 cJSON *sockrpc_client_call_sync(sockrpc_client *client, const char *method, cJSON *params)
 {
+    // Blocking calls would consume responses of submitted calls
+    if (client->nonblocking)
+    {
+        cJSON_Delete(params);
+        return NULL;
+    }
+
     // JSON operations outside the lock
     cJSON *request = cJSON_CreateObject();
     if (!request)
@@ -135,10 +682,13 @@ cJSON *sockrpc_client_call_sync(sockrpc_client *client, const char *method, cJSO
         return NULL;
     }
 
+    unsigned int id = __atomic_fetch_add(&client->next_id, 1, __ATOMIC_RELAXED);
+    cJSON_AddNumberToObject(request, "id", id);
     cJSON_AddStringToObject(request, "method", method);
     cJSON_AddItemToObject(request, "params", params);
+    add_trace(request);
 
-    char *request_str = cJSON_Print(request);
+    char *request_str = cJSON_PrintUnformatted(request);
     cJSON_Delete(request);
     if (!request_str)
     {
@@ -148,19 +698,265 @@ cJSON *sockrpc_client_call_sync(sockrpc_client *client, const char *method, cJSO
     // Only lock the socket operations
     pthread_mutex_lock(&client->mutex);
 
-    write(client->fd, request_str, strlen(request_str));
+    char *response = NULL;
+    if (send_request(client, request_str, strlen(request_str)) == 0)
+        response = recv_response(client);
+    int has_events = client->events_head != NULL;
+
+    pthread_mutex_unlock(&client->mutex);
     free(request_str);
 
-    char buffer[BUFFER_SIZE];
-    ssize_t n = read(client->fd, buffer, BUFFER_SIZE);
+    if (has_events)
+        deliver_events(client);
+
+    if (!response)
+        return NULL;
+
+    cJSON *envelope = cJSON_Parse(response);
+    free(response);
+
+    return unwrap_response(envelope, id);
+}
+
+/**
+ * @brief Negotiates compression with the server
+ * @param client Client context
+ * @param dictionary Zstandard dictionary shared with the server, or NULL
+ * @param size Dictionary size
+ * @return 0 if a codec was agreed, -1 otherwise
+ *
+ * Offers every codec built into the library, most preferred first, and
+ * the id of the dictionary. The dictionary is used only if the server
+ * has the same one.
+ */
+int sockrpc_client_enable_compression(sockrpc_client *client, const void *dictionary, size_t size)
+{
+    if (!client)
+        return -1;
+
+    compress_dict *dict = dictionary ? compress_dict_create(dictionary, size) : NULL;
+
+    cJSON *params = cJSON_CreateObject();
+    cJSON *offered = cJSON_AddArrayToObject(params, "compression");
+    compress_codec codecs[2];
+    int count = compress_supported_codecs(codecs);
+    for (int i = 0; i < count; i++)
+        cJSON_AddItemToArray(offered, cJSON_CreateString(compress_codec_name(codecs[i])));
+    cJSON_AddNumberToObject(params, "dictionary", compress_dict_id(dict));
+
+    cJSON *result = sockrpc_client_call_sync(client, COMPRESS_NEGOTIATE_METHOD, params);
+    cJSON *codec_item = cJSON_GetObjectItem(result, "compression");
+    cJSON *dict_item = cJSON_GetObjectItem(result, "dictionary");
+    compress_codec codec = compress_codec_from_name(cJSON_GetStringValue(codec_item));
+    int use_dict = dict && cJSON_IsNumber(dict_item) &&
+                   (uint32_t)dict_item->valuedouble == compress_dict_id(dict);
+    cJSON_Delete(result);
+
+    compress_context *ctx = codec != COMPRESS_NONE
+                                ? compress_context_create(codec, use_dict ? dict : NULL)
+                                : NULL;
+
+    pthread_mutex_lock(&client->mutex);
+    compress_context_destroy(client->compress);
+    compress_dict_destroy(client->dict);
+    client->compress = ctx;
+    client->dict = dict;
+    pthread_mutex_unlock(&client->mutex);
+
+    return ctx ? 0 : -1;
+}
+
+/**
+ * @brief Enables adaptive busy-polling while waiting for responses
+ * @param client Client context
+ * @param spin_us Longest spin before blocking, 0 to disable
+ * @return 0 on success, -1 on error
+ */
+int sockrpc_client_set_busy_poll(sockrpc_client *client, unsigned int spin_us)
+{
+    if (!client)
+        return -1;
 
+    pthread_mutex_lock(&client->mutex);
+    spin_init(&client->spin, spin_us * 1000ul);
     pthread_mutex_unlock(&client->mutex);
+    return 0;
+}
 
-    if (n <= 0)
+/**
+ * @brief Collects client metrics
+ * @param client Client context
+ * @return {"busy_poll": {...}, "coalescing": {...}} (caller frees) or NULL
+ */
+cJSON *sockrpc_client_get_stats(sockrpc_client *client)
+{
+    if (!client)
         return NULL;
 
-    buffer[n] = '\0';
-    return cJSON_Parse(buffer);
+    cJSON *stats = cJSON_CreateObject();
+    pthread_mutex_lock(&client->mutex);
+    cJSON_AddItemToObject(stats, "busy_poll", spin_stats_json(&client->spin));
+    pthread_mutex_unlock(&client->mutex);
+
+    coalescer *c = client->coalescer;
+    if (c)
+    {
+        pthread_mutex_lock(&c->mutex);
+        cJSON *coalescing = cJSON_AddObjectToObject(stats, "coalescing");
+        cJSON_AddNumberToObject(coalescing, "calls", c->calls);
+        cJSON_AddNumberToObject(coalescing, "batches", c->batches);
+        cJSON_AddNumberToObject(coalescing, "calls_per_write",
+                                c->batches ? (double)c->calls / c->batches : 0);
+        pthread_mutex_unlock(&c->mutex);
+    }
+    return stats;
+}
+
+/**
+ * @brief Subscribes to a topic
+ * @param client Client context
+ * @param topic Topic name
+ * @param callback Event callback
+ * @param ctx Context for callback
+ * @return 0 on success, -1 on error
+ *
+ * The callback is registered before the request is sent, because the
+ * first events may arrive ahead of the response.
+ */
+int sockrpc_client_subscribe(sockrpc_client *client, const char *topic,
+                             sockrpc_event_callback callback, void *ctx)
+{
+    if (!client || !topic || !callback)
+        return -1;
+
+    client_subscription *added = calloc(1, sizeof(client_subscription));
+    if (!added || !(added->topic = strdup(topic)))
+    {
+        free(added);
+        return -1;
+    }
+
+    pthread_mutex_lock(&client->mutex);
+    client_subscription *subscription = *find_subscription(client, topic);
+    int existed = subscription != NULL;
+    if (!subscription)
+    {
+        subscription = added;
+        subscription->next = client->subscriptions;
+        client->subscriptions = subscription;
+        added = NULL;
+    }
+    subscription->callback = callback;
+    subscription->ctx = ctx;
+    pthread_mutex_unlock(&client->mutex);
+
+    if (added)
+    {
+        free(added->topic);
+        free(added);
+    }
+
+    cJSON *params = cJSON_CreateObject();
+    cJSON_AddStringToObject(params, "topic", topic);
+    cJSON *result = sockrpc_client_call_sync(client, PUBSUB_SUBSCRIBE_METHOD, params);
+    int subscribed = cJSON_IsTrue(cJSON_GetObjectItem(result, "subscribed"));
+    cJSON_Delete(result);
+
+    if (!subscribed && !existed)
+    {
+        pthread_mutex_lock(&client->mutex);
+        client_subscription **link = find_subscription(client, topic);
+        if (*link)
+        {
+            subscription = *link;
+            *link = subscription->next;
+            free(subscription->topic);
+            free(subscription);
+        }
+        pthread_mutex_unlock(&client->mutex);
+    }
+    return subscribed ? 0 : -1;
+}
+
+/**
+ * @brief Unsubscribes from a topic
+ * @param client Client context
+ * @param topic Topic name
+ * @return 0 on success, -1 on error
+ */
+int sockrpc_client_unsubscribe(sockrpc_client *client, const char *topic)
+{
+    if (!client || !topic)
+        return -1;
+
+    pthread_mutex_lock(&client->mutex);
+    client_subscription **link = find_subscription(client, topic);
+    client_subscription *subscription = *link;
+    if (subscription)
+        *link = subscription->next;
+    pthread_mutex_unlock(&client->mutex);
+    if (!subscription)
+        return -1;
+    free(subscription->topic);
+    free(subscription);
+
+    cJSON *params = cJSON_CreateObject();
+    cJSON_AddStringToObject(params, "topic", topic);
+    cJSON *result = sockrpc_client_call_sync(client, PUBSUB_UNSUBSCRIBE_METHOD, params);
+    int rc = result ? 0 : -1;
+    cJSON_Delete(result);
+    return rc;
+}
+
+/**
+ * @brief Waits for events and delivers them
+ * @param client Client context
+ * @param timeout_ms Longest wait, -1 for no limit
+ * @return Number of events delivered, or -1 if the connection failed
+ *
+ * Waits without the mutex so calls from other threads are not held up,
+ * then reads every frame already available under the mutex. A call may
+ * have consumed the data in between; that is not an error. Responses
+ * read here complete coalesced calls in flight; others belong to no
+ * call and are dropped.
+ */
+int sockrpc_client_process_events(sockrpc_client *client, int timeout_ms)
+{
+    if (!client || client->nonblocking)
+        return -1;
+
+    struct pollfd pfd = {.fd = client->fd, .events = POLLIN};
+    int rc = poll(&pfd, 1, timeout_ms);
+    if (rc == -1)
+        return errno == EINTR ? 0 : -1;
+
+    int failed = 0;
+    if (rc > 0)
+    {
+        pthread_mutex_lock(&client->mutex);
+        while (poll(&pfd, 1, 0) > 0)
+        {
+            frame_status status;
+            char *payload = recv_frame(client, &status);
+            if (!payload)
+            {
+                failed = status != FRAME_AGAIN;
+                break;
+            }
+            if (is_event(payload))
+                queue_event(client, payload);
+            else
+            {
+                if (client->calls_pending)
+                    complete_call(client, payload);
+                free(payload);
+            }
+        }
+        pthread_mutex_unlock(&client->mutex);
+    }
+
+    int delivered = deliver_events(client);
+    return failed ? -1 : delivered;
 }
 
 /**
@@ -185,6 +981,9 @@ static void *async_call_routine(void *arg)
     if (!data)
         return NULL;
 
+    // Continue the trace of the thread that made the call
+    if (data->trace.valid)
+        trace_set_current(&data->trace);
     cJSON *result = sockrpc_client_call_sync(data->client, data->method, data->params);
     // params now owned and freed by call_sync
 
@@ -205,8 +1004,466 @@ static void *async_call_routine(void *arg)
 }
 
 /**
- * @brief Makes an asynchronous RPC call
- * @param client Client context
+ * @brief Frames the calls of a batch into one buffer
+ * @param client Client context (mutex held)
+ * @param batch Calls in submission order
+ * @param len Set to the bytes framed
+ * @return Buffer (caller frees) or NULL if no call could be framed
+ *
+ * Payloads are compressed like in send_request. Calls whose frame is
+ * too large or cannot be built are marked answered, with no result.
+ */
+static char *frame_batch(sockrpc_client *client, coalesced_call *batch, size_t *len)
+{
+    size_t capacity = 0;
+    for (coalesced_call *call = batch; call; call = call->next)
+        capacity += FRAME_HEADER_SIZE + call->len;
+
+    char *buffer = malloc(capacity ? capacity : 1);
+    *len = 0;
+    for (coalesced_call *call = batch; call; call = call->next)
+    {
+        const char *payload = call->payload;
+        size_t payload_len = call->len;
+        uint32_t flags = 0;
+        char *packed = NULL;
+        if (client->compress && call->len >= SOCKRPC_COMPRESS_THRESHOLD)
+        {
+            size_t packed_len;
+            packed = compress_encode(client->compress, call->payload, call->len, &packed_len);
+            if (packed)
+            {
+                payload = packed;
+                payload_len = packed_len;
+                flags = compress_context_codec(client->compress);
+            }
+        }
+
+        if (!buffer || payload_len > FRAME_MAX_PAYLOAD)
+        {
+            call->answered = 1;
+        }
+        else
+        {
+            frame_encode_header((unsigned char *)buffer + *len, payload_len, flags);
+            memcpy(buffer + *len + FRAME_HEADER_SIZE, payload, payload_len);
+            *len += FRAME_HEADER_SIZE + payload_len;
+        }
+        free(packed);
+        free(call->payload);
+        call->payload = NULL;
+    }
+
+    if (*len == 0)
+    {
+        free(buffer);
+        return NULL;
+    }
+    return buffer;
+}
+
+/**
+ * @brief Coalescer whose thread is the calling thread, NULL elsewhere
+ */
+static __thread coalescer *coalescing_thread;
+
+/**
+ * @brief Wakes the coalescing thread from its poll
+ * @param c Coalescer
+ */
+static void wake_coalescer(coalescer *c)
+{
+    uint64_t one = 1;
+    while (write(c->wake_fd, &one, sizeof(one)) == -1 && errno == EINTR)
+        ;
+}
+
+/**
+ * @brief Hands an answered coalesced call to the coalescing thread
+ * @param result Result (ownership transferred) or NULL
+ * @param ctx The coalesced call
+ *
+ * Completion of the call's pending-call slot, run with the client mutex
+ * held by whichever thread read the response.
+ */
+static void coalesced_done(cJSON *result, void *ctx)
+{
+    coalesced_call *call = ctx;
+    coalescer *c = call->owner;
+    call->result = result;
+    call->answered = 1;
+    call->next = NULL;
+
+    pthread_mutex_lock(&c->mutex);
+    int wake = !c->done_head;
+    if (c->done_tail)
+        c->done_tail->next = call;
+    else
+        c->done_head = call;
+    c->done_tail = call;
+    c->in_flight--;
+    pthread_mutex_unlock(&c->mutex);
+
+    if (wake)
+        wake_coalescer(c);
+}
+
+/**
+ * @brief Runs the callbacks of answered calls
+ * @param calls Answered calls, freed here
+ */
+static void finish_coalesced(coalesced_call *calls)
+{
+    while (calls)
+    {
+        coalesced_call *call = calls;
+        calls = call->next;
+        if (call->callback)
+            call->callback(call->result);
+        else
+            cJSON_Delete(call->result);
+        free(call->payload);
+        free(call);
+    }
+}
+
+/**
+ * @brief Sends a batch of async calls with one write
+ * @param client Client context (mutex not held)
+ * @param batch Calls in submission order
+ *
+ * The sent calls are entered in the pending-call table before the
+ * mutex is released, so whichever thread reads a response completes
+ * its call; the mutex is not held while responses are in flight. Calls
+ * that could not be sent get a NULL result right away.
+ */
+static void send_batch(sockrpc_client *client, coalesced_call *batch)
+{
+    coalescer *c = client->coalescer;
+    coalesced_call *failed = NULL;
+    coalesced_call **failed_tail = &failed;
+
+    pthread_mutex_lock(&client->mutex);
+
+    size_t len;
+    char *frames = frame_batch(client, batch, &len);
+    int written = frames && frame_write(client->fd, frames, len) == 0;
+    free(frames);
+
+    unsigned int sent = 0;
+    while (batch)
+    {
+        coalesced_call *call = batch;
+        batch = call->next;
+        pending_call *slot = written && !call->answered ? reserve_call(client, call->id) : NULL;
+        if (!slot)
+        {
+            call->answered = 1;
+            call->next = NULL;
+            *failed_tail = call;
+            failed_tail = &call->next;
+            continue;
+        }
+
+        slot->id = call->id;
+        slot->used = 1;
+        slot->callback = coalesced_done;
+        slot->ctx = call;
+        client->calls_pending++;
+        sent++;
+    }
+
+    // Counted before any reader can take the mutex and complete them
+    pthread_mutex_lock(&c->mutex);
+    c->in_flight += sent;
+    pthread_mutex_unlock(&c->mutex);
+
+    pthread_mutex_unlock(&client->mutex);
+
+    finish_coalesced(failed);
+}
+
+/**
+ * @brief Reads the responses that have arrived for coalesced calls
+ * @param client Client context (mutex not held)
+ *
+ * Only reads frames that are already available, so the mutex is never
+ * held while waiting for a response. A broken connection completes
+ * every call in flight with NULL.
+ */
+static void read_coalesced(sockrpc_client *client)
+{
+    struct pollfd pfd = {.fd = client->fd, .events = POLLIN};
+
+    pthread_mutex_lock(&client->mutex);
+    while (client->calls_pending && poll(&pfd, 1, 0) > 0)
+    {
+        frame_status status;
+        char *payload = recv_frame(client, &status);
+        if (!payload)
+        {
+            if (status != FRAME_AGAIN)
+                abandon_calls(client);
+            break;
+        }
+        if (is_event(payload))
+            queue_event(client, payload);
+        else
+        {
+            complete_call(client, payload);
+            free(payload);
+        }
+    }
+    int has_events = client->events_head != NULL;
+    pthread_mutex_unlock(&client->mutex);
+
+    if (has_events)
+        deliver_events(client);
+}
+
+/**
+ * @brief Checks whether the open batch should be sent now
+ * @param c Coalescer (mutex held, batch not empty)
+ * @return Non-zero once a limit is reached or the client is going away
+ */
+static int batch_full(const coalescer *c)
+{
+    return c->stopping || (c->max_calls && c->count >= c->max_calls) ||
+           (c->max_bytes && c->bytes >= c->max_bytes);
+}
+
+/**
+ * @brief Thread routine sending the batches of a coalescing client
+ * @param arg Client context
+ * @return NULL
+ *
+ * Polls the wake eventfd, plus the socket while calls are in flight,
+ * with the open batch's window as the timeout. Sends the batch when its
+ * window closes or a limit is reached, reads responses as they arrive
+ * and runs the callbacks of answered calls. Exits once stopping is set,
+ * every gathered call has been sent and every sent call answered.
+ */
+static void *coalesce_routine(void *arg)
+{
+    sockrpc_client *client = arg;
+    coalescer *c = client->coalescer;
+    struct pollfd fds[2] = {{.fd = c->wake_fd, .events = POLLIN},
+                            {.fd = client->fd, .events = POLLIN}};
+    coalescing_thread = c;
+
+    pthread_mutex_lock(&c->mutex);
+    while (1)
+    {
+        coalesced_call *done = c->done_head;
+        if (done)
+        {
+            c->done_head = c->done_tail = NULL;
+            pthread_mutex_unlock(&c->mutex);
+            finish_coalesced(done);
+            pthread_mutex_lock(&c->mutex);
+            continue;
+        }
+
+        struct timespec timeout;
+        struct timespec *wait = NULL;
+        if (c->head)
+        {
+            struct timespec now;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            long long left = (long long)c->window_ns -
+                             ((now.tv_sec - c->opened.tv_sec) * 1000000000ll +
+                              (now.tv_nsec - c->opened.tv_nsec));
+            if (left <= 0 || batch_full(c))
+            {
+                coalesced_call *batch = c->head;
+                c->calls += c->count;
+                c->batches++;
+                c->head = c->tail = NULL;
+                c->count = 0;
+                c->bytes = 0;
+                pthread_mutex_unlock(&c->mutex);
+
+                send_batch(client, batch);
+
+                pthread_mutex_lock(&c->mutex);
+                continue;
+            }
+            timeout.tv_sec = left / 1000000000ll;
+            timeout.tv_nsec = left % 1000000000ll;
+            wait = &timeout;
+        }
+        else if (c->stopping && !c->in_flight)
+            break;
+
+        nfds_t nfds = c->in_flight ? 2 : 1;
+        pthread_mutex_unlock(&c->mutex);
+
+        if (ppoll(fds, nfds, wait, NULL) > 0)
+        {
+            uint64_t count;
+            while (fds[0].revents && read(c->wake_fd, &count, sizeof(count)) == -1 &&
+                   errno == EINTR)
+                ;
+            if (nfds == 2 && fds[1].revents)
+                read_coalesced(client);
+        }
+
+        pthread_mutex_lock(&c->mutex);
+    }
+    pthread_mutex_unlock(&c->mutex);
+    return NULL;
+}
+
+/**
+ * @brief Adds an async call to the open batch
+ * @param client Coalescing client
+ * @param method Method name
+ * @param params JSON parameters (ownership transferred)
+ * @param callback Result callback, may be NULL
+ *
+ * The request is formatted on the calling thread, carrying its trace
+ * context. The coalescing thread is only woken for the first call of a
+ * batch and when a limit is reached, not for every call.
+ */
+static void coalesce_call(sockrpc_client *client, const char *method, cJSON *params,
+                          void (*callback)(cJSON *result))
+{
+    coalesced_call *call = calloc(1, sizeof(coalesced_call));
+    cJSON *request = call ? cJSON_CreateObject() : NULL;
+    if (!request)
+    {
+        free(call);
+        cJSON_Delete(params);
+        if (callback)
+            callback(NULL);
+        return;
+    }
+
+    call->id = __atomic_fetch_add(&client->next_id, 1, __ATOMIC_RELAXED);
+    call->callback = callback;
+    cJSON_AddNumberToObject(request, "id", call->id);
+    cJSON_AddStringToObject(request, "method", method);
+    cJSON_AddItemToObject(request, "params", params);
+    add_trace(request);
+    call->payload = cJSON_PrintUnformatted(request);
+    cJSON_Delete(request);
+    if (!call->payload)
+    {
+        free(call);
+        if (callback)
+            callback(NULL);
+        return;
+    }
+    call->len = strlen(call->payload);
+
+    coalescer *c = client->coalescer;
+    call->owner = c;
+    pthread_mutex_lock(&c->mutex);
+    if (c->tail)
+        c->tail->next = call;
+    else
+    {
+        c->head = call;
+        clock_gettime(CLOCK_MONOTONIC, &c->opened);
+    }
+    c->tail = call;
+    c->count++;
+    c->bytes += call->len;
+    int wake = c->count == 1 || batch_full(c);
+    pthread_mutex_unlock(&c->mutex);
+
+    if (wake)
+        wake_coalescer(c);
+}
+
+/**
+ * @brief Stops a client's coalescing thread after every gathered call was answered
+ * @param client Client context
+ */
+static void stop_coalescing(sockrpc_client *client)
+{
+    coalescer *c = client->coalescer;
+    pthread_mutex_lock(&c->mutex);
+    c->stopping = 1;
+    pthread_mutex_unlock(&c->mutex);
+    wake_coalescer(c);
+    pthread_join(c->thread, NULL);
+
+    client->coalescer = NULL;
+    close(c->wake_fd);
+    pthread_mutex_destroy(&c->mutex);
+    free(c);
+}
+
+/**
+ * @brief Gathers bursts of async calls into single writes
+ * @param client Blocking stream client
+ * @param window_us Longest a call waits for others, 0 to stop coalescing
+ * @param max_bytes Payload bytes that send a batch at once, 0 for no limit
+ * @param max_calls Calls that send a batch at once, 0 for no limit
+ * @return 0 on success, -1 on error
+ *
+ * Settings of an active coalescer are updated in place. Stopping waits
+ * until the gathered calls have been answered, so it is refused on the
+ * coalescing thread itself, where callbacks run.
+ */
+int sockrpc_client_set_coalescing(sockrpc_client *client, unsigned int window_us,
+                                  size_t max_bytes, unsigned int max_calls)
+{
+    // Non-blocking clients already write their submitted calls together
+    if (!client || client->nonblocking || client->socktype != SOCK_STREAM)
+        return -1;
+
+    coalescer *c = client->coalescer;
+    if (window_us == 0)
+    {
+        if (c && coalescing_thread == c)
+            return -1;
+        if (c)
+            stop_coalescing(client);
+        return 0;
+    }
+
+    if (c)
+    {
+        pthread_mutex_lock(&c->mutex);
+        c->window_ns = window_us * 1000ul;
+        c->max_bytes = max_bytes;
+        c->max_calls = max_calls;
+        pthread_mutex_unlock(&c->mutex);
+        wake_coalescer(c);
+        return 0;
+    }
+
+    c = calloc(1, sizeof(coalescer));
+    if (!c)
+        return -1;
+    c->window_ns = window_us * 1000ul;
+    c->max_bytes = max_bytes;
+    c->max_calls = max_calls;
+    c->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (c->wake_fd == -1)
+    {
+        free(c);
+        return -1;
+    }
+    pthread_mutex_init(&c->mutex, NULL);
+
+    client->coalescer = c;
+    if (pthread_create(&c->thread, NULL, coalesce_routine, client) != 0)
+    {
+        client->coalescer = NULL;
+        close(c->wake_fd);
+        pthread_mutex_destroy(&c->mutex);
+        free(c);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Makes an asynchronous RPC call
+ * @param client Client context
  * @param method Method name to call
  * @param params JSON parameters (ownership transferred)
  * @param callback Function to receive result
@@ -216,6 +1473,9 @@ static void *async_call_routine(void *arg)
  * 2. Spawns worker thread
  * 3. Returns immediately
  *
+ * With coalescing enabled the call joins the open batch instead, and
+ * its callback runs on the coalescing thread.
+ *
  * Thread safety:
  * - Safe to call from multiple threads
  * - Multiple async calls can be active
@@ -231,31 +1491,536 @@ static void *async_call_routine(void *arg)
 void sockrpc_client_call_async(sockrpc_client *client, const char *method, cJSON *params,
                                void (*callback)(cJSON *result))
 {
+    if (client->coalescer)
+    {
+        coalesce_call(client, method, params, callback);
+        return;
+    }
+
     struct async_call_data *data = malloc(sizeof(struct async_call_data));
     data->client = client;
     data->method = strdup(method);
     data->params = params;
     data->callback = callback;
+    data->trace = *trace_current();
 
     pthread_t thread;
     pthread_create(&thread, NULL, async_call_routine, data);
     pthread_detach(thread);
 }
 
+/**
+ * @brief Creates a client for use from an application's event loop
+ * @param socket_path Path to server's socket, "@name" or a stream URL
+ * @return New client context or NULL on error
+ *
+ * The socket is non-blocking from the start: a TCP connection that
+ * is still being established completes once the socket is writable,
+ * so the caller never waits for the peer. Seqpacket addresses are
+ * refused: requests are written as a byte stream that may be cut
+ * anywhere.
+ */
+sockrpc_client *sockrpc_client_create_nonblocking(const char *socket_path)
+{
+    transport_address address;
+    if (transport_resolve(socket_path, SOCK_STREAM, &address) == -1 ||
+        address.socktype != SOCK_STREAM)
+        return NULL;
+
+    sockrpc_client *client = calloc(1, sizeof(sockrpc_client));
+    if (!client)
+        return NULL;
+
+    client->socktype = SOCK_STREAM;
+    client->fd = transport_connect_nonblocking(&address, &client->connecting);
+    if (client->fd == -1)
+    {
+        free(client);
+        return NULL;
+    }
+
+    pthread_mutex_init(&client->mutex, NULL);
+    client->nonblocking = 1;
+    return client;
+}
+
+/**
+ * @brief Returns the socket a non-blocking client's loop watches
+ * @param client Client context
+ * @return Socket, or -1 if the client is not in non-blocking mode
+ */
+int sockrpc_client_fd(sockrpc_client *client)
+{
+    return client && client->nonblocking ? client->fd : -1;
+}
+
+/**
+ * @brief Ensures room for more bytes after the unwritten output
+ * @param client Non-blocking client
+ * @param size Bytes to append
+ * @return 0 on success, -1 on allocation failure
+ *
+ * Written bytes are dropped from the front first.
+ */
+static int reserve_output(sockrpc_client *client, size_t size)
+{
+    if (client->out_sent)
+    {
+        client->out_len -= client->out_sent;
+        memmove(client->out, client->out + client->out_sent, client->out_len);
+        client->out_sent = 0;
+    }
+    if (client->out_len + size <= client->out_capacity)
+        return 0;
+
+    size_t capacity = client->out_capacity ? client->out_capacity : NONBLOCKING_BUFFER_SIZE;
+    while (capacity < client->out_len + size)
+        capacity *= 2;
+    char *out = realloc(client->out, capacity);
+    if (!out)
+        return -1;
+    client->out = out;
+    client->out_capacity = capacity;
+    return 0;
+}
+
+/**
+ * @brief Queues a request on a non-blocking client
+ * @param client Client created by sockrpc_client_create_nonblocking
+ * @param method Method name to call
+ * @param params JSON parameters (ownership transferred)
+ * @param callback Receives the result, may be NULL
+ * @param ctx Passed to callback
+ * @return 0 on success, -1 on error (callback is not invoked)
+ *
+ * The request is framed into the output buffer; nothing is written
+ * until sockrpc_client_on_writable.
+ */
+int sockrpc_client_submit(sockrpc_client *client, const char *method, cJSON *params,
+                          sockrpc_completion_callback callback, void *ctx)
+{
+    cJSON *request = client && client->nonblocking && !client->failed && method
+                         ? cJSON_CreateObject()
+                         : NULL;
+    if (!request)
+    {
+        cJSON_Delete(params);
+        return -1;
+    }
+
+    unsigned int id = client->next_id++;
+    cJSON_AddNumberToObject(request, "id", id);
+    cJSON_AddStringToObject(request, "method", method);
+    cJSON_AddItemToObject(request, "params", params);
+    add_trace(request);
+
+    char *payload = cJSON_PrintUnformatted(request);
+    cJSON_Delete(request);
+    size_t len = payload ? strlen(payload) : 0;
+    pending_call *call = NULL;
+    if (!payload || len > FRAME_MAX_PAYLOAD ||
+        reserve_output(client, FRAME_HEADER_SIZE + len) == -1 || !(call = reserve_call(client, id)))
+    {
+        free(payload);
+        return -1;
+    }
+
+    frame_encode_header((unsigned char *)client->out + client->out_len, len, 0);
+    memcpy(client->out + client->out_len + FRAME_HEADER_SIZE, payload, len);
+    client->out_len += FRAME_HEADER_SIZE + len;
+    free(payload);
+
+    call->id = id;
+    call->used = 1;
+    call->callback = callback;
+    call->ctx = ctx;
+    client->calls_pending++;
+    return 0;
+}
+
+/**
+ * @brief Checks whether a non-blocking client has output to write
+ * @param client Client context
+ * @return Non-zero while connecting or while submitted requests are
+ *         not fully written
+ */
+int sockrpc_client_wants_write(sockrpc_client *client)
+{
+    return client && client->nonblocking && !client->failed &&
+           (client->connecting || client->out_sent < client->out_len);
+}
+
+/**
+ * @brief Marks a non-blocking connection failed and completes every call
+ * @param client Non-blocking client
+ * @return -1
+ */
+static int fail_calls(sockrpc_client *client)
+{
+    client->failed = 1;
+    client->out_len = client->out_sent = 0;
+    abandon_calls(client);
+    return -1;
+}
+
+/**
+ * @brief Completes a non-blocking connect once the socket reports progress
+ * @param client Non-blocking client that is connecting
+ * @return 0 once connected, 1 while still connecting, -1 if the
+ *         connection failed (every submitted call completed with NULL)
+ */
+static int finish_connect(sockrpc_client *client)
+{
+    int error = 0;
+    socklen_t len = sizeof(error);
+    if (getsockopt(client->fd, SOL_SOCKET, SO_ERROR, &error, &len) == -1 || error)
+        return fail_calls(client);
+
+    struct sockaddr_storage peer;
+    len = sizeof(peer);
+    if (getpeername(client->fd, (struct sockaddr *)&peer, &len) == -1)
+        return errno == ENOTCONN ? 1 : fail_calls(client);
+
+    client->connecting = 0;
+    return 0;
+}
+
+/**
+ * @brief Writes submitted requests until done or the socket is full
+ * @param client Client created by sockrpc_client_create_nonblocking
+ * @return 0 once all output is written, 1 if some remains, -1 if the
+ *         connection failed
+ *
+ * The first call after a TCP connect started completes the connect.
+ */
+int sockrpc_client_on_writable(sockrpc_client *client)
+{
+    if (!client || !client->nonblocking || client->failed)
+        return -1;
+    if (client->connecting)
+    {
+        int rc = finish_connect(client);
+        if (rc != 0)
+            return rc;
+    }
+
+    while (client->out_sent < client->out_len)
+    {
+        ssize_t n = send(client->fd, client->out + client->out_sent,
+                         client->out_len - client->out_sent, MSG_NOSIGNAL);
+        if (n > 0)
+            client->out_sent += (size_t)n;
+        else if (n == -1 && errno == EINTR)
+            continue;
+        else if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return 1;
+        else
+            return fail_calls(client);
+    }
+
+    client->out_len = client->out_sent = 0;
+    return 0;
+}
+
+/**
+ * @brief Reads available responses and runs their completions
+ * @param client Client created by sockrpc_client_create_nonblocking
+ * @return Number of calls completed, or -1 if the connection failed
+ *
+ * Reads until the socket is drained. The input buffer keeps a spare
+ * byte after the data so each payload can be NUL-terminated in place.
+ * A connect that failed is reported here too, as readable with an error.
+ */
+int sockrpc_client_on_readable(sockrpc_client *client)
+{
+    if (!client || !client->nonblocking || client->failed)
+        return -1;
+    if (client->connecting)
+    {
+        int rc = finish_connect(client);
+        if (rc != 0)
+            return rc == 1 ? 0 : -1;
+    }
+
+    int completed = 0;
+    size_t needed = NONBLOCKING_BUFFER_SIZE;
+    while (1)
+    {
+        // Room for the whole pending frame, and always for one more byte
+        size_t want = needed > client->in_len + 1 ? needed : client->in_len + 2;
+        if (client->in_capacity < want)
+        {
+            size_t capacity = client->in_capacity ? client->in_capacity : NONBLOCKING_BUFFER_SIZE;
+            while (capacity < want)
+                capacity *= 2;
+            char *in = realloc(client->in, capacity);
+            if (!in)
+                return fail_calls(client);
+            client->in = in;
+            client->in_capacity = capacity;
+        }
+
+        ssize_t n = recv(client->fd, client->in + client->in_len,
+                         client->in_capacity - client->in_len - 1, 0);
+        if (n == 0)
+            return fail_calls(client);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return completed;
+            return fail_calls(client);
+        }
+        client->in_len += (size_t)n;
+
+        size_t offset = 0;
+        needed = NONBLOCKING_BUFFER_SIZE;
+        while (client->in_len - offset >= FRAME_HEADER_SIZE)
+        {
+            size_t len;
+            uint32_t flags;
+            if (frame_decode_header((unsigned char *)client->in + offset, &len, &flags) == -1 ||
+                flags != 0)
+                return fail_calls(client);
+
+            size_t frame = FRAME_HEADER_SIZE + len;
+            if (client->in_len - offset < frame)
+            {
+                needed = frame + 1;
+                break;
+            }
+
+            char *payload = client->in + offset + FRAME_HEADER_SIZE;
+            char saved = payload[len];
+            payload[len] = '\0';
+            completed += complete_call(client, payload);
+            payload[len] = saved;
+            offset += frame;
+        }
+
+        client->in_len -= offset;
+        if (offset && client->in_len)
+            memmove(client->in, client->in + offset, client->in_len);
+    }
+}
+
+/**
+ * @brief Serializes and sends a message of an upload
+ * @param upload Upload (client mutex held)
+ * @param message Message (freed)
+ * @return 0 on success, -1 on error (upload marked failed)
+ */
+static int send_upload_message(sockrpc_upload *upload, cJSON *message)
+{
+    char *payload = message ? cJSON_PrintUnformatted(message) : NULL;
+    cJSON_Delete(message);
+    if (!payload || send_request(upload->client, payload, strlen(payload)) == -1)
+        upload->failed = 1;
+    free(payload);
+    return upload->failed ? -1 : 0;
+}
+
+/**
+ * @brief Reads an acknowledgement or the response of an upload
+ * @param upload Upload (client mutex held)
+ * @return 0 on success, -1 on error (upload marked failed)
+ *
+ * Events received meanwhile are queued for delivery at the end of the
+ * upload.
+ */
+static int read_upload_frame(sockrpc_upload *upload)
+{
+    char *payload = recv_response(upload->client);
+    cJSON *envelope = payload ? cJSON_Parse(payload) : NULL;
+    free(payload);
+    if (!envelope)
+    {
+        upload->failed = 1;
+        return -1;
+    }
+
+    cJSON *ack = cJSON_GetObjectItem(envelope, "ack");
+    if (cJSON_IsNumber(ack) && !cJSON_HasObjectItem(envelope, "result") &&
+        !cJSON_HasObjectItem(envelope, "error"))
+    {
+        if ((unsigned long)ack->valuedouble > upload->acked)
+            upload->acked = (unsigned long)ack->valuedouble;
+        cJSON_Delete(envelope);
+    }
+    else
+    {
+        upload->response = envelope;
+    }
+    return 0;
+}
+
+/**
+ * @brief Begins a client-streaming call
+ * @param client Client context
+ * @param method Stream method name
+ * @param params JSON parameters (ownership transferred, may be NULL)
+ * @return Upload handle or NULL on error
+ *
+ * Reserves the connection until sockrpc_upload_finish.
+ */
+sockrpc_upload *sockrpc_client_upload_begin(sockrpc_client *client, const char *method,
+                                            cJSON *params)
+{
+    sockrpc_upload *upload =
+        client && !client->nonblocking && method ? calloc(1, sizeof(sockrpc_upload)) : NULL;
+    cJSON *request = upload ? cJSON_CreateObject() : NULL;
+    if (!request)
+    {
+        free(upload);
+        cJSON_Delete(params);
+        return NULL;
+    }
+
+    upload->client = client;
+    upload->id = __atomic_fetch_add(&client->next_id, 1, __ATOMIC_RELAXED);
+    cJSON_AddNumberToObject(request, "id", upload->id);
+    cJSON_AddStringToObject(request, "method", method);
+    if (params)
+        cJSON_AddItemToObject(request, "params", params);
+    cJSON_AddBoolToObject(request, "stream", 1);
+    add_trace(request);
+
+    pthread_mutex_lock(&client->mutex);
+    if (send_upload_message(upload, request) == -1)
+    {
+        pthread_mutex_unlock(&client->mutex);
+        free(upload);
+        return NULL;
+    }
+    return upload;
+}
+
+/**
+ * @brief Sends one chunk of an upload
+ * @param upload Upload handle
+ * @param chunk Chunk (ownership transferred)
+ * @return 0 on success, -1 if the upload failed or was answered
+ *
+ * Waits for acknowledgements while STREAM_WINDOW chunks are
+ * unacknowledged, so the server never buffers more than that.
+ */
+int sockrpc_upload_send(sockrpc_upload *upload, cJSON *chunk)
+{
+    if (!upload || !chunk)
+    {
+        cJSON_Delete(chunk);
+        return -1;
+    }
+
+    while (!upload->failed && !upload->response &&
+           upload->sent - upload->acked >= STREAM_WINDOW)
+    {
+        read_upload_frame(upload);
+    }
+
+    if (upload->failed || upload->response)
+    {
+        cJSON_Delete(chunk);
+        return -1;
+    }
+
+    cJSON *message = cJSON_CreateObject();
+    if (message)
+    {
+        cJSON_AddNumberToObject(message, "id", upload->id);
+        cJSON_AddItemToObject(message, "chunk", chunk);
+    }
+    else
+    {
+        cJSON_Delete(chunk);
+    }
+
+    if (send_upload_message(upload, message) == -1)
+        return -1;
+    upload->sent++;
+    return 0;
+}
+
+/**
+ * @brief Ends an upload and waits for the result
+ * @param upload Upload handle (freed)
+ * @return Result (caller frees) or NULL on error
+ */
+cJSON *sockrpc_upload_finish(sockrpc_upload *upload)
+{
+    if (!upload)
+        return NULL;
+
+    sockrpc_client *client = upload->client;
+    if (!upload->failed && !upload->response)
+    {
+        cJSON *end = cJSON_CreateObject();
+        if (end)
+        {
+            cJSON_AddNumberToObject(end, "id", upload->id);
+            cJSON_AddBoolToObject(end, "end", 1);
+        }
+        send_upload_message(upload, end);
+    }
+
+    while (!upload->failed && !upload->response)
+        read_upload_frame(upload);
+    int has_events = client->events_head != NULL;
+    pthread_mutex_unlock(&client->mutex);
+
+    if (has_events)
+        deliver_events(client);
+
+    cJSON *result = unwrap_response(upload->response, upload->id);
+    free(upload);
+    return result;
+}
+
 /**
  * @brief Destroys a client instance
  * @param client Client context to destroy
  *
  * Cleanup process:
  * 1. Closes socket connection
- * 2. Destroys synchronization primitives
- * 3. Frees memory
+ * 2. Frees compression state, subscriptions and undelivered events
+ * 3. Destroys synchronization primitives
+ * 4. Frees memory
  *
  * @note Outstanding async calls may be terminated
+ * @note Async calls gathered for coalescing are sent and their callbacks
+ *       run before the connection is closed
+ * @note Calls still outstanding on a non-blocking client complete with NULL
  */
 void sockrpc_client_destroy(sockrpc_client *client)
 {
+    if (client->coalescer)
+        stop_coalescing(client);
+    if (client->nonblocking && !client->failed)
+        fail_calls(client);
+    free(client->calls);
+    free(client->in);
+    free(client->out);
+
     close(client->fd);
+    compress_context_destroy(client->compress);
+    compress_dict_destroy(client->dict);
+
+    while (client->subscriptions)
+    {
+        client_subscription *next = client->subscriptions->next;
+        free(client->subscriptions->topic);
+        free(client->subscriptions);
+        client->subscriptions = next;
+    }
+    while (client->events_head)
+    {
+        pending_event *next = client->events_head->next;
+        free(client->events_head->payload);
+        free(client->events_head);
+        client->events_head = next;
+    }
+
     pthread_mutex_destroy(&client->mutex);
     free(client);
 }
\ No newline at end of file
@@ -0,0 +1,423 @@
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+#ifdef SOCKRPC_HAVE_LZ4
+#include <lz4.h>
+#endif
+#ifdef SOCKRPC_HAVE_ZSTD
+#include <zstd.h>
+#endif
+#include "compress.h"
+
+/**
+ * @file compress.c
+ * @brief Implementation of per-connection payload compression
+ *
+ * Both codecs are used in their fastest settings: the goal is to cut
+ * bytes on large, repetitive JSON responses without adding noticeable
+ * latency. Contexts are allocated once per connection and reused for
+ * every message instead of being set up per call.
+ *
+ * Dictionaries are identified by a hash of their bytes rather than the
+ * zstd dictionary id, so raw-content dictionaries (a sample of typical
+ * messages) work as well as trained ones.
+ */
+
+/**
+ * @brief Zstandard compression level
+ */
+#define COMPRESS_ZSTD_LEVEL 1
+
+/**
+ * @brief LZ4 acceleration factor (1 = default speed/ratio)
+ */
+#define COMPRESS_LZ4_ACCELERATION 1
+
+/**
+ * @brief Digested dictionary
+ */
+struct compress_dict
+{
+    uint32_t id; /**< FNV-1a hash of the dictionary bytes */
+#ifdef SOCKRPC_HAVE_ZSTD
+    ZSTD_CDict *cdict; /**< Dictionary digested for compression */
+    ZSTD_DDict *ddict; /**< Dictionary digested for decompression */
+#endif
+};
+
+/**
+ * @brief Per-connection compression state
+ */
+struct compress_context
+{
+    compress_codec codec;       /**< Negotiated codec */
+    const compress_dict *dict;  /**< Shared dictionary or NULL */
+#ifdef SOCKRPC_HAVE_LZ4
+    void *lz4_state;            /**< LZ4 compression state */
+#endif
+#ifdef SOCKRPC_HAVE_ZSTD
+    ZSTD_CCtx *cctx;            /**< Zstandard compression context */
+    ZSTD_DCtx *dctx;            /**< Zstandard decompression context */
+#endif
+};
+
+/**
+ * @brief Returns the name of a codec
+ * @param codec Codec
+ * @return Static string
+ */
+const char *compress_codec_name(compress_codec codec)
+{
+    switch (codec)
+    {
+    case COMPRESS_LZ4:
+        return "lz4";
+    case COMPRESS_ZSTD:
+        return "zstd";
+    default:
+        return "none";
+    }
+}
+
+/**
+ * @brief Lists the built-in codecs in order of preference
+ * @param codecs Output array of at least 2 entries
+ * @return Number of codecs written
+ *
+ * zstd is preferred for its ratio on JSON; LZ4 is cheaper on CPU.
+ */
+int compress_supported_codecs(compress_codec *codecs)
+{
+    int count = 0;
+#ifdef SOCKRPC_HAVE_ZSTD
+    codecs[count++] = COMPRESS_ZSTD;
+#endif
+#ifdef SOCKRPC_HAVE_LZ4
+    codecs[count++] = COMPRESS_LZ4;
+#endif
+    (void)codecs;
+    return count;
+}
+
+/**
+ * @brief Looks up a built-in codec by name
+ * @param name Codec name
+ * @return Codec, or COMPRESS_NONE if unknown or not built in
+ */
+compress_codec compress_codec_from_name(const char *name)
+{
+    compress_codec codecs[2];
+    int count = compress_supported_codecs(codecs);
+    for (int i = 0; name && i < count; i++)
+    {
+        if (strcmp(name, compress_codec_name(codecs[i])) == 0)
+            return codecs[i];
+    }
+    return COMPRESS_NONE;
+}
+
+/**
+ * @brief Digests a dictionary for COMPRESS_ZSTD
+ * @param data Dictionary bytes
+ * @param size Dictionary size
+ * @return Dictionary or NULL
+ */
+compress_dict *compress_dict_create(const void *data, size_t size)
+{
+#ifdef SOCKRPC_HAVE_ZSTD
+    if (!data || size == 0)
+        return NULL;
+
+    compress_dict *dict = calloc(1, sizeof(compress_dict));
+    if (!dict)
+        return NULL;
+
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; i++)
+        hash = (hash ^ ((const unsigned char *)data)[i]) * 16777619u;
+    dict->id = hash ? hash : 1;
+
+    dict->cdict = ZSTD_createCDict(data, size, COMPRESS_ZSTD_LEVEL);
+    dict->ddict = ZSTD_createDDict(data, size);
+    if (!dict->cdict || !dict->ddict)
+    {
+        compress_dict_destroy(dict);
+        return NULL;
+    }
+    return dict;
+#else
+    (void)data;
+    (void)size;
+    return NULL;
+#endif
+}
+
+/**
+ * @brief Frees a dictionary
+ * @param dict Dictionary, may be NULL
+ */
+void compress_dict_destroy(compress_dict *dict)
+{
+    if (!dict)
+        return;
+
+#ifdef SOCKRPC_HAVE_ZSTD
+    ZSTD_freeCDict(dict->cdict);
+    ZSTD_freeDDict(dict->ddict);
+#endif
+    free(dict);
+}
+
+/**
+ * @brief Returns the negotiation id of a dictionary
+ * @param dict Dictionary, may be NULL
+ * @return Non-zero id, or 0 for NULL
+ */
+uint32_t compress_dict_id(const compress_dict *dict)
+{
+    return dict ? dict->id : 0;
+}
+
+/**
+ * @brief Creates compression state for one connection
+ * @param codec Negotiated codec
+ * @param dict Dictionary for COMPRESS_ZSTD, or NULL
+ * @return Context or NULL on error
+ */
+compress_context *compress_context_create(compress_codec codec, const compress_dict *dict)
+{
+    compress_context *ctx = calloc(1, sizeof(compress_context));
+    if (!ctx)
+        return NULL;
+
+    ctx->codec = codec;
+    int ok = 0;
+
+    switch (codec)
+    {
+#ifdef SOCKRPC_HAVE_LZ4
+    case COMPRESS_LZ4:
+        ctx->lz4_state = malloc(LZ4_sizeofState());
+        ok = ctx->lz4_state != NULL;
+        break;
+#endif
+#ifdef SOCKRPC_HAVE_ZSTD
+    case COMPRESS_ZSTD:
+        ctx->dict = dict;
+        ctx->cctx = ZSTD_createCCtx();
+        ctx->dctx = ZSTD_createDCtx();
+        ok = ctx->cctx && ctx->dctx;
+        break;
+#endif
+    default:
+        (void)dict;
+        break;
+    }
+
+    if (!ok)
+    {
+        compress_context_destroy(ctx);
+        return NULL;
+    }
+    return ctx;
+}
+
+/**
+ * @brief Frees compression state
+ * @param ctx Context, may be NULL
+ */
+void compress_context_destroy(compress_context *ctx)
+{
+    if (!ctx)
+        return;
+
+#ifdef SOCKRPC_HAVE_LZ4
+    free(ctx->lz4_state);
+#endif
+#ifdef SOCKRPC_HAVE_ZSTD
+    ZSTD_freeCCtx(ctx->cctx);
+    ZSTD_freeDCtx(ctx->dctx);
+#endif
+    free(ctx);
+}
+
+/**
+ * @brief Returns the codec of a context
+ * @param ctx Context
+ * @return Codec
+ */
+compress_codec compress_context_codec(const compress_context *ctx)
+{
+    return ctx->codec;
+}
+
+/**
+ * @brief Returns the largest compressed size of a payload
+ * @param ctx Context
+ * @param len Payload length
+ * @return Bound in bytes, 0 if the payload cannot be compressed
+ */
+static size_t codec_bound(const compress_context *ctx, size_t len)
+{
+    switch (ctx->codec)
+    {
+#ifdef SOCKRPC_HAVE_LZ4
+    case COMPRESS_LZ4:
+        return len > INT32_MAX / 2 ? 0 : (size_t)LZ4_compressBound((int)len);
+#endif
+#ifdef SOCKRPC_HAVE_ZSTD
+    case COMPRESS_ZSTD:
+        return ZSTD_compressBound(len);
+#endif
+    default:
+        (void)len;
+        return 0;
+    }
+}
+
+/**
+ * @brief Runs the codec's compressor
+ * @param ctx Context
+ * @param src Payload
+ * @param len Payload length
+ * @param dst Output buffer
+ * @param capacity Output capacity, at least codec_bound(len)
+ * @return Compressed size, 0 on failure
+ */
+static size_t codec_compress(compress_context *ctx, const char *src, size_t len, char *dst,
+                             size_t capacity)
+{
+    switch (ctx->codec)
+    {
+#ifdef SOCKRPC_HAVE_LZ4
+    case COMPRESS_LZ4:
+    {
+        int n = LZ4_compress_fast_extState(ctx->lz4_state, src, dst, (int)len, (int)capacity,
+                                           COMPRESS_LZ4_ACCELERATION);
+        return n > 0 ? (size_t)n : 0;
+    }
+#endif
+#ifdef SOCKRPC_HAVE_ZSTD
+    case COMPRESS_ZSTD:
+    {
+        size_t n = ctx->dict
+                       ? ZSTD_compress_usingCDict(ctx->cctx, dst, capacity, src, len, ctx->dict->cdict)
+                       : ZSTD_compressCCtx(ctx->cctx, dst, capacity, src, len, COMPRESS_ZSTD_LEVEL);
+        return ZSTD_isError(n) ? 0 : n;
+    }
+#endif
+    default:
+        (void)src;
+        (void)len;
+        (void)dst;
+        (void)capacity;
+        return 0;
+    }
+}
+
+/**
+ * @brief Runs the codec's decompressor
+ * @param ctx Context
+ * @param src Compressed data (without length prefix)
+ * @param len Compressed length
+ * @param dst Output buffer of original bytes
+ * @param original Expected original length
+ * @return 1 if exactly original bytes were produced, 0 otherwise
+ */
+static int codec_decompress(compress_context *ctx, const char *src, size_t len, char *dst,
+                            size_t original)
+{
+    switch (ctx->codec)
+    {
+#ifdef SOCKRPC_HAVE_LZ4
+    case COMPRESS_LZ4:
+        return len <= INT32_MAX &&
+               LZ4_decompress_safe(src, dst, (int)len, (int)original) == (int)original;
+#endif
+#ifdef SOCKRPC_HAVE_ZSTD
+    case COMPRESS_ZSTD:
+    {
+        size_t n = ctx->dict
+                       ? ZSTD_decompress_usingDDict(ctx->dctx, dst, original, src, len, ctx->dict->ddict)
+                       : ZSTD_decompressDCtx(ctx->dctx, dst, original, src, len);
+        return !ZSTD_isError(n) && n == original;
+    }
+#endif
+    default:
+        (void)src;
+        (void)len;
+        (void)dst;
+        (void)original;
+        return 0;
+    }
+}
+
+/**
+ * @brief Compresses one payload
+ * @param ctx Context
+ * @param data Payload
+ * @param len Payload length
+ * @param out_len Set to the length of the result
+ * @return Compressed payload with length prefix, or NULL
+ */
+char *compress_encode(compress_context *ctx, const char *data, size_t len, size_t *out_len)
+{
+    size_t bound = codec_bound(ctx, len);
+    if (bound == 0 || len > UINT32_MAX)
+        return NULL;
+
+    char *out = malloc(COMPRESS_PREFIX_SIZE + bound);
+    if (!out)
+        return NULL;
+
+    size_t written = codec_compress(ctx, data, len, out + COMPRESS_PREFIX_SIZE, bound);
+
+    // Not worth it: the peer would spend time decoding for no gain
+    if (written == 0 || COMPRESS_PREFIX_SIZE + written >= len)
+    {
+        free(out);
+        return NULL;
+    }
+
+    uint32_t original = htonl((uint32_t)len);
+    memcpy(out, &original, COMPRESS_PREFIX_SIZE);
+    *out_len = COMPRESS_PREFIX_SIZE + written;
+    return out;
+}
+
+/**
+ * @brief Decompresses one payload
+ * @param ctx Context
+ * @param data Compressed payload with length prefix
+ * @param len Compressed payload length
+ * @param max_len Largest acceptable original length
+ * @param out_len Set to the original length
+ * @return NUL-terminated original payload or NULL
+ */
+char *compress_decode(compress_context *ctx, const char *data, size_t len, size_t max_len,
+                      size_t *out_len)
+{
+    if (len < COMPRESS_PREFIX_SIZE)
+        return NULL;
+
+    uint32_t original;
+    memcpy(&original, data, COMPRESS_PREFIX_SIZE);
+    original = ntohl(original);
+    if (original > max_len)
+        return NULL;
+
+    char *out = malloc((size_t)original + 1);
+    if (!out)
+        return NULL;
+
+    if (!codec_decompress(ctx, data + COMPRESS_PREFIX_SIZE, len - COMPRESS_PREFIX_SIZE, out,
+                          original))
+    {
+        free(out);
+        return NULL;
+    }
+
+    out[original] = '\0';
+    *out_len = original;
+    return out;
+}
@@ -0,0 +1,145 @@
+#ifndef SOCKRPC_COMPRESS_H
+#define SOCKRPC_COMPRESS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @file compress.h
+ * @brief Internal payload compression shared by client and server
+ *
+ * Compression is negotiated per connection and applied per message: a
+ * frame whose flags carry a codec id holds a 4-byte big-endian original
+ * length followed by the compressed payload. Codecs are optional at
+ * build time (SOCKRPC_HAVE_LZ4, SOCKRPC_HAVE_ZSTD); without any, every
+ * negotiation settles on COMPRESS_NONE.
+ */
+
+/**
+ * @brief Built-in method a client calls to negotiate compression
+ *
+ * Params: {"compression": ["zstd", "lz4"], "dictionary": id}, codecs in
+ * the client's order of preference and the id of its dictionary or 0.
+ * Result: {"compression": "zstd"|"lz4"|"none", "dictionary": id or 0}.
+ */
+#define COMPRESS_NEGOTIATE_METHOD "sockrpc.negotiate"
+
+/**
+ * @brief Size of the original-length prefix of a compressed payload
+ */
+#define COMPRESS_PREFIX_SIZE 4
+
+/**
+ * @brief Codec identifiers, as carried in the frame flags
+ */
+typedef enum
+{
+    COMPRESS_NONE = 0, /**< Uncompressed */
+    COMPRESS_LZ4 = 1,  /**< LZ4 block format */
+    COMPRESS_ZSTD = 2  /**< Zstandard, optionally with a dictionary */
+} compress_codec;
+
+/**
+ * @brief Digested dictionary shared by all connections
+ */
+typedef struct compress_dict compress_dict;
+
+/**
+ * @brief Per-connection compression state
+ *
+ * Holds reusable compression and decompression contexts. Compression
+ * and decompression use separate state, so one thread may encode while
+ * another decodes; each direction must be used by one thread at a time.
+ */
+typedef struct compress_context compress_context;
+
+/**
+ * @brief Returns the name of a codec ("none", "lz4", "zstd")
+ * @param codec Codec
+ * @return Static string
+ */
+const char *compress_codec_name(compress_codec codec);
+
+/**
+ * @brief Looks up a codec built into this library by name
+ * @param name Codec name
+ * @return Codec, or COMPRESS_NONE if unknown or not built in
+ */
+compress_codec compress_codec_from_name(const char *name);
+
+/**
+ * @brief Lists the built-in codecs in order of preference
+ * @param codecs Output array of at least 2 entries
+ * @return Number of codecs written
+ */
+int compress_supported_codecs(compress_codec *codecs);
+
+/**
+ * @brief Digests a dictionary for COMPRESS_ZSTD
+ * @param data Dictionary bytes (trained or raw content), copied
+ * @param size Dictionary size
+ * @return Dictionary or NULL if zstd is not built in or on error
+ */
+compress_dict *compress_dict_create(const void *data, size_t size);
+
+/**
+ * @brief Frees a dictionary
+ * @param dict Dictionary, may be NULL
+ *
+ * Contexts using the dictionary must be destroyed first.
+ */
+void compress_dict_destroy(compress_dict *dict);
+
+/**
+ * @brief Returns the id both peers compare to agree on a dictionary
+ * @param dict Dictionary, may be NULL
+ * @return Non-zero id, or 0 for NULL
+ */
+uint32_t compress_dict_id(const compress_dict *dict);
+
+/**
+ * @brief Creates compression state for one connection
+ * @param codec Negotiated codec, not COMPRESS_NONE
+ * @param dict Dictionary for COMPRESS_ZSTD, or NULL
+ * @return Context or NULL on error
+ */
+compress_context *compress_context_create(compress_codec codec, const compress_dict *dict);
+
+/**
+ * @brief Frees compression state
+ * @param ctx Context, may be NULL
+ */
+void compress_context_destroy(compress_context *ctx);
+
+/**
+ * @brief Returns the codec of a context
+ * @param ctx Context
+ * @return Codec
+ */
+compress_codec compress_context_codec(const compress_context *ctx);
+
+/**
+ * @brief Compresses one payload
+ * @param ctx Context
+ * @param data Payload
+ * @param len Payload length
+ * @param out_len Set to the length of the result
+ * @return Compressed payload with length prefix (caller frees), or NULL
+ *         if compression failed or would not make the payload smaller
+ */
+char *compress_encode(compress_context *ctx, const char *data, size_t len, size_t *out_len);
+
+/**
+ * @brief Decompresses one payload
+ * @param ctx Context
+ * @param data Compressed payload with length prefix
+ * @param len Compressed payload length
+ * @param max_len Largest acceptable original length
+ * @param out_len Set to the original length
+ * @return NUL-terminated original payload (caller frees) or NULL if the
+ *         data is corrupt or too large
+ */
+char *compress_decode(compress_context *ctx, const char *data, size_t len, size_t max_len,
+                      size_t *out_len);
+
+#endif /* SOCKRPC_COMPRESS_H */
@@ -0,0 +1,300 @@
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "frame.h"
+
+/**
+ * @file frame.c
+ * @brief Implementation of the internal message framing
+ *
+ * All sends use MSG_NOSIGNAL so that writing to a closed peer reports
+ * EPIPE instead of killing the process with SIGPIPE.
+ */
+
+/**
+ * @brief Waits until fd is ready for the given poll events
+ * @param fd File descriptor
+ * @param events POLLIN or POLLOUT
+ * @return 0 when ready, -1 on timeout or error
+ */
+static int wait_ready(int fd, short events)
+{
+    struct pollfd pfd = {.fd = fd, .events = events};
+    int rc;
+    do
+    {
+        rc = poll(&pfd, 1, FRAME_IO_TIMEOUT_MS);
+    } while (rc == -1 && errno == EINTR);
+
+    return rc == 1 ? 0 : -1;
+}
+
+/**
+ * @brief Encodes a frame header
+ * @param header Output buffer of FRAME_HEADER_SIZE bytes
+ * @param len Payload length
+ * @param flags Frame flags
+ */
+void frame_encode_header(unsigned char *header, size_t len, uint32_t flags)
+{
+    uint32_t words[2] = {htonl((uint32_t)len), htonl(flags)};
+    memcpy(header, words, FRAME_HEADER_SIZE);
+}
+
+/**
+ * @brief Decodes and validates a frame header
+ * @param header FRAME_HEADER_SIZE bytes
+ * @param len Set to the payload length
+ * @param flags Set to the frame flags
+ * @return 0 if valid, -1 if the frame is malformed or too large
+ */
+int frame_decode_header(const unsigned char *header, size_t *len, uint32_t *flags)
+{
+    uint32_t words[2];
+    memcpy(words, header, FRAME_HEADER_SIZE);
+
+    *len = ntohl(words[0]);
+    *flags = ntohl(words[1]);
+    if ((*flags & ~FRAME_FLAG_CODEC_MASK) != 0 || *len > FRAME_MAX_PAYLOAD)
+        return -1;
+    return 0;
+}
+
+/**
+ * @brief Sends one frame gathered from several buffers
+ * @param fd Connected socket
+ * @param socktype SOCK_STREAM or SOCK_SEQPACKET
+ * @param iov Header slot followed by the payload buffers
+ * @param iovcnt Number of entries
+ * @param flags Frame flags
+ * @return 0 on success, -1 on error
+ */
+int frame_sendv(int fd, int socktype, struct iovec *iov, int iovcnt, uint32_t flags)
+{
+    if (iovcnt < 1 || iovcnt > FRAME_MAX_IOV)
+        return -1;
+
+    size_t len = 0;
+    for (int i = 1; i < iovcnt; i++)
+    {
+        len += iov[i].iov_len;
+    }
+    if (len > FRAME_MAX_PAYLOAD)
+        return -1;
+
+    unsigned char header[FRAME_HEADER_SIZE];
+    frame_encode_header(header, len, flags);
+    iov[0].iov_base = header;
+    iov[0].iov_len = FRAME_HEADER_SIZE;
+
+    struct msghdr msg = {.msg_iov = iov, .msg_iovlen = iovcnt};
+    size_t remaining = FRAME_HEADER_SIZE + len;
+
+    while (remaining > 0)
+    {
+        ssize_t n = sendmsg(fd, &msg, MSG_NOSIGNAL);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if ((errno == EAGAIN || errno == EWOULDBLOCK) && wait_ready(fd, POLLOUT) == 0)
+                continue;
+            return -1;
+        }
+
+        // Seqpacket sends are atomic, only streams can be partial
+        if (socktype == SOCK_SEQPACKET)
+            return 0;
+
+        remaining -= n;
+        while (n > 0 && msg.msg_iovlen > 0)
+        {
+            if ((size_t)n >= msg.msg_iov->iov_len)
+            {
+                n -= msg.msg_iov->iov_len;
+                msg.msg_iov++;
+                msg.msg_iovlen--;
+            }
+            else
+            {
+                msg.msg_iov->iov_base = (char *)msg.msg_iov->iov_base + n;
+                msg.msg_iov->iov_len -= n;
+                n = 0;
+            }
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Sends one frame
+ * @param fd Connected socket
+ * @param socktype SOCK_STREAM or SOCK_SEQPACKET
+ * @param payload Payload bytes
+ * @param len Payload length
+ * @param flags Frame flags
+ * @return 0 on success, -1 on error
+ */
+int frame_send(int fd, int socktype, const char *payload, size_t len, uint32_t flags)
+{
+    struct iovec iov[2] = {{0}, {.iov_base = (void *)payload, .iov_len = len}};
+    return frame_sendv(fd, socktype, iov, 2, flags);
+}
+
+/**
+ * @brief Writes encoded frames to a stream socket
+ * @param fd Socket
+ * @param data Frames
+ * @param len Bytes in data
+ * @return 0 on success, -1 on error
+ */
+int frame_write(int fd, const char *data, size_t len)
+{
+    size_t total = 0;
+    while (total < len)
+    {
+        ssize_t n = send(fd, data + total, len - total, MSG_NOSIGNAL);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if ((errno == EAGAIN || errno == EWOULDBLOCK) && wait_ready(fd, POLLOUT) == 0)
+                continue;
+            return -1;
+        }
+        total += n;
+    }
+    return 0;
+}
+
+/**
+ * @brief Reads exactly len bytes from a stream socket
+ * @param fd Socket
+ * @param buffer Destination
+ * @param len Number of bytes to read
+ * @param at_boundary Non-zero if nothing of the current frame was read yet
+ * @return FRAME_OK, or FRAME_AGAIN/FRAME_CLOSED (only at a frame boundary),
+ *         or FRAME_ERROR
+ */
+static frame_status read_exact(int fd, char *buffer, size_t len, int at_boundary)
+{
+    size_t total = 0;
+    while (total < len)
+    {
+        ssize_t n = read(fd, buffer + total, len - total);
+        if (n == 0)
+            return at_boundary && total == 0 ? FRAME_CLOSED : FRAME_ERROR;
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                if (at_boundary && total == 0)
+                    return FRAME_AGAIN;
+                if (wait_ready(fd, POLLIN) == 0)
+                    continue;
+            }
+            return FRAME_ERROR;
+        }
+        total += n;
+    }
+    return FRAME_OK;
+}
+
+/**
+ * @brief Receives one frame from a SOCK_SEQPACKET socket
+ * @param fd Socket
+ * @param len Set to the payload length
+ * @param flags Set to the frame flags
+ * @param status Set to the result
+ * @return NUL-terminated payload or NULL
+ *
+ * The packet size is peeked with MSG_TRUNC so the buffer is allocated
+ * exactly, then the whole frame is read with a single recv.
+ */
+static char *recv_packet(int fd, size_t *len, uint32_t *flags, frame_status *status)
+{
+    ssize_t size;
+    do
+    {
+        size = recv(fd, NULL, 0, MSG_PEEK | MSG_TRUNC);
+    } while (size < 0 && errno == EINTR);
+
+    if (size <= 0)
+    {
+        if (size == 0)
+            *status = FRAME_CLOSED;
+        else
+            *status = errno == EAGAIN || errno == EWOULDBLOCK ? FRAME_AGAIN : FRAME_ERROR;
+        return NULL;
+    }
+
+    *status = FRAME_ERROR;
+    char *buffer = malloc(size + 1);
+    if (!buffer)
+        return NULL;
+
+    ssize_t n = recv(fd, buffer, size, 0);
+    if (n != size || n < FRAME_HEADER_SIZE ||
+        frame_decode_header((unsigned char *)buffer, len, flags) == -1 ||
+        *len != (size_t)n - FRAME_HEADER_SIZE)
+    {
+        free(buffer);
+        return NULL;
+    }
+
+    memmove(buffer, buffer + FRAME_HEADER_SIZE, *len);
+    buffer[*len] = '\0';
+    *status = FRAME_OK;
+    return buffer;
+}
+
+/**
+ * @brief Receives one frame
+ * @param fd Connected socket
+ * @param socktype SOCK_STREAM or SOCK_SEQPACKET
+ * @param len Set to the payload length on FRAME_OK
+ * @param flags Set to the frame flags on FRAME_OK
+ * @param status Set to the result of the call
+ * @return NUL-terminated payload (caller frees) or NULL
+ */
+char *frame_recv(int fd, int socktype, size_t *len, uint32_t *flags, frame_status *status)
+{
+    if (socktype == SOCK_SEQPACKET)
+        return recv_packet(fd, len, flags, status);
+
+    unsigned char header[FRAME_HEADER_SIZE];
+    *status = read_exact(fd, (char *)header, FRAME_HEADER_SIZE, 1);
+    if (*status != FRAME_OK)
+        return NULL;
+
+    if (frame_decode_header(header, len, flags) == -1)
+    {
+        *status = FRAME_ERROR;
+        return NULL;
+    }
+
+    char *payload = malloc(*len + 1);
+    if (!payload)
+    {
+        *status = FRAME_ERROR;
+        return NULL;
+    }
+
+    *status = read_exact(fd, payload, *len, 0);
+    if (*status != FRAME_OK)
+    {
+        free(payload);
+        return NULL;
+    }
+
+    payload[*len] = '\0';
+    return payload;
+}
@@ -0,0 +1,137 @@
+#ifndef SOCKRPC_FRAME_H
+#define SOCKRPC_FRAME_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+/**
+ * @file frame.h
+ * @brief Internal message framing shared by client and server
+ *
+ * Every message on the wire is a frame: an 8-byte header followed by the
+ * JSON payload. The header holds the payload length and a flags word,
+ * both as big-endian 32-bit integers. The low byte of the flags names
+ * the compression codec of the payload (see compress.h), 0 for plain
+ * JSON; the other bits are reserved and must be 0.
+ *
+ * Byte streams (Unix SOCK_STREAM, TCP) may split or merge writes, so
+ * the length is needed to find message boundaries. On SOCK_SEQPACKET
+ * sockets a frame is always sent and received as one packet.
+ */
+
+/**
+ * @brief Size of the frame header in bytes
+ */
+#define FRAME_HEADER_SIZE 8
+
+/**
+ * @brief Flags bits holding the payload's compression codec
+ */
+#define FRAME_FLAG_CODEC_MASK 0xffu
+
+/**
+ * @brief Largest accepted payload; bigger frames are a protocol error
+ */
+#define FRAME_MAX_PAYLOAD (64u * 1024 * 1024)
+
+/**
+ * @brief Most iovec entries frame_sendv accepts (Linux UIO_MAXIOV)
+ */
+#define FRAME_MAX_IOV 1024
+
+/**
+ * @brief Time to wait for the rest of a partially received frame
+ */
+#define FRAME_IO_TIMEOUT_MS 5000
+
+/**
+ * @brief Result of frame_recv
+ */
+typedef enum
+{
+    FRAME_OK,     /**< A complete frame was received */
+    FRAME_AGAIN,  /**< Non-blocking socket has no pending frame */
+    FRAME_CLOSED, /**< Peer closed the connection cleanly */
+    FRAME_ERROR   /**< I/O error, timeout or malformed frame */
+} frame_status;
+
+/**
+ * @brief Encodes a frame header
+ * @param header Output buffer of FRAME_HEADER_SIZE bytes
+ * @param len Payload length
+ * @param flags Frame flags
+ *
+ * For code that assembles frames in its own buffers.
+ */
+void frame_encode_header(unsigned char *header, size_t len, uint32_t flags);
+
+/**
+ * @brief Decodes and validates a frame header
+ * @param header FRAME_HEADER_SIZE bytes
+ * @param len Set to the payload length
+ * @param flags Set to the frame flags
+ * @return 0 if valid, -1 if reserved flags are set or the payload is
+ *         too large
+ */
+int frame_decode_header(const unsigned char *header, size_t *len, uint32_t *flags);
+
+/**
+ * @brief Sends one frame
+ * @param fd Connected socket (blocking or non-blocking)
+ * @param socktype SOCK_STREAM or SOCK_SEQPACKET
+ * @param payload Payload bytes
+ * @param len Payload length
+ * @param flags Frame flags, 0 for plain JSON
+ * @return 0 on success, -1 on error
+ *
+ * Header and payload go out in a single sendmsg call whenever the
+ * socket buffer allows it. Partial writes are completed, waiting for
+ * POLLOUT on non-blocking sockets.
+ */
+int frame_send(int fd, int socktype, const char *payload, size_t len, uint32_t flags);
+
+/**
+ * @brief Sends one frame gathered from several buffers
+ * @param fd Connected socket (blocking or non-blocking)
+ * @param socktype SOCK_STREAM or SOCK_SEQPACKET
+ * @param iov Buffers; iov[0] is overwritten with the frame header and
+ *        iov[1..iovcnt-1] form the payload. Modified while sending.
+ * @param iovcnt Number of entries, at most FRAME_MAX_IOV
+ * @param flags Frame flags, 0 for plain JSON
+ * @return 0 on success, -1 on error
+ *
+ * Same as frame_send, without first copying the payload into one
+ * buffer.
+ */
+int frame_sendv(int fd, int socktype, struct iovec *iov, int iovcnt, uint32_t flags);
+
+/**
+ * @brief Writes frames that were already encoded into one buffer
+ * @param fd Connected stream socket (blocking or non-blocking)
+ * @param data Back-to-back frames, each header followed by its payload
+ * @param len Bytes in data
+ * @return 0 on success, -1 on error
+ *
+ * Lets a sender collect several frames and write them with one call.
+ * Partial writes are completed like in frame_send.
+ */
+int frame_write(int fd, const char *data, size_t len);
+
+/**
+ * @brief Receives one frame
+ * @param fd Connected socket (blocking or non-blocking)
+ * @param socktype SOCK_STREAM or SOCK_SEQPACKET
+ * @param len Set to the payload length on FRAME_OK
+ * @param flags Set to the frame flags on FRAME_OK
+ * @param status Set to the result of the call
+ * @return NUL-terminated payload (caller frees) or NULL
+ *
+ * On non-blocking sockets FRAME_AGAIN is reported only if no byte of a
+ * new frame is available. Once a frame has started, the rest is waited
+ * for up to FRAME_IO_TIMEOUT_MS.
+ */
+char *frame_recv(int fd, int socktype, size_t *len, uint32_t *flags, frame_status *status);
+
+#endif /* SOCKRPC_FRAME_H */
@@ -0,0 +1,46 @@
+#ifndef SOCKRPC_LOCK_H
+#define SOCKRPC_LOCK_H
+
+#include <pthread.h>
+
+/**
+ * @file lock.h
+ * @brief Internal mutex operations of the server's request path
+ *
+ * The server, its buffer pools, connection slabs and topic registry
+ * lock through these macros. A library built with
+ * SOCKRPC_EMBEDDED_ONLY ("make EMBEDDED=1") only runs servers driven by
+ * sockrpc_server_process() on the application's thread and has no
+ * worker threads or groups, so the macros compile to nothing there.
+ *
+ * Modules with their own background thread (capture writer, span
+ * exporter) and the client keep real locks in every build.
+ */
+
+#ifdef SOCKRPC_EMBEDDED_ONLY
+
+/**
+ * @brief Locks a mutex (no-op in the embedded-only build)
+ */
+#define lock_mutex(mutex) ((void)(mutex))
+
+/**
+ * @brief Unlocks a mutex (no-op in the embedded-only build)
+ */
+#define unlock_mutex(mutex) ((void)(mutex))
+
+#else
+
+/**
+ * @brief Locks a mutex
+ */
+#define lock_mutex(mutex) pthread_mutex_lock(mutex)
+
+/**
+ * @brief Unlocks a mutex
+ */
+#define unlock_mutex(mutex) pthread_mutex_unlock(mutex)
+
+#endif
+
+#endif /* SOCKRPC_LOCK_H */
@@ -0,0 +1,125 @@
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "module.h"
+
+/**
+ * @file module.c
+ * @brief Implementation of handler module loading
+ *
+ * dlopen returns the already loaded instance when asked for the same file
+ * again, which would make a reload a no-op, and overwriting a mapped
+ * shared object in place corrupts the running code. Loading from a
+ * private memfd copy avoids both: each load is a separate instance and
+ * the original file can be replaced by any means.
+ */
+
+/**
+ * @brief Size of the buffer used to copy a module into memory
+ */
+#define MODULE_COPY_CHUNK 65536
+
+/**
+ * @brief Copies a file into a new anonymous memory file
+ * @param path File to copy
+ * @return memfd holding the file contents, or -1 on error
+ */
+static int copy_to_memfd(const char *path)
+{
+    int in = open(path, O_RDONLY | O_CLOEXEC);
+    if (in == -1)
+        return -1;
+
+    int out = memfd_create("sockrpc-module", MFD_CLOEXEC);
+    if (out == -1)
+    {
+        close(in);
+        return -1;
+    }
+
+    char buffer[MODULE_COPY_CHUNK];
+    ssize_t n;
+    while ((n = read(in, buffer, sizeof(buffer))) > 0)
+    {
+        if (write(out, buffer, n) != n)
+        {
+            n = -1;
+            break;
+        }
+    }
+
+    close(in);
+    if (n < 0)
+    {
+        close(out);
+        return -1;
+    }
+    return out;
+}
+
+/**
+ * @brief Loads a private instance of a module
+ * @param path Path to the shared object
+ * @return Module with one reference, or NULL on error
+ */
+module *module_open(const char *path)
+{
+    int fd = copy_to_memfd(path);
+    if (fd == -1)
+        return NULL;
+
+    char fd_path[64];
+    snprintf(fd_path, sizeof(fd_path), "/proc/self/fd/%d", fd);
+    void *handle = dlopen(fd_path, RTLD_NOW | RTLD_LOCAL);
+    close(fd); // The mapping keeps the contents alive
+    if (!handle)
+        return NULL;
+
+    const sockrpc_module *info = dlsym(handle, SOCKRPC_MODULE_SYMBOL);
+    if (!info || info->abi_version != SOCKRPC_MODULE_ABI_VERSION || !info->methods)
+    {
+        dlclose(handle);
+        return NULL;
+    }
+
+    module *mod = calloc(1, sizeof(module));
+    if (!mod || !(mod->path = strdup(path)))
+    {
+        free(mod);
+        dlclose(handle);
+        return NULL;
+    }
+
+    mod->handle = handle;
+    mod->methods = info->methods;
+    mod->refs = 1;
+    return mod;
+}
+
+/**
+ * @brief Takes a reference to a module
+ * @param mod Module
+ */
+void module_acquire(module *mod)
+{
+    __atomic_add_fetch(&mod->refs, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Drops a reference, unloading the module when none remain
+ * @param mod Module
+ */
+void module_release(module *mod)
+{
+    if (__atomic_sub_fetch(&mod->refs, 1, __ATOMIC_ACQ_REL) != 0)
+        return;
+
+    dlclose(mod->handle);
+    free(mod->path);
+    free(mod);
+}
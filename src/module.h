@@ -0,0 +1,55 @@
+#ifndef SOCKRPC_MODULE_H
+#define SOCKRPC_MODULE_H
+
+#include "sockrpc/sockrpc.h"
+
+/**
+ * @file module.h
+ * @brief Internal loading of handler modules (shared objects)
+ *
+ * A loaded module is reference counted: the server holds one reference
+ * while the module is installed and every running call holds another.
+ * The shared object is unloaded when the last reference is dropped, so
+ * calls that started before a reload finish on the old code.
+ */
+
+/**
+ * @brief One loaded instance of a handler module
+ */
+typedef struct module
+{
+    char *path;                /**< Path the module was loaded from */
+    void *handle;              /**< dlopen handle */
+    const rpc_method *methods; /**< Exported method table, {NULL, NULL} terminated */
+    int refs;                  /**< Installed reference plus running calls (atomic) */
+} module;
+
+/**
+ * @brief Loads a private instance of a module
+ * @param path Path to the shared object
+ * @return Module with one reference, or NULL on error
+ *
+ * The file is copied to an anonymous memory file before dlopen, so every
+ * call yields a fresh instance even if the path names the same file as a
+ * module that is still loaded, and the file may be overwritten in place
+ * while loaded.
+ *
+ * Error conditions (returns NULL):
+ * - File cannot be read or dlopen fails
+ * - Missing SOCKRPC_MODULE_SYMBOL or ABI version mismatch
+ */
+module *module_open(const char *path);
+
+/**
+ * @brief Takes a reference to a module
+ * @param mod Module
+ */
+void module_acquire(module *mod);
+
+/**
+ * @brief Drops a reference, unloading the module when none remain
+ * @param mod Module
+ */
+void module_release(module *mod);
+
+#endif /* SOCKRPC_MODULE_H */
@@ -0,0 +1,176 @@
+#include <stdlib.h>
+#include <sys/mman.h>
+#include "pool.h"
+#include "lock.h"
+
+/**
+ * @file pool.c
+ * @brief Implementation of the size-classed buffer pool
+ */
+
+/**
+ * @brief Capacity of each size class
+ */
+static const size_t class_sizes[POOL_CLASSES] = {POOL_MIN_SIZE, 64 * 1024, POOL_MAX_SIZE};
+
+/**
+ * @brief Most free buffers kept per class (1 MiB, 2 MiB and 4 MiB)
+ */
+static const size_t class_limits[POOL_CLASSES] = {256, 32, 4};
+
+/**
+ * @brief Finds the smallest class holding size bytes
+ * @param size Required size
+ * @return Class index, or -1 if size needs a huge buffer
+ */
+static int size_class(size_t size)
+{
+    for (int i = 0; i < POOL_CLASSES; i++)
+    {
+        if (size <= class_sizes[i])
+            return i;
+    }
+    return -1;
+}
+
+/**
+ * @brief Rounds a huge size up to whole pages
+ * @param size Required size
+ * @return Mapping size
+ */
+static size_t huge_capacity(size_t size)
+{
+    size_t page = 4096;
+    return (size + page - 1) & ~(page - 1);
+}
+
+/**
+ * @brief Initializes an empty pool
+ * @param pool Pool
+ */
+void pool_init(buffer_pool *pool)
+{
+    for (int i = 0; i < POOL_CLASSES; i++)
+    {
+        pool->free[i] = NULL;
+        pool->free_count[i] = 0;
+    }
+    pool->stats = (pool_stats){0};
+    pthread_mutex_init(&pool->mutex, NULL);
+}
+
+/**
+ * @brief Frees every cached buffer
+ * @param pool Pool
+ */
+void pool_cleanup(buffer_pool *pool)
+{
+    for (int i = 0; i < POOL_CLASSES; i++)
+    {
+        while (pool->free[i])
+        {
+            pool_free *next = pool->free[i]->next;
+            free(pool->free[i]);
+            pool->free[i] = next;
+        }
+        pool->free_count[i] = 0;
+    }
+    pool->stats.cached_bytes = 0;
+    pthread_mutex_destroy(&pool->mutex);
+}
+
+/**
+ * @brief Acquires a buffer of at least size bytes
+ * @param pool Pool
+ * @param size Required size
+ * @param capacity Set to the actual capacity
+ * @return Buffer or NULL on allocation failure
+ */
+char *pool_acquire(buffer_pool *pool, size_t size, size_t *capacity)
+{
+    int cls = size_class(size);
+    if (cls == -1)
+    {
+        size_t len = huge_capacity(size);
+        void *buffer = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (buffer == MAP_FAILED)
+            return NULL;
+
+        lock_mutex(&pool->mutex);
+        pool->stats.huge++;
+        pool->stats.in_use_bytes += len;
+        unlock_mutex(&pool->mutex);
+        *capacity = len;
+        return buffer;
+    }
+
+    lock_mutex(&pool->mutex);
+    pool_free *buffer = pool->free[cls];
+    if (buffer)
+    {
+        pool->free[cls] = buffer->next;
+        pool->free_count[cls]--;
+        pool->stats.cached_bytes -= class_sizes[cls];
+        pool->stats.hits++;
+    }
+    else
+    {
+        pool->stats.misses++;
+    }
+    pool->stats.in_use_bytes += class_sizes[cls];
+    unlock_mutex(&pool->mutex);
+
+    if (!buffer && !(buffer = malloc(class_sizes[cls])))
+    {
+        lock_mutex(&pool->mutex);
+        pool->stats.in_use_bytes -= class_sizes[cls];
+        unlock_mutex(&pool->mutex);
+        return NULL;
+    }
+
+    *capacity = class_sizes[cls];
+    return (char *)buffer;
+}
+
+/**
+ * @brief Returns a buffer to its pool
+ * @param pool Pool it was acquired from
+ * @param buffer Buffer, may be NULL
+ * @param capacity Capacity reported by pool_acquire
+ */
+void pool_release(buffer_pool *pool, char *buffer, size_t capacity)
+{
+    if (!buffer)
+        return;
+
+    int cls = size_class(capacity);
+    lock_mutex(&pool->mutex);
+    pool->stats.in_use_bytes -= capacity;
+    if (cls != -1 && pool->free_count[cls] < class_limits[cls])
+    {
+        pool_free *entry = (pool_free *)buffer;
+        entry->next = pool->free[cls];
+        pool->free[cls] = entry;
+        pool->free_count[cls]++;
+        pool->stats.cached_bytes += capacity;
+        buffer = NULL;
+    }
+    unlock_mutex(&pool->mutex);
+
+    if (cls == -1)
+        munmap(buffer, capacity);
+    else
+        free(buffer);
+}
+
+/**
+ * @brief Copies the pool's counters
+ * @param pool Pool
+ * @param stats Output
+ */
+void pool_get_stats(buffer_pool *pool, pool_stats *stats)
+{
+    lock_mutex(&pool->mutex);
+    *stats = pool->stats;
+    unlock_mutex(&pool->mutex);
+}
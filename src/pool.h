@@ -0,0 +1,103 @@
+#ifndef SOCKRPC_POOL_H
+#define SOCKRPC_POOL_H
+
+#include <stddef.h>
+#include <pthread.h>
+
+/**
+ * @file pool.h
+ * @brief Internal size-classed buffer pool
+ *
+ * Buffers come in three pooled size classes (4 KiB, 64 KiB, 1 MiB).
+ * Larger requests are mapped with mmap and unmapped on release, so a
+ * rare huge message does not stay resident afterwards. Each class keeps
+ * a bounded free list; buffers released beyond the bound are freed.
+ *
+ * Each I/O worker owns one pool. The pool has its own mutex because
+ * worker group threads also borrow buffers from the pool of the
+ * connection's worker while sending responses.
+ */
+
+/**
+ * @brief Number of pooled size classes
+ */
+#define POOL_CLASSES 3
+
+/**
+ * @brief Size of the smallest class, enough for most messages
+ */
+#define POOL_MIN_SIZE 4096
+
+/**
+ * @brief Size of the largest pooled class; bigger buffers use mmap
+ */
+#define POOL_MAX_SIZE (1024 * 1024)
+
+/**
+ * @brief Free buffer linked into its class's free list
+ */
+typedef struct pool_free
+{
+    struct pool_free *next; /**< Next free buffer of the same class */
+} pool_free;
+
+/**
+ * @brief Buffer pool counters
+ */
+typedef struct
+{
+    unsigned long hits;          /**< Acquisitions served from a free list */
+    unsigned long misses;        /**< Acquisitions that allocated */
+    unsigned long huge;          /**< Acquisitions above POOL_MAX_SIZE */
+    size_t in_use_bytes;         /**< Capacity of buffers currently acquired */
+    size_t cached_bytes;         /**< Capacity of buffers on free lists */
+} pool_stats;
+
+/**
+ * @brief Pool of reusable buffers
+ */
+typedef struct
+{
+    pool_free *free[POOL_CLASSES];   /**< Free list per class */
+    size_t free_count[POOL_CLASSES]; /**< Length of each free list */
+    pool_stats stats;                /**< Counters */
+    pthread_mutex_t mutex;           /**< Protects free lists and counters */
+} buffer_pool;
+
+/**
+ * @brief Initializes an empty pool
+ * @param pool Pool
+ */
+void pool_init(buffer_pool *pool);
+
+/**
+ * @brief Frees every cached buffer
+ * @param pool Pool; buffers still acquired must not be released later
+ */
+void pool_cleanup(buffer_pool *pool);
+
+/**
+ * @brief Acquires a buffer of at least size bytes
+ * @param pool Pool
+ * @param size Required size
+ * @param capacity Set to the actual capacity (the size class)
+ * @return Buffer or NULL on allocation failure
+ */
+char *pool_acquire(buffer_pool *pool, size_t size, size_t *capacity);
+
+/**
+ * @brief Returns a buffer to its pool
+ * @param pool Pool it was acquired from
+ * @param buffer Buffer, may be NULL
+ * @param capacity Capacity reported by pool_acquire
+ */
+void pool_release(buffer_pool *pool, char *buffer, size_t capacity);
+
+/**
+ * @brief Copies the pool's counters
+ * @param pool Pool
+ * @param stats Output
+ */
+void pool_get_stats(buffer_pool *pool, pool_stats *stats);
+
+#endif /* SOCKRPC_POOL_H */
@@ -0,0 +1,512 @@
+#include <sys/socket.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pubsub.h"
+#include "frame.h"
+#include "lock.h"
+
+/**
+ * @file pubsub.c
+ * @brief Implementation of event frames, subscriber queues and topics
+ */
+
+/**
+ * @brief Serializes an event into a frame
+ * @param topic Topic name
+ * @param topic_id Topic identity
+ * @param event Event payload
+ * @return Event with one reference, or NULL
+ */
+pubsub_event *pubsub_event_create(const char *topic, uint64_t topic_id, const cJSON *event)
+{
+    cJSON *envelope = cJSON_CreateObject();
+    if (!envelope)
+        return NULL;
+
+    // "topic" goes first so clients recognize events by PUBSUB_EVENT_PREFIX
+    cJSON_AddStringToObject(envelope, "topic", topic);
+    cJSON_AddItemReferenceToObject(envelope, "event", (cJSON *)event);
+    char *payload = cJSON_PrintUnformatted(envelope);
+    cJSON_Delete(envelope);
+    if (!payload)
+        return NULL;
+
+    size_t len = strlen(payload);
+    pubsub_event *frame = malloc(sizeof(pubsub_event) + FRAME_HEADER_SIZE + len);
+    if (frame)
+    {
+        frame->refs = 1;
+        frame->topic_id = topic_id;
+        frame->len = FRAME_HEADER_SIZE + len;
+        frame_encode_header((unsigned char *)frame->data, len, 0);
+        memcpy(frame->data + FRAME_HEADER_SIZE, payload, len);
+    }
+    free(payload);
+    return frame;
+}
+
+/**
+ * @brief Drops a reference to an event
+ * @param event Event
+ */
+void pubsub_event_release(pubsub_event *event)
+{
+    if (event && __atomic_sub_fetch(&event->refs, 1, __ATOMIC_ACQ_REL) == 0)
+        free(event);
+}
+
+/**
+ * @brief Returns the ring slot of the i-th oldest event
+ * @param queue Queue
+ * @param i Position from the oldest event
+ * @return Slot index
+ */
+static size_t queue_slot(const pubsub_queue *queue, size_t i)
+{
+    return (queue->head + i) % queue->capacity;
+}
+
+/**
+ * @brief Removes the oldest event
+ * @param queue Non-empty queue
+ */
+static void queue_pop(pubsub_queue *queue)
+{
+    pubsub_event_release(queue->events[queue->head]);
+    queue->head = queue_slot(queue, 1);
+    queue->count--;
+    queue->offset = 0;
+}
+
+/**
+ * @brief Pushes an event, applying the overflow policy when full
+ * @param queue Queue
+ * @param event Event
+ * @param limit Most events queued
+ * @param policy Overflow policy
+ * @return Outcome
+ */
+pubsub_push_result pubsub_queue_push(pubsub_queue *queue, pubsub_event *event, size_t limit,
+                                     sockrpc_overflow_policy policy)
+{
+    if (!queue->events)
+    {
+        queue->events = malloc((limit ? limit : 1) * sizeof(pubsub_event *));
+        if (!queue->events)
+            return PUBSUB_DROPPED;
+        queue->capacity = limit ? limit : 1;
+    }
+
+    // The partially sent event must go out whole
+    size_t first = queue->offset ? 1 : 0;
+    __atomic_add_fetch(&event->refs, 1, __ATOMIC_RELAXED);
+
+    if (policy == SOCKRPC_OVERFLOW_COALESCE)
+    {
+        for (size_t i = first; i < queue->count; i++)
+        {
+            size_t slot = queue_slot(queue, i);
+            if (queue->events[slot]->topic_id == event->topic_id)
+            {
+                pubsub_event_release(queue->events[slot]);
+                queue->events[slot] = event;
+                return PUBSUB_COALESCED;
+            }
+        }
+    }
+
+    pubsub_push_result result = PUBSUB_QUEUED;
+    if (queue->count == queue->capacity)
+    {
+        if (policy == SOCKRPC_OVERFLOW_DROP_NEWEST || first == queue->count)
+        {
+            pubsub_event_release(event);
+            return PUBSUB_DROPPED;
+        }
+
+        // Drop the oldest event that has not started, keeping a partial one in front
+        size_t victim = queue_slot(queue, first);
+        pubsub_event_release(queue->events[victim]);
+        if (first)
+            queue->events[victim] = queue->events[queue->head];
+        queue->head = queue_slot(queue, 1);
+        queue->count--;
+        result = PUBSUB_EVICTED;
+    }
+
+    queue->events[queue_slot(queue, queue->count)] = event;
+    queue->count++;
+    return result;
+}
+
+/**
+ * @brief Sends queued events without blocking
+ * @param queue Queue
+ * @param fd Non-blocking socket
+ * @param sent Incremented per completed event
+ * @return 0 if empty, 1 if the socket is full, -1 on error
+ */
+int pubsub_queue_send(pubsub_queue *queue, int fd, unsigned long *sent)
+{
+    while (queue->count)
+    {
+        pubsub_event *event = queue->events[queue->head];
+        ssize_t n = send(fd, event->data + queue->offset, event->len - queue->offset,
+                         MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK ? 1 : -1;
+        }
+
+        queue->offset += (size_t)n;
+        if (queue->offset == event->len)
+        {
+            queue_pop(queue);
+            (*sent)++;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Completes a partially sent event
+ * @param queue Queue
+ * @param fd Socket
+ * @param sent Incremented if the event was completed
+ * @return 0 if no event is partially sent, 1 if the socket is full,
+ *         -1 on error
+ */
+int pubsub_queue_finish(pubsub_queue *queue, int fd, unsigned long *sent)
+{
+    while (queue->count && queue->offset)
+    {
+        pubsub_event *event = queue->events[queue->head];
+        ssize_t n = send(fd, event->data + queue->offset, event->len - queue->offset,
+                         MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK ? 1 : -1;
+        }
+
+        queue->offset += (size_t)n;
+        if (queue->offset == event->len)
+        {
+            queue_pop(queue);
+            (*sent)++;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Releases every queued event and the ring
+ * @param queue Queue
+ */
+void pubsub_queue_clear(pubsub_queue *queue)
+{
+    while (queue->count)
+    {
+        queue_pop(queue);
+    }
+    free(queue->events);
+    queue->events = NULL;
+    queue->capacity = 0;
+    queue->head = 0;
+}
+
+/**
+ * @brief Initializes an empty registry
+ * @param registry Registry
+ */
+void pubsub_init(pubsub_registry *registry)
+{
+    registry->topics = NULL;
+    registry->next_id = 1;
+    registry->queue_limit = SOCKRPC_SUBSCRIBER_QUEUE;
+    registry->stats = (pubsub_stats){0};
+    pthread_mutex_init(&registry->mutex, NULL);
+}
+
+/**
+ * @brief Frees a topic
+ * @param topic Topic
+ */
+static void topic_free(pubsub_topic *topic)
+{
+    free(topic->name);
+    free(topic->subscribers);
+    free(topic);
+}
+
+/**
+ * @brief Frees every topic
+ * @param registry Registry
+ */
+void pubsub_cleanup(pubsub_registry *registry)
+{
+    while (registry->topics)
+    {
+        pubsub_topic *next = registry->topics->next;
+        topic_free(registry->topics);
+        registry->topics = next;
+    }
+    pthread_mutex_destroy(&registry->mutex);
+}
+
+/**
+ * @brief Finds a topic, optionally creating it
+ * @param registry Registry (mutex held)
+ * @param name Topic name
+ * @param create Create the topic if it does not exist
+ * @return Topic, or NULL if not found or on allocation failure
+ */
+static pubsub_topic *find_topic(pubsub_registry *registry, const char *name, int create)
+{
+    for (pubsub_topic *topic = registry->topics; topic; topic = topic->next)
+    {
+        if (strcmp(topic->name, name) == 0)
+            return topic;
+    }
+    if (!create)
+        return NULL;
+
+    pubsub_topic *topic = calloc(1, sizeof(pubsub_topic));
+    if (!topic || !(topic->name = strdup(name)))
+    {
+        free(topic);
+        return NULL;
+    }
+    topic->id = registry->next_id++;
+    topic->policy = SOCKRPC_OVERFLOW_DROP_OLDEST;
+    topic->next = registry->topics;
+    registry->topics = topic;
+    return topic;
+}
+
+/**
+ * @brief Frees a topic nobody needs any more
+ * @param registry Registry (mutex held)
+ * @param topic Topic in the registry
+ *
+ * Topics without subscribers are kept only if a policy was set, so
+ * clients subscribing to arbitrary names cannot grow the list forever.
+ */
+static void drop_unused_topic(pubsub_registry *registry, pubsub_topic *topic)
+{
+    if (topic->count || topic->configured)
+        return;
+
+    pubsub_topic **link = &registry->topics;
+    while (*link != topic)
+        link = &(*link)->next;
+    *link = topic->next;
+    topic_free(topic);
+}
+
+/**
+ * @brief Sets a topic's overflow policy
+ * @param registry Registry
+ * @param name Topic name
+ * @param policy Overflow policy
+ * @return 0 on success, -1 on allocation failure
+ */
+int pubsub_set_policy(pubsub_registry *registry, const char *name,
+                      sockrpc_overflow_policy policy)
+{
+    lock_mutex(&registry->mutex);
+    pubsub_topic *topic = find_topic(registry, name, 1);
+    if (topic)
+    {
+        topic->policy = policy;
+        topic->configured = 1;
+    }
+    unlock_mutex(&registry->mutex);
+    return topic ? 0 : -1;
+}
+
+/**
+ * @brief Subscribes to a topic
+ * @param registry Registry
+ * @param name Topic name
+ * @param subscriber Subscriber
+ * @return 1 if subscribed, 0 if already subscribed, -1 on error
+ */
+int pubsub_subscribe(pubsub_registry *registry, const char *name, void *subscriber)
+{
+    lock_mutex(&registry->mutex);
+    pubsub_topic *topic = find_topic(registry, name, 1);
+    int rc = topic ? 1 : -1;
+    for (size_t i = 0; topic && i < topic->count; i++)
+    {
+        if (topic->subscribers[i] == subscriber)
+            rc = 0;
+    }
+
+    if (rc == 1 && topic->count == topic->capacity)
+    {
+        size_t capacity = topic->capacity ? topic->capacity * 2 : 8;
+        void **subscribers = realloc(topic->subscribers, capacity * sizeof(void *));
+        if (subscribers)
+        {
+            topic->subscribers = subscribers;
+            topic->capacity = capacity;
+        }
+        else
+        {
+            drop_unused_topic(registry, topic);
+            rc = -1;
+        }
+    }
+    if (rc == 1)
+        topic->subscribers[topic->count++] = subscriber;
+    unlock_mutex(&registry->mutex);
+    return rc;
+}
+
+/**
+ * @brief Removes a subscriber from one topic
+ * @param registry Registry (mutex held)
+ * @param topic Topic
+ * @param subscriber Subscriber
+ * @return 1 if removed, 0 if not subscribed
+ */
+static int topic_remove(pubsub_registry *registry, pubsub_topic *topic, void *subscriber)
+{
+    for (size_t i = 0; i < topic->count; i++)
+    {
+        if (topic->subscribers[i] == subscriber)
+        {
+            topic->subscribers[i] = topic->subscribers[--topic->count];
+            drop_unused_topic(registry, topic);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Unsubscribes from a topic
+ * @param registry Registry
+ * @param name Topic name
+ * @param subscriber Subscriber
+ * @return 1 if unsubscribed, 0 if it was not subscribed
+ */
+int pubsub_unsubscribe(pubsub_registry *registry, const char *name, void *subscriber)
+{
+    lock_mutex(&registry->mutex);
+    pubsub_topic *topic = find_topic(registry, name, 0);
+    int rc = topic ? topic_remove(registry, topic, subscriber) : 0;
+    unlock_mutex(&registry->mutex);
+    return rc;
+}
+
+/**
+ * @brief Removes a subscriber from every topic
+ * @param registry Registry
+ * @param subscriber Subscriber
+ */
+void pubsub_remove_subscriber(pubsub_registry *registry, void *subscriber)
+{
+    lock_mutex(&registry->mutex);
+    pubsub_topic *topic = registry->topics;
+    while (topic)
+    {
+        // topic_remove may free the topic
+        pubsub_topic *next = topic->next;
+        topic_remove(registry, topic, subscriber);
+        topic = next;
+    }
+    unlock_mutex(&registry->mutex);
+}
+
+/**
+ * @brief Publishes an event to every subscriber of a topic
+ * @param registry Registry
+ * @param name Topic name
+ * @param event Event payload
+ * @param deliver Called for each subscriber
+ * @param ctx Context for deliver
+ * @return Number of subscribers, or -1 on allocation failure
+ */
+int pubsub_publish(pubsub_registry *registry, const char *name, const cJSON *event,
+                   pubsub_deliver_fn deliver, void *ctx)
+{
+    lock_mutex(&registry->mutex);
+    registry->stats.published++;
+    pubsub_topic *topic = find_topic(registry, name, 0);
+    if (!topic || !topic->count)
+    {
+        unlock_mutex(&registry->mutex);
+        return 0;
+    }
+
+    pubsub_event *frame = pubsub_event_create(name, topic->id, event);
+    if (!frame)
+    {
+        unlock_mutex(&registry->mutex);
+        return -1;
+    }
+
+    for (size_t i = 0; i < topic->count; i++)
+    {
+        switch (deliver(topic->subscribers[i], frame, topic->policy, ctx))
+        {
+        case PUBSUB_QUEUED:
+            registry->stats.delivered++;
+            break;
+        case PUBSUB_COALESCED:
+            registry->stats.delivered++;
+            registry->stats.coalesced++;
+            break;
+        case PUBSUB_EVICTED:
+            registry->stats.delivered++;
+            registry->stats.dropped++;
+            break;
+        case PUBSUB_DROPPED:
+            registry->stats.dropped++;
+            break;
+        }
+    }
+    int count = (int)topic->count;
+    unlock_mutex(&registry->mutex);
+
+    pubsub_event_release(frame);
+    return count;
+}
+
+/**
+ * @brief Reports topics, subscriptions and counters as JSON
+ * @param registry Registry
+ * @return JSON object or NULL
+ */
+cJSON *pubsub_stats_json(pubsub_registry *registry)
+{
+    cJSON *stats = cJSON_CreateObject();
+    if (!stats)
+        return NULL;
+
+    size_t topics = 0, subscriptions = 0;
+    lock_mutex(&registry->mutex);
+    for (pubsub_topic *topic = registry->topics; topic; topic = topic->next)
+    {
+        topics++;
+        subscriptions += topic->count;
+    }
+    pubsub_stats counters = registry->stats;
+    unlock_mutex(&registry->mutex);
+
+    cJSON_AddNumberToObject(stats, "topics", topics);
+    cJSON_AddNumberToObject(stats, "subscriptions", subscriptions);
+    cJSON_AddNumberToObject(stats, "published", counters.published);
+    cJSON_AddNumberToObject(stats, "delivered", counters.delivered);
+    cJSON_AddNumberToObject(stats, "coalesced", counters.coalesced);
+    cJSON_AddNumberToObject(stats, "dropped", counters.dropped);
+    cJSON_AddNumberToObject(stats, "sent",
+                            __atomic_load_n(&registry->stats.sent, __ATOMIC_RELAXED));
+    return stats;
+}
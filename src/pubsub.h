@@ -0,0 +1,253 @@
+#ifndef SOCKRPC_PUBSUB_H
+#define SOCKRPC_PUBSUB_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "sockrpc/sockrpc.h"
+
+/**
+ * @file pubsub.h
+ * @brief Internal publish/subscribe support shared by client and server
+ *
+ * A published event is serialized once into a refcounted frame
+ * (header and payload in one buffer). Every subscribed connection gets
+ * a reference in its own bounded queue, so fan-out costs one pointer
+ * per subscriber rather than one copy. Queues are drained with
+ * non-blocking sends; a frame may be partially sent, and the queue
+ * remembers how much of its oldest frame went out.
+ *
+ * Event payload: {"topic": "name", "event": any}. Responses always
+ * begin with {"id" or {"result"/{"error", so clients tell events apart
+ * by the PUBSUB_EVENT_PREFIX without parsing.
+ */
+
+/**
+ * @brief Method subscribing the calling connection, params {"topic": name}
+ */
+#define PUBSUB_SUBSCRIBE_METHOD "sockrpc.subscribe"
+
+/**
+ * @brief Method unsubscribing the calling connection, params {"topic": name}
+ */
+#define PUBSUB_UNSUBSCRIBE_METHOD "sockrpc.unsubscribe"
+
+/**
+ * @brief Start of every event payload
+ */
+#define PUBSUB_EVENT_PREFIX "{\"topic\":"
+
+/**
+ * @brief Serialized event shared by every queue it was pushed to
+ */
+typedef struct
+{
+    unsigned int refs; /**< Queue references plus the publisher's (atomic) */
+    uint64_t topic_id; /**< Identity of the topic, for coalescing */
+    size_t len;        /**< Frame length, header included */
+    char data[];       /**< Complete frame */
+} pubsub_event;
+
+/**
+ * @brief Outcome of pushing an event to a queue
+ */
+typedef enum
+{
+    PUBSUB_QUEUED,    /**< Appended */
+    PUBSUB_COALESCED, /**< Replaced a queued event of the same topic */
+    PUBSUB_EVICTED,   /**< Appended after dropping the oldest queued event */
+    PUBSUB_DROPPED    /**< Not queued, the queue is full */
+} pubsub_push_result;
+
+/**
+ * @brief Bounded FIFO of events waiting to be sent on one connection
+ */
+typedef struct
+{
+    pubsub_event **events; /**< Ring buffer, allocated on first push */
+    size_t capacity;       /**< Ring size, the queue limit */
+    size_t head;           /**< Index of the oldest event */
+    size_t count;          /**< Queued events */
+    size_t offset;         /**< Bytes of the oldest event already sent */
+} pubsub_queue;
+
+/**
+ * @brief Topic and the connections subscribed to it
+ */
+typedef struct pubsub_topic
+{
+    char *name;                     /**< Topic name */
+    uint64_t id;                    /**< Unique among topics ever created */
+    sockrpc_overflow_policy policy; /**< What to do when a queue is full */
+    int configured;                 /**< Policy was set, keep while unsubscribed */
+    void **subscribers;             /**< Subscribed connections */
+    size_t count;                   /**< Number of subscribers */
+    size_t capacity;                /**< Room in subscribers */
+    struct pubsub_topic *next;      /**< Next topic */
+} pubsub_topic;
+
+/**
+ * @brief Publish/subscribe counters
+ */
+typedef struct
+{
+    unsigned long published;  /**< sockrpc_server_publish calls */
+    unsigned long delivered;  /**< Events queued to a subscriber */
+    unsigned long coalesced;  /**< Queued events replaced by newer ones */
+    unsigned long dropped;    /**< Events discarded from full queues */
+    unsigned long sent;       /**< Events completely written (atomic) */
+} pubsub_stats;
+
+/**
+ * @brief Topics of a server
+ *
+ * Subscribers are opaque pointers. A subscriber is removed from every
+ * topic before it goes away, under the registry mutex, so publishing
+ * never sees a dangling one.
+ */
+typedef struct
+{
+    pubsub_topic *topics;  /**< Topic list */
+    uint64_t next_id;      /**< Id of the next topic created */
+    size_t queue_limit;    /**< Queue limit of new subscribers */
+    pubsub_stats stats;    /**< Counters (under mutex unless noted) */
+    pthread_mutex_t mutex; /**< Protects topics and counters */
+} pubsub_registry;
+
+/**
+ * @brief Called for each subscriber of a published event (mutex held)
+ * @param subscriber Subscriber
+ * @param event Event to queue; take a reference to keep it
+ * @param policy Overflow policy of the topic
+ * @param ctx Context passed to pubsub_publish
+ * @return Outcome of the push
+ */
+typedef pubsub_push_result (*pubsub_deliver_fn)(void *subscriber, pubsub_event *event,
+                                                sockrpc_overflow_policy policy, void *ctx);
+
+/**
+ * @brief Serializes an event into a frame
+ * @param topic Topic name
+ * @param topic_id Topic identity
+ * @param event Event payload
+ * @return Event with one reference, or NULL on allocation failure
+ */
+pubsub_event *pubsub_event_create(const char *topic, uint64_t topic_id, const cJSON *event);
+
+/**
+ * @brief Drops a reference to an event
+ * @param event Event, freed with the last reference
+ */
+void pubsub_event_release(pubsub_event *event);
+
+/**
+ * @brief Pushes an event, applying the overflow policy when full
+ * @param queue Queue
+ * @param event Event; the queue takes its own reference if queued
+ * @param limit Most events queued
+ * @param policy Overflow policy
+ * @return Outcome, PUBSUB_DROPPED also on allocation failure
+ *
+ * A partially sent event is never dropped or replaced.
+ */
+pubsub_push_result pubsub_queue_push(pubsub_queue *queue, pubsub_event *event, size_t limit,
+                                     sockrpc_overflow_policy policy);
+
+/**
+ * @brief Sends queued events without blocking
+ * @param queue Queue
+ * @param fd Non-blocking socket
+ * @param sent Incremented by the number of events completely sent
+ * @return 0 if the queue is empty, 1 if the socket is full, -1 on error
+ */
+int pubsub_queue_send(pubsub_queue *queue, int fd, unsigned long *sent);
+
+/**
+ * @brief Completes a partially sent event
+ * @param queue Queue
+ * @param fd Socket
+ * @param sent Incremented if the event was completed
+ * @return 0 if no event is partially sent, 1 if the socket is full,
+ *         -1 on error
+ *
+ * Never waits; another frame may only follow on a byte stream once this
+ * returned 0.
+ */
+int pubsub_queue_finish(pubsub_queue *queue, int fd, unsigned long *sent);
+
+/**
+ * @brief Releases every queued event and the ring
+ * @param queue Queue
+ */
+void pubsub_queue_clear(pubsub_queue *queue);
+
+/**
+ * @brief Initializes an empty registry
+ * @param registry Registry
+ */
+void pubsub_init(pubsub_registry *registry);
+
+/**
+ * @brief Frees every topic
+ * @param registry Registry
+ */
+void pubsub_cleanup(pubsub_registry *registry);
+
+/**
+ * @brief Sets a topic's overflow policy, creating the topic if needed
+ * @param registry Registry
+ * @param name Topic name
+ * @param policy Overflow policy
+ * @return 0 on success, -1 on allocation failure
+ */
+int pubsub_set_policy(pubsub_registry *registry, const char *name,
+                      sockrpc_overflow_policy policy);
+
+/**
+ * @brief Subscribes to a topic
+ * @param registry Registry
+ * @param name Topic name
+ * @param subscriber Subscriber
+ * @return 1 if subscribed, 0 if already subscribed, -1 on allocation failure
+ */
+int pubsub_subscribe(pubsub_registry *registry, const char *name, void *subscriber);
+
+/**
+ * @brief Unsubscribes from a topic
+ * @param registry Registry
+ * @param name Topic name
+ * @param subscriber Subscriber
+ * @return 1 if unsubscribed, 0 if it was not subscribed
+ */
+int pubsub_unsubscribe(pubsub_registry *registry, const char *name, void *subscriber);
+
+/**
+ * @brief Removes a subscriber from every topic
+ * @param registry Registry
+ * @param subscriber Subscriber
+ */
+void pubsub_remove_subscriber(pubsub_registry *registry, void *subscriber);
+
+/**
+ * @brief Publishes an event to every subscriber of a topic
+ * @param registry Registry
+ * @param name Topic name
+ * @param event Event payload
+ * @param deliver Called for each subscriber
+ * @param ctx Context for deliver
+ * @return Number of subscribers, or -1 on allocation failure
+ *
+ * The event is serialized once, and only if the topic has subscribers.
+ */
+int pubsub_publish(pubsub_registry *registry, const char *name, const cJSON *event,
+                   pubsub_deliver_fn deliver, void *ctx);
+
+/**
+ * @brief Reports topics, subscriptions and counters as JSON
+ * @param registry Registry
+ * @return {"topics", "subscriptions", "published", "delivered",
+ *         "coalesced", "dropped", "sent"} or NULL
+ */
+cJSON *pubsub_stats_json(pubsub_registry *registry);
+
+#endif /* SOCKRPC_PUBSUB_H */
@@ -0,0 +1,263 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "recorder.h"
+
+/**
+ * @file recorder.c
+ * @brief Implementation of the flight recorder
+ *
+ * Each entry is written seqlock-style by its ring's only writer: seq
+ * is cleared, the fields are written, then seq is set to the entry's
+ * position. A reader copies an entry and keeps the copy only if seq
+ * was the same non-zero value before and after.
+ */
+
+_Static_assert(sizeof(recorder_entry) == 64, "recorder_entry is one cache line");
+_Static_assert(sizeof(recorder_header) == 40, "recorder_header layout");
+_Static_assert((RECORDER_ENTRIES & (RECORDER_ENTRIES - 1)) == 0, "ring size is a power of two");
+
+struct recorder_ring
+{
+    recorder_entry entries[RECORDER_ENTRIES]; /**< Last requests, by seq modulo size */
+    uint64_t head;                            /**< Entries ever written (atomic) */
+    uint8_t thread;                           /**< Thread id of the writer */
+    struct recorder_ring *next;               /**< Next ring of the recorder */
+};
+
+/**
+ * @brief Initializes a recorder without rings
+ * @param rec Recorder
+ */
+void recorder_init(recorder *rec)
+{
+    rec->rings = NULL;
+    rec->shared = NULL;
+    rec->count = 0;
+    pthread_mutex_init(&rec->mutex, NULL);
+}
+
+/**
+ * @brief Frees every ring
+ * @param rec Recorder
+ */
+void recorder_cleanup(recorder *rec)
+{
+    while (rec->rings)
+    {
+        recorder_ring *next = rec->rings->next;
+        free(rec->rings);
+        rec->rings = next;
+    }
+    rec->shared = NULL;
+    pthread_mutex_destroy(&rec->mutex);
+}
+
+/**
+ * @brief Allocates a ring (mutex held)
+ * @param rec Recorder
+ * @param thread Thread id stored in the ring's entries
+ * @return Ring added to rec, or NULL
+ */
+static recorder_ring *add_ring(recorder *rec, uint8_t thread)
+{
+    // Zeroed pages are only touched once requests are recorded
+    recorder_ring *ring = calloc(1, sizeof(recorder_ring));
+    if (!ring)
+        return NULL;
+
+    ring->thread = thread;
+    ring->next = rec->rings;
+    rec->rings = ring;
+    rec->count++;
+    return ring;
+}
+
+/**
+ * @brief Creates a ring for one writer thread
+ * @param rec Recorder
+ * @param thread Thread id stored in the ring's entries
+ * @return Ring or NULL
+ */
+recorder_ring *recorder_attach(recorder *rec, uint8_t thread)
+{
+    pthread_mutex_lock(&rec->mutex);
+    recorder_ring *ring = add_ring(rec, thread);
+    pthread_mutex_unlock(&rec->mutex);
+    return ring;
+}
+
+/**
+ * @brief Converts an interval to saturated 32-bit nanoseconds
+ * @param from Start, 0 if the phase did not run
+ * @param to End
+ * @return Duration
+ */
+static uint32_t duration(unsigned long from, unsigned long to)
+{
+    if (!from || to <= from)
+        return 0;
+    return to - from > UINT32_MAX ? UINT32_MAX : (uint32_t)(to - from);
+}
+
+/**
+ * @brief Records a completed request in a writer's ring
+ * @param ring Ring of the calling thread or NULL
+ * @param sample Request
+ */
+void recorder_record(recorder_ring *ring, const recorder_sample *sample)
+{
+    if (!ring)
+        return;
+
+    uint64_t seq = ring->head;
+    recorder_entry *entry = &ring->entries[seq & (RECORDER_ENTRIES - 1)];
+    __atomic_store_n(&entry->seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    entry->start_ns = sample->start_ns;
+    entry->queue_ns = duration(sample->start_ns, sample->handler_ns);
+    entry->handler_ns = duration(sample->handler_ns, sample->handler_end_ns);
+    entry->send_ns = duration(sample->handler_end_ns, sample->end_ns);
+    entry->request_bytes = sample->request_bytes > UINT32_MAX ? UINT32_MAX
+                                                              : (uint32_t)sample->request_bytes;
+    entry->response_bytes = sample->response_bytes > UINT32_MAX
+                                ? UINT32_MAX
+                                : (uint32_t)sample->response_bytes;
+    entry->connection = sample->connection;
+    entry->status = (uint16_t)sample->status;
+    entry->thread = ring->thread;
+    entry->worker = sample->worker;
+    strncpy(entry->method, sample->method ? sample->method : "", RECORDER_METHOD_LEN);
+
+    __atomic_store_n(&entry->seq, seq + 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&ring->head, seq + 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Records a request completed by a thread without a ring
+ * @param rec Recorder
+ * @param sample Request
+ */
+void recorder_record_shared(recorder *rec, const recorder_sample *sample)
+{
+    pthread_mutex_lock(&rec->mutex);
+    if (!rec->shared)
+        rec->shared = add_ring(rec, RECORDER_OTHER_THREAD);
+    recorder_record(rec->shared, sample);
+    pthread_mutex_unlock(&rec->mutex);
+}
+
+/**
+ * @brief Orders entries by start time
+ * @param a First entry
+ * @param b Second entry
+ * @return Negative, zero or positive
+ */
+static int compare_start(const void *a, const void *b)
+{
+    uint64_t x = ((const recorder_entry *)a)->start_ns;
+    uint64_t y = ((const recorder_entry *)b)->start_ns;
+    return x < y ? -1 : x > y;
+}
+
+/**
+ * @brief Returns a clock reading in nanoseconds
+ * @param clock CLOCK_MONOTONIC or CLOCK_REALTIME
+ * @return Nanoseconds
+ */
+static uint64_t clock_ns(clockid_t clock)
+{
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief Writes every ring to a dump file
+ * @param rec Recorder
+ * @param path Output file
+ * @return Number of entries written, or -1 on error
+ *
+ * Writes to a temporary file renamed over path, so readers never see
+ * a partial dump.
+ */
+int recorder_dump(recorder *rec, const char *path)
+{
+    pthread_mutex_lock(&rec->mutex);
+    recorder_entry *entries = malloc((size_t)(rec->count ? rec->count : 1) * RECORDER_ENTRIES *
+                                     sizeof(recorder_entry));
+    if (!entries)
+    {
+        pthread_mutex_unlock(&rec->mutex);
+        return -1;
+    }
+
+    recorder_header header = {.magic = RECORDER_MAGIC, .version = RECORDER_VERSION,
+                              .entry_size = sizeof(recorder_entry), .threads = rec->count};
+    for (recorder_ring *ring = rec->rings; ring; ring = ring->next)
+    {
+        for (size_t i = 0; i < RECORDER_ENTRIES; i++)
+        {
+            recorder_entry *entry = &ring->entries[i];
+            uint64_t seq = __atomic_load_n(&entry->seq, __ATOMIC_ACQUIRE);
+            if (!seq)
+                continue;
+            entries[header.count] = *entry;
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            if (__atomic_load_n(&entry->seq, __ATOMIC_RELAXED) == seq)
+                header.count++;
+        }
+    }
+    pthread_mutex_unlock(&rec->mutex);
+
+    qsort(entries, header.count, sizeof(recorder_entry), compare_start);
+    header.dump_ns = clock_ns(CLOCK_MONOTONIC);
+    header.dump_unix_ns = clock_ns(CLOCK_REALTIME);
+
+    char temp[4096];
+    FILE *fp = NULL;
+    if ((size_t)snprintf(temp, sizeof(temp), "%s.tmp", path) < sizeof(temp))
+        fp = fopen(temp, "wb");
+    if (!fp)
+    {
+        free(entries);
+        return -1;
+    }
+
+    int ok = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+             fwrite(entries, sizeof(recorder_entry), header.count, fp) == header.count;
+    ok = fclose(fp) == 0 && ok;
+    free(entries);
+    if (!ok || rename(temp, path) == -1)
+    {
+        remove(temp);
+        return -1;
+    }
+    return (int)header.count;
+}
+
+/**
+ * @brief Reports ring count, capacity and requests recorded
+ * @param rec Recorder
+ * @return Counters as JSON or NULL
+ */
+cJSON *recorder_stats_json(recorder *rec)
+{
+    cJSON *stats = cJSON_CreateObject();
+    if (!stats)
+        return NULL;
+
+    unsigned long recorded = 0;
+    pthread_mutex_lock(&rec->mutex);
+    for (recorder_ring *ring = rec->rings; ring; ring = ring->next)
+    {
+        recorded += __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+    }
+    cJSON_AddNumberToObject(stats, "threads", rec->count);
+    cJSON_AddNumberToObject(stats, "capacity", (double)rec->count * RECORDER_ENTRIES);
+    cJSON_AddNumberToObject(stats, "recorded", recorded);
+    pthread_mutex_unlock(&rec->mutex);
+    return stats;
+}
@@ -0,0 +1,192 @@
+#ifndef SOCKRPC_RECORDER_H
+#define SOCKRPC_RECORDER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <cjson/cJSON.h>
+
+/**
+ * @file recorder.h
+ * @brief Internal flight recorder of recent requests
+ *
+ * Every server thread that completes requests (I/O workers and worker
+ * group threads) owns a ring of the last RECORDER_ENTRIES requests it
+ * finished. Recording is a few stores into the thread's own ring: no
+ * lock, no allocation and no shared cache line, so it stays on in
+ * production. A dump copies every ring, skipping entries that were
+ * being overwritten at that moment.
+ *
+ * Rings are handed to their writer by recorder_attach and passed back
+ * explicitly, so a thread driving several servers writes each server's
+ * requests to that server's ring. Requests completed by threads the
+ * server does not own go to one shared ring under the recorder's mutex.
+ *
+ * Dump file layout (host byte order, little-endian on supported
+ * platforms): a recorder_header followed by header.count entries of
+ * header.entry_size bytes, sorted by start time. tools/sockrpc_frdump
+ * decodes it.
+ */
+
+/**
+ * @brief First bytes of a dump file
+ */
+#define RECORDER_MAGIC "SRPCFR1"
+
+/**
+ * @brief Version of the dump file layout
+ */
+#define RECORDER_VERSION 1
+
+/**
+ * @brief Requests remembered per thread, a power of two
+ */
+#define RECORDER_ENTRIES 4096
+
+/**
+ * @brief Bytes of the method name kept, not NUL-terminated when full
+ */
+#define RECORDER_METHOD_LEN 20
+
+/**
+ * @brief Thread id of the threads of worker group i is RECORDER_GROUP_THREAD + i
+ */
+#define RECORDER_GROUP_THREAD 128
+
+/**
+ * @brief Thread id of the shared ring of threads the server does not own
+ */
+#define RECORDER_OTHER_THREAD 255
+
+/**
+ * @brief How a recorded request ended
+ */
+typedef enum
+{
+    RECORD_OK = 0,        /**< Result sent */
+    RECORD_FAILED = 1,    /**< Handler returned NULL */
+    RECORD_BUSY = 2,      /**< Worker group queue full */
+    RECORD_NOT_FOUND = 3  /**< Unknown method */
+} record_status;
+
+/**
+ * @brief One request in a ring and in a dump file (64 bytes)
+ *
+ * Durations saturate at UINT32_MAX nanoseconds (4.29 s).
+ */
+typedef struct
+{
+    uint64_t seq;                     /**< 1 + position in the ring's history, 0 while written */
+    uint64_t start_ns;                /**< Monotonic time the request was dispatched */
+    uint32_t queue_ns;                /**< Dispatch to handler start (parse, group queue) */
+    uint32_t handler_ns;              /**< Handler run time */
+    uint32_t send_ns;                 /**< Writing the response */
+    uint32_t request_bytes;           /**< Request frame payload */
+    uint32_t response_bytes;          /**< Response payload before compression */
+    uint32_t connection;              /**< Connection slot of the server's worker */
+    uint16_t status;                  /**< record_status */
+    uint8_t thread;                   /**< Worker id, or RECORDER_GROUP_THREAD + group */
+    uint8_t worker;                   /**< Worker owning the connection */
+    char method[RECORDER_METHOD_LEN]; /**< Method name, truncated */
+} recorder_entry;
+
+/**
+ * @brief Dump file header (40 bytes)
+ */
+typedef struct
+{
+    char magic[8];         /**< RECORDER_MAGIC */
+    uint32_t version;      /**< RECORDER_VERSION */
+    uint32_t entry_size;   /**< sizeof(recorder_entry) */
+    uint64_t dump_unix_ns; /**< Wall clock at the dump */
+    uint64_t dump_ns;      /**< Monotonic clock at the dump, relates start_ns to dump_unix_ns */
+    uint32_t count;        /**< Entries that follow */
+    uint32_t threads;      /**< Rings the entries came from */
+} recorder_header;
+
+/**
+ * @brief Completed request as seen by the server
+ */
+typedef struct
+{
+    const char *method;           /**< Method name */
+    int status;                   /**< record_status */
+    uint32_t connection;          /**< Connection slot */
+    uint8_t worker;               /**< Worker owning the connection */
+    unsigned long start_ns;       /**< Dispatched */
+    unsigned long handler_ns;     /**< Handler started */
+    unsigned long handler_end_ns; /**< Handler returned */
+    unsigned long end_ns;         /**< Response sent */
+    size_t request_bytes;         /**< Request payload */
+    size_t response_bytes;        /**< Response payload */
+} recorder_sample;
+
+/**
+ * @brief Ring of one thread
+ */
+typedef struct recorder_ring recorder_ring;
+
+/**
+ * @brief Rings of a server
+ */
+typedef struct
+{
+    recorder_ring *rings;  /**< Every ring, kept until cleanup */
+    recorder_ring *shared; /**< Ring of other threads, NULL until used (under mutex) */
+    unsigned int count;    /**< Number of rings */
+    pthread_mutex_t mutex; /**< Protects the list and the shared ring */
+} recorder;
+
+/**
+ * @brief Initializes a recorder without rings
+ * @param rec Recorder
+ */
+void recorder_init(recorder *rec);
+
+/**
+ * @brief Frees every ring
+ * @param rec Recorder whose writers have exited or stopped recording
+ */
+void recorder_cleanup(recorder *rec);
+
+/**
+ * @brief Creates a ring for one writer thread
+ * @param rec Recorder
+ * @param thread Thread id stored in the ring's entries
+ * @return Ring owned by rec, or NULL on allocation failure, in which
+ *         case the thread simply records nothing
+ */
+recorder_ring *recorder_attach(recorder *rec, uint8_t thread);
+
+/**
+ * @brief Records a completed request in a writer's ring
+ * @param ring Ring of the calling thread, NULL to record nothing
+ * @param sample Request
+ */
+void recorder_record(recorder_ring *ring, const recorder_sample *sample);
+
+/**
+ * @brief Records a request completed by a thread without a ring
+ * @param rec Recorder
+ * @param sample Request
+ *
+ * Writes to the shared ring, created on first use, under the mutex.
+ */
+void recorder_record_shared(recorder *rec, const recorder_sample *sample);
+
+/**
+ * @brief Writes every ring to a dump file
+ * @param rec Recorder
+ * @param path Output file, replaced atomically
+ * @return Number of entries written, or -1 on error
+ */
+int recorder_dump(recorder *rec, const char *path);
+
+/**
+ * @brief Reports ring count, capacity and requests recorded
+ * @param rec Recorder
+ * @return {"threads", "capacity", "recorded"} or NULL
+ */
+cJSON *recorder_stats_json(recorder *rec);
+
+#endif /* SOCKRPC_RECORDER_H */
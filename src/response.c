@@ -0,0 +1,187 @@
+#include <stdlib.h>
+#include <string.h>
+#include "response.h"
+
+/**
+ * @file response.c
+ * @brief Implementation of fragment-based responses
+ */
+
+/**
+ * @brief Fragments a new response has room for before growing
+ */
+#define RESPONSE_INITIAL_FRAGMENTS 8
+
+/**
+ * @brief Release callback of one fragment
+ */
+typedef struct
+{
+    sockrpc_release_fn release; /**< Callback or NULL */
+    void *ctx;                  /**< Context for release */
+} fragment_release;
+
+/**
+ * @brief Response under construction
+ *
+ * iov and releases are parallel arrays of capacity entries; fragment i
+ * lives in iov[RESPONSE_HEAD_SLOTS + i] and releases[i].
+ */
+struct sockrpc_response
+{
+    struct iovec *iov;           /**< Reserved slots and fragments */
+    fragment_release *releases;  /**< Release callback per fragment */
+    size_t count;                /**< Number of fragments */
+    size_t capacity;             /**< Fragments the arrays have room for */
+    int failed;                  /**< An append failed */
+};
+
+/**
+ * @brief Creates an empty response
+ * @return Response or NULL on allocation failure
+ */
+sockrpc_response *sockrpc_response_create(void)
+{
+    sockrpc_response *response = calloc(1, sizeof(sockrpc_response));
+    if (!response)
+        return NULL;
+
+    response->capacity = RESPONSE_INITIAL_FRAGMENTS;
+    response->iov = malloc((RESPONSE_HEAD_SLOTS + response->capacity + RESPONSE_TAIL_SLOTS) *
+                           sizeof(struct iovec));
+    response->releases = malloc(response->capacity * sizeof(fragment_release));
+    if (!response->iov || !response->releases)
+    {
+        free(response->iov);
+        free(response->releases);
+        free(response);
+        return NULL;
+    }
+    return response;
+}
+
+/**
+ * @brief Makes room for one more fragment
+ * @param response Response
+ * @return 0 on success, -1 on allocation failure
+ */
+static int reserve_fragment(sockrpc_response *response)
+{
+    if (response->count < response->capacity)
+        return 0;
+
+    size_t capacity = response->capacity * 2;
+    struct iovec *iov = realloc(response->iov, (RESPONSE_HEAD_SLOTS + capacity +
+                                                RESPONSE_TAIL_SLOTS) * sizeof(struct iovec));
+    if (!iov)
+        return -1;
+    response->iov = iov;
+
+    fragment_release *releases = realloc(response->releases, capacity * sizeof(fragment_release));
+    if (!releases)
+        return -1;
+    response->releases = releases;
+
+    response->capacity = capacity;
+    return 0;
+}
+
+/**
+ * @brief Appends a borrowed fragment released after sending
+ * @param response Response
+ * @param data JSON text, not copied
+ * @param len Length of data
+ * @param release Release callback or NULL
+ * @param ctx Context for release
+ * @return 0 on success, -1 on error (release has been called)
+ */
+int sockrpc_response_add_borrowed(sockrpc_response *response, const char *data, size_t len,
+                                  sockrpc_release_fn release, void *ctx)
+{
+    if (!response || !data || reserve_fragment(response) == -1)
+    {
+        if (response)
+            response->failed = 1;
+        if (release)
+            release(ctx);
+        return -1;
+    }
+
+    response->iov[RESPONSE_HEAD_SLOTS + response->count].iov_base = (void *)data;
+    response->iov[RESPONSE_HEAD_SLOTS + response->count].iov_len = len;
+    response->releases[response->count].release = release;
+    response->releases[response->count].ctx = ctx;
+    response->count++;
+    return 0;
+}
+
+/**
+ * @brief Appends a fragment that outlives the response
+ * @param response Response
+ * @param data JSON text, not copied
+ * @param len Length of data
+ * @return 0 on success, -1 on error
+ */
+int sockrpc_response_add_static(sockrpc_response *response, const char *data, size_t len)
+{
+    return sockrpc_response_add_borrowed(response, data, len, NULL, NULL);
+}
+
+/**
+ * @brief Appends the JSON text of a cJSON item
+ * @param response Response
+ * @param item Item to print
+ * @return 0 on success, -1 on error
+ */
+int sockrpc_response_add_json(sockrpc_response *response, const cJSON *item)
+{
+    char *text = item ? cJSON_PrintUnformatted(item) : NULL;
+    if (!text)
+    {
+        if (response)
+            response->failed = 1;
+        return -1;
+    }
+    return sockrpc_response_add_borrowed(response, text, strlen(text), free, text);
+}
+
+/**
+ * @brief Destroys a response, releasing its borrowed fragments
+ * @param response Response, may be NULL
+ */
+void sockrpc_response_destroy(sockrpc_response *response)
+{
+    if (!response)
+        return;
+
+    for (size_t i = 0; i < response->count; i++)
+    {
+        if (response->releases[i].release)
+            response->releases[i].release(response->releases[i].ctx);
+    }
+    free(response->iov);
+    free(response->releases);
+    free(response);
+}
+
+/**
+ * @brief Checks that every fragment was appended successfully
+ * @param response Response
+ * @return 1 if the response can be sent, 0 otherwise
+ */
+int response_valid(const sockrpc_response *response)
+{
+    return !response->failed;
+}
+
+/**
+ * @brief Returns the iovec array of a response
+ * @param response Response
+ * @param iovcnt Set to the number of entries including reserved slots
+ * @return Array owned by the response
+ */
+struct iovec *response_iov(sockrpc_response *response, int *iovcnt)
+{
+    *iovcnt = (int)(RESPONSE_HEAD_SLOTS + response->count + RESPONSE_TAIL_SLOTS);
+    return response->iov;
+}
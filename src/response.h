@@ -0,0 +1,44 @@
+#ifndef SOCKRPC_RESPONSE_H
+#define SOCKRPC_RESPONSE_H
+
+#include <sys/uio.h>
+#include "sockrpc/sockrpc.h"
+
+/**
+ * @file response.h
+ * @brief Internal access to the fragments of a sockrpc_response
+ *
+ * A response keeps its fragments in an iovec array with free slots
+ * before and after them, so the server can add the frame header and
+ * the {"id":...,"result": envelope around them and hand the whole array
+ * to sendmsg without building a second array.
+ */
+
+/**
+ * @brief Slots reserved before the fragments: frame header and envelope
+ */
+#define RESPONSE_HEAD_SLOTS 4
+
+/**
+ * @brief Slots reserved after the fragments: closing brace
+ */
+#define RESPONSE_TAIL_SLOTS 1
+
+/**
+ * @brief Checks that every fragment was appended successfully
+ * @param response Response
+ * @return 1 if the response can be sent, 0 otherwise
+ */
+int response_valid(const sockrpc_response *response);
+
+/**
+ * @brief Returns the iovec array of a response
+ * @param response Response
+ * @param iovcnt Set to the number of entries: RESPONSE_HEAD_SLOTS, the
+ *        fragments, then RESPONSE_TAIL_SLOTS
+ * @return Array owned by the response; the caller fills the reserved
+ *         slots and may modify the array while sending
+ */
+struct iovec *response_iov(sockrpc_response *response, int *iovcnt);
+
+#endif /* SOCKRPC_RESPONSE_H */
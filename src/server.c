@@ -1,6 +1,9 @@
+#define _GNU_SOURCE
 #include <sys/socket.h>
 #include <sys/un.h>
 #include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <poll.h>
 #include <pthread.h>
 #include <unistd.h>
 #include <stdlib.h>
@@ -9,15 +12,32 @@
 #include <errno.h>
 #include <stdio.h>
 #include <fcntl.h>
+#include <sched.h>
+#include <time.h>
 #include "sockrpc/sockrpc.h"
+#include "transport.h"
+#include "frame.h"
+#include "module.h"
+#include "compress.h"
+#include "response.h"
+#include "pool.h"
+#include "slab.h"
+#include "spin.h"
+#include "pubsub.h"
+#include "stream.h"
+#include "trace.h"
+#include "recorder.h"
+#include "capture.h"
+#include "lock.h"
 
 /**
  * @file server.c
  * @brief Implementation of the SockRPC server component
  *
- * This file implements a multi-threaded RPC server using Unix domain sockets
- * and epoll for efficient I/O multiplexing. The server uses a worker pool
- * architecture with round-robin load balancing.
+ * This file implements a multi-threaded RPC server using Unix domain or
+ * TCP sockets and epoll for efficient I/O multiplexing. The server uses a
+ * worker pool architecture with round-robin load balancing for Unix
+ * sockets and SO_REUSEPORT listener sharding for TCP.
  *
  * Key features:
  * - Thread pool with configurable number of workers
@@ -25,6 +45,40 @@
  * - Round-robin load balancing
  * - Thread-safe method registration
  * - Graceful shutdown handling
+ * - Stream or seqpacket sockets, filesystem or abstract-namespace names
+ * - TCP transport with TCP_NODELAY and keepalive tuning
+ * - Length-prefixed framing (see frame.h)
+ * - Named worker groups that run selected methods off the I/O threads
+ * - Handler modules loaded from shared objects and reloaded in place
+ * - Per-connection negotiated compression with per-method metrics
+ * - Responses gathered from handler-provided fragments with sendmsg
+ * - Per-worker size-classed buffer pools; idle connections hold none
+ * - Connection objects from per-worker slabs, generation-checked events
+ * - Optional adaptive busy-polling of the workers' epoll sets
+ * - No timeouts while idle: shutdown is signaled through an eventfd
+ * - Topic subscriptions with events fanned out from one shared frame
+ * - Client-streaming uploads with credit-based flow control (see stream.h)
+ * - Trace context continued into handlers, sampled spans exported (see trace.h)
+ * - Always-on flight recorder of recent requests, dumped on demand
+ * - Optional capture of incoming requests for replay (see capture.h)
+ * - Embedded mode driven by the application's event loop, without
+ *   threads; request-path locks compiled out with SOCKRPC_EMBEDDED_ONLY
+ * - Deferred calls completed after the handler returns, with downstream
+ *   non-blocking clients driven by the worker serving the call
+ * - Responses to pipelined requests corked into one write per batch
+ *
+ * Message format (JSON payload of each frame):
+ * - Request: {"id": any, "method": "name", "params": any}, id optional
+ * - Response: {"id": any, "result": any} or {"id": any, "error": "text"}
+ * - Upload: a request with "stream": true, then {"id": any, "chunk": any}
+ *   frames and {"id": any, "end": true}, acknowledged with
+ *   {"id": any, "ack": count} and answered by one response
+ * - Any request may carry "trace": "<W3C traceparent>"
+ *
+ * Exactly one response is sent per request, echoing the request id if
+ * present. Responses on a connection may be matched by id, which allows
+ * pipelining several requests without waiting. Methods bound to a worker
+ * group may complete out of order relative to other requests.
  *
  * @note The server uses JSON for message serialization via the cJSON library
  */
@@ -36,16 +90,52 @@
 #define MAX_EVENTS 10
 
 /**
- * @brief Maximum number of RPC methods that can be registered
- * @note Can be increased if needed, affects memory usage
+ * @brief epoll data of the server's wake_fd; never a valid slab handle
  */
-#define MAX_METHODS 100
+#define WAKE_HANDLE UINT64_MAX
+
+/**
+ * @brief epoll data of the server's dump_fd in worker 0's epoll set
+ */
+#define DUMP_HANDLE (UINT64_MAX - 1)
+
+/**
+ * @brief epoll data of a worker's downstream client slot
+ *
+ * Slots count down from below DUMP_HANDLE; slab handles never get near.
+ */
+#define DOWNSTREAM_HANDLE(slot) (UINT64_MAX - 2 - (uint64_t)(slot))
+
+/**
+ * @brief Most downstream clients (distinct addresses) per worker
+ */
+#define MAX_DOWNSTREAM 16
+
+/**
+ * @brief Most response bytes a connection collects before writing them
+ */
+#define CORK_MAX_BYTES (64 * 1024)
+
+/**
+ * @brief Default for how long a batch collects responses before writing them out
+ */
+#define CORK_MAX_NS 200000UL
+
+/**
+ * @brief Most unsent bytes a connection holds for a client that stops reading
+ */
+#define OUTPUT_MAX_BYTES (2 * ((size_t)FRAME_MAX_PAYLOAD + FRAME_HEADER_SIZE))
 
 /**
- * @brief Size of the buffer for reading/writing socket data
- * @note Should be large enough for typical RPC messages
+ * @brief Most servers dumping their flight recorder on SIGUSR2 at once
  */
-#define BUFFER_SIZE 4096
+#define MAX_DUMP_SERVERS 16
+
+/**
+ * @brief Maximum number of RPC methods that can be registered
+ * @note Can be increased if needed, affects memory usage
+ */
+#define MAX_METHODS 100
 
 /**
  * @brief Number of worker threads in the thread pool
@@ -53,23 +143,251 @@
  */
 #define NUM_WORKERS 4
 
+/**
+ * @brief Maximum number of worker groups per server
+ */
+#define MAX_GROUPS 16
+
+/**
+ * @brief Maximum number of threads in one worker group
+ */
+#define MAX_GROUP_THREADS 64
+
+/**
+ * @brief Maximum number of handler modules loaded at once
+ */
+#define MAX_MODULES 16
+
+/**
+ * @brief Method compression threshold meaning "use the server default"
+ */
+#define THRESHOLD_INHERIT ((size_t)-1)
+
+/**
+ * @brief First file descriptor passed by a socket-activating supervisor
+ * @note Matches SD_LISTEN_FDS_START from the systemd activation protocol
+ */
+#define LISTEN_FDS_START 3
+
+/**
+ * @brief State of one client connection
+ *
+ * Owned by the I/O worker that accepted it and referenced by every
+ * request queued to a worker group, so a group thread can still send its
+ * response (or find out the connection is gone) after the worker has
+ * closed it. Responses from group threads and the I/O worker are
+ * serialized by write_mutex so frames never interleave. Requests are
+ * only ever decompressed by the owning I/O worker, responses are
+ * compressed under write_mutex.
+ *
+ * The input buffer holds the bytes of frames not yet complete. It is
+ * taken from the worker's pool when data arrives and given back as soon
+ * as every received frame has been dispatched, so idle connections pin
+ * no buffer memory.
+ *
+ * Connections live in the owning worker's slab. The epoll registration
+ * carries the slab handle rather than a pointer; closing retires the
+ * handle, so events that were already returned for the connection are
+ * recognized as stale even if the slot has been reused since.
+ *
+ * Nothing is written to the socket blocking. Published events wait in
+ * a bounded queue under write_mutex; response bytes the socket does not
+ * take go to an output backlog. While either holds data, the epoll
+ * registration includes EPOLLOUT and the I/O worker continues once the
+ * socket is writable. A frame is only written directly when no other
+ * frame is partially sent.
+ *
+ * While the owning worker dispatches a batch of pipelined requests that
+ * arrived together, the connection is corked: response frames, from any
+ * thread, are appended to a pooled cork buffer and written with one
+ * call when the batch ends, the buffer fills or the cork deadline passes.
+ */
+typedef struct connection
+{
+    int fd;                        /**< Client socket */
+    uint64_t handle;               /**< Slab handle, the epoll event data */
+    struct worker_context *worker; /**< Owning I/O worker */
+    char *in;                      /**< Pending input or NULL (owning worker only) */
+    size_t in_len;                 /**< Bytes in the input buffer */
+    size_t in_capacity;            /**< Capacity of the input buffer */
+    int closed;                    /**< fd has been closed (guarded by write_mutex) */
+    pubsub_queue events;           /**< Events not yet sent (guarded by write_mutex) */
+    int out_armed;                 /**< EPOLLOUT registered (guarded by write_mutex) */
+    char *out;                     /**< Unsent response frames or NULL (guarded by write_mutex) */
+    size_t out_len;                /**< Bytes in the output backlog */
+    size_t out_sent;               /**< Bytes of the backlog already sent */
+    size_t out_capacity;           /**< Capacity of the output backlog */
+    int subscribed;                /**< Ever subscribed to a topic (owning worker only) */
+    sockrpc_stream *streams;       /**< Uploads receiving chunks (owning worker only) */
+    int refs;                      /**< Worker reference plus queued jobs (atomic) */
+    compress_context *compress;    /**< Negotiated compression or NULL */
+    int corked;                    /**< Responses are collected (guarded by write_mutex) */
+    char *cork;                    /**< Collected frames or NULL (guarded by write_mutex) */
+    size_t cork_len;               /**< Bytes in the cork buffer */
+    size_t cork_capacity;          /**< Capacity of the cork buffer */
+    pthread_mutex_t write_mutex;   /**< Serializes responses, close and compress */
+    struct connection *prev;       /**< Previous in worker's connection list */
+    struct connection *next;       /**< Next in worker's connection list */
+} connection;
+
+/**
+ * @brief Non-blocking client a worker drives for deferred handlers
+ *
+ * Created by sockrpc_call_client on the worker's thread, registered in
+ * its epoll set under DOWNSTREAM_HANDLE(slot) while still connecting and
+ * dropped when the connection fails, so the next call reconnects.
+ */
+typedef struct
+{
+    char *address;          /**< Address the client connected to */
+    sockrpc_client *client; /**< Client, NULL if the slot is free */
+    int out_armed;          /**< EPOLLOUT registered */
+} downstream_client;
+
 /**
  * @brief Context structure for worker threads
  *
  * Each worker thread maintains its own epoll instance and connection counter.
  * The mutex protects access to shared resources within the worker context.
+ * For TCP servers each worker also owns a SO_REUSEPORT listener and
+ * accepts its own connections, so there is no shared accept queue.
+ * Input buffers of its connections and response buffers come from the
+ * worker's buffer pool, the connection objects from its slab.
  *
  * @note The num_connections counter is marked volatile as it's accessed
- *       from multiple threads
+ *       from multiple threads; it is updated under mutex when a
+ *       connection is added or closed
  */
-typedef struct
+typedef struct worker_context
 {
     int worker_id;                /**< Unique identifier for the worker */
+    struct sockrpc_server *server; /**< Owning server */
     int epoll_fd;                 /**< Worker's epoll instance */
-    volatile int num_connections; /**< Number of active connections */
+    int listen_fd;                /**< Worker's own TCP listener or -1 */
+    volatile int num_connections; /**< Number of open connections */
+    unsigned long accepted;       /**< Connections accepted so far (under mutex) */
+    connection *connections;      /**< Open connections, closed on destroy */
+    buffer_pool pool;             /**< Input and response buffers */
+    slab_cache slab;              /**< Connection objects */
+    spin_state spin;              /**< Busy-poll budget and counters */
+    downstream_client downstream[MAX_DOWNSTREAM]; /**< Clients of deferred handlers */
+    int downstream_count;         /**< Slots in use or freed, never shrinks */
+    recorder_ring *ring;          /**< Flight recorder ring, set before serving starts, or NULL */
     pthread_mutex_t mutex;        /**< Protects worker's shared state */
 } worker_context;
 
+/**
+ * @brief Compression metrics of one method name
+ *
+ * Created the first time a name is registered and kept until the
+ * server is destroyed, so calls in flight can update them without the
+ * registration lock even if the method is removed meanwhile. Counters
+ * are updated atomically and cover responses on connections that
+ * negotiated compression.
+ */
+typedef struct method_stats
+{
+    char *name;                /**< Method name */
+    unsigned long responses;   /**< Responses on compressing connections */
+    unsigned long compressed;  /**< Responses sent compressed */
+    unsigned long raw_bytes;   /**< Response bytes before compression */
+    unsigned long wire_bytes;  /**< Response bytes sent */
+    unsigned long compress_ns; /**< Time spent compressing */
+    struct method_stats *next; /**< Next in the server's stats list */
+} method_stats;
+
+/**
+ * @brief Registered method and its dispatch settings
+ */
+typedef struct
+{
+    char *name;                /**< Method name (owned) */
+    rpc_handler handler;       /**< Handler function, or NULL */
+    rpc_response_handler response_handler; /**< Fragment handler, or NULL */
+    rpc_stream_handler stream_handler; /**< Upload handler, or NULL */
+    rpc_deferred_handler deferred_handler; /**< Deferred handler, or NULL */
+    void *deferred_ctx;        /**< Passed to the deferred handler */
+    int group;                 /**< Worker group index, -1 for I/O workers */
+    module *mod;               /**< Module providing the handler or NULL */
+    size_t compress_threshold; /**< Smallest response to compress, or THRESHOLD_INHERIT */
+    method_stats *stats;       /**< Metrics for this name */
+} method_entry;
+
+/**
+ * @brief Everything a call needs, captured under the registration lock
+ */
+typedef struct
+{
+    rpc_handler handler;       /**< Handler to run, or NULL */
+    rpc_response_handler response_handler; /**< Fragment handler to run, or NULL */
+    rpc_stream_handler stream_handler; /**< Upload handler to run, or NULL */
+    rpc_deferred_handler deferred_handler; /**< Deferred handler to run, or NULL */
+    void *deferred_ctx;        /**< Passed to the deferred handler */
+    module *mod;               /**< Module providing handler (referenced) or NULL */
+    size_t compress_threshold; /**< Smallest response to compress, 0 = never */
+    method_stats *stats;       /**< Metrics to update, may be NULL */
+    trace_context trace;       /**< Trace the call continues, valid 0 if none */
+    trace_span *span;          /**< Span recorded for the call, or NULL */
+    const char *method;        /**< Method name, owned by the request */
+    unsigned long received_ns; /**< Monotonic time the request was dispatched */
+    size_t request_bytes;      /**< Request frame payload length */
+} call_info;
+
+/**
+ * @brief Request queued for execution by a worker group
+ */
+typedef struct group_job
+{
+    struct group_job *next; /**< Next job in the group queue */
+    connection *conn;       /**< Connection to answer on (referenced) */
+    call_info call;         /**< Handler and response settings */
+    cJSON *request;         /**< Parsed request, owns the params */
+    cJSON *id;              /**< Request id detached from request */
+    sockrpc_stream *stream; /**< Upload for a stream handler (referenced) or NULL */
+} group_job;
+
+/**
+ * @brief Deferred call between its handler and sockrpc_call_complete
+ *
+ * Holds everything the response needs, so it can be sent from any
+ * thread once the result is known.
+ */
+struct sockrpc_call
+{
+    struct sockrpc_server *server; /**< Server answering the call */
+    connection *conn;              /**< Connection to answer on (referenced) */
+    call_info call;                /**< Handler and response settings */
+    cJSON *request;                /**< Parsed request, owns the params */
+    cJSON *id;                     /**< Request id detached from request */
+    unsigned long handler_ns;      /**< Monotonic time the handler started */
+    recorder_ring *ring;           /**< Ring of the worker that started the call or NULL */
+    pthread_t thread;              /**< Thread that started the call, the ring's writer */
+};
+
+/**
+ * @brief Named pool of threads running the methods bound to it
+ *
+ * I/O workers parse requests and append jobs for grouped methods to the
+ * group's FIFO queue; the group's threads run the handlers and send the
+ * responses themselves. A full queue rejects new requests with a
+ * "Server busy" error instead of letting latency grow without bound.
+ */
+typedef struct
+{
+    char *name;                           /**< Group name */
+    int num_threads;                      /**< Threads in the group */
+    pthread_t threads[MAX_GROUP_THREADS]; /**< Group threads */
+    size_t queue_limit;                   /**< Maximum queued jobs, 0 = no limit */
+    size_t queued;                        /**< Jobs currently queued */
+    group_job *head;                      /**< Oldest queued job */
+    group_job *tail;                      /**< Newest queued job */
+    int stopping;                         /**< Exit once the queue is empty */
+    pthread_mutex_t mutex;                /**< Protects the queue */
+    pthread_cond_t cond;                  /**< Signals queued jobs and stopping */
+    struct sockrpc_server *server;        /**< Owning server */
+    int index;                            /**< Position in the server's groups */
+} worker_group;
+
 /**
  * @brief Main server context structure
  *
@@ -80,291 +398,2318 @@ typedef struct
  * - Synchronization primitives
  *
  * Thread safety is ensured through multiple mutexes:
- * - mutex: Protects method registration
+ * - mutex: Protects method registration, the group and module tables
  * - lb_mutex: Protects load balancer state
  * - Per-worker mutexes: Protect worker-specific state
  */
 struct sockrpc_server
 {
-    char *socket_path;                     /**< Path to Unix domain socket */
-    int server_fd;                         /**< Server socket file descriptor */
+    char *socket_path;                     /**< Socket path or transport URL */
+    transport_address address;             /**< Resolved listening address */
+    int server_fd;                         /**< Shared listening socket or -1 */
+    int owns_socket;                       /**< Socket file created by us (unlink on destroy) */
+    int blocking_listener;                 /**< Adopted listener is blocking between accepts */
+    sockrpc_socket_type socket_type;       /**< Stream or seqpacket connections */
     volatile int running;                  /**< Server running flag */
+    int wake_fd;                           /**< Control eventfd in every epoll set */
+    int started;                           /**< Threads were launched, or embedded mode began */
+    int embedded;                          /**< Driven by sockrpc_server_process, no threads */
     pthread_t worker_threads[NUM_WORKERS]; /**< Worker thread pool */
+    pthread_t acceptor_thread;             /**< Acceptor, valid if server_fd != -1 */
     worker_context workers[NUM_WORKERS];   /**< Worker contexts */
-    rpc_method methods[MAX_METHODS];       /**< Registered RPC methods */
+    method_entry methods[MAX_METHODS];     /**< Registered RPC methods */
     size_t method_count;                   /**< Number of registered methods */
+    method_stats *stats;                   /**< Per-name metrics, never shrinks */
+    worker_group *groups[MAX_GROUPS];      /**< Worker groups */
+    size_t group_count;                    /**< Number of worker groups */
+    module *modules[MAX_MODULES];          /**< Installed handler modules */
+    size_t module_count;                   /**< Number of installed modules */
+    size_t compress_threshold;             /**< Default smallest response to compress */
+    compress_dict *compress_dict;          /**< Zstandard dictionary or NULL */
+    unsigned long compressed_requests;     /**< Compressed requests received (atomic) */
+    unsigned long request_raw_bytes;       /**< Their size after decompression (atomic) */
+    unsigned long request_wire_bytes;      /**< Their size on the wire (atomic) */
+    unsigned long decompress_ns;           /**< Time spent decompressing (atomic) */
+    unsigned long corked_responses;        /**< Frames sent through a cork (atomic) */
+    unsigned long cork_writes;             /**< Writes of corked frames (atomic) */
+    unsigned long cork_max_ns;             /**< Longest a batch is corked, 0 for no limit */
+    pubsub_registry pubsub;                /**< Topics and their subscribers */
+    trace_exporter *tracer;                /**< Span exporter, NULL if tracing is off */
+    recorder recorder;                     /**< Recent requests of every server thread */
+    int dump_fd;                           /**< eventfd signaled by SIGUSR2, or -1 */
+    char *dump_path;                       /**< File written on SIGUSR2, or NULL */
+    capture_writer *capture;               /**< Request capture, NULL if off */
     pthread_mutex_t mutex;                 /**< Protects method registration */
     int next_worker;                       /**< Next worker for round-robin */
     pthread_mutex_t lb_mutex;              /**< Protects load balancing state */
 };
 
+#ifndef SOCKRPC_EMBEDDED_ONLY
 /**
- * @brief Sets a file descriptor to non-blocking mode
- * @param fd File descriptor to modify
- *
- * Used for both the server socket and client connections to ensure
- * non-blocking I/O operations.
+ * @brief Selects the next worker thread for a new connection
+ * @param server Server context
+ * @return Pointer to selected worker context
  *
- * @note This is a critical operation - failure here would impact
- *       the server's ability to handle concurrent connections
+ * Implements round-robin load balancing across worker threads.
+ * Thread-safe through lb_mutex.
  */
-static void set_nonblocking(int fd)
+static worker_context *select_worker(sockrpc_server *server)
 {
-    int flags = fcntl(fd, F_GETFL, 0);
-    fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+    lock_mutex(&server->lb_mutex);
+    int selected = server->next_worker;
+    server->next_worker = (server->next_worker + 1) % NUM_WORKERS;
+    unlock_mutex(&server->lb_mutex);
+
+    return &server->workers[selected];
 }
+#endif
 
 /**
- * @brief Reads all available data from a socket
- * @param fd Socket file descriptor
- * @param buffer Buffer to store read data
- * @param max_len Maximum number of bytes to read
- * @return Number of bytes read, or -1 on error
+ * @brief Drops a reference to a connection
+ * @param conn Connection context
  *
- * Handles partial reads and common socket errors (EAGAIN, EINTR).
- * Ensures null-termination of the received data.
+ * Returns the connection to its worker's slab once the worker has
+ * closed it and no queued group job refers to it any more.
  */
-static ssize_t read_all(int fd, char *buffer, size_t max_len)
+static void connection_release(connection *conn)
 {
-    size_t total = 0;
-    while (total < max_len - 1)
+    if (__atomic_sub_fetch(&conn->refs, 1, __ATOMIC_ACQ_REL) == 0)
     {
-        ssize_t n = read(fd, buffer + total, max_len - total - 1);
-        if (n == 0)
-            break; // EOF
-        if (n < 0)
-        {
-            if (errno == EAGAIN || errno == EWOULDBLOCK)
-                break;
-            if (errno == EINTR)
-                continue;
-            return -1;
-        }
-        total += n;
+        compress_context_destroy(conn->compress);
+        pubsub_queue_clear(&conn->events);
+        pthread_mutex_destroy(&conn->write_mutex);
+        slab_free(&conn->worker->slab, conn->handle);
+    }
+}
+
+/**
+ * @brief Returns a monotonic timestamp in nanoseconds
+ * @return Nanoseconds since an arbitrary point
+ */
+static unsigned long now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long)ts.tv_sec * 1000000000ul + (unsigned long)ts.tv_nsec;
+}
+
+/**
+ * @brief Records a response sent on a compressing connection
+ * @param call Settings of the answered call
+ * @param compressed Whether the response was sent compressed
+ * @param raw Response size before compression
+ * @param wire Response size sent
+ * @param elapsed Time spent compressing in nanoseconds
+ */
+static void count_response(const call_info *call, int compressed, size_t raw, size_t wire,
+                           unsigned long elapsed)
+{
+    method_stats *stats = call->stats;
+    if (stats)
+    {
+        __atomic_add_fetch(&stats->responses, 1, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&stats->compressed, compressed, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&stats->raw_bytes, raw, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&stats->wire_bytes, wire, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&stats->compress_ns, elapsed, __ATOMIC_RELAXED);
     }
-    buffer[total] = '\0';
-    return total;
 }
 
 /**
- * @brief Writes all data to a socket
- * @param fd Socket file descriptor
- * @param buffer Data to write
- * @param len Number of bytes to write
- * @return Number of bytes written, or -1 on error
+ * @brief Registers or unregisters EPOLLOUT for a connection
+ * @param conn Client connection (write_mutex held, not closed)
+ * @param pending Whether output is waiting for the socket
+ */
+static void watch_output(connection *conn, int pending)
+{
+    if (pending == conn->out_armed)
+        return;
+
+    struct epoll_event ev = {
+        .events = EPOLLIN | EPOLLRDHUP | EPOLLET | (pending ? EPOLLOUT : 0),
+        .data.u64 = conn->handle};
+    if (epoll_ctl(conn->worker->epoll_fd, EPOLL_CTL_MOD, conn->fd, &ev) == 0)
+        conn->out_armed = pending;
+}
+
+/**
+ * @brief Sends the output backlog without blocking
+ * @param server Server context
+ * @param conn Client connection (write_mutex held, not closed)
+ * @return 0 once the backlog is empty, 1 if the socket is full, -1 on error
  *
- * Handles partial writes and common socket errors (EAGAIN, EINTR).
- * Ensures all data is written or an error is returned.
+ * On SOCK_SEQPACKET every frame of the backlog goes out as one packet.
+ * The emptied backlog is freed, so idle connections hold none.
  */
-static ssize_t write_all(int fd, const char *buffer, size_t len)
+static int send_backlog(sockrpc_server *server, connection *conn)
 {
-    size_t total = 0;
-    while (total < len)
+    while (conn->out_sent < conn->out_len)
     {
-        ssize_t n = write(fd, buffer + total, len - total);
-        if (n <= 0)
+        size_t len = conn->out_len - conn->out_sent;
+        if (server->address.socktype == SOCK_SEQPACKET)
+        {
+            uint32_t flags;
+            frame_decode_header((unsigned char *)conn->out + conn->out_sent, &len, &flags);
+            len += FRAME_HEADER_SIZE;
+        }
+
+        ssize_t n = send(conn->fd, conn->out + conn->out_sent, len, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (n < 0)
         {
-            if (errno == EAGAIN || errno == EWOULDBLOCK)
-                continue;
             if (errno == EINTR)
                 continue;
-            return -1;
+            return errno == EAGAIN || errno == EWOULDBLOCK ? 1 : -1;
         }
-        total += n;
+        conn->out_sent += (size_t)n;
     }
-    return total;
+
+    free(conn->out);
+    conn->out = NULL;
+    conn->out_len = 0;
+    conn->out_sent = 0;
+    conn->out_capacity = 0;
+    return 0;
 }
 
 /**
- * @brief Selects the next worker thread for a new connection
+ * @brief Sends queued output without blocking
  * @param server Server context
- * @return Pointer to selected worker context
+ * @param conn Client connection (write_mutex held, not closed)
  *
- * Implements round-robin load balancing across worker threads.
- * Thread-safe through lb_mutex.
+ * A partially sent event is completed first, then the response
+ * backlog, then the remaining events, so frames never interleave.
+ * Registers EPOLLOUT while output remains so the owning worker resumes
+ * sending when the socket drains, and unregisters it once all is out.
+ * On a socket error the connection is shut down for its worker to close.
  */
-static worker_context *select_worker(sockrpc_server *server)
+static void flush_output(sockrpc_server *server, connection *conn)
 {
-    pthread_mutex_lock(&server->lb_mutex);
-    int selected = server->next_worker;
-    server->next_worker = (server->next_worker + 1) % NUM_WORKERS;
-    pthread_mutex_unlock(&server->lb_mutex);
+    unsigned long sent = 0;
+    int rc = pubsub_queue_finish(&conn->events, conn->fd, &sent);
+    if (rc == 0)
+        rc = send_backlog(server, conn);
+    if (rc == 0)
+        rc = pubsub_queue_send(&conn->events, conn->fd, &sent);
+    __atomic_add_fetch(&server->pubsub.stats.sent, sent, __ATOMIC_RELAXED);
 
-    return &server->workers[selected];
+    if (rc == -1)
+        shutdown(conn->fd, SHUT_RDWR);
+    watch_output(conn, rc == 1);
 }
 
 /**
- * @brief Handles an RPC request from a client
- * @param server Server context
- * @param worker Worker context handling the request
- * @param client_fd Client socket file descriptor
- *
- * Processes a single RPC request:
- * 1. Reads request data
- * 2. Parses JSON message
- * 3. Looks up method handler
- * 4. Executes handler
- * 5. Sends response
- *
- * @note Handles its own memory management for JSON objects
+ * @brief Appends frames to a connection's output backlog
+ * @param conn Client connection (write_mutex held, not closed)
+ * @param iov Remaining bytes of complete frames
+ * @param iovcnt Number of entries
+ * @return 0 on success, -1 if the backlog would exceed OUTPUT_MAX_BYTES
+ *         or cannot grow
  */
-static void handle_client_request(sockrpc_server *server, worker_context *worker, int client_fd)
+static int queue_output(connection *conn, const struct iovec *iov, int iovcnt)
 {
-    char buffer[BUFFER_SIZE];
-    ssize_t n = read_all(client_fd, buffer, BUFFER_SIZE);
-
-    if (n <= 0)
-    {
-        pthread_mutex_lock(&worker->mutex);
-        worker->num_connections--;
-        pthread_mutex_unlock(&worker->mutex);
-        return;
-    }
-
-    cJSON *request = cJSON_Parse(buffer);
-    if (!request)
+    size_t len = 0;
+    for (int i = 0; i < iovcnt; i++)
     {
-        return;
+        len += iov[i].iov_len;
     }
+    if (len == 0)
+        return 0;
 
-    const char *method = cJSON_GetObjectItem(request, "method")->valuestring;
-    cJSON *params = cJSON_GetObjectItem(request, "params");
-
-    cJSON *result = NULL;
-    rpc_handler found_handler = NULL;
+    size_t queued = conn->out_len - conn->out_sent;
+    if (queued + len > OUTPUT_MAX_BYTES)
+        return -1;
 
-    // Find the handler while holding the lock
-    pthread_mutex_lock(&server->mutex);
-    for (size_t i = 0; i < server->method_count; i++)
+    if (conn->out_sent)
     {
-        if (strcmp(server->methods[i].name, method) == 0)
-        {
-            found_handler = server->methods[i].handler;
-            break;
-        }
+        memmove(conn->out, conn->out + conn->out_sent, queued);
+        conn->out_len = queued;
+        conn->out_sent = 0;
     }
-    pthread_mutex_unlock(&server->mutex);
 
-    // Execute handler outside the critical section
-    if (found_handler)
+    if (conn->out_len + len > conn->out_capacity)
     {
-        result = found_handler(params);
+        size_t capacity = conn->out_capacity * 2;
+        if (capacity < conn->out_len + len)
+            capacity = conn->out_len + len;
+        char *out = realloc(conn->out, capacity);
+        if (!out)
+            return -1;
+        conn->out = out;
+        conn->out_capacity = capacity;
     }
 
-    if (result)
+    for (int i = 0; i < iovcnt; i++)
     {
-        char *response = cJSON_Print(result);
-        write_all(client_fd, response, strlen(response));
-        free(response);
-        cJSON_Delete(result);
+        memcpy(conn->out + conn->out_len, iov[i].iov_base, iov[i].iov_len);
+        conn->out_len += iov[i].iov_len;
     }
-
-    cJSON_Delete(request);
+    return 0;
 }
 
 /**
- * @brief Worker thread main function
- * @param arg Pointer to worker context
- * @return NULL
- *
- * Main loop for worker threads:
- * 1. Waits for events using epoll
- * 2. Handles client requests
- * 3. Manages connection lifecycle
+ * @brief Writes complete frames without blocking
+ * @param conn Client connection (write_mutex held, not closed)
+ * @param iov Encoded frames, one frame on SOCK_SEQPACKET; modified
+ * @param iovcnt Number of entries, at most FRAME_MAX_IOV
  *
- * @note Runs until server->running becomes false
+ * The frames are sent directly unless other output is still waiting
+ * for the socket. Whatever the socket does not take is appended to the
+ * backlog for the owning worker to send on EPOLLOUT, so one client that
+ * stops reading never stalls the thread answering it. If the write
+ * fails or the backlog overflows, the connection is shut down for its
+ * worker to close.
  */
-static void *worker_routine(void *arg)
+static void send_output(connection *conn, struct iovec *iov, int iovcnt)
 {
-    worker_context *worker = (worker_context *)arg;
-    sockrpc_server *server = (sockrpc_server *)((char *)worker - offsetof(sockrpc_server, workers[worker->worker_id]));
-    struct epoll_event events[MAX_EVENTS];
-
-    printf("Worker %d started\n", worker->worker_id);
-
-    while (server->running)
+    if (conn->out_len == 0 && conn->events.offset == 0)
     {
-        int nfds = epoll_wait(worker->epoll_fd, events, MAX_EVENTS, 100);
-        if (nfds == -1)
+        struct msghdr msg = {.msg_iov = iov, .msg_iovlen = (size_t)iovcnt};
+        while (msg.msg_iovlen)
         {
-            if (errno == EINTR)
-                continue;
-            break;
-        }
+            ssize_t n = sendmsg(conn->fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                if (errno == EAGAIN || errno == EWOULDBLOCK)
+                    break;
+                shutdown(conn->fd, SHUT_RDWR);
+                return;
+            }
 
-        for (int i = 0; i < nfds; i++)
-        {
-            int fd = events[i].data.fd;
-            handle_client_request(server, worker, fd);
+            size_t left = (size_t)n;
+            while (msg.msg_iovlen && left >= msg.msg_iov->iov_len)
+            {
+                left -= msg.msg_iov->iov_len;
+                msg.msg_iov++;
+                msg.msg_iovlen--;
+            }
+            if (msg.msg_iovlen)
+            {
+                msg.msg_iov->iov_base = (char *)msg.msg_iov->iov_base + left;
+                msg.msg_iov->iov_len -= left;
+            }
         }
+        iov = msg.msg_iov;
+        iovcnt = (int)msg.msg_iovlen;
     }
 
-    printf("Worker %d shutting down (handled %d connections)\n",
-           worker->worker_id, worker->num_connections);
-    return NULL;
+    if (queue_output(conn, iov, iovcnt) == -1)
+    {
+        shutdown(conn->fd, SHUT_RDWR);
+        return;
+    }
+    if (conn->out_len)
+        watch_output(conn, 1);
 }
 
 /**
- * @brief Acceptor thread main function
- * @param arg Pointer to server context
- * @return NULL
- *
- * Accepts new client connections and distributes them to workers:
- * 1. Accepts connection
- * 2. Sets non-blocking mode
- * 3. Selects worker thread
- * 4. Adds to worker's epoll set
+ * @brief Writes the frames collected in a connection's cork
+ * @param server Server context
+ * @param conn Client connection (write_mutex held)
  *
- * @note Runs until server->running becomes false
+ * Called before any frame is written directly, so frames leave in the
+ * order they were sent. The buffer is kept for the rest of the batch.
  */
-static void *acceptor_routine(void *arg)
+static void flush_cork(sockrpc_server *server, connection *conn)
 {
-    sockrpc_server *server = (sockrpc_server *)arg;
+    if (conn->cork_len == 0)
+        return;
 
-    printf("Acceptor started\n");
+    if (!conn->closed)
+    {
+        struct iovec iov = {.iov_base = conn->cork, .iov_len = conn->cork_len};
+        send_output(conn, &iov, 1);
+        __atomic_add_fetch(&server->cork_writes, 1, __ATOMIC_RELAXED);
+    }
+    conn->cork_len = 0;
+}
 
-    while (server->running)
+/**
+ * @brief Starts collecting a connection's responses
+ * @param conn Client connection (called from its I/O worker)
+ */
+static void begin_cork(connection *conn)
+{
+    lock_mutex(&conn->write_mutex);
+    conn->corked = 1;
+    unlock_mutex(&conn->write_mutex);
+}
+
+/**
+ * @brief Writes the collected responses and stops collecting
+ * @param server Server context
+ * @param conn Client connection (called from its I/O worker)
+ *
+ * The cork buffer goes back to the pool, so idle connections hold none.
+ */
+static void end_cork(sockrpc_server *server, connection *conn)
+{
+    lock_mutex(&conn->write_mutex);
+    flush_cork(server, conn);
+    pool_release(&conn->worker->pool, conn->cork, conn->cork_capacity);
+    conn->cork = NULL;
+    conn->cork_capacity = 0;
+    conn->corked = 0;
+    unlock_mutex(&conn->write_mutex);
+}
+
+/**
+ * @brief Writes a frame, or collects it while the connection is corked
+ * @param server Server context
+ * @param conn Client connection (write_mutex held, not closed)
+ * @param payload Frame payload
+ * @param len Payload length
+ * @param flags Frame flags
+ *
+ * Frames larger than the cork, or arriving when no buffer is available,
+ * are written directly after the collected ones.
+ */
+static void write_frame(sockrpc_server *server, connection *conn, const char *payload,
+                        size_t len, uint32_t flags)
+{
+    size_t frame = FRAME_HEADER_SIZE + len;
+    if (conn->corked && frame <= CORK_MAX_BYTES)
     {
-        int client_fd = accept(server->server_fd, NULL, NULL);
-        if (client_fd < 0)
+        if (!conn->cork)
+            conn->cork = pool_acquire(&conn->worker->pool, CORK_MAX_BYTES, &conn->cork_capacity);
+        if (conn->cork)
         {
-            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
-                continue;
-            break;
+            if (conn->cork_len + frame > conn->cork_capacity)
+                flush_cork(server, conn);
+            frame_encode_header((unsigned char *)conn->cork + conn->cork_len, len, flags);
+            memcpy(conn->cork + conn->cork_len + FRAME_HEADER_SIZE, payload, len);
+            conn->cork_len += frame;
+            __atomic_add_fetch(&server->corked_responses, 1, __ATOMIC_RELAXED);
+            return;
         }
+    }
 
-        set_nonblocking(client_fd);
-
-        // Select worker using round-robin
-        worker_context *worker = select_worker(server);
+    flush_cork(server, conn);
 
-        // Add connection to worker's epoll
-        struct epoll_event ev = {
-            .events = EPOLLIN | EPOLLET,
-            .data.fd = client_fd};
+    unsigned char header[FRAME_HEADER_SIZE];
+    frame_encode_header(header, len, flags);
+    struct iovec iov[2] = {{.iov_base = header, .iov_len = FRAME_HEADER_SIZE},
+                           {.iov_base = (char *)payload, .iov_len = len}};
+    send_output(conn, iov, 2);
+}
 
-        if (epoll_ctl(worker->epoll_fd, EPOLL_CTL_ADD, client_fd, &ev) == -1)
-        {
-            close(client_fd);
-            continue;
-        }
+/**
+ * @brief Sends a response payload, compressed if negotiated and worthwhile
+ * @param server Server context
+ * @param conn Client connection (write_mutex held, not closed)
+ * @param payload Response JSON
+ * @param len Payload length
+ * @param call Settings of the answered call, or NULL for protocol errors
+ */
+static void send_payload(sockrpc_server *server, connection *conn, const char *payload,
+                         size_t len, const call_info *call)
+{
+    if (!conn->compress || !call)
+    {
+        write_frame(server, conn, payload, len, 0);
+        return;
+    }
 
-        // Update worker's connection count
-        pthread_mutex_lock(&worker->mutex);
-        worker->num_connections++;
-        printf("Connection assigned to worker %d (total: %d)\n",
-               worker->worker_id, worker->num_connections);
-        pthread_mutex_unlock(&worker->mutex);
+    char *packed = NULL;
+    size_t packed_len = len;
+    unsigned long elapsed = 0;
+    if (call->compress_threshold && len >= call->compress_threshold)
+    {
+        unsigned long start = now_ns();
+        packed = compress_encode(conn->compress, payload, len, &packed_len);
+        elapsed = now_ns() - start;
+        if (!packed)
+            packed_len = len;
     }
 
-    printf("Acceptor shutting down\n");
-    return NULL;
+    if (packed)
+        write_frame(server, conn, packed, packed_len, compress_context_codec(conn->compress));
+    else
+        write_frame(server, conn, payload, len, 0);
+    free(packed);
+
+    count_response(call, packed != NULL, len, packed_len, elapsed);
 }
 
 /**
- * @brief Creates a new RPC server instance
- * @param socket_path Path where the Unix domain socket will be created
- * @return Pointer to server context or NULL on error
+ * @brief Sends a response envelope to the client
+ * @param server Server context
+ * @param conn Client connection
+ * @param id Request id to echo back (ownership transferred, may be NULL)
+ * @param result Handler result (ownership transferred, may be NULL)
+ * @param error Error message, used when result is NULL
+ * @param call Settings of the answered call, or NULL for protocol errors
+ * @return Payload length written, 0 if nothing was sent
+ *
+ * Every request gets exactly one response, so pipelining clients and
+ * proxies can match responses to requests by id.
+ */
+static size_t send_response(sockrpc_server *server, connection *conn, cJSON *id, cJSON *result,
+                            const char *error, const call_info *call)
+{
+    cJSON *response = cJSON_CreateObject();
+    if (!response)
+    {
+        cJSON_Delete(id);
+        cJSON_Delete(result);
+        return 0;
+    }
+
+    if (id)
+        cJSON_AddItemToObject(response, "id", id);
+
+    if (result)
+        cJSON_AddItemToObject(response, "result", result);
+    else
+        cJSON_AddStringToObject(response, "error", error);
+
+    // Most responses fit a pooled buffer; larger ones are printed by cJSON
+    buffer_pool *pool = &conn->worker->pool;
+    size_t capacity = 0;
+    char *payload = pool_acquire(pool, POOL_MIN_SIZE, &capacity);
+    if (payload && !cJSON_PrintPreallocated(response, payload, (int)capacity, 0))
+    {
+        pool_release(pool, payload, capacity);
+        payload = NULL;
+    }
+    if (!payload)
+    {
+        capacity = 0;
+        payload = cJSON_PrintUnformatted(response);
+    }
+
+    size_t sent = 0;
+    if (payload)
+    {
+        lock_mutex(&conn->write_mutex);
+        if (!conn->closed)
+        {
+            sent = strlen(payload);
+            send_payload(server, conn, payload, sent, call);
+        }
+        unlock_mutex(&conn->write_mutex);
+        if (capacity)
+            pool_release(pool, payload, capacity);
+        else
+            free(payload);
+    }
+    cJSON_Delete(response);
+    return sent;
+}
+
+/**
+ * @brief Joins the payload buffers of an iovec array
+ * @param iov Buffers
+ * @param iovcnt Number of buffers
+ * @param len Set to the total length
+ * @return Contiguous copy or NULL on allocation failure
+ */
+static char *flatten_iov(const struct iovec *iov, int iovcnt, size_t *len)
+{
+    *len = 0;
+    for (int i = 0; i < iovcnt; i++)
+    {
+        *len += iov[i].iov_len;
+    }
+
+    char *buffer = malloc(*len ? *len : 1);
+    if (!buffer)
+        return NULL;
+
+    size_t offset = 0;
+    for (int i = 0; i < iovcnt; i++)
+    {
+        memcpy(buffer + offset, iov[i].iov_base, iov[i].iov_len);
+        offset += iov[i].iov_len;
+    }
+    return buffer;
+}
+
+/**
+ * @brief Sends a response built from fragments
+ * @param server Server context
+ * @param conn Client connection
+ * @param id Request id to echo back (ownership transferred, may be NULL)
+ * @param response Valid response whose fragments form the result
+ * @param call Settings of the answered call
+ * @return Payload length written, 0 if nothing was sent
+ *
+ * The envelope goes into the response's reserved iovec slots and the
+ * frame is written straight from the fragments. Only when the response
+ * is to be compressed, or has more fragments than one sendmsg accepts,
+ * is it copied into one buffer and sent like any other payload.
+ */
+static size_t send_fragments(sockrpc_server *server, connection *conn, cJSON *id,
+                             sockrpc_response *response, const call_info *call)
+{
+    char *id_text = id ? cJSON_PrintUnformatted(id) : NULL;
+    cJSON_Delete(id);
+    if (id && !id_text)
+        return 0;
+
+    int iovcnt;
+    struct iovec *iov = response_iov(response, &iovcnt);
+    iov[1].iov_base = id_text ? "{\"id\":" : "{";
+    iov[1].iov_len = strlen(iov[1].iov_base);
+    iov[2].iov_base = id_text ? id_text : "";
+    iov[2].iov_len = id_text ? strlen(id_text) : 0;
+    iov[3].iov_base = id_text ? ",\"result\":" : "\"result\":";
+    iov[3].iov_len = strlen(iov[3].iov_base);
+    iov[iovcnt - 1].iov_base = "}";
+    iov[iovcnt - 1].iov_len = 1;
+
+    size_t len = 0;
+    for (int i = 1; i < iovcnt; i++)
+    {
+        len += iov[i].iov_len;
+    }
+
+    size_t sent = 0;
+    lock_mutex(&conn->write_mutex);
+    if (!conn->closed)
+    {
+        sent = len;
+        int compress = conn->compress && call->compress_threshold &&
+                       len >= call->compress_threshold;
+        if (compress || iovcnt > FRAME_MAX_IOV)
+        {
+            char *payload = flatten_iov(iov + 1, iovcnt - 1, &len);
+            if (payload)
+                send_payload(server, conn, payload, len, call);
+            free(payload);
+        }
+        else
+        {
+            unsigned char header[FRAME_HEADER_SIZE];
+            frame_encode_header(header, len, 0);
+            iov[0].iov_base = header;
+            iov[0].iov_len = FRAME_HEADER_SIZE;
+            flush_cork(server, conn);
+            send_output(conn, iov, iovcnt);
+            if (conn->compress)
+                count_response(call, 0, len, len, 0);
+        }
+    }
+    unlock_mutex(&conn->write_mutex);
+    free(id_text);
+    return sent;
+}
+
+/**
+ * @brief Drops a reference to a stream
+ * @param stream Stream, freed with the last reference
+ *
+ * A stream receiving chunks references its connection, which is
+ * released along with it.
+ */
+static void release_stream(sockrpc_stream *stream)
+{
+    if (__atomic_sub_fetch(&stream->refs, 1, __ATOMIC_ACQ_REL) == 0)
+    {
+        connection *conn = stream->owner;
+        stream_destroy(stream);
+        if (conn)
+            connection_release(conn);
+    }
+}
+
+/**
+ * @brief Acknowledges consumed chunks so the client may send more
+ * @param stream Stream (called from the handler's thread)
+ * @param consumed Chunks consumed so far
+ */
+static void send_stream_ack(sockrpc_stream *stream, unsigned long consumed)
+{
+    connection *conn = stream->owner;
+    sockrpc_server *server = conn->worker->server;
+
+    // Acknowledgements go out once per half window, formatting them is cheap
+    char *payload = NULL;
+    int len = asprintf(&payload, "{\"id\":%s,\"ack\":%lu}", stream->id, consumed);
+    if (len == -1)
+        return;
+
+    lock_mutex(&conn->write_mutex);
+    if (!conn->closed)
+        write_frame(server, conn, payload, (size_t)len, 0);
+    unlock_mutex(&conn->write_mutex);
+    free(payload);
+}
+
+/**
+ * @brief Removes a stream from its connection and drops the list's reference
+ * @param conn Client connection (called from its I/O worker)
+ * @param stream Stream in conn->streams
+ */
+static void unlink_stream(connection *conn, sockrpc_stream *stream)
+{
+    for (sockrpc_stream **link = &conn->streams; *link; link = &(*link)->next)
+    {
+        if (*link == stream)
+        {
+            *link = stream->next;
+            release_stream(stream);
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Creates the stream of a call to a stream handler
+ * @param conn Client connection (called from its I/O worker)
+ * @param id Request id, required when streaming
+ * @param streaming Non-zero if the client will upload chunks
+ * @return Stream with a reference for the call, or NULL if the id is
+ *         missing or already streaming, or on allocation failure
+ *
+ * A streaming call's stream is also linked into conn->streams, which
+ * holds a second reference, so chunk frames can find it. A plain call
+ * gets a stream that has already ended.
+ */
+static sockrpc_stream *open_stream(connection *conn, cJSON *id, int streaming)
+{
+    if (!streaming)
+    {
+        sockrpc_stream *stream = stream_create(NULL, NULL, NULL);
+        if (stream)
+            stream_end(stream, 0);
+        return stream;
+    }
+
+    char *text = id ? cJSON_PrintUnformatted(id) : NULL;
+    if (!text)
+        return NULL;
+
+    for (sockrpc_stream *s = conn->streams; s; s = s->next)
+    {
+        if (strcmp(s->id, text) == 0)
+        {
+            free(text);
+            return NULL;
+        }
+    }
+
+    sockrpc_stream *stream = stream_create(text, conn, send_stream_ack);
+    free(text);
+    if (!stream)
+        return NULL;
+
+    __atomic_add_fetch(&conn->refs, 1, __ATOMIC_RELAXED);
+    stream->refs = 2;
+    stream->next = conn->streams;
+    conn->streams = stream;
+    return stream;
+}
+
+/**
+ * @brief Hands a chunk or end frame to the stream it belongs to
+ * @param conn Client connection (called from its I/O worker)
+ * @param id Stream id from the frame
+ * @param request Parsed frame
+ *
+ * Frames of unknown streams are dropped: the call may have already
+ * been answered. A chunk beyond the window aborts the stream.
+ */
+static void handle_stream_frame(connection *conn, cJSON *id, cJSON *request)
+{
+    char *text = id ? cJSON_PrintUnformatted(id) : NULL;
+    if (!text)
+        return;
+
+    sockrpc_stream *stream = conn->streams;
+    while (stream && strcmp(stream->id, text) != 0)
+        stream = stream->next;
+    free(text);
+    if (!stream)
+        return;
+
+    cJSON *chunk = cJSON_DetachItemFromObject(request, "chunk");
+    if (!chunk)
+    {
+        stream_end(stream, 0);
+        unlink_stream(conn, stream);
+    }
+    else if (stream_push(stream, chunk) == -1)
+    {
+        stream_end(stream, 1);
+        unlink_stream(conn, stream);
+    }
+}
+
+/**
+ * @brief Completes a call's span and hands it to the exporter
+ * @param server Server context
+ * @param span Span of the call
+ * @param error Error sent instead of a result, or NULL
+ * @param end_ns Monotonic time the response was sent
+ */
+static void finish_span(sockrpc_server *server, trace_span *span, const char *error,
+                        unsigned long end_ns)
+{
+    span->error = error;
+    span->end_ns = end_ns;
+    trace_exporter_submit(server->tracer, span);
+}
+
+/**
+ * @brief Records a completed request in the thread's flight recorder
+ * @param ring Ring of the calling thread, NULL for threads the server
+ *        does not own, which share one locked ring
+ * @param conn Client connection
+ * @param call Call, with method, dispatch time and request size
+ * @param status How the request ended
+ * @param handler_ns Handler start, 0 if it did not run
+ * @param handler_end_ns Handler end, 0 if it did not run
+ * @param end_ns Response sent
+ * @param response_bytes Response payload length
+ */
+static void record_call(recorder_ring *ring, connection *conn, const call_info *call,
+                        record_status status, unsigned long handler_ns,
+                        unsigned long handler_end_ns, unsigned long end_ns, size_t response_bytes)
+{
+    recorder_sample sample = {
+        .method = call->method,
+        .status = status,
+        .connection = (uint32_t)conn->handle,
+        .worker = (uint8_t)conn->worker->worker_id,
+        .start_ns = call->received_ns,
+        .handler_ns = handler_ns,
+        .handler_end_ns = handler_end_ns,
+        .end_ns = end_ns,
+        .request_bytes = call->request_bytes,
+        .response_bytes = response_bytes};
+    if (ring)
+        recorder_record(ring, &sample);
+    else
+        recorder_record_shared(&conn->worker->server->recorder, &sample);
+}
+
+/**
+ * @brief Sends a call's response and records how the call went
+ * @param server Server context
+ * @param conn Client connection
+ * @param id Request id to echo back (ownership transferred, may be NULL)
+ * @param result Handler result (ownership transferred), used without a response
+ * @param response Fragment response (destroyed here) or NULL
+ * @param call Settings of the answered call
+ * @param handler_ns Handler start
+ * @param handler_end_ns Handler end, or completion of a deferred call
+ * @param ring Flight recorder ring of the calling thread or NULL
+ */
+static void finish_call(sockrpc_server *server, connection *conn, cJSON *id, cJSON *result,
+                        sockrpc_response *response, const call_info *call,
+                        unsigned long handler_ns, unsigned long handler_end_ns,
+                        recorder_ring *ring)
+{
+    const char *error = NULL;
+    size_t sent;
+    if (response && response_valid(response))
+        sent = send_fragments(server, conn, id, response, call);
+    else
+    {
+        error = result ? NULL : "Handler failed";
+        sent = send_response(server, conn, id, result, "Handler failed", call);
+    }
+    sockrpc_response_destroy(response);
+
+    unsigned long end_ns = now_ns();
+    record_call(ring, conn, call, error ? RECORD_FAILED : RECORD_OK, handler_ns, handler_end_ns,
+                end_ns, sent);
+    if (call->span)
+    {
+        call->span->handler_ns = handler_ns;
+        call->span->handler_end_ns = handler_end_ns;
+        finish_span(server, call->span, error, end_ns);
+    }
+}
+
+/**
+ * @brief Runs a call's handler and sends its response
+ * @param server Server context
+ * @param conn Client connection
+ * @param id Request id to echo back (ownership transferred, may be NULL)
+ * @param params Request params
+ * @param call Resolved method with a handler of any kind
+ * @param stream Upload for a stream handler, NULL otherwise
+ * @param ring Flight recorder ring of the calling thread
+ *
+ * The call's trace is the thread's current context while the handler
+ * runs, so client calls made by the handler propagate it. Phase times
+ * are taken for every call, for the flight recorder and the span.
+ */
+static void run_call(sockrpc_server *server, connection *conn, cJSON *id, cJSON *params,
+                     const call_info *call, sockrpc_stream *stream, recorder_ring *ring)
+{
+    if (call->trace.valid)
+        trace_set_current(&call->trace);
+    unsigned long handler_ns = now_ns();
+
+    cJSON *result = NULL;
+    sockrpc_response *response = NULL;
+    if (call->stream_handler)
+        result = call->stream_handler(params, stream);
+    else if (call->response_handler)
+        response = call->response_handler(params);
+    else
+        result = call->handler(params);
+
+    if (call->trace.valid)
+        trace_set_current(NULL);
+    finish_call(server, conn, id, result, response, call, handler_ns, now_ns(), ring);
+}
+
+/**
+ * @brief Starts a deferred call, whose handler completes it later
+ * @param server Server context
+ * @param conn Client connection (called from its I/O worker)
+ * @param id Request id to echo back (ownership transferred, may be NULL)
+ * @param request Parsed request (ownership transferred)
+ * @param call Resolved method with a deferred handler
+ *
+ * The handler may complete the call before returning; neither the
+ * request nor the call may be touched afterwards.
+ */
+static void run_deferred(sockrpc_server *server, connection *conn, cJSON *id, cJSON *request,
+                         const call_info *call)
+{
+    sockrpc_call *deferred = malloc(sizeof(sockrpc_call));
+    if (!deferred)
+    {
+        finish_call(server, conn, id, NULL, NULL, call, 0, 0, conn->worker->ring);
+        cJSON_Delete(request);
+        return;
+    }
+
+    __atomic_add_fetch(&conn->refs, 1, __ATOMIC_RELAXED);
+    deferred->server = server;
+    deferred->conn = conn;
+    deferred->call = *call;
+    deferred->request = request;
+    deferred->id = id;
+    deferred->ring = conn->worker->ring;
+    deferred->thread = pthread_self();
+
+    if (call->trace.valid)
+        trace_set_current(&call->trace);
+    deferred->handler_ns = now_ns();
+    call->deferred_handler(cJSON_GetObjectItem(request, "params"), deferred, call->deferred_ctx);
+    if (call->trace.valid)
+        trace_set_current(NULL);
+}
+
+/**
+ * @brief Answers a deferred call and frees it
+ * @param call Call passed to a deferred handler
+ * @param result Result (ownership transferred) or NULL ("Handler failed")
+ *
+ * Completions on the thread that started the call use its worker's
+ * ring; other threads record into the recorder's shared ring.
+ */
+void sockrpc_call_complete(sockrpc_call *call, cJSON *result)
+{
+    if (!call)
+    {
+        cJSON_Delete(result);
+        return;
+    }
+
+    recorder_ring *ring = pthread_equal(call->thread, pthread_self()) ? call->ring : NULL;
+    finish_call(call->server, call->conn, call->id, result, NULL, &call->call, call->handler_ns,
+                now_ns(), ring);
+    cJSON_Delete(call->request);
+    connection_release(call->conn);
+    free(call);
+}
+
+/**
+ * @brief Queues a request to a worker group
+ * @param group Target worker group
+ * @param job Job to queue (ownership transferred on success)
+ * @return 0 on success, -1 if the group's queue is full
+ *
+ * Groups cannot be created in SOCKRPC_EMBEDDED_ONLY builds, so there
+ * this is never reached and always fails.
+ */
+static int group_enqueue(worker_group *group, group_job *job)
+{
+#ifdef SOCKRPC_EMBEDDED_ONLY
+    (void)group;
+    (void)job;
+    return -1;
+#else
+    pthread_mutex_lock(&group->mutex);
+    if (group->queue_limit && group->queued >= group->queue_limit)
+    {
+        pthread_mutex_unlock(&group->mutex);
+        return -1;
+    }
+
+    __atomic_add_fetch(&job->conn->refs, 1, __ATOMIC_RELAXED);
+    job->next = NULL;
+    if (group->tail)
+        group->tail->next = job;
+    else
+        group->head = job;
+    group->tail = job;
+    group->queued++;
+
+    pthread_cond_signal(&group->cond);
+    pthread_mutex_unlock(&group->mutex);
+    return 0;
+#endif
+}
+
+#ifndef SOCKRPC_EMBEDDED_ONLY
+/**
+ * @brief Worker group thread main function
+ * @param arg Pointer to worker group
+ * @return NULL
+ *
+ * Runs queued jobs in FIFO order and sends their responses. Exits once
+ * the group is stopping and its queue has been drained.
+ */
+static void *group_routine(void *arg)
+{
+    worker_group *group = (worker_group *)arg;
+    recorder_ring *ring =
+        recorder_attach(&group->server->recorder, (uint8_t)(RECORDER_GROUP_THREAD + group->index));
+
+    while (1)
+    {
+        pthread_mutex_lock(&group->mutex);
+        while (!group->head && !group->stopping)
+            pthread_cond_wait(&group->cond, &group->mutex);
+
+        group_job *job = group->head;
+        if (!job)
+        {
+            pthread_mutex_unlock(&group->mutex);
+            break;
+        }
+
+        group->head = job->next;
+        if (!group->head)
+            group->tail = NULL;
+        group->queued--;
+        pthread_mutex_unlock(&group->mutex);
+
+        run_call(group->server, job->conn, job->id, cJSON_GetObjectItem(job->request, "params"),
+                 &job->call, job->stream, ring);
+
+        if (job->stream)
+        {
+            // Chunks still arriving for a handler that returned are discarded
+            stream_end(job->stream, 0);
+            release_stream(job->stream);
+        }
+
+        if (job->call.mod)
+            module_release(job->call.mod);
+        cJSON_Delete(job->request);
+        connection_release(job->conn);
+        free(job);
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Stops a worker group and frees it
+ * @param group Worker group
+ *
+ * Threads finish the jobs already queued before exiting.
+ */
+static void group_destroy(worker_group *group)
+{
+    pthread_mutex_lock(&group->mutex);
+    group->stopping = 1;
+    pthread_cond_broadcast(&group->cond);
+    pthread_mutex_unlock(&group->mutex);
+
+    for (int i = 0; i < group->num_threads; i++)
+    {
+        pthread_join(group->threads[i], NULL);
+    }
+
+    pthread_mutex_destroy(&group->mutex);
+    pthread_cond_destroy(&group->cond);
+    free(group->name);
+    free(group);
+}
+#endif
+
+/**
+ * @brief Finds a worker group by name
+ * @param server Server context (mutex held)
+ * @param name Group name
+ * @return Group index or -1 if there is no such group
+ */
+static int find_group(sockrpc_server *server, const char *name)
+{
+    for (size_t i = 0; i < server->group_count; i++)
+    {
+        if (strcmp(server->groups[i]->name, name) == 0)
+            return (int)i;
+    }
+    return -1;
+}
+
+/**
+ * @brief Finds a registered method by name
+ * @param server Server context (mutex held)
+ * @param name Method name
+ * @return Method index or -1 if not registered
+ */
+static int find_method(sockrpc_server *server, const char *name)
+{
+    for (size_t i = 0; i < server->method_count; i++)
+    {
+        if (strcmp(server->methods[i].name, name) == 0)
+            return (int)i;
+    }
+    return -1;
+}
+
+/**
+ * @brief Returns the metrics entry for a method name, creating it
+ * @param server Server context (mutex held)
+ * @param name Method name
+ * @return Metrics entry or NULL on allocation failure
+ */
+static method_stats *stats_for(sockrpc_server *server, const char *name)
+{
+    for (method_stats *stats = server->stats; stats; stats = stats->next)
+    {
+        if (strcmp(stats->name, name) == 0)
+            return stats;
+    }
+
+    method_stats *stats = calloc(1, sizeof(method_stats));
+    if (!stats || !(stats->name = strdup(name)))
+    {
+        free(stats);
+        return NULL;
+    }
+    stats->next = server->stats;
+    server->stats = stats;
+    return stats;
+}
+
+/**
+ * @brief Appends a method to the method table
+ * @param server Server context (mutex held)
+ * @param name Method name, not yet registered
+ * @return Index of the new entry (handler unset), or -1 if the table is
+ *         full or memory is exhausted
+ */
+static int add_method(sockrpc_server *server, const char *name)
+{
+    if (server->method_count >= MAX_METHODS)
+        return -1;
+
+    method_entry *entry = &server->methods[server->method_count];
+    entry->name = strdup(name);
+    if (!entry->name)
+        return -1;
+
+    entry->handler = NULL;
+    entry->response_handler = NULL;
+    entry->stream_handler = NULL;
+    entry->deferred_handler = NULL;
+    entry->deferred_ctx = NULL;
+    entry->group = -1;
+    entry->mod = NULL;
+    entry->compress_threshold = THRESHOLD_INHERIT;
+    entry->stats = stats_for(server, name);
+    return (int)server->method_count++;
+}
+
+/**
+ * @brief Answers a compression negotiation request
+ * @param server Server context
+ * @param conn Client connection
+ * @param params Negotiation params, see COMPRESS_NEGOTIATE_METHOD
+ * @return Negotiation result
+ *
+ * Picks the first codec offered by the client that this build supports
+ * and uses the server's dictionary if the client has the same one. The
+ * new state takes effect with the next message in each direction; the
+ * response itself is never compressed.
+ */
+static cJSON *negotiate_compression(sockrpc_server *server, connection *conn, cJSON *params)
+{
+    compress_codec codec = COMPRESS_NONE;
+    cJSON *offered = cJSON_GetObjectItem(params, "compression");
+    cJSON *item;
+    cJSON_ArrayForEach(item, offered)
+    {
+        codec = compress_codec_from_name(cJSON_GetStringValue(item));
+        if (codec != COMPRESS_NONE)
+            break;
+    }
+
+    const compress_dict *dict = NULL;
+    cJSON *dict_item = cJSON_GetObjectItem(params, "dictionary");
+    if (codec == COMPRESS_ZSTD && server->compress_dict && cJSON_IsNumber(dict_item) &&
+        (uint32_t)dict_item->valuedouble == compress_dict_id(server->compress_dict))
+        dict = server->compress_dict;
+
+    compress_context *ctx = codec != COMPRESS_NONE ? compress_context_create(codec, dict) : NULL;
+    if (!ctx)
+    {
+        codec = COMPRESS_NONE;
+        dict = NULL;
+    }
+
+    lock_mutex(&conn->write_mutex);
+    compress_context *old = conn->compress;
+    conn->compress = ctx;
+    unlock_mutex(&conn->write_mutex);
+    compress_context_destroy(old);
+
+    cJSON *result = cJSON_CreateObject();
+    cJSON_AddStringToObject(result, "compression", compress_codec_name(codec));
+    cJSON_AddNumberToObject(result, "dictionary", compress_dict_id(dict));
+    return result;
+}
+
+/**
+ * @brief Queues an event to one subscriber and starts sending it
+ * @param subscriber Subscribed connection
+ * @param event Shared event frame
+ * @param policy Overflow policy of the topic
+ * @param ctx Server context
+ * @return Outcome of the push
+ */
+static pubsub_push_result deliver_event(void *subscriber, pubsub_event *event,
+                                        sockrpc_overflow_policy policy, void *ctx)
+{
+    sockrpc_server *server = ctx;
+    connection *conn = subscriber;
+    pubsub_push_result result = PUBSUB_DROPPED;
+
+    lock_mutex(&conn->write_mutex);
+    if (!conn->closed)
+    {
+        result = pubsub_queue_push(&conn->events, event, server->pubsub.queue_limit, policy);
+        flush_output(server, conn);
+    }
+    unlock_mutex(&conn->write_mutex);
+    return result;
+}
+
+/**
+ * @brief Answers a subscribe or unsubscribe request
+ * @param server Server context
+ * @param conn Client connection (called from its I/O worker)
+ * @param subscribe Non-zero to subscribe, zero to unsubscribe
+ * @param params Request params, {"topic": name}
+ * @return {"topic": name, "subscribed": bool}, or NULL if params are
+ *         invalid or memory is exhausted
+ */
+static cJSON *handle_subscription(sockrpc_server *server, connection *conn, int subscribe,
+                                  cJSON *params)
+{
+    const char *topic = cJSON_GetStringValue(cJSON_GetObjectItem(params, "topic"));
+    if (!topic)
+        return NULL;
+
+    if (subscribe)
+    {
+        if (pubsub_subscribe(&server->pubsub, topic, conn) == -1)
+            return NULL;
+        conn->subscribed = 1;
+    }
+    else
+    {
+        pubsub_unsubscribe(&server->pubsub, topic, conn);
+    }
+
+    cJSON *result = cJSON_CreateObject();
+    cJSON_AddStringToObject(result, "topic", topic);
+    cJSON_AddBoolToObject(result, "subscribed", subscribe);
+    return result;
+}
+
+/**
+ * @brief Sets up the trace of a call
+ * @param server Server context
+ * @param call Call to trace
+ * @param request Parsed request
+ * @param method Method name
+ * @param received Monotonic time the request was dispatched
+ *
+ * Incoming context is continued even with tracing off, so traces pass
+ * through servers that do not record spans. With tracing on, requests
+ * without context start a trace, and sampled calls get a span.
+ */
+static void start_trace(sockrpc_server *server, call_info *call, cJSON *request,
+                        const char *method, unsigned long received)
+{
+    trace_context incoming = {0};
+    const char *parent = cJSON_GetStringValue(cJSON_GetObjectItem(request, TRACE_FIELD));
+    if (parent)
+        trace_parse(parent, &incoming);
+    if (!incoming.valid && !server->tracer)
+        return;
+
+    trace_start(&incoming, server->tracer ? trace_exporter_sample_rate(server->tracer) : 0,
+                &call->trace);
+    if (server->tracer && call->trace.sampled)
+        call->span = trace_span_create(&call->trace, method, received);
+}
+
+/**
+ * @brief Dispatches one RPC request and sends the response
+ * @param server Server context
+ * @param conn Client connection
+ * @param buffer NUL-terminated request payload
+ * @param len Length of the request frame's payload
+ *
+ * Processes a single RPC request:
+ * 1. Parses JSON message; upload chunks go to their stream instead
+ * 2. Answers compression negotiation and subscriptions itself
+ * 3. Looks up method handler, its worker group and compression
+ *    settings, and takes a reference to the handler's module so a
+ *    reload cannot unload it while the call runs
+ * 4. Opens the stream of stream handlers and continues or starts the
+ *    request's trace
+ * 5. Queues the request to the group, or executes the handler inline
+ * 6. Sends the result, or an error if the request is malformed, the
+ *    method is unknown, the group's queue is full or the handler
+ *    returned NULL
+ *
+ * @note Handles its own memory management for JSON objects
+ */
+static void dispatch_request(sockrpc_server *server, connection *conn, const char *buffer,
+                             size_t len)
+{
+    unsigned long received = now_ns();
+    cJSON *request = cJSON_Parse(buffer);
+    if (!request)
+    {
+        send_response(server, conn, NULL, NULL, "Invalid request", NULL);
+        return;
+    }
+
+    cJSON *id = cJSON_DetachItemFromObject(request, "id");
+    cJSON *method_item = cJSON_GetObjectItem(request, "method");
+    if (!method_item &&
+        (cJSON_HasObjectItem(request, "chunk") || cJSON_HasObjectItem(request, "end")))
+    {
+        handle_stream_frame(conn, id, request);
+        cJSON_Delete(id);
+        cJSON_Delete(request);
+        return;
+    }
+
+    if (!cJSON_IsString(method_item))
+    {
+        send_response(server, conn, id, NULL, "Invalid request", NULL);
+        cJSON_Delete(request);
+        return;
+    }
+
+    const char *method = method_item->valuestring;
+    cJSON *params = cJSON_GetObjectItem(request, "params");
+
+    if (strcmp(method, COMPRESS_NEGOTIATE_METHOD) == 0)
+    {
+        send_response(server, conn, id, negotiate_compression(server, conn, params), NULL, NULL);
+        cJSON_Delete(request);
+        return;
+    }
+
+    int subscribe = strcmp(method, PUBSUB_SUBSCRIBE_METHOD) == 0;
+    if (subscribe || strcmp(method, PUBSUB_UNSUBSCRIBE_METHOD) == 0)
+    {
+        send_response(server, conn, id, handle_subscription(server, conn, subscribe, params),
+                      "Invalid request", NULL);
+        cJSON_Delete(request);
+        return;
+    }
+
+    call_info call = {.method = method, .received_ns = received, .request_bytes = len};
+    worker_group *group = NULL;
+
+    // Find the handler while holding the lock
+    lock_mutex(&server->mutex);
+    int index = find_method(server, method);
+    if (index != -1)
+    {
+        method_entry *entry = &server->methods[index];
+        call.handler = entry->handler;
+        call.response_handler = entry->response_handler;
+        call.stream_handler = entry->stream_handler;
+        call.deferred_handler = entry->deferred_handler;
+        call.deferred_ctx = entry->deferred_ctx;
+        call.mod = entry->mod;
+        call.stats = entry->stats;
+        call.compress_threshold = entry->compress_threshold == THRESHOLD_INHERIT
+                                      ? server->compress_threshold
+                                      : entry->compress_threshold;
+        if (call.mod)
+            module_acquire(call.mod);
+        if (entry->group != -1)
+            group = server->groups[entry->group];
+    }
+    unlock_mutex(&server->mutex);
+
+    // Only stream handlers accept uploads, and they always run on a group
+    int streaming = cJSON_IsTrue(cJSON_GetObjectItem(request, "stream"));
+    sockrpc_stream *stream = NULL;
+    if (streaming || call.stream_handler)
+    {
+        const char *error = NULL;
+        if (index == -1)
+            error = "Method not found";
+        else if (!call.stream_handler || !group ||
+                 !(stream = open_stream(conn, id, streaming)))
+            error = "Invalid request";
+
+        if (error)
+        {
+            if (call.mod)
+                module_release(call.mod);
+            send_response(server, conn, id, NULL, error, NULL);
+            cJSON_Delete(request);
+            return;
+        }
+    }
+
+    if (index != -1)
+        start_trace(server, &call, request, method, received);
+
+    if (group)
+    {
+        group_job *job = malloc(sizeof(group_job));
+        if (job)
+        {
+            job->conn = conn;
+            job->call = call;
+            job->request = request;
+            job->id = id;
+            job->stream = stream;
+            if (group_enqueue(group, job) == 0)
+                return;
+            free(job);
+        }
+
+        if (stream)
+        {
+            stream_end(stream, 1);
+            if (streaming)
+                unlink_stream(conn, stream);
+            release_stream(stream);
+        }
+        if (call.mod)
+            module_release(call.mod);
+        size_t sent = send_response(server, conn, id, NULL, "Server busy", NULL);
+        unsigned long end_ns = now_ns();
+        record_call(conn->worker->ring, conn, &call, RECORD_BUSY, 0, 0, end_ns, sent);
+        if (call.span)
+            finish_span(server, call.span, "Server busy", end_ns);
+        cJSON_Delete(request);
+        return;
+    }
+
+    // Execute handler outside the critical section
+    if (call.deferred_handler)
+    {
+        run_deferred(server, conn, id, request, &call);
+        return;
+    }
+    if (call.handler || call.response_handler)
+        run_call(server, conn, id, params, &call, NULL, conn->worker->ring);
+    else
+    {
+        size_t sent = send_response(server, conn, id, NULL, "Method not found", NULL);
+        record_call(conn->worker->ring, conn, &call, RECORD_NOT_FOUND, 0, 0, now_ns(), sent);
+    }
+
+    if (call.mod)
+        module_release(call.mod);
+
+    cJSON_Delete(request);
+}
+
+/**
+ * @brief Closes a client connection and updates the worker's counter
+ * @param worker Worker context owning the connection
+ * @param conn Client connection
+ *
+ * Closing the descriptor also removes it from the worker's epoll set.
+ * The connection is freed once queued group jobs have released it.
+ * Its subscriptions end first, so publishers never see it closed.
+ */
+static void close_connection(worker_context *worker, connection *conn)
+{
+    if (conn->subscribed)
+        pubsub_remove_subscriber(&worker->server->pubsub, conn);
+
+    // Handlers waiting for chunks see the upload fail
+    while (conn->streams)
+    {
+        stream_end(conn->streams, 1);
+        unlink_stream(conn, conn->streams);
+    }
+
+    lock_mutex(&worker->mutex);
+    if (conn->prev)
+        conn->prev->next = conn->next;
+    else
+        worker->connections = conn->next;
+    if (conn->next)
+        conn->next->prev = conn->prev;
+    worker->num_connections--;
+    unlock_mutex(&worker->mutex);
+
+    pool_release(&worker->pool, conn->in, conn->in_capacity);
+    conn->in = NULL;
+    slab_retire(&worker->slab, conn->handle);
+
+    lock_mutex(&conn->write_mutex);
+    close(conn->fd);
+    conn->closed = 1;
+    free(conn->out);
+    conn->out = NULL;
+    conn->out_len = 0;
+    conn->out_sent = 0;
+    conn->out_capacity = 0;
+    unlock_mutex(&conn->write_mutex);
+
+    connection_release(conn);
+}
+
+/**
+ * @brief Decompresses a request frame
+ * @param server Server context
+ * @param conn Client connection (called from its I/O worker)
+ * @param payload Compressed payload
+ * @param len Payload length
+ * @param flags Frame flags
+ * @return NUL-terminated request (caller frees) or NULL if the frame
+ *         is invalid
+ */
+static char *decompress_request(sockrpc_server *server, connection *conn, const char *payload,
+                                size_t len, uint32_t flags)
+{
+    char *plain = NULL;
+    size_t plain_len = 0;
+    unsigned long start = now_ns();
+    if (conn->compress && flags == compress_context_codec(conn->compress))
+        plain = compress_decode(conn->compress, payload, len, FRAME_MAX_PAYLOAD, &plain_len);
+
+    if (plain)
+    {
+        __atomic_add_fetch(&server->compressed_requests, 1, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&server->request_raw_bytes, plain_len, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&server->request_wire_bytes, len, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&server->decompress_ns, now_ns() - start, __ATOMIC_RELAXED);
+    }
+    return plain;
+}
+
+/**
+ * @brief Dispatches one received frame
+ * @param server Server context
+ * @param conn Client connection
+ * @param payload Payload followed by one writable byte
+ * @param len Payload length
+ * @param flags Frame flags
+ * @return 0 on success, -1 if the frame is invalid
+ *
+ * The byte after the payload is set to NUL for the parser and restored
+ * afterwards, as it may already hold the start of the next frame.
+ * Captured requests are recorded as the handler will see them, after
+ * decompression.
+ */
+static int dispatch_frame(sockrpc_server *server, connection *conn, char *payload, size_t len,
+                          uint32_t flags)
+{
+    if (flags != 0)
+    {
+        char *plain = decompress_request(server, conn, payload, len, flags);
+        if (!plain)
+            return -1;
+        if (server->capture)
+            capture_request(server->capture, conn->worker->worker_id, conn->handle, plain,
+                            strlen(plain));
+        dispatch_request(server, conn, plain, len);
+        free(plain);
+        return 0;
+    }
+
+    if (server->capture)
+        capture_request(server->capture, conn->worker->worker_id, conn->handle, payload, len);
+
+    char saved = payload[len];
+    payload[len] = '\0';
+    dispatch_request(server, conn, payload, len);
+    payload[len] = saved;
+    return 0;
+}
+
+/**
+ * @brief Makes room in a connection's input buffer
+ * @param pool Worker's buffer pool
+ * @param conn Client connection
+ * @param size Capacity needed
+ * @return 0 on success, -1 on allocation failure
+ *
+ * Moves pending bytes to a buffer of the next fitting size class.
+ */
+static int grow_input(buffer_pool *pool, connection *conn, size_t size)
+{
+    if (conn->in && conn->in_capacity >= size)
+        return 0;
+
+    size_t capacity;
+    char *buffer = pool_acquire(pool, size, &capacity);
+    if (!buffer)
+        return -1;
+
+    if (conn->in)
+    {
+        memcpy(buffer, conn->in, conn->in_len);
+        pool_release(pool, conn->in, conn->in_capacity);
+    }
+    conn->in = buffer;
+    conn->in_capacity = capacity;
+    return 0;
+}
+
+/**
+ * @brief Dispatches the complete frames in a connection's input buffer
+ * @param server Server context
+ * @param conn Client connection
+ * @param needed Set to the buffer size the next frame requires
+ * @return 0 on success, -1 on a malformed frame
+ *
+ * Incomplete data is moved to the start of the buffer. The buffer is
+ * never filled completely, so every complete payload is followed by a
+ * spare byte and can be NUL-terminated in place.
+ *
+ * When more than one request arrived, the connection is corked while
+ * they are dispatched and their responses leave in one write at the
+ * end, or every cork_max_ns for long batches. A lone request is
+ * answered directly, as before.
+ */
+static int consume_input(sockrpc_server *server, connection *conn, size_t *needed)
+{
+    size_t offset = 0;
+    int rc = 0;
+    int corked = 0;
+    unsigned long corked_at = 0;
+    *needed = POOL_MIN_SIZE;
+
+    while (conn->in_len - offset >= FRAME_HEADER_SIZE)
+    {
+        size_t len;
+        uint32_t flags;
+        if (frame_decode_header((unsigned char *)conn->in + offset, &len, &flags) == -1)
+        {
+            rc = -1;
+            break;
+        }
+
+        size_t frame = FRAME_HEADER_SIZE + len;
+        if (conn->in_len - offset < frame)
+        {
+            *needed = frame + 1;
+            break;
+        }
+
+        if (!corked && conn->in_len - offset - frame >= FRAME_HEADER_SIZE)
+        {
+            begin_cork(conn);
+            corked = 1;
+            corked_at = now_ns();
+        }
+        else if (corked && server->cork_max_ns && now_ns() - corked_at >= server->cork_max_ns)
+        {
+            lock_mutex(&conn->write_mutex);
+            flush_cork(server, conn);
+            unlock_mutex(&conn->write_mutex);
+            corked_at = now_ns();
+        }
+
+        if (dispatch_frame(server, conn, conn->in + offset + FRAME_HEADER_SIZE, len, flags) == -1)
+        {
+            rc = -1;
+            break;
+        }
+        offset += frame;
+    }
+
+    if (corked)
+        end_cork(server, conn);
+    if (rc == -1)
+        return -1;
+
+    conn->in_len -= offset;
+    if (offset && conn->in_len)
+        memmove(conn->in, conn->in + offset, conn->in_len);
+    return 0;
+}
+
+/**
+ * @brief Reads and dispatches frames from a stream connection
+ * @param server Server context
+ * @param worker Worker context owning the connection
+ * @param conn Client connection
+ * @return 0 once the socket is drained, -1 to close the connection
+ *
+ * Bytes are appended to the connection's input buffer, which survives
+ * partial frames across wakeups and grows through the pool's size
+ * classes for large ones. A worker never waits for the rest of a frame.
+ */
+static int read_stream(sockrpc_server *server, worker_context *worker, connection *conn)
+{
+    size_t needed = POOL_MIN_SIZE;
+    while (1)
+    {
+        if (grow_input(&worker->pool, conn, needed) == -1)
+            return -1;
+
+        ssize_t n = read(conn->fd, conn->in + conn->in_len, conn->in_capacity - conn->in_len - 1);
+        if (n == 0)
+            return -1;
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+        }
+
+        conn->in_len += n;
+        if (consume_input(server, conn, &needed) == -1)
+            return -1;
+    }
+}
+
+/**
+ * @brief Reads and dispatches packets from a seqpacket connection
+ * @param server Server context
+ * @param worker Worker context owning the connection
+ * @param conn Client connection
+ * @return 0 once the socket is drained, -1 to close the connection
+ *
+ * Each packet is one frame; its size is peeked so it can be received
+ * into a pooled buffer of the right class with a single recv.
+ */
+static int read_packets(sockrpc_server *server, worker_context *worker, connection *conn)
+{
+    while (1)
+    {
+        ssize_t size = recv(conn->fd, NULL, 0, MSG_PEEK | MSG_TRUNC);
+        if (size == 0)
+            return -1;
+        if (size < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+        }
+
+        if (grow_input(&worker->pool, conn, (size_t)size + 1) == -1)
+            return -1;
+
+        size_t len;
+        uint32_t flags;
+        ssize_t n = recv(conn->fd, conn->in, conn->in_capacity, 0);
+        if (n != size || n < FRAME_HEADER_SIZE ||
+            frame_decode_header((unsigned char *)conn->in, &len, &flags) == -1 ||
+            len != (size_t)n - FRAME_HEADER_SIZE)
+            return -1;
+
+        if (dispatch_frame(server, conn, conn->in + FRAME_HEADER_SIZE, len, flags) == -1)
+            return -1;
+    }
+}
+
+/**
+ * @brief Handles pending requests on a client connection
+ * @param server Server context
+ * @param worker Worker context handling the connection
+ * @param conn Client connection
+ * @param events Events reported by epoll
+ *
+ * Receives and dispatches frames until the socket is drained, as
+ * required by edge-triggered epoll. Several pipelined requests that
+ * arrived together are all served in one wakeup. The connection is
+ * closed on EOF, I/O errors, malformed frames and compressed frames
+ * that were not negotiated or fail to decompress.
+ *
+ * Once everything received has been dispatched, the input buffer goes
+ * back to the pool. A hangup or error reported by epoll closes the
+ * connection after the requests that arrived before it were served.
+ * EPOLLOUT, registered while responses or published events are
+ * queued, resumes sending them.
+ */
+static void handle_client_request(sockrpc_server *server, worker_context *worker, connection *conn,
+                                  uint32_t events)
+{
+    if (events & EPOLLOUT)
+    {
+        lock_mutex(&conn->write_mutex);
+        if (!conn->closed)
+            flush_output(server, conn);
+        unlock_mutex(&conn->write_mutex);
+        if (!(events & ~EPOLLOUT))
+            return;
+    }
+
+    int rc = server->address.socktype == SOCK_SEQPACKET ? read_packets(server, worker, conn)
+                                                        : read_stream(server, worker, conn);
+    if (rc == -1 || (events & (EPOLLHUP | EPOLLRDHUP | EPOLLERR)))
+    {
+        close_connection(worker, conn);
+        return;
+    }
+
+    if (conn->in_len == 0)
+    {
+        pool_release(&worker->pool, conn->in, conn->in_capacity);
+        conn->in = NULL;
+        conn->in_capacity = 0;
+    }
+}
+
+/**
+ * @brief Registers an accepted connection with a worker
+ * @param worker Worker that will serve the connection
+ * @param client_fd Accepted, non-blocking client socket
+ *
+ * Applies transport tuning (TCP_NODELAY, keepalive), allocates the
+ * connection context and adds the socket to the worker's epoll set.
+ */
+static void add_connection(worker_context *worker, int client_fd)
+{
+    transport_tune(client_fd);
+
+    uint64_t handle;
+    connection *conn = slab_alloc(&worker->slab, &handle);
+    if (!conn)
+    {
+        close(client_fd);
+        return;
+    }
+    conn->fd = client_fd;
+    conn->handle = handle;
+    conn->worker = worker;
+    conn->refs = 1;
+    pthread_mutex_init(&conn->write_mutex, NULL);
+
+    // Link before epoll can report it: the worker may close it at once
+    lock_mutex(&worker->mutex);
+    conn->next = worker->connections;
+    if (conn->next)
+        conn->next->prev = conn;
+    worker->connections = conn;
+    worker->num_connections++;
+    worker->accepted++;
+    printf("Connection assigned to worker %d (total: %d)\n",
+           worker->worker_id, worker->num_connections);
+    unlock_mutex(&worker->mutex);
+
+    struct epoll_event ev = {
+        .events = EPOLLIN | EPOLLRDHUP | EPOLLET,
+        .data.u64 = handle};
+
+    if (epoll_ctl(worker->epoll_fd, EPOLL_CTL_ADD, client_fd, &ev) == -1)
+        close_connection(worker, conn);
+}
+
+/**
+ * @brief Switches an adopted blocking listener to non-blocking and back
+ * @param server Server context
+ * @param nonblocking 1 before accepting, 0 once done to restore the flag
+ * @return 0 if accept4 will not wait, -1 otherwise
+ *
+ * accept4 has no flag to not wait, and a supervisor sharing the listener
+ * may take a pending connection between poll and accept. O_NONBLOCK is
+ * set only while a batch is accepted, so the shared file description is
+ * blocking again whenever the server is not accepting on it.
+ */
+static int listener_nonblocking(sockrpc_server *server, int nonblocking)
+{
+    if (!server->blocking_listener)
+        return 0;
+
+    int flags = fcntl(server->server_fd, F_GETFL);
+    if (flags == -1)
+        return -1;
+    flags = nonblocking ? flags | O_NONBLOCK : flags & ~O_NONBLOCK;
+    return fcntl(server->server_fd, F_SETFL, flags);
+}
+
+/**
+ * @brief Accepts all pending connections on a listener in a worker's epoll set
+ * @param worker Worker context that will serve the connections
+ * @param listen_fd The worker's own listener, or the server's in embedded mode
+ *
+ * Used with SO_REUSEPORT sharding: the kernel spreads incoming TCP
+ * connections across the workers' listeners. Never waits, even on an
+ * adopted blocking listener, so the host's loop driving an embedded
+ * server is not stalled.
+ */
+static void accept_connections(worker_context *worker, int listen_fd)
+{
+    sockrpc_server *server = worker->server;
+    int adopted = listen_fd == server->server_fd;
+    if (adopted && listener_nonblocking(server, 1) == -1)
+        return;
+
+    while (1)
+    {
+        int client_fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (client_fd < 0)
+        {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            break;
+        }
+
+        add_connection(worker, client_fd);
+    }
+
+    if (adopted)
+        listener_nonblocking(server, 0);
+}
+
+/**
+ * @brief Non-blocking epoll check used while busy-polling
+ */
+typedef struct
+{
+    int epoll_fd;               /**< Worker's epoll instance */
+    struct epoll_event *events; /**< Output array of MAX_EVENTS entries */
+    int nfds;                   /**< Result of the last epoll_wait */
+} epoll_poll;
+
+#ifndef SOCKRPC_EMBEDDED_ONLY
+/**
+ * @brief Checks a worker's epoll set without blocking
+ * @param ctx epoll_poll
+ * @return Non-zero once events arrived or epoll_wait failed
+ */
+static int poll_events(void *ctx)
+{
+    epoll_poll *poll = ctx;
+    poll->nfds = epoll_wait(poll->epoll_fd, poll->events, MAX_EVENTS, 0);
+    return poll->nfds != 0;
+}
+#endif
+
+/**
+ * @brief eventfds of servers dumping on SIGUSR2, stored as fd + 1 (0 is free)
+ *
+ * The signal handler only reads the slots and writes to the descriptors,
+ * both async-signal-safe.
+ */
+static int dump_fds[MAX_DUMP_SERVERS];
+
+/**
+ * @brief SIGUSR2 handler, wakes every server's dumping worker
+ * @param signo Signal number
+ */
+static void dump_signal_handler(int signo)
+{
+    (void)signo;
+    int saved = errno;
+    uint64_t one = 1;
+    for (int i = 0; i < MAX_DUMP_SERVERS; i++)
+    {
+        int slot = __atomic_load_n(&dump_fds[i], __ATOMIC_ACQUIRE);
+        if (slot && write(slot - 1, &one, sizeof(one)) == -1)
+            continue;
+    }
+    errno = saved;
+}
+
+/**
+ * @brief Adds an eventfd to the SIGUSR2 registry, installing the handler once
+ * @param fd eventfd of the server
+ * @return 0 on success, -1 if the registry is full or sigaction fails
+ */
+static int register_dump_fd(int fd)
+{
+    static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+    static int installed;
+
+    pthread_mutex_lock(&lock);
+    int ok = installed;
+    if (!ok)
+    {
+        struct sigaction sa = {.sa_handler = dump_signal_handler, .sa_flags = SA_RESTART};
+        sigemptyset(&sa.sa_mask);
+        ok = installed = sigaction(SIGUSR2, &sa, NULL) == 0;
+    }
+
+    int slot = -1;
+    for (int i = 0; ok && slot == -1 && i < MAX_DUMP_SERVERS; i++)
+    {
+        if (!__atomic_load_n(&dump_fds[i], __ATOMIC_RELAXED))
+        {
+            __atomic_store_n(&dump_fds[i], fd + 1, __ATOMIC_RELEASE);
+            slot = i;
+        }
+    }
+    pthread_mutex_unlock(&lock);
+    return slot == -1 ? -1 : 0;
+}
+
+/**
+ * @brief Removes an eventfd from the SIGUSR2 registry
+ * @param fd eventfd of the server
+ *
+ * The handler stays installed; a signal arriving later finds no slot.
+ */
+static void unregister_dump_fd(int fd)
+{
+    for (int i = 0; i < MAX_DUMP_SERVERS; i++)
+    {
+        int expected = fd + 1;
+        __atomic_compare_exchange_n(&dump_fds[i], &expected, 0, 0, __ATOMIC_RELEASE,
+                                    __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * @brief Writes the flight recorder to the dump path after SIGUSR2
+ * @param server Server context (called from worker 0)
+ */
+static void dump_on_signal(sockrpc_server *server)
+{
+    uint64_t count;
+    if (read(server->dump_fd, &count, sizeof(count)) != sizeof(count))
+        return;
+
+    int written = recorder_dump(&server->recorder, server->dump_path);
+    if (written == -1)
+        printf("Flight recorder dump to %s failed\n", server->dump_path);
+    else
+        printf("Flight recorder dumped %d requests to %s\n", written, server->dump_path);
+}
+
+/**
+ * @brief Destroys a worker's downstream client and frees its slot
+ * @param worker Worker context (called from its thread)
+ * @param slot Slot of the client
+ *
+ * Outstanding calls complete with NULL, unless the client already
+ * failed and completed them.
+ */
+static void drop_downstream(worker_context *worker, int slot)
+{
+    downstream_client *downstream = &worker->downstream[slot];
+    sockrpc_client *client = downstream->client;
+    epoll_ctl(worker->epoll_fd, EPOLL_CTL_DEL, sockrpc_client_fd(client), NULL);
+
+    // Completions may look the address up again; they find no client
+    downstream->client = NULL;
+    sockrpc_client_destroy(client);
+    free(downstream->address);
+    downstream->address = NULL;
+}
+
+/**
+ * @brief Returns a non-blocking client driven by the worker serving a call
+ * @param call Call passed to a deferred handler
+ * @param address Server address to call
+ * @return Client or NULL if it cannot connect or the server is stopping
+ *
+ * Nothing here waits on the network: host names are refused rather than
+ * looked up, and TCP connections complete from the worker's epoll set,
+ * with requests submitted meanwhile written once connected.
+ */
+sockrpc_client *sockrpc_call_client(sockrpc_call *call, const char *address)
+{
+    if (!call || !address || !call->server->running)
+        return NULL;
+
+    worker_context *worker = call->conn->worker;
+    int free_slot = -1;
+    for (int i = 0; i < worker->downstream_count; i++)
+    {
+        downstream_client *downstream = &worker->downstream[i];
+        if (!downstream->client)
+        {
+            if (free_slot == -1)
+                free_slot = i;
+        }
+        else if (strcmp(downstream->address, address) == 0)
+            return downstream->client;
+    }
+
+    if (free_slot == -1 && worker->downstream_count == MAX_DOWNSTREAM)
+        return NULL;
+    int slot = free_slot != -1 ? free_slot : worker->downstream_count;
+
+    transport_address resolved;
+    if (transport_resolve_numeric(address, SOCK_STREAM, &resolved) == -1)
+        return NULL;
+
+    char *copy = strdup(address);
+    sockrpc_client *client = copy ? sockrpc_client_create_nonblocking(address) : NULL;
+    struct epoll_event ev = {.events = EPOLLIN | EPOLLRDHUP, .data.u64 = DOWNSTREAM_HANDLE(slot)};
+    if (!client || epoll_ctl(worker->epoll_fd, EPOLL_CTL_ADD, sockrpc_client_fd(client), &ev) == -1)
+    {
+        if (client)
+            sockrpc_client_destroy(client);
+        free(copy);
+        return NULL;
+    }
+
+    worker->downstream[slot].address = copy;
+    worker->downstream[slot].client = client;
+    worker->downstream[slot].out_armed = 0;
+    if (slot == worker->downstream_count)
+        worker->downstream_count++;
+    return client;
+}
+
+/**
+ * @brief Queues a downstream call carrying the trace of a deferred call
+ * @param call Deferred call the downstream call serves
+ * @param client Client from sockrpc_call_client
+ * @param method Method name
+ * @param params Parameters (ownership transferred)
+ * @param callback Receives the result, may be NULL
+ * @param ctx Passed to callback
+ * @return 0 on success, -1 on error
+ *
+ * Completion callbacks run outside the handler, where the thread has no
+ * current trace; the call's own context is made current for the submit
+ * and the thread's previous one restored afterwards.
+ */
+int sockrpc_call_submit(sockrpc_call *call, sockrpc_client *client, const char *method,
+                        cJSON *params, sockrpc_completion_callback callback, void *ctx)
+{
+    if (!call)
+    {
+        cJSON_Delete(params);
+        return -1;
+    }
+
+    trace_context previous = *trace_current();
+    if (call->call.trace.valid)
+        trace_set_current(&call->call.trace);
+    int rc = sockrpc_client_submit(client, method, params, callback, ctx);
+    if (call->call.trace.valid)
+        trace_set_current(previous.valid ? &previous : NULL);
+    return rc;
+}
+
+/**
+ * @brief Reads and writes a downstream client that epoll reported ready
+ * @param worker Worker context (called from its thread)
+ * @param slot Slot of the client
+ * @param events Events reported for its socket
+ *
+ * Completions run here, on the worker, and may answer deferred calls.
+ */
+static void handle_downstream(worker_context *worker, int slot, uint32_t events)
+{
+    sockrpc_client *client = worker->downstream[slot].client;
+    if (!client)
+        return;
+
+    int rc = 0;
+    if (events & EPOLLOUT)
+        rc = sockrpc_client_on_writable(client);
+    if (rc != -1 && (events & ~EPOLLOUT))
+        rc = sockrpc_client_on_readable(client);
+    if (rc == -1)
+        drop_downstream(worker, slot);
+}
+
+/**
+ * @brief Writes requests handlers submitted on downstream clients
+ * @param worker Worker context (called from its thread)
+ *
+ * Runs after each batch of events, so calls submitted while serving it
+ * leave in one write per client. EPOLLOUT stays registered only while a
+ * client's socket is full.
+ */
+static void flush_downstream(worker_context *worker)
+{
+    for (int i = 0; i < worker->downstream_count; i++)
+    {
+        downstream_client *downstream = &worker->downstream[i];
+        if (!downstream->client)
+            continue;
+
+        int rc = 0;
+        if (sockrpc_client_wants_write(downstream->client))
+            rc = sockrpc_client_on_writable(downstream->client);
+        if (rc == -1)
+        {
+            drop_downstream(worker, i);
+            continue;
+        }
+        if (rc == downstream->out_armed)
+            continue;
+
+        struct epoll_event ev = {.events = EPOLLIN | EPOLLRDHUP | (rc ? EPOLLOUT : 0),
+                                 .data.u64 = DOWNSTREAM_HANDLE(i)};
+        if (epoll_ctl(worker->epoll_fd, EPOLL_CTL_MOD, sockrpc_client_fd(downstream->client),
+                      &ev) == 0)
+            downstream->out_armed = rc;
+    }
+}
+
+/**
+ * @brief Handles the events returned by one epoll_wait on a worker's set
+ * @param server Server context
+ * @param worker Worker context owning the epoll set
+ * @param events Events
+ * @param nfds Number of events
+ */
+static void handle_events(sockrpc_server *server, worker_context *worker,
+                          const struct epoll_event *events, int nfds)
+{
+    for (int i = 0; i < nfds; i++)
+    {
+        // Handle 0 is the worker's listener, stale handles are skipped
+        uint64_t handle = events[i].data.u64;
+        if (handle == WAKE_HANDLE)
+            continue;
+        if (handle == DUMP_HANDLE)
+        {
+            dump_on_signal(server);
+            continue;
+        }
+        if (handle > DOWNSTREAM_HANDLE(MAX_DOWNSTREAM))
+        {
+            handle_downstream(worker, (int)(DOWNSTREAM_HANDLE(0) - handle), events[i].events);
+            continue;
+        }
+
+        connection *conn = handle ? slab_lookup(&worker->slab, handle) : NULL;
+        if (!handle)
+        {
+            accept_connections(worker, server->embedded ? server->server_fd : worker->listen_fd);
+        }
+        else if (conn)
+            handle_client_request(server, worker, conn, events[i].events);
+    }
+
+    if (worker->downstream_count)
+        flush_downstream(worker);
+}
+
+#ifndef SOCKRPC_EMBEDDED_ONLY
+/**
+ * @brief Worker thread main function
+ * @param arg Pointer to worker context
+ * @return NULL
+ *
+ * Main loop for worker threads:
+ * 1. Waits for events using epoll, spinning on it first when
+ *    busy-polling is enabled
+ * 2. Accepts connections on its own listener (TCP)
+ * 3. Handles client requests
+ * 4. Manages connection lifecycle
+ *
+ * Blocks in epoll_wait without a timeout; the server's wake_fd becomes
+ * readable in every worker's epoll set on shutdown.
+ *
+ * @note Runs until server->running becomes false
+ */
+static void *worker_routine(void *arg)
+{
+    worker_context *worker = (worker_context *)arg;
+    sockrpc_server *server = worker->server;
+    struct epoll_event events[MAX_EVENTS];
+
+    printf("Worker %d started\n", worker->worker_id);
+
+    while (server->running)
+    {
+        epoll_poll poll = {worker->epoll_fd, events, 0};
+        if (worker->spin.max_ns)
+            spin_wait(&worker->spin, poll_events, &poll);
+
+        int nfds = poll.nfds;
+        if (nfds == 0)
+            nfds = epoll_wait(worker->epoll_fd, events, MAX_EVENTS, -1);
+        if (nfds == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+
+        handle_events(server, worker, events, nfds);
+    }
+
+    printf("Worker %d shutting down (handled %lu connections, %d open)\n",
+           worker->worker_id, worker->accepted, worker->num_connections);
+    return NULL;
+}
+
+/**
+ * @brief Acceptor thread main function
+ * @param arg Pointer to server context
+ * @return NULL
+ *
+ * Accepts new client connections and distributes them to workers:
+ * 1. Waits until the listener or the server's wake_fd is readable
+ * 2. Accepts all pending connections without waiting
+ * 3. Selects worker thread
+ * 4. Adds to worker's epoll set
+ *
+ * @note Runs until server->running becomes false
+ */
+static void *acceptor_routine(void *arg)
+{
+    sockrpc_server *server = (sockrpc_server *)arg;
+    struct pollfd fds[2] = {
+        {.fd = server->server_fd, .events = POLLIN},
+        {.fd = server->wake_fd, .events = POLLIN}};
+
+    printf("Acceptor started\n");
+
+    while (server->running)
+    {
+        if (poll(fds, 2, -1) == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        if (fds[1].revents || (fds[0].revents & (POLLERR | POLLHUP | POLLNVAL)))
+            break;
+
+        // Another process may have taken the connection since poll returned
+        if (listener_nonblocking(server, 1) == -1)
+            break;
+
+        int client_fd;
+        while ((client_fd = accept4(server->server_fd, NULL, NULL,
+                                    SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0)
+        {
+            // Select worker using round-robin
+            add_connection(select_worker(server), client_fd);
+        }
+        int error = errno;
+        listener_nonblocking(server, 0);
+        if (error != EAGAIN && error != EWOULDBLOCK && error != EINTR && error != ECONNABORTED)
+            break;
+    }
+
+    printf("Acceptor shutting down\n");
+    return NULL;
+}
+#endif
+
+/**
+ * @brief Creates a new RPC server instance
+ * @param socket_path Path where the Unix domain socket will be created
+ * @return Pointer to server context or NULL on error
  *
  * This function initializes a new server instance with:
  * - A worker thread pool
@@ -389,93 +2734,792 @@ static void *acceptor_routine(void *arg)
  *
  * @note Caller must call sockrpc_server_destroy() to clean up
  */
-sockrpc_server *sockrpc_server_create(const char *socket_path)
+sockrpc_server *sockrpc_server_create(const char *socket_path)
+{
+    sockrpc_server *server = calloc(1, sizeof(sockrpc_server));
+    if (!server)
+        return NULL;
+
+    server->socket_path = strdup(socket_path);
+    server->server_fd = -1;
+    server->owns_socket = 0;
+    server->socket_type = SOCKRPC_SOCK_STREAM;
+    server->method_count = 0;
+    server->running = 0;
+    server->next_worker = 0;
+    server->compress_threshold = SOCKRPC_COMPRESS_THRESHOLD;
+    server->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    pubsub_init(&server->pubsub);
+    server->cork_max_ns = CORK_MAX_NS;
+    recorder_init(&server->recorder);
+    server->dump_fd = -1;
+    pthread_mutex_init(&server->mutex, NULL);
+    pthread_mutex_init(&server->lb_mutex, NULL);
+
+    // Initialize worker contexts
+    for (int i = 0; i < NUM_WORKERS; i++)
+    {
+        // Level-triggered and never read, so every worker sees the wakeup
+        struct epoll_event ev = {.events = EPOLLIN, .data.u64 = WAKE_HANDLE};
+        server->workers[i].worker_id = i;
+        server->workers[i].server = server;
+        server->workers[i].num_connections = 0;
+        server->workers[i].epoll_fd = epoll_create1(0);
+        epoll_ctl(server->workers[i].epoll_fd, EPOLL_CTL_ADD, server->wake_fd, &ev);
+        server->workers[i].listen_fd = -1;
+        server->workers[i].accepted = 0;
+        spin_init(&server->workers[i].spin, 0);
+        pool_init(&server->workers[i].pool);
+        slab_init(&server->workers[i].slab, sizeof(connection));
+        pthread_mutex_init(&server->workers[i].mutex, NULL);
+    }
+
+    return server;
+}
+
+/**
+ * @brief Returns a listening socket inherited from a supervisor, if any
+ * @return Inherited listening socket or -1 if none was passed
+ *
+ * Implements the receiving side of the LISTEN_FDS activation protocol:
+ * the socket is only taken when LISTEN_PID names this process, and the
+ * variables are cleared so that child processes do not inherit them.
+ * Only the first passed descriptor is used.
+ */
+static int inherited_listen_fd(void)
+{
+    const char *pid_str = getenv("LISTEN_PID");
+    const char *fds_str = getenv("LISTEN_FDS");
+    if (!pid_str || !fds_str)
+        return -1;
+
+    if (strtol(pid_str, NULL, 10) != (long)getpid() || strtol(fds_str, NULL, 10) < 1)
+        return -1;
+
+    unsetenv("LISTEN_PID");
+    unsetenv("LISTEN_FDS");
+    unsetenv("LISTEN_FDNAMES");
+
+    int flags = fcntl(LISTEN_FDS_START, F_GETFD);
+    if (flags == -1)
+        return -1;
+    fcntl(LISTEN_FDS_START, F_SETFD, flags | FD_CLOEXEC);
+
+    return LISTEN_FDS_START;
+}
+
+#ifndef SOCKRPC_EMBEDDED_ONLY
+/**
+ * @brief Launches the worker pool and acceptor on server->server_fd
+ * @param server Server context with a listening server_fd
+ */
+static void start_threads(sockrpc_server *server)
+{
+    server->running = 1;
+    server->started = 1;
+
+    // Rings are attached before the threads exist, so readers never race their setup
+    for (int i = 0; i < NUM_WORKERS; i++)
+    {
+        worker_context *worker = &server->workers[i];
+        worker->ring = recorder_attach(&server->recorder, (uint8_t)worker->worker_id);
+        pthread_create(&server->worker_threads[i], NULL, worker_routine, worker);
+    }
+
+    // Sharded TCP listeners are accepted on by the workers themselves
+    if (server->server_fd == -1)
+        return;
+
+    pthread_create(&server->acceptor_thread, NULL, acceptor_routine, server);
+}
+
+/**
+ * @brief Creates one SO_REUSEPORT TCP listener per worker
+ * @param server Server context with a resolved TCP address
+ * @return 0 on success, -1 on error (all listeners closed)
+ *
+ * Each listener is added to its worker's epoll set with data 0, which
+ * no connection handle uses. If the address uses port 0, the first
+ * bind picks the port and the others reuse it.
+ */
+static int start_tcp_listeners(sockrpc_server *server)
+{
+    for (int i = 0; i < NUM_WORKERS; i++)
+    {
+        worker_context *worker = &server->workers[i];
+        worker->listen_fd = transport_listen(&server->address, 1);
+
+        struct epoll_event ev = {
+            .events = EPOLLIN,
+            .data.u64 = 0};
+
+        if (worker->listen_fd == -1 ||
+            epoll_ctl(worker->epoll_fd, EPOLL_CTL_ADD, worker->listen_fd, &ev) == -1)
+        {
+            for (int j = 0; j <= i; j++)
+            {
+                if (server->workers[j].listen_fd != -1)
+                    close(server->workers[j].listen_fd);
+                server->workers[j].listen_fd = -1;
+            }
+            return -1;
+        }
+    }
+
+    return 0;
+}
+#endif
+
+/**
+ * @brief Starts the RPC server
+ * @param server Server context
+ *
+ * Server startup process:
+ * 1. Uses a listening socket inherited through LISTEN_FDS, if present
+ * 2. Otherwise resolves the socket path or URL
+ * 3. For TCP: creates one SO_REUSEPORT listener per worker
+ * 4. For Unix: creates a non-blocking socket of the configured type
+ *    (stream or seqpacket), binds it and starts listening
+ * 5. Launches worker threads
+ * 6. Starts acceptor thread (Unix only)
+ *
+ * Error handling:
+ * - Returns silently on socket creation failure
+ * - Returns silently on bind failure
+ * - Returns silently on listen failure
+ * - Does nothing in SOCKRPC_EMBEDDED_ONLY builds
+ * - Existing socket file is removed before binding (filesystem paths only)
+ *
+ * Thread safety:
+ * - Not thread-safe
+ * - Must be called only once
+ * - Must be called before any client connections
+ *
+ * Resource management:
+ * - Creates NUM_WORKERS threads
+ * - Creates acceptor thread for Unix sockets
+ * - Manages worker thread lifecycle
+ *
+ * @note Server continues running until sockrpc_server_destroy() is called
+ */
+void sockrpc_server_start(sockrpc_server *server)
+{
+#ifdef SOCKRPC_EMBEDDED_ONLY
+    // Without locks the server may only run on the application's thread
+    (void)server;
+#else
+    int inherited_fd = inherited_listen_fd();
+    if (inherited_fd != -1)
+    {
+        sockrpc_server_start_from_fd(server, inherited_fd);
+        return;
+    }
+
+    int type = server->socket_type == SOCKRPC_SOCK_SEQPACKET ? SOCK_SEQPACKET : SOCK_STREAM;
+    if (transport_resolve(server->socket_path, type, &server->address) == -1)
+        return;
+
+    if (server->address.kind == TRANSPORT_TCP)
+    {
+        if (start_tcp_listeners(server) == -1)
+            return;
+
+        start_threads(server);
+        return;
+    }
+
+    server->server_fd = transport_listen(&server->address, 0);
+    if (server->server_fd == -1)
+        return;
+
+    server->owns_socket = !server->address.abstract;
+    start_threads(server);
+#endif
+}
+
+/**
+ * @brief Takes over an already listening socket as the server's listener
+ * @param server Server context
+ * @param listen_fd Bound and listening socket
+ * @return 0 on success, -1 if listen_fd is not a listening socket
+ */
+static int adopt_listener(sockrpc_server *server, int listen_fd)
+{
+    int listening = 0;
+    socklen_t len = sizeof(listening);
+    if (getsockopt(listen_fd, SOL_SOCKET, SO_ACCEPTCONN, &listening, &len) == -1 || !listening)
+        return -1;
+
+    int type = SOCK_STREAM;
+    len = sizeof(type);
+    if (getsockopt(listen_fd, SOL_SOCKET, SO_TYPE, &type, &len) == -1)
+        return -1;
+
+    // The file description may be shared with a supervisor that accepts
+    // on it too, so a blocking one is only made non-blocking while accepting
+    int flags = fcntl(listen_fd, F_GETFL);
+    if (flags == -1)
+        return -1;
+
+    server->socket_type = type == SOCK_SEQPACKET ? SOCKRPC_SOCK_SEQPACKET : SOCKRPC_SOCK_STREAM;
+    server->address.socktype = type;
+    server->server_fd = listen_fd;
+    server->owns_socket = 0;
+    server->blocking_listener = !(flags & O_NONBLOCK);
+    return 0;
+}
+
+/**
+ * @brief Starts the RPC server on an already listening socket
+ * @param server Server context
+ * @param listen_fd Bound and listening socket
+ * @return 0 on success, -1 on error
+ *
+ * Startup process:
+ * 1. Verifies listen_fd is a listening socket (SO_ACCEPTCONN)
+ * 2. Takes the socket type (stream or seqpacket) from SO_TYPE
+ * 3. Launches worker threads and acceptor thread
+ *
+ * The descriptor's file status flags are not changed. A blocking
+ * listener is accepted on once per poll wakeup instead of until EAGAIN.
+ *
+ * Connections queued in the kernel backlog before this call are
+ * accepted as soon as the acceptor starts.
+ *
+ * Resource management:
+ * - Server takes ownership of listen_fd and closes it on destroy
+ * - The socket file is not unlinked, it belongs to whoever bound it
+ */
+int sockrpc_server_start_from_fd(sockrpc_server *server, int listen_fd)
+{
+#ifdef SOCKRPC_EMBEDDED_ONLY
+    (void)server;
+    (void)listen_fd;
+    return -1;
+#else
+    if (!server || listen_fd < 0 || server->started || adopt_listener(server, listen_fd) == -1)
+        return -1;
+
+    start_threads(server);
+    return 0;
+#endif
+}
+
+/**
+ * @brief Starts the server without threads, driven by sockrpc_server_process
+ * @param server Server context
+ * @return 0 on success, -1 on error
+ *
+ * Opens the listener like sockrpc_server_start() (a single one for
+ * TCP) and adds it to worker 0's epoll set, which then holds every
+ * connection. That epoll descriptor is what the application polls.
+ */
+int sockrpc_server_start_embedded(sockrpc_server *server)
+{
+    if (!server || server->started)
+        return -1;
+
+    int inherited_fd = inherited_listen_fd();
+    if (inherited_fd != -1)
+    {
+        if (adopt_listener(server, inherited_fd) == -1)
+            return -1;
+    }
+    else
+    {
+        int type = server->socket_type == SOCKRPC_SOCK_SEQPACKET ? SOCK_SEQPACKET : SOCK_STREAM;
+        if (transport_resolve(server->socket_path, type, &server->address) == -1)
+            return -1;
+
+        server->server_fd = transport_listen(&server->address, 0);
+        if (server->server_fd == -1)
+            return -1;
+        server->owns_socket = server->address.kind == TRANSPORT_UNIX && !server->address.abstract;
+    }
+
+    struct epoll_event ev = {.events = EPOLLIN, .data.u64 = 0};
+    if (epoll_ctl(server->workers[0].epoll_fd, EPOLL_CTL_ADD, server->server_fd, &ev) == -1)
+        return -1;
+
+    server->workers[0].ring = recorder_attach(&server->recorder, 0);
+    server->running = 1;
+    server->started = 1;
+    server->embedded = 1;
+    return 0;
+}
+
+/**
+ * @brief Returns the descriptor an embedding application polls
+ * @param server Server context started with sockrpc_server_start_embedded
+ * @return epoll descriptor, readable while there is work, or -1
+ */
+int sockrpc_server_get_fd(sockrpc_server *server)
+{
+    if (!server || !server->embedded)
+        return -1;
+
+    return server->workers[0].epoll_fd;
+}
+
+/**
+ * @brief Accepts, reads, dispatches and writes without blocking
+ * @param server Server context started with sockrpc_server_start_embedded
+ * @param max_events Most ready descriptors to handle, at least 1
+ * @return Number of events handled (0 if there was no work), -1 on error
+ *
+ * Handlers run on the calling thread. Each connection event is handled
+ * as on a worker thread: every request that has arrived is served, so
+ * max_events bounds the connections served per call rather than the
+ * requests. Events left over stay ready and keep the descriptor
+ * readable.
+ */
+int sockrpc_server_process(sockrpc_server *server, int max_events)
+{
+    if (!server || !server->embedded || max_events < 1)
+        return -1;
+
+    worker_context *worker = &server->workers[0];
+
+    struct epoll_event events[MAX_EVENTS];
+    int handled = 0;
+    while (handled < max_events)
+    {
+        int batch = max_events - handled < MAX_EVENTS ? max_events - handled : MAX_EVENTS;
+        int nfds = epoll_wait(worker->epoll_fd, events, batch, 0);
+        if (nfds == -1 && errno == EINTR)
+            continue;
+        if (nfds == -1)
+            return handled ? handled : -1;
+
+        handle_events(server, worker, events, nfds);
+        handled += nfds;
+        if (nfds < batch)
+            break;
+    }
+    return handled;
+}
+
+/**
+ * @brief Enables adaptive busy-polling on the I/O workers
+ * @param server Server context
+ * @param spin_us Longest spin before blocking in epoll_wait, 0 to disable
+ * @return 0 on success, -1 if the server has started
+ */
+int sockrpc_server_set_busy_poll(sockrpc_server *server, unsigned int spin_us)
+{
+    if (!server || server->started)
+        return -1;
+
+    for (int i = 0; i < NUM_WORKERS; i++)
+    {
+        spin_init(&server->workers[i].spin, spin_us * 1000ul);
+    }
+    return 0;
+}
+
+/**
+ * @brief Sets how long a batch of pipelined requests is corked
+ * @param server Server context
+ * @param max_us Longest time responses are collected, 0 for no limit
+ * @return 0 on success, -1 if the server has started
+ */
+int sockrpc_server_set_cork_deadline(sockrpc_server *server, unsigned int max_us)
+{
+    if (!server || server->started)
+        return -1;
+
+    server->cork_max_ns = max_us * 1000ul;
+    return 0;
+}
+
+/**
+ * @brief Selects the socket type used by sockrpc_server_start()
+ * @param server Server context
+ * @param type SOCKRPC_SOCK_STREAM or SOCKRPC_SOCK_SEQPACKET
+ *
+ * Has no effect once the server is running.
+ */
+void sockrpc_server_set_socket_type(sockrpc_server *server, sockrpc_socket_type type)
+{
+    if (!server || server->started)
+        return;
+
+    server->socket_type = type;
+}
+
+/**
+ * @brief Creates a named worker group and starts its threads
+ * @param server Server context
+ * @param name Group name
+ * @param config Thread count, CPU set and queue limit
+ * @return 0 on success, -1 on error
+ *
+ * Threads are pinned to config->cpus at creation when a CPU set is
+ * given, so creating the group fails if a listed CPU is not usable.
+ *
+ * Thread safety:
+ * - Thread-safe, can be called before or after server start
+ */
+int sockrpc_server_add_group(sockrpc_server *server, const char *name,
+                             const sockrpc_group_config *config)
+{
+#ifdef SOCKRPC_EMBEDDED_ONLY
+    (void)server;
+    (void)name;
+    (void)config;
+    return -1;
+#else
+    if (!server || !name || !config || config->threads < 1 ||
+        config->threads > MAX_GROUP_THREADS || (config->num_cpus && !config->cpus))
+        return -1;
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    if (config->num_cpus)
+    {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        for (size_t i = 0; i < config->num_cpus; i++)
+        {
+            if (config->cpus[i] < 0 || config->cpus[i] >= CPU_SETSIZE)
+            {
+                pthread_attr_destroy(&attr);
+                return -1;
+            }
+            CPU_SET(config->cpus[i], &cpus);
+        }
+        pthread_attr_setaffinity_np(&attr, sizeof(cpus), &cpus);
+    }
+
+    worker_group *group = calloc(1, sizeof(worker_group));
+    if (!group || !(group->name = strdup(name)))
+    {
+        free(group);
+        pthread_attr_destroy(&attr);
+        return -1;
+    }
+    group->queue_limit = config->queue_limit;
+    group->server = server;
+    pthread_mutex_init(&group->mutex, NULL);
+    pthread_cond_init(&group->cond, NULL);
+
+    lock_mutex(&server->mutex);
+    int ok = server->group_count < MAX_GROUPS && find_group(server, name) == -1;
+    group->index = (int)server->group_count;
+    for (int i = 0; ok && i < config->threads; i++)
+    {
+        if (pthread_create(&group->threads[i], &attr, group_routine, group) != 0)
+            ok = 0;
+        else
+            group->num_threads++;
+    }
+
+    if (ok)
+        server->groups[server->group_count++] = group;
+    unlock_mutex(&server->mutex);
+    pthread_attr_destroy(&attr);
+
+    if (!ok)
+    {
+        group_destroy(group);
+        return -1;
+    }
+    return 0;
+#endif
+}
+
+/**
+ * @brief Registers a method with either kind of handler
+ * @param server Server context
+ * @param name Method name to register
+ * @param handler JSON handler, or NULL
+ * @param response_handler Fragment handler, or NULL
+ * @param stream_handler Upload handler, or NULL
+ * @param deferred_handler Deferred handler, or NULL
+ * @param deferred_ctx Passed to the deferred handler
+ * @param group Worker group name, or NULL to run on the I/O workers
+ * @return 0 on success, -1 on error
+ *
+ * Re-registering a method replaces both its handler and its group;
+ * its compression threshold is kept.
+ */
+static int register_method(sockrpc_server *server, const char *name, rpc_handler handler,
+                           rpc_response_handler response_handler,
+                           rpc_stream_handler stream_handler,
+                           rpc_deferred_handler deferred_handler, void *deferred_ctx,
+                           const char *group)
+{
+
+    lock_mutex(&server->mutex);
+
+    int group_index = group ? find_group(server, group) : -1;
+    if (group && group_index == -1)
+    {
+        unlock_mutex(&server->mutex);
+        return -1;
+    }
+
+    int i = find_method(server, name);
+    if (i == -1)
+        i = add_method(server, name);
+    if (i == -1)
+    {
+        unlock_mutex(&server->mutex);
+        return -1;
+    }
+
+    server->methods[i].handler = handler;
+    server->methods[i].response_handler = response_handler;
+    server->methods[i].stream_handler = stream_handler;
+    server->methods[i].deferred_handler = deferred_handler;
+    server->methods[i].deferred_ctx = deferred_ctx;
+    server->methods[i].group = group_index;
+    server->methods[i].mod = NULL;
+
+    unlock_mutex(&server->mutex);
+    return 0;
+}
+
+/**
+ * @brief Registers an RPC method, optionally bound to a worker group
+ * @param server Server context
+ * @param name Method name to register
+ * @param handler Function pointer to method implementation
+ * @param group Worker group name, or NULL to run on the I/O workers
+ * @return 0 on success, -1 on error
+ */
+int sockrpc_server_register_in_group(sockrpc_server *server, const char *name,
+                                     rpc_handler handler, const char *group)
 {
-    sockrpc_server *server = calloc(1, sizeof(sockrpc_server));
-    if (!server)
-        return NULL;
+    if (!server || !name || !handler)
+        return -1;
 
-    server->socket_path = strdup(socket_path);
-    server->method_count = 0;
-    server->running = 0;
-    server->next_worker = 0;
-    pthread_mutex_init(&server->mutex, NULL);
-    pthread_mutex_init(&server->lb_mutex, NULL);
+    return register_method(server, name, handler, NULL, NULL, NULL, NULL, group);
+}
 
-    // Initialize worker contexts
-    for (int i = 0; i < NUM_WORKERS; i++)
+/**
+ * @brief Registers an RPC method whose handler returns fragments
+ * @param server Server context
+ * @param name Method name to register
+ * @param handler Handler building a sockrpc_response
+ * @param group Worker group name, or NULL to run on the I/O workers
+ * @return 0 on success, -1 on error
+ */
+int sockrpc_server_register_response(sockrpc_server *server, const char *name,
+                                     rpc_response_handler handler, const char *group)
+{
+    if (!server || !name || !handler)
+        return -1;
+
+    return register_method(server, name, NULL, handler, NULL, NULL, NULL, group);
+}
+
+/**
+ * @brief Registers a method receiving a client-streaming upload
+ * @param server Server context
+ * @param name Method name to register
+ * @param handler Handler pulling the uploaded chunks
+ * @param group Worker group name, required since handlers block
+ * @return 0 on success, -1 on error
+ */
+int sockrpc_server_register_stream(sockrpc_server *server, const char *name,
+                                   rpc_stream_handler handler, const char *group)
+{
+    if (!server || !name || !handler || !group)
+        return -1;
+
+    return register_method(server, name, NULL, NULL, handler, NULL, NULL, group);
+}
+
+/**
+ * @brief Registers a method whose handler completes calls later
+ * @param server Server context
+ * @param name Method name to register
+ * @param handler Handler starting the call
+ * @param ctx Passed to every invocation of handler
+ * @return 0 on success, -1 on error
+ */
+int sockrpc_server_register_deferred(sockrpc_server *server, const char *name,
+                                     rpc_deferred_handler handler, void *ctx)
+{
+    if (!server || !name || !handler)
+        return -1;
+
+    return register_method(server, name, NULL, NULL, NULL, handler, ctx, NULL);
+}
+
+/**
+ * @brief Checks whether a module's table exports a method
+ * @param mod Module, may be NULL
+ * @param name Method name
+ * @return 1 if exported, 0 otherwise
+ */
+static int module_exports(const module *mod, const char *name)
+{
+    for (const rpc_method *m = mod ? mod->methods : NULL; m && m->name; m++)
     {
-        server->workers[i].worker_id = i;
-        server->workers[i].num_connections = 0;
-        server->workers[i].epoll_fd = epoll_create1(0);
-        pthread_mutex_init(&server->workers[i].mutex, NULL);
+        if (strcmp(m->name, name) == 0)
+            return 1;
     }
+    return 0;
+}
 
-    return server;
+/**
+ * @brief Removes the methods provided by a module from the method table
+ * @param server Server context (mutex held)
+ * @param mod Module whose methods to remove
+ * @param keep Module whose exported names are kept, or NULL
+ *
+ * Only entries mod installed are removed: a name registered again after
+ * the module was loaded belongs to its new owner. Methods also exported
+ * by keep stay in place so that a reload
+ * preserves their group binding and compression threshold; they are
+ * rebound by the caller.
+ */
+static void remove_module_methods(sockrpc_server *server, module *mod, module *keep)
+{
+    size_t out = 0;
+    for (size_t i = 0; i < server->method_count; i++)
+    {
+        if (server->methods[i].mod == mod && !module_exports(keep, server->methods[i].name))
+        {
+            free(server->methods[i].name);
+            continue;
+        }
+
+        server->methods[out++] = server->methods[i];
+    }
+    server->method_count = out;
 }
 
 /**
- * @brief Starts the RPC server
+ * @brief Finds an installed module by the path it was loaded from
+ * @param server Server context (mutex held)
+ * @param path Module path
+ * @return Module index or -1 if not loaded
+ */
+static int find_module(sockrpc_server *server, const char *path)
+{
+    for (size_t i = 0; i < server->module_count; i++)
+    {
+        if (strcmp(server->modules[i]->path, path) == 0)
+            return (int)i;
+    }
+    return -1;
+}
+
+/**
+ * @brief Loads or reloads a handler module
  * @param server Server context
+ * @param path Path to the shared object
+ * @return 0 on success, -1 on error
  *
- * Server startup process:
- * 1. Creates non-blocking Unix domain socket
- * 2. Binds to specified path
- * 3. Starts listening for connections
- * 4. Launches worker threads
- * 5. Starts acceptor thread
- *
- * Error handling:
- * - Returns silently on socket creation failure
- * - Returns silently on bind failure
- * - Returns silently on listen failure
- * - Existing socket file is removed before binding
- *
- * Thread safety:
- * - Not thread-safe
- * - Must be called only once
- * - Must be called before any client connections
- *
- * Resource management:
- * - Creates NUM_WORKERS threads
- * - Creates detached acceptor thread
- * - Manages worker thread lifecycle
+ * Reload process:
+ * 1. Loads a private instance of the new version (outside the lock)
+ * 2. Checks that the method and module tables have room
+ * 3. Removes methods only the old version exported
+ * 4. Points every exported method at the new version, except those
+ *    registered by the application over the old version since
+ * 5. Drops the server's reference to the old version, which is
+ *    unloaded when the calls still running on it return
  *
- * @note Server continues running until sockrpc_server_destroy() is called
+ * Steps 2-4 run under the registration mutex, so each request sees
+ * either the old or the new version of the whole module.
  */
-void sockrpc_server_start(sockrpc_server *server)
+int sockrpc_server_load_module(sockrpc_server *server, const char *path)
 {
-    server->server_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
-    if (server->server_fd == -1)
-        return;
+    if (!server || !path)
+        return -1;
+
+    module *mod = module_open(path);
+    if (!mod)
+        return -1;
 
-    struct sockaddr_un addr = {
-        .sun_family = AF_UNIX};
-    strncpy(addr.sun_path, server->socket_path, sizeof(addr.sun_path) - 1);
+    lock_mutex(&server->mutex);
 
-    unlink(server->socket_path);
-    if (bind(server->server_fd, (struct sockaddr *)&addr, sizeof(addr)) == -1)
+    int slot = find_module(server, path);
+    module *old = slot == -1 ? NULL : server->modules[slot];
+
+    // Size of the method table once the new version is installed
+    size_t count = server->method_count;
+    for (const rpc_method *m = mod->methods; m->name; m++)
     {
-        close(server->server_fd);
-        return;
+        count += find_method(server, m->name) == -1;
+    }
+    for (size_t i = 0; old && i < server->method_count; i++)
+    {
+        count -= server->methods[i].mod == old && !module_exports(mod, server->methods[i].name);
     }
 
-    if (listen(server->server_fd, SOMAXCONN) == -1)
+    if (count > MAX_METHODS || (!old && server->module_count >= MAX_MODULES))
     {
-        close(server->server_fd);
-        return;
+        unlock_mutex(&server->mutex);
+        module_release(mod);
+        return -1;
     }
 
-    server->running = 1;
+    if (old)
+        remove_module_methods(server, old, mod);
 
-    for (int i = 0; i < NUM_WORKERS; i++)
+    for (const rpc_method *m = mod->methods; m->name; m++)
+    {
+        int i = find_method(server, m->name);
+        if (i != -1 && old && server->methods[i].mod != old && module_exports(old, m->name))
+            continue; // Registered again since the old version was loaded, no longer ours
+        if (i == -1)
+            i = add_method(server, m->name);
+        if (i == -1)
+            continue; // Out of memory, the method stays unavailable
+
+        server->methods[i].handler = m->handler;
+        server->methods[i].response_handler = NULL;
+        server->methods[i].stream_handler = NULL;
+        server->methods[i].deferred_handler = NULL;
+        server->methods[i].mod = mod;
+    }
+
+    if (old)
+        server->modules[slot] = mod;
+    else
+        server->modules[server->module_count++] = mod;
+
+    unlock_mutex(&server->mutex);
+
+    if (old)
+        module_release(old);
+    return 0;
+}
+
+/**
+ * @brief Unloads a handler module
+ * @param server Server context
+ * @param path Path the module was loaded from
+ * @return 0 on success, -1 if not loaded
+ *
+ * The shared object stays mapped until calls still running on it return.
+ */
+int sockrpc_server_unload_module(sockrpc_server *server, const char *path)
+{
+    if (!server || !path)
+        return -1;
+
+    lock_mutex(&server->mutex);
+
+    int slot = find_module(server, path);
+    if (slot == -1)
     {
-        pthread_create(&server->worker_threads[i], NULL, worker_routine, &server->workers[i]);
+        unlock_mutex(&server->mutex);
+        return -1;
     }
 
-    pthread_t acceptor_thread;
-    pthread_create(&acceptor_thread, NULL, acceptor_routine, server);
-    pthread_detach(acceptor_thread);
+    module *mod = server->modules[slot];
+    remove_module_methods(server, mod, NULL);
+    server->modules[slot] = server->modules[--server->module_count];
+
+    unlock_mutex(&server->mutex);
+
+    module_release(mod);
+    return 0;
 }
 
 /**
@@ -487,7 +3531,7 @@ void sockrpc_server_start(sockrpc_server *server)
  * Registration process:
  * 1. Validates input parameters
  * 2. Checks for method name conflicts
- * 3. Adds or updates method in registry
+ * 3. Adds or updates method in registry, run on the I/O workers
  *
  * Thread safety:
  * - Thread-safe
@@ -509,28 +3553,319 @@ void sockrpc_server_start(sockrpc_server *server)
  */
 void sockrpc_server_register(sockrpc_server *server, const char *name, rpc_handler handler)
 {
-    if (!server || !name || !handler || server->method_count >= MAX_METHODS)
-        return;
+    sockrpc_server_register_in_group(server, name, handler, NULL);
+}
 
-    pthread_mutex_lock(&server->mutex);
+/**
+ * @brief Sets the smallest response compressed on negotiated connections
+ * @param server Server context
+ * @param method Registered method name, or NULL for the server default
+ * @param threshold Size in bytes, 0 to never compress
+ * @return 0 on success, -1 on error
+ *
+ * Method settings override the default and survive re-registration and
+ * module reloads.
+ */
+int sockrpc_server_set_compression(sockrpc_server *server, const char *method, size_t threshold)
+{
+    if (!server)
+        return -1;
 
-    for (size_t i = 0; i < server->method_count; i++)
+    lock_mutex(&server->mutex);
+    int i = method ? find_method(server, method) : -1;
+    if (method && i == -1)
     {
-        if (strcmp(server->methods[i].name, name) == 0)
-        {
-            free((char *)server->methods[i].name);
-            server->methods[i].handler = handler;
-            server->methods[i].name = strdup(name);
-            pthread_mutex_unlock(&server->mutex);
-            return;
-        }
+        unlock_mutex(&server->mutex);
+        return -1;
+    }
+
+    if (method)
+        server->methods[i].compress_threshold = threshold;
+    else
+        server->compress_threshold = threshold;
+    unlock_mutex(&server->mutex);
+    return 0;
+}
+
+/**
+ * @brief Sets the Zstandard dictionary offered to clients
+ * @param server Server context
+ * @param data Dictionary bytes (copied)
+ * @param size Dictionary size
+ * @return 0 on success, -1 on error
+ *
+ * Must be called before the server starts, since connections keep a
+ * pointer to the digested dictionary.
+ */
+int sockrpc_server_set_compression_dictionary(sockrpc_server *server, const void *data,
+                                              size_t size)
+{
+    if (!server || server->started)
+        return -1;
+
+    compress_dict *dict = compress_dict_create(data, size);
+    if (!dict)
+        return -1;
+
+    compress_dict_destroy(server->compress_dict);
+    server->compress_dict = dict;
+    return 0;
+}
+
+/**
+ * @brief Publishes an event to every subscriber of a topic
+ * @param server Server context
+ * @param topic Topic name
+ * @param event Event payload
+ * @return Number of subscribed connections, or -1 on error
+ */
+int sockrpc_server_publish(sockrpc_server *server, const char *topic, const cJSON *event)
+{
+    if (!server || !topic || !event)
+        return -1;
+
+    return pubsub_publish(&server->pubsub, topic, event, deliver_event, server);
+}
+
+/**
+ * @brief Sets a topic's overflow policy
+ * @param server Server context
+ * @param topic Topic name
+ * @param policy Overflow policy
+ * @return 0 on success, -1 on error
+ */
+int sockrpc_server_set_topic_policy(sockrpc_server *server, const char *topic,
+                                    sockrpc_overflow_policy policy)
+{
+    if (!server || !topic || policy < SOCKRPC_OVERFLOW_DROP_OLDEST ||
+        policy > SOCKRPC_OVERFLOW_COALESCE)
+        return -1;
+
+    return pubsub_set_policy(&server->pubsub, topic, policy);
+}
+
+/**
+ * @brief Sets the event queue limit of subscriber connections
+ * @param server Server context
+ * @param limit Events queued per connection
+ * @return 0 on success, -1 on error
+ */
+int sockrpc_server_set_subscriber_queue(sockrpc_server *server, size_t limit)
+{
+    if (!server || !limit || server->started)
+        return -1;
+
+    server->pubsub.queue_limit = limit;
+    return 0;
+}
+
+/**
+ * @brief Enables request tracing and starts the span exporter
+ * @param server Server context
+ * @param config Tracing configuration
+ * @return 0 on success, -1 on error
+ */
+int sockrpc_server_set_tracing(sockrpc_server *server, const sockrpc_trace_config *config)
+{
+    if (!server || !config || !config->path || server->started || server->tracer ||
+        !(config->sample_rate >= 0 && config->sample_rate <= 1))
+        return -1;
+
+    server->tracer = trace_exporter_create(config);
+    return server->tracer ? 0 : -1;
+}
+
+/**
+ * @brief Captures incoming requests to a file
+ * @param server Server context
+ * @param config Capture configuration
+ * @return 0 on success, -1 on error
+ */
+int sockrpc_server_set_capture(sockrpc_server *server, const sockrpc_capture_config *config)
+{
+    if (!server || !config || !config->path || server->started || server->capture)
+        return -1;
+
+    server->capture = capture_create(config);
+    return server->capture ? 0 : -1;
+}
+
+/**
+ * @brief Writes the flight recorder to a file
+ * @param server Server context
+ * @param path Output file, replaced atomically
+ * @return Number of requests written, or -1 on error
+ */
+int sockrpc_server_dump_requests(sockrpc_server *server, const char *path)
+{
+    if (!server || !path)
+        return -1;
+
+    return recorder_dump(&server->recorder, path);
+}
+
+/**
+ * @brief Dumps the flight recorder to a file whenever SIGUSR2 arrives
+ * @param server Server context
+ * @param path Output file, replaced on each dump
+ * @return 0 on success, -1 on error
+ *
+ * The signal only wakes worker 0, which writes the file.
+ */
+int sockrpc_server_set_dump_signal(sockrpc_server *server, const char *path)
+{
+    if (!server || !path || server->started || server->dump_fd != -1)
+        return -1;
+
+    server->dump_path = strdup(path);
+    server->dump_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    struct epoll_event ev = {.events = EPOLLIN, .data.u64 = DUMP_HANDLE};
+    if (!server->dump_path || server->dump_fd == -1 ||
+        epoll_ctl(server->workers[0].epoll_fd, EPOLL_CTL_ADD, server->dump_fd, &ev) == -1 ||
+        register_dump_fd(server->dump_fd) == -1)
+    {
+        if (server->dump_fd != -1)
+            close(server->dump_fd);
+        server->dump_fd = -1;
+        free(server->dump_path);
+        server->dump_path = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Collects server metrics
+ * @param server Server context
+ * @return New JSON object (caller frees) or NULL
+ *
+ * Layout:
+ * {"compression": {
+ *    "requests": {"compressed", "raw_bytes", "wire_bytes", "decompress_us"},
+ *    "methods": {"name": {"responses", "compressed", "raw_bytes",
+ *                         "wire_bytes", "ratio", "compress_us"}}},
+ *  "buffers": {"hits", "misses", "hit_rate", "huge", "in_use_bytes",
+ *              "cached_bytes", "resident_bytes"},
+ *  "connections": {"open", "accepted"},
+ *  "busy_poll": {"spins", "hits", "hit_rate", "spin_us", "wasted_us"}}
+ *
+ * Methods appear once they have answered on a compressing connection.
+ * ratio is raw_bytes / wire_bytes over all such responses. Buffer
+ * counters are summed over the workers' pools.
+ */
+cJSON *sockrpc_server_get_stats(sockrpc_server *server)
+{
+    if (!server)
+        return NULL;
+
+    cJSON *stats = cJSON_CreateObject();
+    cJSON *compression = cJSON_AddObjectToObject(stats, "compression");
+
+    cJSON *requests = cJSON_AddObjectToObject(compression, "requests");
+    cJSON_AddNumberToObject(requests, "compressed",
+                            __atomic_load_n(&server->compressed_requests, __ATOMIC_RELAXED));
+    cJSON_AddNumberToObject(requests, "raw_bytes",
+                            __atomic_load_n(&server->request_raw_bytes, __ATOMIC_RELAXED));
+    cJSON_AddNumberToObject(requests, "wire_bytes",
+                            __atomic_load_n(&server->request_wire_bytes, __ATOMIC_RELAXED));
+    cJSON_AddNumberToObject(requests, "decompress_us",
+                            __atomic_load_n(&server->decompress_ns, __ATOMIC_RELAXED) / 1000.0);
+
+    cJSON *methods = cJSON_AddObjectToObject(compression, "methods");
+    lock_mutex(&server->mutex);
+    for (method_stats *m = server->stats; m; m = m->next)
+    {
+        unsigned long responses = __atomic_load_n(&m->responses, __ATOMIC_RELAXED);
+        if (responses == 0)
+            continue;
+
+        unsigned long raw = __atomic_load_n(&m->raw_bytes, __ATOMIC_RELAXED);
+        unsigned long wire = __atomic_load_n(&m->wire_bytes, __ATOMIC_RELAXED);
+        cJSON *entry = cJSON_AddObjectToObject(methods, m->name);
+        cJSON_AddNumberToObject(entry, "responses", responses);
+        cJSON_AddNumberToObject(entry, "compressed",
+                                __atomic_load_n(&m->compressed, __ATOMIC_RELAXED));
+        cJSON_AddNumberToObject(entry, "raw_bytes", raw);
+        cJSON_AddNumberToObject(entry, "wire_bytes", wire);
+        cJSON_AddNumberToObject(entry, "ratio", wire ? (double)raw / wire : 1.0);
+        cJSON_AddNumberToObject(entry, "compress_us",
+                                __atomic_load_n(&m->compress_ns, __ATOMIC_RELAXED) / 1000.0);
+    }
+    unlock_mutex(&server->mutex);
+
+    pool_stats total = {0};
+    for (int i = 0; i < NUM_WORKERS; i++)
+    {
+        pool_stats worker;
+        pool_get_stats(&server->workers[i].pool, &worker);
+        total.hits += worker.hits;
+        total.misses += worker.misses;
+        total.huge += worker.huge;
+        total.in_use_bytes += worker.in_use_bytes;
+        total.cached_bytes += worker.cached_bytes;
+    }
+
+    unsigned long acquired = total.hits + total.misses;
+    cJSON *buffers = cJSON_AddObjectToObject(stats, "buffers");
+    cJSON_AddNumberToObject(buffers, "hits", total.hits);
+    cJSON_AddNumberToObject(buffers, "misses", total.misses);
+    cJSON_AddNumberToObject(buffers, "hit_rate", acquired ? (double)total.hits / acquired : 0);
+    cJSON_AddNumberToObject(buffers, "huge", total.huge);
+    cJSON_AddNumberToObject(buffers, "in_use_bytes", total.in_use_bytes);
+    cJSON_AddNumberToObject(buffers, "cached_bytes", total.cached_bytes);
+    cJSON_AddNumberToObject(buffers, "resident_bytes", total.in_use_bytes + total.cached_bytes);
+
+    int open = 0;
+    unsigned long accepted = 0;
+    for (int i = 0; i < NUM_WORKERS; i++)
+    {
+        lock_mutex(&server->workers[i].mutex);
+        open += server->workers[i].num_connections;
+        accepted += server->workers[i].accepted;
+        unlock_mutex(&server->workers[i].mutex);
+    }
+    cJSON *connections = cJSON_AddObjectToObject(stats, "connections");
+    cJSON_AddNumberToObject(connections, "open", open);
+    cJSON_AddNumberToObject(connections, "accepted", accepted);
+
+    cJSON *corking = cJSON_AddObjectToObject(stats, "corking");
+    cJSON_AddNumberToObject(corking, "responses",
+                            __atomic_load_n(&server->corked_responses, __ATOMIC_RELAXED));
+    cJSON_AddNumberToObject(corking, "writes",
+                            __atomic_load_n(&server->cork_writes, __ATOMIC_RELAXED));
+
+    spin_state spin = {0};
+    for (int i = 0; i < NUM_WORKERS; i++)
+    {
+        spin_state *worker = &server->workers[i].spin;
+        spin.spins += __atomic_load_n(&worker->spins, __ATOMIC_RELAXED);
+        spin.hits += __atomic_load_n(&worker->hits, __ATOMIC_RELAXED);
+        spin.spin_ns += __atomic_load_n(&worker->spin_ns, __ATOMIC_RELAXED);
+        spin.wasted_ns += __atomic_load_n(&worker->wasted_ns, __ATOMIC_RELAXED);
     }
+    cJSON_AddItemToObject(stats, "busy_poll", spin_stats_json(&spin));
+    cJSON_AddItemToObject(stats, "pubsub", pubsub_stats_json(&server->pubsub));
+    if (server->tracer)
+        cJSON_AddItemToObject(stats, "tracing", trace_exporter_stats(server->tracer));
+    cJSON_AddItemToObject(stats, "recorder", recorder_stats_json(&server->recorder));
+    if (server->capture)
+        cJSON_AddItemToObject(stats, "capture", capture_stats(server->capture));
 
-    server->methods[server->method_count].name = strdup(name);
-    server->methods[server->method_count].handler = handler;
-    server->method_count++;
+    return stats;
+}
 
-    pthread_mutex_unlock(&server->mutex);
+/**
+ * @brief Wakes every worker and the acceptor
+ * @param server Server context
+ *
+ * Makes wake_fd readable for good; threads blocked in epoll_wait or
+ * poll return and see that running was cleared.
+ */
+static void wake_threads(sockrpc_server *server)
+{
+    uint64_t one = 1;
+    while (write(server->wake_fd, &one, sizeof(one)) == -1 && errno == EINTR)
+        ;
 }
 
 /**
@@ -538,12 +3873,13 @@ void sockrpc_server_register(sockrpc_server *server, const char *name, rpc_handl
  * @param server Server context to destroy
  *
  * Cleanup process:
- * 1. Signals server to stop (sets running = 0)
+ * 1. Signals server to stop (clears running, signals wake_fd)
  * 2. Shuts down server socket
  * 3. Waits for worker threads to finish
- * 4. Frees registered method names
- * 5. Closes file descriptors
- * 6. Removes socket file
+ * 4. Fails calls of downstream clients, closes client connections,
+ *    then drains and stops worker groups
+ * 5. Frees registered method names and closes file descriptors
+ * 6. Removes socket file (only if created by sockrpc_server_start)
  * 7. Destroys synchronization primitives
  * 8. Frees all allocated memory
  *
@@ -558,7 +3894,8 @@ void sockrpc_server_register(sockrpc_server *server, const char *name, rpc_handl
  * - All dynamic memory freed
  * - Socket file removed from filesystem
  *
- * @note Acceptor thread terminates automatically due to socket shutdown
+ * @note Worker and acceptor threads block without timeouts and exit
+ *       when wake_fd becomes readable
  */
 void sockrpc_server_destroy(sockrpc_server *server)
 {
@@ -566,28 +3903,97 @@ void sockrpc_server_destroy(sockrpc_server *server)
         return;
 
     server->running = 0;
+    wake_threads(server);
 
-    shutdown(server->server_fd, SHUT_RDWR);
+    // An inherited socket is shared with the supervisor, leave it listening
+    if (server->server_fd != -1 && server->owns_socket)
+        shutdown(server->server_fd, SHUT_RDWR);
 
-    for (int i = 0; i < NUM_WORKERS; i++)
+    int threads = server->started && !server->embedded;
+    for (int i = 0; i < NUM_WORKERS && threads; i++)
     {
         pthread_join(server->worker_threads[i], NULL);
     }
 
+    // The acceptor must not hand out connections while they are closed
+    if (server->server_fd != -1 && threads)
+        pthread_join(server->acceptor_thread, NULL);
+
+    for (int i = 0; i < NUM_WORKERS; i++)
+    {
+        worker_context *worker = &server->workers[i];
+
+        // Pending downstream calls fail, answering their deferred calls
+        for (int slot = 0; slot < worker->downstream_count; slot++)
+        {
+            if (worker->downstream[slot].client)
+                drop_downstream(worker, slot);
+        }
+
+        while (worker->connections)
+            close_connection(worker, worker->connections);
+
+        if (worker->listen_fd != -1)
+            close(worker->listen_fd);
+        close(worker->epoll_fd);
+        pthread_mutex_destroy(&worker->mutex);
+    }
+
+#ifndef SOCKRPC_EMBEDDED_ONLY
+    // Queued jobs still run, their responses are dropped on closed connections
+    for (size_t i = 0; i < server->group_count; i++)
+    {
+        group_destroy(server->groups[i]);
+    }
+#endif
+
+    // Every span has been submitted once the groups are done
+    trace_exporter_destroy(server->tracer);
+    capture_destroy(server->capture);
+
+    // Group threads borrow response buffers and release connections
     for (int i = 0; i < NUM_WORKERS; i++)
     {
-        pthread_mutex_destroy(&server->workers[i].mutex);
+        pool_cleanup(&server->workers[i].pool);
+        slab_cleanup(&server->workers[i].slab);
+    }
+
+    for (size_t i = 0; i < server->module_count; i++)
+    {
+        module_release(server->modules[i]);
     }
 
     for (size_t i = 0; i < server->method_count; i++)
     {
-        free((char *)server->methods[i].name);
+        free(server->methods[i].name);
     }
 
-    close(server->server_fd);
+    while (server->stats)
+    {
+        method_stats *next = server->stats->next;
+        free(server->stats->name);
+        free(server->stats);
+        server->stats = next;
+    }
+
+    compress_dict_destroy(server->compress_dict);
+    pubsub_cleanup(&server->pubsub);
+
+    if (server->server_fd != -1)
+        close(server->server_fd);
+
+    if (server->owns_socket)
+        unlink(server->address.path);
 
-    unlink(server->socket_path);
+    if (server->dump_fd != -1)
+    {
+        unregister_dump_fd(server->dump_fd);
+        close(server->dump_fd);
+    }
+    free(server->dump_path);
+    recorder_cleanup(&server->recorder);
 
+    close(server->wake_fd);
     pthread_mutex_destroy(&server->mutex);
     pthread_mutex_destroy(&server->lb_mutex);
 
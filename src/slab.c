@@ -0,0 +1,180 @@
+#include <stdlib.h>
+#include <string.h>
+#include "slab.h"
+#include "lock.h"
+
+/**
+ * @file slab.c
+ * @brief Implementation of the slab allocator
+ *
+ * Handle layout: generation in the high 32 bits, slot index in the low
+ * 32 bits. Generations skip 0, so no handle is ever 0 and callers can
+ * use 0 to mean "no object".
+ */
+
+/**
+ * @brief Chunk of slots with their generations
+ *
+ * Slot i occupies object_size bytes at objects + i * object_size.
+ */
+struct slab_chunk
+{
+    uint32_t generations[SLAB_CHUNK_OBJECTS]; /**< Current generation per slot (atomic) */
+    _Alignas(SLAB_ALIGN) char objects[];     /**< Slots */
+};
+
+/**
+ * @brief Advances a slot's generation, skipping 0
+ * @param generation Generation to advance
+ */
+static void next_generation(uint32_t *generation)
+{
+    uint32_t value = __atomic_load_n(generation, __ATOMIC_RELAXED) + 1;
+    __atomic_store_n(generation, value ? value : 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Initializes an empty slab
+ * @param slab Slab
+ * @param object_size Size of one object
+ */
+void slab_init(slab_cache *slab, size_t object_size)
+{
+    slab->object_size = (object_size + SLAB_ALIGN - 1) & ~(size_t)(SLAB_ALIGN - 1);
+    memset(slab->chunks, 0, sizeof(slab->chunks));
+    slab->chunk_count = 0;
+    slab->free_slots = NULL;
+    slab->free_count = 0;
+    slab->in_use = 0;
+    pthread_mutex_init(&slab->mutex, NULL);
+}
+
+/**
+ * @brief Frees all chunks
+ * @param slab Slab
+ */
+void slab_cleanup(slab_cache *slab)
+{
+    for (size_t c = 0; c < slab->chunk_count; c++)
+    {
+        free(slab->chunks[c]);
+    }
+    free(slab->free_slots);
+    slab->chunk_count = 0;
+    slab->free_slots = NULL;
+    pthread_mutex_destroy(&slab->mutex);
+}
+
+/**
+ * @brief Adds a chunk and pushes its slots on the free stack
+ * @param slab Slab (mutex held)
+ * @return 0 on success, -1 if the slab is full or memory is exhausted
+ */
+static int add_chunk(slab_cache *slab)
+{
+    if (slab->chunk_count >= SLAB_MAX_CHUNKS)
+        return -1;
+
+    uint32_t *free_slots = realloc(slab->free_slots, (slab->chunk_count + 1) *
+                                                         SLAB_CHUNK_OBJECTS * sizeof(uint32_t));
+    if (!free_slots)
+        return -1;
+    slab->free_slots = free_slots;
+
+    size_t size = sizeof(slab_chunk) + SLAB_CHUNK_OBJECTS * slab->object_size;
+    size = (size + SLAB_ALIGN - 1) & ~(size_t)(SLAB_ALIGN - 1);
+    slab_chunk *chunk = aligned_alloc(SLAB_ALIGN, size);
+    if (!chunk)
+        return -1;
+
+    for (size_t i = 0; i < SLAB_CHUNK_OBJECTS; i++)
+    {
+        chunk->generations[i] = 1;
+    }
+
+    // Push in reverse so the lowest slots are handed out first
+    size_t first = slab->chunk_count * SLAB_CHUNK_OBJECTS;
+    for (size_t i = SLAB_CHUNK_OBJECTS; i > 0; i--)
+    {
+        slab->free_slots[slab->free_count++] = (uint32_t)(first + i - 1);
+    }
+    slab->chunks[slab->chunk_count++] = chunk;
+    return 0;
+}
+
+/**
+ * @brief Allocates a zeroed object
+ * @param slab Slab
+ * @param handle Set to the object's handle
+ * @return Object or NULL
+ */
+void *slab_alloc(slab_cache *slab, uint64_t *handle)
+{
+    lock_mutex(&slab->mutex);
+    if (slab->free_count == 0 && add_chunk(slab) == -1)
+    {
+        unlock_mutex(&slab->mutex);
+        return NULL;
+    }
+
+    uint32_t index = slab->free_slots[--slab->free_count];
+    slab_chunk *chunk = slab->chunks[index / SLAB_CHUNK_OBJECTS];
+    slab->in_use++;
+    unlock_mutex(&slab->mutex);
+
+    size_t slot = index % SLAB_CHUNK_OBJECTS;
+    void *object = chunk->objects + slot * slab->object_size;
+    memset(object, 0, slab->object_size);
+
+    uint32_t generation = __atomic_load_n(&chunk->generations[slot], __ATOMIC_ACQUIRE);
+    *handle = (uint64_t)generation << 32 | index;
+    return object;
+}
+
+/**
+ * @brief Looks up an object by handle
+ * @param slab Slab
+ * @param handle Handle from slab_alloc
+ * @return Object or NULL if stale
+ */
+void *slab_lookup(slab_cache *slab, uint64_t handle)
+{
+    uint32_t index = (uint32_t)handle;
+    uint32_t generation = (uint32_t)(handle >> 32);
+    if (index / SLAB_CHUNK_OBJECTS >= SLAB_MAX_CHUNKS)
+        return NULL;
+
+    slab_chunk *chunk = slab->chunks[index / SLAB_CHUNK_OBJECTS];
+    size_t slot = index % SLAB_CHUNK_OBJECTS;
+    if (!chunk || __atomic_load_n(&chunk->generations[slot], __ATOMIC_ACQUIRE) != generation)
+        return NULL;
+    return chunk->objects + slot * slab->object_size;
+}
+
+/**
+ * @brief Makes every handle of an object stale, keeping it allocated
+ * @param slab Slab
+ * @param handle Current handle of the object
+ */
+void slab_retire(slab_cache *slab, uint64_t handle)
+{
+    uint32_t index = (uint32_t)handle;
+    slab_chunk *chunk = slab->chunks[index / SLAB_CHUNK_OBJECTS];
+    next_generation(&chunk->generations[index % SLAB_CHUNK_OBJECTS]);
+}
+
+/**
+ * @brief Frees an object
+ * @param slab Slab
+ * @param handle Any handle issued for the object
+ */
+void slab_free(slab_cache *slab, uint64_t handle)
+{
+    uint32_t index = (uint32_t)handle;
+    slab_chunk *chunk = slab->chunks[index / SLAB_CHUNK_OBJECTS];
+    lock_mutex(&slab->mutex);
+    next_generation(&chunk->generations[index % SLAB_CHUNK_OBJECTS]);
+    slab->free_slots[slab->free_count++] = index;
+    slab->in_use--;
+    unlock_mutex(&slab->mutex);
+}
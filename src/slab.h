@@ -0,0 +1,103 @@
+#ifndef SOCKRPC_SLAB_H
+#define SOCKRPC_SLAB_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+/**
+ * @file slab.h
+ * @brief Internal slab allocator for fixed-size objects
+ *
+ * Objects are carved out of cache-line aligned chunks that are never
+ * moved or freed before the slab itself, and freed objects are reused
+ * from a free list. Every slot carries a generation counter; a handle
+ * combines the slot index with the generation it was issued for, so a
+ * handle kept somewhere else (an epoll registration, an event already
+ * returned by epoll_wait) can be checked for staleness after the
+ * object was retired or reused.
+ *
+ * Allocation and freeing are serialized by the slab's mutex. Lookups
+ * take no lock.
+ */
+
+/**
+ * @brief Alignment and size granularity of objects
+ */
+#define SLAB_ALIGN 64
+
+/**
+ * @brief Objects per chunk
+ */
+#define SLAB_CHUNK_OBJECTS 64
+
+/**
+ * @brief Most chunks per slab (262144 objects)
+ */
+#define SLAB_MAX_CHUNKS 4096
+
+/**
+ * @brief Chunk of SLAB_CHUNK_OBJECTS slots
+ */
+typedef struct slab_chunk slab_chunk;
+
+/**
+ * @brief Slab of equally sized objects
+ */
+typedef struct
+{
+    size_t object_size;                  /**< Slot size, multiple of SLAB_ALIGN */
+    slab_chunk *chunks[SLAB_MAX_CHUNKS]; /**< Allocated chunks */
+    size_t chunk_count;                  /**< Number of chunks */
+    uint32_t *free_slots;                /**< Stack of free slot indices */
+    size_t free_count;                   /**< Entries on the free stack */
+    size_t in_use;                       /**< Allocated objects */
+    pthread_mutex_t mutex;               /**< Protects allocation state */
+} slab_cache;
+
+/**
+ * @brief Initializes an empty slab
+ * @param slab Slab
+ * @param object_size Size of one object
+ */
+void slab_init(slab_cache *slab, size_t object_size);
+
+/**
+ * @brief Frees all chunks
+ * @param slab Slab; objects still allocated become invalid
+ */
+void slab_cleanup(slab_cache *slab);
+
+/**
+ * @brief Allocates a zeroed object
+ * @param slab Slab
+ * @param handle Set to the object's handle, never 0
+ * @return Object or NULL if the slab is full or memory is exhausted
+ */
+void *slab_alloc(slab_cache *slab, uint64_t *handle);
+
+/**
+ * @brief Looks up an object by handle
+ * @param slab Slab
+ * @param handle Handle from slab_alloc
+ * @return Object, or NULL if the handle was retired or freed since
+ */
+void *slab_lookup(slab_cache *slab, uint64_t handle);
+
+/**
+ * @brief Makes every handle of an object stale, keeping it allocated
+ * @param slab Slab
+ * @param handle Current handle of the object
+ */
+void slab_retire(slab_cache *slab, uint64_t handle);
+
+/**
+ * @brief Frees an object
+ * @param slab Slab
+ * @param handle Any handle issued for the object, retired or not
+ *
+ * Handles of the object become stale.
+ */
+void slab_free(slab_cache *slab, uint64_t handle);
+
+#endif /* SOCKRPC_SLAB_H */
@@ -0,0 +1,111 @@
+#include <time.h>
+#include "spin.h"
+
+/**
+ * @file spin.c
+ * @brief Implementation of adaptive busy-polling
+ */
+
+/**
+ * @brief Smallest budget as a fraction of the configured maximum
+ */
+#define SPIN_MIN_FRACTION 16
+
+/**
+ * @brief Returns a monotonic timestamp in nanoseconds
+ * @return Nanoseconds since an arbitrary point
+ */
+static unsigned long spin_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long)ts.tv_sec * 1000000000ul + (unsigned long)ts.tv_nsec;
+}
+
+/**
+ * @brief Tells the CPU this is a spin-wait loop
+ *
+ * Frees pipeline resources for a sibling hyperthread and avoids the
+ * memory-order flush when the loop exits.
+ */
+static void cpu_relax(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+/**
+ * @brief Initializes a spin state
+ * @param state State
+ * @param max_ns Budget per spin phase, 0 to disable spinning
+ */
+void spin_init(spin_state *state, unsigned long max_ns)
+{
+    *state = (spin_state){.max_ns = max_ns, .budget_ns = max_ns};
+}
+
+/**
+ * @brief Spins on poll until it reports readiness or the budget runs out
+ * @param state State
+ * @param poll Readiness check
+ * @param ctx Context for poll
+ * @return 1 if poll stopped the phase, 0 if the budget ran out
+ */
+int spin_wait(spin_state *state, spin_poll_fn poll, void *ctx)
+{
+    unsigned long start = spin_now_ns();
+    unsigned long elapsed = 0;
+    int hit = 0;
+
+    while (elapsed < state->budget_ns)
+    {
+        if (poll(ctx))
+        {
+            hit = 1;
+            break;
+        }
+        cpu_relax();
+        elapsed = spin_now_ns() - start;
+    }
+    elapsed = spin_now_ns() - start;
+
+    __atomic_add_fetch(&state->spins, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&state->spin_ns, elapsed, __ATOMIC_RELAXED);
+    if (hit)
+    {
+        __atomic_add_fetch(&state->hits, 1, __ATOMIC_RELAXED);
+        state->budget_ns = state->budget_ns * 2 < state->max_ns ? state->budget_ns * 2
+                                                                : state->max_ns;
+    }
+    else
+    {
+        __atomic_add_fetch(&state->wasted_ns, elapsed, __ATOMIC_RELAXED);
+        unsigned long floor = state->max_ns / SPIN_MIN_FRACTION;
+        state->budget_ns = state->budget_ns / 2 > floor ? state->budget_ns / 2 : floor;
+    }
+    return hit;
+}
+
+/**
+ * @brief Reports the counters of a spin state
+ * @param state State
+ * @return New JSON object or NULL
+ */
+cJSON *spin_stats_json(const spin_state *state)
+{
+    unsigned long spins = __atomic_load_n(&state->spins, __ATOMIC_RELAXED);
+    unsigned long hits = __atomic_load_n(&state->hits, __ATOMIC_RELAXED);
+
+    cJSON *stats = cJSON_CreateObject();
+    cJSON_AddNumberToObject(stats, "spins", spins);
+    cJSON_AddNumberToObject(stats, "hits", hits);
+    cJSON_AddNumberToObject(stats, "hit_rate", spins ? (double)hits / spins : 0);
+    cJSON_AddNumberToObject(stats, "spin_us",
+                            __atomic_load_n(&state->spin_ns, __ATOMIC_RELAXED) / 1000.0);
+    cJSON_AddNumberToObject(stats, "wasted_us",
+                            __atomic_load_n(&state->wasted_ns, __ATOMIC_RELAXED) / 1000.0);
+    return stats;
+}
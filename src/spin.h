@@ -0,0 +1,64 @@
+#ifndef SOCKRPC_SPIN_H
+#define SOCKRPC_SPIN_H
+
+#include <cjson/cJSON.h>
+
+/**
+ * @file spin.h
+ * @brief Internal adaptive busy-polling shared by workers and clients
+ *
+ * Before blocking in epoll_wait or read, a thread may spin on a
+ * non-blocking poll for a short budget. On a dedicated core this avoids
+ * the sleep/wakeup round trip when the next message arrives within
+ * microseconds. The budget adapts: it is halved after a spin phase that
+ * found nothing (down to 1/16 of the configured maximum) and doubled
+ * after one that did, so idle periods cost little CPU.
+ *
+ * A spin_state is used by one thread at a time; its counters are
+ * updated atomically so other threads may read them.
+ */
+
+/**
+ * @brief Busy-poll settings, adaptive budget and counters
+ */
+typedef struct
+{
+    unsigned long max_ns;    /**< Configured budget, 0 = disabled */
+    unsigned long budget_ns; /**< Budget of the next spin phase */
+    unsigned long spins;     /**< Spin phases (atomic) */
+    unsigned long hits;      /**< Phases that found work (atomic) */
+    unsigned long spin_ns;   /**< Time spent spinning (atomic) */
+    unsigned long wasted_ns; /**< Time spent in phases that found nothing (atomic) */
+} spin_state;
+
+/**
+ * @brief Non-blocking readiness check run while spinning
+ * @param ctx Caller context
+ * @return Non-zero to stop spinning (ready or error), 0 to keep going
+ */
+typedef int (*spin_poll_fn)(void *ctx);
+
+/**
+ * @brief Initializes a spin state
+ * @param state State
+ * @param max_ns Budget per spin phase, 0 to disable spinning
+ */
+void spin_init(spin_state *state, unsigned long max_ns);
+
+/**
+ * @brief Spins on poll until it reports readiness or the budget runs out
+ * @param state State, enabled with a non-zero budget
+ * @param poll Readiness check
+ * @param ctx Context for poll
+ * @return 1 if poll stopped the phase, 0 if the budget ran out
+ */
+int spin_wait(spin_state *state, spin_poll_fn poll, void *ctx);
+
+/**
+ * @brief Reports the counters of a spin state
+ * @param state State
+ * @return {"spins", "hits", "hit_rate", "spin_us", "wasted_us"} or NULL
+ */
+cJSON *spin_stats_json(const spin_state *state);
+
+#endif /* SOCKRPC_SPIN_H */
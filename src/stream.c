@@ -0,0 +1,143 @@
+#include <stdlib.h>
+#include <string.h>
+#include "stream.h"
+
+/**
+ * @file stream.c
+ * @brief Implementation of the chunk queue behind streaming calls
+ */
+
+/**
+ * @brief Creates a stream with one reference
+ * @param id Request id as JSON text, or NULL
+ * @param owner Connection the chunks arrive on
+ * @param ack Acknowledgement callback or NULL
+ * @return Stream or NULL
+ */
+sockrpc_stream *stream_create(const char *id, void *owner, stream_ack_fn ack)
+{
+    sockrpc_stream *stream = calloc(1, sizeof(sockrpc_stream));
+    if (!stream)
+        return NULL;
+
+    if (id && !(stream->id = strdup(id)))
+    {
+        free(stream);
+        return NULL;
+    }
+    stream->owner = owner;
+    stream->ack = ack;
+    stream->refs = 1;
+    pthread_mutex_init(&stream->mutex, NULL);
+    pthread_cond_init(&stream->cond, NULL);
+    return stream;
+}
+
+/**
+ * @brief Hands a received chunk to the stream
+ * @param stream Stream
+ * @param chunk Chunk (ownership transferred)
+ * @return 0 on success, -1 on error
+ */
+int stream_push(sockrpc_stream *stream, cJSON *chunk)
+{
+    pthread_mutex_lock(&stream->mutex);
+    if (stream->ended || stream->count == STREAM_WINDOW)
+    {
+        pthread_mutex_unlock(&stream->mutex);
+        cJSON_Delete(chunk);
+        return -1;
+    }
+
+    stream->chunks[(stream->head + stream->count) % STREAM_WINDOW] = chunk;
+    stream->count++;
+    pthread_cond_signal(&stream->cond);
+    pthread_mutex_unlock(&stream->mutex);
+    return 0;
+}
+
+/**
+ * @brief Ends the stream
+ * @param stream Stream
+ * @param aborted Non-zero if the upload did not complete
+ */
+void stream_end(sockrpc_stream *stream, int aborted)
+{
+    pthread_mutex_lock(&stream->mutex);
+    stream->ended = 1;
+    stream->aborted |= aborted;
+    pthread_cond_signal(&stream->cond);
+    pthread_mutex_unlock(&stream->mutex);
+}
+
+/**
+ * @brief Frees a stream
+ * @param stream Stream
+ */
+void stream_destroy(sockrpc_stream *stream)
+{
+    while (stream->count)
+    {
+        cJSON_Delete(stream->chunks[stream->head]);
+        stream->head = (stream->head + 1) % STREAM_WINDOW;
+        stream->count--;
+    }
+    pthread_cond_destroy(&stream->cond);
+    pthread_mutex_destroy(&stream->mutex);
+    free(stream->id);
+    free(stream);
+}
+
+/**
+ * @brief Waits for the next chunk of an upload
+ * @param stream Stream passed to the handler
+ * @return Chunk (caller frees) or NULL at the end of the upload
+ *
+ * Consumed chunks are acknowledged in batches of half the window, which
+ * lets the client send more.
+ */
+cJSON *sockrpc_stream_next(sockrpc_stream *stream)
+{
+    if (!stream)
+        return NULL;
+
+    pthread_mutex_lock(&stream->mutex);
+    while (!stream->count && !stream->ended)
+        pthread_cond_wait(&stream->cond, &stream->mutex);
+
+    cJSON *chunk = NULL;
+    unsigned long ack = 0;
+    if (stream->count && !stream->aborted)
+    {
+        chunk = stream->chunks[stream->head];
+        stream->head = (stream->head + 1) % STREAM_WINDOW;
+        stream->count--;
+        stream->consumed++;
+        if (!stream->ended && stream->consumed - stream->acked >= STREAM_WINDOW / 2)
+        {
+            stream->acked = stream->consumed;
+            ack = stream->consumed;
+        }
+    }
+    pthread_mutex_unlock(&stream->mutex);
+
+    if (ack && stream->ack)
+        stream->ack(stream, ack);
+    return chunk;
+}
+
+/**
+ * @brief Tells whether an upload ended abnormally
+ * @param stream Stream passed to the handler
+ * @return 1 if aborted, 0 otherwise
+ */
+int sockrpc_stream_failed(sockrpc_stream *stream)
+{
+    if (!stream)
+        return 1;
+
+    pthread_mutex_lock(&stream->mutex);
+    int aborted = stream->aborted;
+    pthread_mutex_unlock(&stream->mutex);
+    return aborted;
+}
@@ -0,0 +1,88 @@
+#ifndef SOCKRPC_STREAM_H
+#define SOCKRPC_STREAM_H
+
+#include <pthread.h>
+#include "sockrpc/sockrpc.h"
+
+/**
+ * @file stream.h
+ * @brief Internal state of client-streaming calls
+ *
+ * A streaming call starts with a request carrying "stream": true, is
+ * followed by chunk frames {"id": id, "chunk": any} and ends with
+ * {"id": id, "end": true}; the response comes when the handler
+ * returns. The handler pulls chunks with sockrpc_stream_next while the
+ * I/O worker keeps pushing them, so processing overlaps the upload.
+ *
+ * Flow control is credit based: the client keeps at most STREAM_WINDOW
+ * chunks unacknowledged, and the server acknowledges with
+ * {"id": id, "ack": consumed} as the handler consumes them. A stream
+ * therefore never holds more than STREAM_WINDOW chunks, however large
+ * the upload.
+ */
+
+/**
+ * @brief Most chunks in flight per stream
+ */
+#define STREAM_WINDOW 16
+
+/**
+ * @brief Called when consumed chunks should be acknowledged
+ * @param stream Stream
+ * @param consumed Chunks consumed so far
+ */
+typedef void (*stream_ack_fn)(sockrpc_stream *stream, unsigned long consumed);
+
+/**
+ * @brief Upload in progress
+ */
+struct sockrpc_stream
+{
+    cJSON *chunks[STREAM_WINDOW];  /**< Ring of received chunks */
+    size_t head;                   /**< Index of the oldest chunk */
+    size_t count;                  /**< Chunks waiting for the handler */
+    unsigned long consumed;        /**< Chunks handed to the handler */
+    unsigned long acked;           /**< consumed at the last acknowledgement */
+    int ended;                     /**< End received, no more chunks */
+    int aborted;                   /**< Connection lost or protocol violated */
+    char *id;                      /**< Request id as JSON text */
+    void *owner;                   /**< Connection the chunks arrive on */
+    stream_ack_fn ack;             /**< Acknowledgement callback or NULL */
+    unsigned int refs;             /**< Owner's list plus the running call (atomic) */
+    struct sockrpc_stream *next;   /**< Next stream of the owner */
+    pthread_mutex_t mutex;         /**< Protects the chunk ring and flags */
+    pthread_cond_t cond;           /**< Signals chunks, end and abort */
+};
+
+/**
+ * @brief Creates a stream with one reference
+ * @param id Request id as JSON text (copied), or NULL
+ * @param owner Connection the chunks arrive on
+ * @param ack Acknowledgement callback or NULL
+ * @return Stream or NULL on allocation failure
+ */
+sockrpc_stream *stream_create(const char *id, void *owner, stream_ack_fn ack);
+
+/**
+ * @brief Hands a received chunk to the stream
+ * @param stream Stream
+ * @param chunk Chunk (ownership transferred)
+ * @return 0 on success, -1 if the window is exceeded or the stream is
+ *         over (chunk freed)
+ */
+int stream_push(sockrpc_stream *stream, cJSON *chunk);
+
+/**
+ * @brief Ends the stream, waking a handler waiting for chunks
+ * @param stream Stream
+ * @param aborted Non-zero if the upload did not complete
+ */
+void stream_end(sockrpc_stream *stream, int aborted);
+
+/**
+ * @brief Frees a stream and the chunks nobody consumed
+ * @param stream Stream
+ */
+void stream_destroy(sockrpc_stream *stream);
+
+#endif /* SOCKRPC_STREAM_H */
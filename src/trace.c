@@ -0,0 +1,599 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/random.h>
+#include "trace.h"
+
+/**
+ * @file trace.c
+ * @brief Implementation of trace propagation and the span exporter
+ */
+
+/**
+ * @brief Default number of spans written per batch
+ */
+#define TRACE_DEFAULT_BATCH 64
+
+/**
+ * @brief Default longest time a span waits for its batch, in milliseconds
+ */
+#define TRACE_DEFAULT_FLUSH_MS 1000
+
+/**
+ * @brief Spans that may wait for the exporter, in batches
+ */
+#define TRACE_QUEUE_BATCHES 16
+
+struct trace_exporter
+{
+    FILE *file;              /**< Output, one request per line */
+    char *service;           /**< service.name resource attribute */
+    double sample_rate;      /**< Fraction of new traces sampled */
+    size_t batch_size;       /**< Spans per write */
+    unsigned int flush_ms;   /**< Longest wait for a batch to fill */
+    trace_span *head;        /**< Oldest queued span */
+    trace_span *tail;        /**< Newest queued span */
+    size_t queued;           /**< Spans in the queue */
+    size_t queue_limit;      /**< Spans queued before dropping */
+    unsigned long spans;     /**< Spans submitted */
+    unsigned long exported;  /**< Spans written */
+    unsigned long dropped;   /**< Spans dropped while the queue was full */
+    unsigned long batches;   /**< Lines written */
+    int stopping;            /**< Destroy requested */
+    pthread_t thread;        /**< Exporter thread */
+    pthread_mutex_t mutex;   /**< Protects the queue, counters and stopping */
+    pthread_cond_t cond;     /**< Signals spans to write and stopping */
+};
+
+/**
+ * @brief Context of the call running on this thread
+ */
+static __thread trace_context current;
+
+/**
+ * @brief State of this thread's id generator, seeded on first use
+ */
+static __thread uint64_t rng_state;
+
+/**
+ * @brief Returns the next pseudo-random number of this thread
+ * @return 64 random bits
+ *
+ * xorshift64*, seeded from the kernel once per thread: ids must be
+ * unique, not unpredictable, and the kernel is too slow per request.
+ */
+static uint64_t next_random(void)
+{
+    while (!rng_state)
+    {
+        if (getrandom(&rng_state, sizeof(rng_state), 0) != sizeof(rng_state))
+        {
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            rng_state = (uint64_t)ts.tv_nsec ^ (uint64_t)ts.tv_sec << 32 ^ (uintptr_t)&ts;
+        }
+    }
+
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 0x2545F4914F6CDD1Dull;
+}
+
+/**
+ * @brief Fills an id with random bytes, never all zero
+ * @param id Id
+ * @param len Id length, a multiple of 8
+ */
+static void random_id(uint8_t *id, size_t len)
+{
+    for (size_t i = 0; i < len; i += 8)
+    {
+        uint64_t value = next_random();
+        memcpy(id + i, &value, 8);
+    }
+    id[len - 1] |= 1;
+}
+
+/**
+ * @brief Decodes hex digits
+ * @param text Hex digits
+ * @param out Decoded bytes
+ * @param len Number of bytes
+ * @return 0 on success, -1 on a non-hex digit
+ */
+static int parse_hex(const char *text, uint8_t *out, size_t len)
+{
+    for (size_t i = 0; i < len * 2; i++)
+    {
+        char c = text[i];
+        int v = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+        if (v == -1)
+            return -1;
+        out[i / 2] = (uint8_t)(i % 2 ? out[i / 2] | v : v << 4);
+    }
+    return 0;
+}
+
+/**
+ * @brief Encodes bytes as lowercase hex
+ * @param in Bytes
+ * @param len Number of bytes
+ * @param text Output of 2 * len characters, not terminated
+ */
+static void format_hex(const uint8_t *in, size_t len, char *text)
+{
+    static const char digits[] = "0123456789abcdef";
+    for (size_t i = 0; i < len; i++)
+    {
+        text[2 * i] = digits[in[i] >> 4];
+        text[2 * i + 1] = digits[in[i] & 15];
+    }
+}
+
+/**
+ * @brief Tells whether an id is all zero, which W3C reserves as invalid
+ * @param id Id
+ * @param len Id length
+ * @return Non-zero if zero
+ */
+static int is_zero(const uint8_t *id, size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+    {
+        if (id[i])
+            return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief Parses a traceparent
+ * @param text traceparent string
+ * @param context Filled in on success
+ * @return 0 on success, -1 if malformed
+ */
+int trace_parse(const char *text, trace_context *context)
+{
+    uint8_t flags;
+    trace_context parsed = {0};
+    if (!text || strlen(text) != TRACEPARENT_LEN || strncmp(text, "00-", 3) != 0 ||
+        text[35] != '-' || text[52] != '-' || parse_hex(text + 3, parsed.trace_id, 16) == -1 ||
+        parse_hex(text + 36, parsed.parent_id, 8) == -1 || parse_hex(text + 53, &flags, 1) == -1 ||
+        is_zero(parsed.trace_id, 16) || is_zero(parsed.parent_id, 8))
+        return -1;
+
+    parsed.sampled = flags & 1;
+    parsed.valid = 1;
+    *context = parsed;
+    return 0;
+}
+
+/**
+ * @brief Formats a context's trace and span ids as a traceparent
+ * @param context Valid context
+ * @param text Buffer of at least TRACEPARENT_LEN + 1 bytes
+ */
+void trace_format(const trace_context *context, char *text)
+{
+    memcpy(text, "00-", 3);
+    format_hex(context->trace_id, 16, text + 3);
+    text[35] = '-';
+    format_hex(context->span_id, 8, text + 36);
+    memcpy(text + 52, context->sampled ? "-01" : "-00", 4);
+}
+
+/**
+ * @brief Continues an incoming trace or starts a new one
+ * @param incoming Parsed traceparent of the request, or NULL
+ * @param sample_rate Fraction of new traces sampled
+ * @param context Set to the context of the new span
+ */
+void trace_start(const trace_context *incoming, double sample_rate, trace_context *context)
+{
+    if (incoming && incoming->valid)
+    {
+        *context = *incoming;
+    }
+    else
+    {
+        *context = (trace_context){.valid = 1};
+        random_id(context->trace_id, 16);
+        context->sampled = (double)(next_random() >> 11) * 0x1.0p-53 < sample_rate;
+    }
+    random_id(context->span_id, 8);
+}
+
+/**
+ * @brief Context of the call running on this thread
+ * @return Context, with valid 0 if none
+ */
+const trace_context *trace_current(void)
+{
+    return &current;
+}
+
+/**
+ * @brief Sets or clears the context of this thread
+ * @param context Context to copy, or NULL to clear
+ */
+void trace_set_current(const trace_context *context)
+{
+    if (context)
+        current = *context;
+    else
+        current.valid = 0;
+}
+
+/**
+ * @brief Returns a clock reading in nanoseconds
+ * @param clock CLOCK_MONOTONIC or CLOCK_REALTIME
+ * @return Nanoseconds
+ */
+static uint64_t clock_ns(clockid_t clock)
+{
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief Allocates a span for a sampled call
+ * @param context Context of the span
+ * @param name Method name (copied)
+ * @param start_ns Monotonic time the request was dispatched
+ * @return Span or NULL on allocation failure
+ */
+trace_span *trace_span_create(const trace_context *context, const char *name,
+                              unsigned long start_ns)
+{
+    trace_span *span = calloc(1, sizeof(trace_span));
+    if (!span)
+        return NULL;
+
+    span->name = strdup(name);
+    if (!span->name)
+    {
+        free(span);
+        return NULL;
+    }
+
+    span->context = *context;
+    span->start_ns = start_ns;
+    span->start_unix_ns = clock_ns(CLOCK_REALTIME) - (clock_ns(CLOCK_MONOTONIC) - start_ns);
+    return span;
+}
+
+/**
+ * @brief Frees a span
+ * @param span Span
+ */
+static void span_free(trace_span *span)
+{
+    free(span->name);
+    free(span);
+}
+
+/**
+ * @brief Adds an OTLP attribute
+ * @param attributes Attribute array
+ * @param key Attribute name
+ * @param type OTLP value type, "stringValue" or "intValue"
+ * @param value Value text (int64 values are strings in OTLP JSON)
+ */
+static void add_attribute(cJSON *attributes, const char *key, const char *type, const char *value)
+{
+    cJSON *attribute = cJSON_CreateObject();
+    cJSON *wrapped = cJSON_CreateObject();
+    cJSON_AddStringToObject(attribute, "key", key);
+    cJSON_AddStringToObject(wrapped, type, value);
+    cJSON_AddItemToObject(attribute, "value", wrapped);
+    cJSON_AddItemToArray(attributes, attribute);
+}
+
+/**
+ * @brief Adds a phase duration attribute
+ * @param attributes Attribute array
+ * @param key Attribute name
+ * @param from Phase start, monotonic
+ * @param to Phase end, monotonic, 0 if the phase did not run
+ */
+static void add_duration(cJSON *attributes, const char *key, unsigned long from, unsigned long to)
+{
+    if (!from || !to)
+        return;
+
+    char text[24];
+    snprintf(text, sizeof(text), "%lu", to - from);
+    add_attribute(attributes, key, "intValue", text);
+}
+
+/**
+ * @brief Converts a span to OTLP JSON
+ * @param span Finished span
+ * @return Span object or NULL
+ */
+static cJSON *span_json(const trace_span *span)
+{
+    char hex[33];
+    char number[24];
+    cJSON *json = cJSON_CreateObject();
+    if (!json)
+        return NULL;
+
+    format_hex(span->context.trace_id, 16, hex);
+    hex[32] = '\0';
+    cJSON_AddStringToObject(json, "traceId", hex);
+    format_hex(span->context.span_id, 8, hex);
+    hex[16] = '\0';
+    cJSON_AddStringToObject(json, "spanId", hex);
+    if (!is_zero(span->context.parent_id, 8))
+    {
+        format_hex(span->context.parent_id, 8, hex);
+        cJSON_AddStringToObject(json, "parentSpanId", hex);
+    }
+    cJSON_AddStringToObject(json, "name", span->name);
+    cJSON_AddNumberToObject(json, "kind", 2); // SPAN_KIND_SERVER
+
+    snprintf(number, sizeof(number), "%llu", (unsigned long long)span->start_unix_ns);
+    cJSON_AddStringToObject(json, "startTimeUnixNano", number);
+    snprintf(number, sizeof(number), "%llu",
+             (unsigned long long)(span->start_unix_ns + (span->end_ns - span->start_ns)));
+    cJSON_AddStringToObject(json, "endTimeUnixNano", number);
+
+    cJSON *attributes = cJSON_AddArrayToObject(json, "attributes");
+    add_attribute(attributes, "rpc.system", "stringValue", "sockrpc");
+    add_attribute(attributes, "rpc.method", "stringValue", span->name);
+    add_duration(attributes, "sockrpc.queue_ns", span->start_ns, span->handler_ns);
+    add_duration(attributes, "sockrpc.handler_ns", span->handler_ns, span->handler_end_ns);
+    add_duration(attributes, "sockrpc.send_ns", span->handler_end_ns, span->end_ns);
+
+    cJSON *status = cJSON_AddObjectToObject(json, "status");
+    cJSON_AddNumberToObject(status, "code", span->error ? 2 : 1); // ERROR or OK
+    if (span->error)
+        cJSON_AddStringToObject(status, "message", span->error);
+    return json;
+}
+
+/**
+ * @brief Writes a batch of spans as one ExportTraceServiceRequest line
+ * @param exporter Exporter (mutex not held)
+ * @param spans Spans linked through next, freed
+ * @return Number of spans written
+ */
+static size_t write_batch(trace_exporter *exporter, trace_span *spans)
+{
+    cJSON *request = cJSON_CreateObject();
+    cJSON *resource_spans = cJSON_AddArrayToObject(request, "resourceSpans");
+    cJSON *entry = cJSON_CreateObject();
+    cJSON_AddItemToArray(resource_spans, entry);
+
+    cJSON *resource = cJSON_AddObjectToObject(entry, "resource");
+    add_attribute(cJSON_AddArrayToObject(resource, "attributes"), "service.name", "stringValue",
+                  exporter->service);
+    cJSON *scope_spans = cJSON_AddArrayToObject(entry, "scopeSpans");
+    cJSON *scope_entry = cJSON_CreateObject();
+    cJSON_AddItemToArray(scope_spans, scope_entry);
+    cJSON_AddStringToObject(cJSON_AddObjectToObject(scope_entry, "scope"), "name", "sockrpc");
+    cJSON *list = cJSON_AddArrayToObject(scope_entry, "spans");
+
+    size_t count = 0;
+    while (spans)
+    {
+        trace_span *next = spans->next;
+        cJSON *json = span_json(spans);
+        if (json)
+        {
+            cJSON_AddItemToArray(list, json);
+            count++;
+        }
+        span_free(spans);
+        spans = next;
+    }
+
+    char *line = cJSON_PrintUnformatted(request);
+    cJSON_Delete(request);
+    if (!line)
+        return 0;
+
+    fprintf(exporter->file, "%s\n", line);
+    fflush(exporter->file);
+    free(line);
+    return count;
+}
+
+/**
+ * @brief Exporter thread main function
+ * @param arg Exporter
+ * @return NULL
+ *
+ * Sleeps without a timeout while nothing is queued. Once a span is
+ * queued, waits until a batch is full, flush_ms have passed or the
+ * exporter stops, then writes everything queued.
+ */
+static void *exporter_routine(void *arg)
+{
+    trace_exporter *exporter = arg;
+
+    pthread_mutex_lock(&exporter->mutex);
+    while (1)
+    {
+        while (!exporter->head && !exporter->stopping)
+            pthread_cond_wait(&exporter->cond, &exporter->mutex);
+        if (!exporter->head)
+            break;
+
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += exporter->flush_ms / 1000;
+        deadline.tv_nsec += (long)(exporter->flush_ms % 1000) * 1000000;
+        if (deadline.tv_nsec >= 1000000000)
+        {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+        while (exporter->queued < exporter->batch_size && !exporter->stopping)
+        {
+            if (pthread_cond_timedwait(&exporter->cond, &exporter->mutex, &deadline) == ETIMEDOUT)
+                break;
+        }
+
+        trace_span *spans = exporter->head;
+        exporter->head = exporter->tail = NULL;
+        exporter->queued = 0;
+        pthread_mutex_unlock(&exporter->mutex);
+
+        size_t written = write_batch(exporter, spans);
+
+        pthread_mutex_lock(&exporter->mutex);
+        exporter->exported += written;
+        exporter->batches++;
+    }
+    pthread_mutex_unlock(&exporter->mutex);
+
+    return NULL;
+}
+
+/**
+ * @brief Starts the exporter thread
+ * @param config Tracing configuration
+ * @return Exporter or NULL on error
+ */
+trace_exporter *trace_exporter_create(const sockrpc_trace_config *config)
+{
+    trace_exporter *exporter = calloc(1, sizeof(trace_exporter));
+    if (!exporter)
+        return NULL;
+
+    exporter->service = strdup(config->service ? config->service : "sockrpc");
+    exporter->file = fopen(config->path, "a");
+    if (!exporter->service || !exporter->file)
+    {
+        if (exporter->file)
+            fclose(exporter->file);
+        free(exporter->service);
+        free(exporter);
+        return NULL;
+    }
+
+    exporter->sample_rate = config->sample_rate;
+    exporter->batch_size = config->batch_size ? config->batch_size : TRACE_DEFAULT_BATCH;
+    exporter->flush_ms = config->flush_ms ? config->flush_ms : TRACE_DEFAULT_FLUSH_MS;
+    exporter->queue_limit = exporter->batch_size * TRACE_QUEUE_BATCHES;
+    pthread_mutex_init(&exporter->mutex, NULL);
+    pthread_cond_init(&exporter->cond, NULL);
+
+    if (pthread_create(&exporter->thread, NULL, exporter_routine, exporter) != 0)
+    {
+        pthread_cond_destroy(&exporter->cond);
+        pthread_mutex_destroy(&exporter->mutex);
+        fclose(exporter->file);
+        free(exporter->service);
+        free(exporter);
+        return NULL;
+    }
+    return exporter;
+}
+
+/**
+ * @brief Sample rate configured for new traces
+ * @param exporter Exporter
+ * @return Fraction between 0 and 1
+ */
+double trace_exporter_sample_rate(const trace_exporter *exporter)
+{
+    return exporter->sample_rate;
+}
+
+/**
+ * @brief Queues a finished span for export
+ * @param exporter Exporter
+ * @param span Span (ownership transferred)
+ *
+ * The exporter is only woken for the first span of a batch and when a
+ * batch is full, not for every span.
+ */
+void trace_exporter_submit(trace_exporter *exporter, trace_span *span)
+{
+    pthread_mutex_lock(&exporter->mutex);
+    exporter->spans++;
+    if (exporter->queued >= exporter->queue_limit)
+    {
+        exporter->dropped++;
+        pthread_mutex_unlock(&exporter->mutex);
+        span_free(span);
+        return;
+    }
+
+    span->next = NULL;
+    if (exporter->tail)
+        exporter->tail->next = span;
+    else
+        exporter->head = span;
+    exporter->tail = span;
+    exporter->queued++;
+    if (exporter->queued == 1 || exporter->queued == exporter->batch_size)
+        pthread_cond_signal(&exporter->cond);
+    pthread_mutex_unlock(&exporter->mutex);
+}
+
+/**
+ * @brief Reports export counters
+ * @param exporter Exporter
+ * @return Counters as JSON or NULL
+ */
+cJSON *trace_exporter_stats(trace_exporter *exporter)
+{
+    cJSON *stats = cJSON_CreateObject();
+    if (!stats)
+        return NULL;
+
+    pthread_mutex_lock(&exporter->mutex);
+    cJSON_AddNumberToObject(stats, "sample_rate", exporter->sample_rate);
+    cJSON_AddNumberToObject(stats, "spans", exporter->spans);
+    cJSON_AddNumberToObject(stats, "exported", exporter->exported);
+    cJSON_AddNumberToObject(stats, "dropped", exporter->dropped);
+    cJSON_AddNumberToObject(stats, "batches", exporter->batches);
+    pthread_mutex_unlock(&exporter->mutex);
+    return stats;
+}
+
+/**
+ * @brief Writes the queued spans, stops the thread and closes the file
+ * @param exporter Exporter, may be NULL
+ */
+void trace_exporter_destroy(trace_exporter *exporter)
+{
+    if (!exporter)
+        return;
+
+    pthread_mutex_lock(&exporter->mutex);
+    exporter->stopping = 1;
+    pthread_cond_signal(&exporter->cond);
+    pthread_mutex_unlock(&exporter->mutex);
+    pthread_join(exporter->thread, NULL);
+
+    pthread_cond_destroy(&exporter->cond);
+    pthread_mutex_destroy(&exporter->mutex);
+    fclose(exporter->file);
+    free(exporter->service);
+    free(exporter);
+}
+
+/**
+ * @brief Copies the traceparent of the call running on this thread
+ * @param buffer Output buffer
+ * @param size Buffer size, at least SOCKRPC_TRACEPARENT_SIZE
+ * @return 0 on success, -1 if no trace is active or the buffer is small
+ */
+int sockrpc_trace_current(char *buffer, size_t size)
+{
+    if (!buffer || size < TRACEPARENT_LEN + 1 || !current.valid)
+        return -1;
+
+    trace_format(&current, buffer);
+    return 0;
+}
@@ -0,0 +1,154 @@
+#ifndef SOCKRPC_TRACE_H
+#define SOCKRPC_TRACE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "sockrpc/sockrpc.h"
+
+/**
+ * @file trace.h
+ * @brief Internal trace context propagation and span export
+ *
+ * Requests may carry a "trace" member holding a W3C traceparent:
+ * "00-<32 hex trace id>-<16 hex parent span id>-<2 hex flags>", where
+ * flag 01 means sampled. A server continues an incoming trace with a
+ * span of its own, or starts one when tracing is enabled, and makes it
+ * the current context of the thread running the handler. Client calls
+ * made from that thread send the current context, so the chain crosses
+ * any number of servers.
+ *
+ * Sampled spans are finished on the request threads and handed to an
+ * exporter thread, which appends them in batches to a file, one OTLP
+ * JSON ExportTraceServiceRequest per line. Request threads never wait
+ * for the file: when the exporter falls behind, spans are dropped and
+ * counted.
+ */
+
+/**
+ * @brief Request member carrying the traceparent
+ */
+#define TRACE_FIELD "trace"
+
+/**
+ * @brief Length of a traceparent string
+ */
+#define TRACEPARENT_LEN 55
+
+/**
+ * @brief Position of a call in a trace
+ */
+typedef struct
+{
+    uint8_t trace_id[16]; /**< Trace shared by every span of a request chain */
+    uint8_t span_id[8];   /**< Span of the current call */
+    uint8_t parent_id[8]; /**< Caller's span, zero for a root span */
+    int sampled;          /**< Spans of this trace are recorded */
+    int valid;            /**< Context is set */
+} trace_context;
+
+/**
+ * @brief Finished or running server span
+ *
+ * Phase timestamps are monotonic; start_unix_ns anchors them to the
+ * wall clock for export.
+ */
+typedef struct trace_span
+{
+    trace_context context;       /**< Ids of the span */
+    char *name;                  /**< Method name */
+    uint64_t start_unix_ns;      /**< Wall clock when the request was dispatched */
+    unsigned long start_ns;      /**< Request dispatched */
+    unsigned long handler_ns;    /**< Handler started */
+    unsigned long handler_end_ns; /**< Handler returned */
+    unsigned long end_ns;        /**< Response sent */
+    const char *error;           /**< Error sent instead of a result, or NULL */
+    struct trace_span *next;     /**< Next span in the exporter queue */
+} trace_span;
+
+/**
+ * @brief Background writer of finished spans
+ */
+typedef struct trace_exporter trace_exporter;
+
+/**
+ * @brief Parses a traceparent
+ * @param text traceparent string
+ * @param context Filled in on success; parent_id is the sender's span
+ * @return 0 on success, -1 if malformed
+ */
+int trace_parse(const char *text, trace_context *context);
+
+/**
+ * @brief Formats a context's trace and span ids as a traceparent
+ * @param context Valid context
+ * @param text Buffer of at least TRACEPARENT_LEN + 1 bytes
+ */
+void trace_format(const trace_context *context, char *text);
+
+/**
+ * @brief Continues an incoming trace or starts a new one
+ * @param incoming Parsed traceparent of the request, or NULL
+ * @param sample_rate Fraction of new traces sampled
+ * @param context Set to the context of the new span
+ *
+ * Incoming traces keep their sampling decision.
+ */
+void trace_start(const trace_context *incoming, double sample_rate, trace_context *context);
+
+/**
+ * @brief Context of the call running on this thread
+ * @return Context, with valid 0 if none
+ */
+const trace_context *trace_current(void);
+
+/**
+ * @brief Sets or clears the context of this thread
+ * @param context Context to copy, or NULL to clear
+ */
+void trace_set_current(const trace_context *context);
+
+/**
+ * @brief Starts the exporter thread
+ * @param config Tracing configuration
+ * @return Exporter or NULL if the file cannot be opened
+ */
+trace_exporter *trace_exporter_create(const sockrpc_trace_config *config);
+
+/**
+ * @brief Sample rate configured for new traces
+ * @param exporter Exporter
+ * @return Fraction between 0 and 1
+ */
+double trace_exporter_sample_rate(const trace_exporter *exporter);
+
+/**
+ * @brief Allocates a span for a sampled call
+ * @param context Context of the span
+ * @param name Method name (copied)
+ * @param start_ns Monotonic time the request was dispatched
+ * @return Span or NULL on allocation failure
+ */
+trace_span *trace_span_create(const trace_context *context, const char *name,
+                              unsigned long start_ns);
+
+/**
+ * @brief Queues a finished span for export, never blocking on I/O
+ * @param exporter Exporter
+ * @param span Span (ownership transferred, freed if dropped)
+ */
+void trace_exporter_submit(trace_exporter *exporter, trace_span *span);
+
+/**
+ * @brief Reports export counters
+ * @param exporter Exporter
+ * @return {"sample_rate", "spans", "exported", "dropped", "batches"} or NULL
+ */
+cJSON *trace_exporter_stats(trace_exporter *exporter);
+
+/**
+ * @brief Writes the queued spans, stops the thread and closes the file
+ * @param exporter Exporter, may be NULL
+ */
+void trace_exporter_destroy(trace_exporter *exporter);
+
+#endif /* SOCKRPC_TRACE_H */
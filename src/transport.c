@@ -0,0 +1,309 @@
+#include <errno.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include "transport.h"
+
+/**
+ * @file transport.c
+ * @brief Implementation of the internal transport layer
+ *
+ * Names starting with '@' map to the Linux abstract namespace: the
+ * address starts with a NUL byte, no filesystem inode is created and the
+ * name disappears when the last socket bound to it is closed, so there
+ * are never stale socket files to unlink.
+ *
+ * TCP connections are tuned for request/response traffic: small messages
+ * are sent immediately (TCP_NODELAY) and dead peers are detected by
+ * keepalive probes instead of hanging forever.
+ */
+
+/**
+ * @brief Idle time in seconds before the first TCP keepalive probe
+ */
+#define TRANSPORT_KEEPALIVE_IDLE 30
+
+/**
+ * @brief Interval in seconds between TCP keepalive probes
+ */
+#define TRANSPORT_KEEPALIVE_INTERVAL 10
+
+/**
+ * @brief Unanswered probes before a TCP connection is dropped
+ */
+#define TRANSPORT_KEEPALIVE_COUNT 3
+
+/**
+ * @brief Resolves a Unix socket name
+ * @param name Filesystem path, or "@name" for the abstract namespace
+ * @param out Resolved address (socktype already set)
+ * @return 0 on success, -1 if the name is empty or too long
+ *
+ * Abstract names are not NUL-terminated, so the address length covers
+ * exactly the leading NUL plus the name bytes.
+ */
+static int resolve_unix(const char *name, transport_address *out)
+{
+    struct sockaddr_un *addr = (struct sockaddr_un *)&out->addr;
+    if (name[0] == '\0')
+        return -1;
+
+    out->kind = TRANSPORT_UNIX;
+    addr->sun_family = AF_UNIX;
+
+    if (name[0] == '@')
+    {
+        size_t len = strlen(name + 1);
+        if (len == 0 || len > sizeof(addr->sun_path) - 1)
+            return -1;
+
+        memcpy(addr->sun_path + 1, name + 1, len);
+        out->len = offsetof(struct sockaddr_un, sun_path) + 1 + len;
+        out->abstract = 1;
+        return 0;
+    }
+
+    size_t len = strlen(name);
+    if (len > sizeof(addr->sun_path) - 1)
+        return -1;
+
+    memcpy(addr->sun_path, name, len);
+    memcpy(out->path, name, len);
+    out->len = sizeof(struct sockaddr_un);
+    out->abstract = 0;
+    return 0;
+}
+
+/**
+ * @brief Resolves a "host:port" or "[v6addr]:port" TCP endpoint
+ * @param hostport Endpoint text following "tcp://"
+ * @param numeric Refuse host names instead of looking them up
+ * @param out Resolved address
+ * @return 0 on success, -1 on error
+ */
+static int resolve_tcp(const char *hostport, int numeric, transport_address *out)
+{
+    char host[256];
+    const char *port;
+
+    if (hostport[0] == '[')
+    {
+        const char *end = strchr(hostport, ']');
+        if (!end || end[1] != ':' || (size_t)(end - hostport - 1) >= sizeof(host))
+            return -1;
+        memcpy(host, hostport + 1, end - hostport - 1);
+        host[end - hostport - 1] = '\0';
+        port = end + 2;
+    }
+    else
+    {
+        const char *colon = strrchr(hostport, ':');
+        if (!colon || (size_t)(colon - hostport) >= sizeof(host))
+            return -1;
+        memcpy(host, hostport, colon - hostport);
+        host[colon - hostport] = '\0';
+        port = colon + 1;
+    }
+
+    if (port[0] == '\0')
+        return -1;
+
+    struct addrinfo hints = {
+        .ai_family = AF_UNSPEC,
+        .ai_socktype = SOCK_STREAM,
+        .ai_flags = AI_NUMERICSERV | (numeric ? AI_NUMERICHOST : 0) |
+                    (host[0] == '\0' ? AI_PASSIVE : 0)};
+    struct addrinfo *res = NULL;
+    if (getaddrinfo(host[0] ? host : NULL, port, &hints, &res) != 0 || !res)
+        return -1;
+
+    memcpy(&out->addr, res->ai_addr, res->ai_addrlen);
+    out->len = res->ai_addrlen;
+    out->kind = TRANSPORT_TCP;
+    out->socktype = SOCK_STREAM;
+    freeaddrinfo(res);
+    return 0;
+}
+
+/**
+ * @brief Resolves an address string
+ * @param address Path, abstract name or URL
+ * @param socktype Socket type for Unix addresses without explicit scheme
+ * @param numeric Refuse TCP host names instead of looking them up
+ * @param out Resolved address
+ * @return 0 on success, -1 on error
+ */
+static int resolve(const char *address, int socktype, int numeric, transport_address *out)
+{
+    if (!address || !out)
+        return -1;
+
+    memset(out, 0, sizeof(*out));
+    out->socktype = socktype;
+
+    if (strncmp(address, "tcp://", 6) == 0)
+        return resolve_tcp(address + 6, numeric, out);
+
+    if (strncmp(address, "unix://", 7) == 0)
+        return resolve_unix(address + 7, out);
+
+    if (strncmp(address, "unixpacket://", 13) == 0)
+    {
+        out->socktype = SOCK_SEQPACKET;
+        return resolve_unix(address + 13, out);
+    }
+
+    if (strstr(address, "://"))
+        return -1; // Unknown scheme
+
+    return resolve_unix(address, out);
+}
+
+/**
+ * @brief Resolves an address string
+ * @param address Path, abstract name or URL
+ * @param socktype Socket type for Unix addresses without explicit scheme
+ * @param out Resolved address
+ * @return 0 on success, -1 on error
+ */
+int transport_resolve(const char *address, int socktype, transport_address *out)
+{
+    return resolve(address, socktype, 0, out);
+}
+
+/**
+ * @brief Resolves an address string without DNS lookups
+ * @param address Path, abstract name or URL with a numeric TCP host
+ * @param socktype Socket type for Unix addresses without explicit scheme
+ * @param out Resolved address
+ * @return 0 on success, -1 on error or TCP host name
+ */
+int transport_resolve_numeric(const char *address, int socktype, transport_address *out)
+{
+    return resolve(address, socktype, 1, out);
+}
+
+/**
+ * @brief Creates a non-blocking listening socket
+ * @param address Resolved address (bound port written back for TCP)
+ * @param reuseport Set SO_REUSEPORT before binding (TCP only)
+ * @return Listening socket or -1 on error
+ */
+int transport_listen(transport_address *address, int reuseport)
+{
+    int family = address->kind == TRANSPORT_TCP ? address->addr.ss_family : AF_UNIX;
+    int fd = socket(family, address->socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd == -1)
+        return -1;
+
+    if (address->kind == TRANSPORT_TCP)
+    {
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if (reuseport && setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) == -1)
+        {
+            close(fd);
+            return -1;
+        }
+    }
+    else if (!address->abstract)
+    {
+        unlink(address->path);
+    }
+
+    if (bind(fd, (struct sockaddr *)&address->addr, address->len) == -1 ||
+        listen(fd, SOMAXCONN) == -1)
+    {
+        close(fd);
+        return -1;
+    }
+
+    // Pin an ephemeral port so further SO_REUSEPORT listeners share it
+    if (address->kind == TRANSPORT_TCP)
+    {
+        address->len = sizeof(address->addr);
+        getsockname(fd, (struct sockaddr *)&address->addr, &address->len);
+    }
+
+    return fd;
+}
+
+/**
+ * @brief Creates a blocking socket connected to address
+ * @param address Resolved address
+ * @return Connected and tuned socket or -1 on error
+ */
+int transport_connect(const transport_address *address)
+{
+    int family = address->kind == TRANSPORT_TCP ? address->addr.ss_family : AF_UNIX;
+    int fd = socket(family, address->socktype | SOCK_CLOEXEC, 0);
+    if (fd == -1)
+        return -1;
+
+    if (connect(fd, (const struct sockaddr *)&address->addr, address->len) == -1)
+    {
+        close(fd);
+        return -1;
+    }
+
+    transport_tune(fd);
+    return fd;
+}
+
+/**
+ * @brief Starts connecting a non-blocking socket to address
+ * @param address Resolved address
+ * @param in_progress Set to 1 while the connection is being established
+ * @return Tuned, non-blocking socket or -1 on error
+ *
+ * TCP connections usually complete later; Unix connections complete or
+ * fail at once.
+ */
+int transport_connect_nonblocking(const transport_address *address, int *in_progress)
+{
+    int family = address->kind == TRANSPORT_TCP ? address->addr.ss_family : AF_UNIX;
+    int fd = socket(family, address->socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd == -1)
+        return -1;
+
+    *in_progress = 0;
+    if (connect(fd, (const struct sockaddr *)&address->addr, address->len) == -1)
+    {
+        if (errno != EINPROGRESS)
+        {
+            close(fd);
+            return -1;
+        }
+        *in_progress = 1;
+    }
+
+    transport_tune(fd);
+    return fd;
+}
+
+/**
+ * @brief Applies TCP_NODELAY and keepalive settings to TCP sockets
+ * @param fd Connected socket
+ */
+void transport_tune(int fd)
+{
+    struct sockaddr_storage addr;
+    socklen_t len = sizeof(addr);
+    if (getsockname(fd, (struct sockaddr *)&addr, &len) == -1 ||
+        (addr.ss_family != AF_INET && addr.ss_family != AF_INET6))
+        return;
+
+    int one = 1;
+    int idle = TRANSPORT_KEEPALIVE_IDLE;
+    int interval = TRANSPORT_KEEPALIVE_INTERVAL;
+    int count = TRANSPORT_KEEPALIVE_COUNT;
+
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &one, sizeof(one));
+    setsockopt(fd, IPPROTO_TCP, TCP_KEEPIDLE, &idle, sizeof(idle));
+    setsockopt(fd, IPPROTO_TCP, TCP_KEEPINTVL, &interval, sizeof(interval));
+    setsockopt(fd, IPPROTO_TCP, TCP_KEEPCNT, &count, sizeof(count));
+}
@@ -0,0 +1,103 @@
+#ifndef SOCKRPC_TRANSPORT_H
+#define SOCKRPC_TRANSPORT_H
+
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/**
+ * @file transport.h
+ * @brief Internal transport layer shared by client and server
+ *
+ * Not part of the public API. Both sides resolve addresses and create
+ * sockets through these helpers so that address syntax and socket
+ * tuning behave identically everywhere.
+ *
+ * Accepted address forms:
+ * - "/path/to.sock" or "unix:///path/to.sock": Unix domain socket
+ * - "@name" or "unix://@name": Linux abstract-namespace socket
+ * - "unixpacket:///path" or "unixpacket://@name": SOCK_SEQPACKET socket
+ * - "tcp://host:port" or "tcp://[v6addr]:port": TCP socket
+ */
+
+/**
+ * @brief Address family of a resolved transport address
+ */
+typedef enum
+{
+    TRANSPORT_UNIX, /**< Unix domain socket */
+    TRANSPORT_TCP   /**< TCP over IPv4 or IPv6 */
+} transport_kind;
+
+/**
+ * @brief Resolved transport address
+ */
+typedef struct
+{
+    transport_kind kind;          /**< Unix or TCP */
+    int socktype;                 /**< SOCK_STREAM or SOCK_SEQPACKET */
+    struct sockaddr_storage addr; /**< Address ready for bind/connect */
+    socklen_t len;                /**< Significant length of addr */
+    int abstract;                 /**< Non-zero for abstract-namespace names */
+    char path[108];               /**< Filesystem path (Unix, non-abstract) */
+} transport_address;
+
+/**
+ * @brief Resolves an address string
+ * @param address Path, abstract name or URL (see file description)
+ * @param socktype Socket type for Unix addresses without an explicit
+ *        "unixpacket" scheme (SOCK_STREAM or SOCK_SEQPACKET)
+ * @param out Resolved address
+ * @return 0 on success, -1 on malformed or unresolvable addresses
+ *
+ * TCP addresses are always SOCK_STREAM.
+ */
+int transport_resolve(const char *address, int socktype, transport_address *out);
+
+/**
+ * @brief Resolves an address string without looking up host names
+ * @param address Path, abstract name or URL (see file description)
+ * @param socktype Socket type as for transport_resolve
+ * @param out Resolved address
+ * @return 0 on success, -1 on malformed addresses or TCP host names
+ *
+ * Never waits on DNS, so event loops can resolve addresses inline.
+ */
+int transport_resolve_numeric(const char *address, int socktype, transport_address *out);
+
+/**
+ * @brief Creates a non-blocking listening socket
+ * @param address Resolved address (updated with the bound port for TCP)
+ * @param reuseport Set SO_REUSEPORT so several listeners share the port
+ * @return Listening socket or -1 on error
+ *
+ * Stale Unix socket files are removed before binding.
+ */
+int transport_listen(transport_address *address, int reuseport);
+
+/**
+ * @brief Creates a blocking socket connected to address
+ * @param address Resolved address
+ * @return Connected socket or -1 on error
+ */
+int transport_connect(const transport_address *address);
+
+/**
+ * @brief Starts connecting a non-blocking socket to address
+ * @param address Resolved address
+ * @param in_progress Set to 1 if the connection completes later, when
+ *        the socket becomes writable (check SO_ERROR), 0 if it is
+ *        already connected
+ * @return Non-blocking socket or -1 on error
+ */
+int transport_connect_nonblocking(const transport_address *address, int *in_progress);
+
+/**
+ * @brief Applies per-connection socket options
+ * @param fd Connected socket
+ *
+ * For TCP sockets: disables Nagle's algorithm (TCP_NODELAY) and enables
+ * keepalive with TRANSPORT_KEEPALIVE_* timings. No-op for Unix sockets.
+ */
+void transport_tune(int fd);
+
+#endif /* SOCKRPC_TRANSPORT_H */
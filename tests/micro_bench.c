@@ -0,0 +1,354 @@
+#include "../src/server.c"
+#include <math.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_RDTSC 1
+#else
+#define HAVE_RDTSC 0
+#endif
+
+/*
+ * Microbenchmarks of the library's internal stages, without sockets,
+ * threads or scheduling noise in the way: method lookup, worker
+ * selection, framing, JSON parsing and printing of typical messages,
+ * buffer pools, the connection slab and the flight recorder.
+ *
+ * The server's static functions are reached by compiling server.c into
+ * this file; every other module comes from libsockrpc.
+ *
+ * Each case is calibrated to run about CALIBRATION_NS per repetition,
+ * warmed up, then timed over a number of repetitions. The report gives
+ * min, median, mean and standard deviation in ns per operation and the
+ * median in TSC cycles per operation (x86 only; TSC cycles tick at a
+ * fixed rate, not the core clock).
+ *
+ * Usage: micro_bench [-r repetitions] [name filter]
+ */
+
+#define CALIBRATION_NS 5000000ull
+#define WARMUP_REPETITIONS 3
+#define DEFAULT_REPETITIONS 15
+#define MAX_REPETITIONS 1000
+
+typedef struct
+{
+    const char *name;
+    void (*run)(size_t iterations);
+} micro_case;
+
+// Results are folded in here so the compiler cannot drop the work
+static volatile uintptr_t sink;
+
+static sockrpc_server *bench_server;
+static buffer_pool bench_pool;
+static slab_cache bench_slab;
+static recorder bench_recorder;
+static recorder_ring *bench_ring;
+static int pair[2];
+
+static const char request_text[] =
+    "{\"id\":42,\"method\":\"calculate\",\"params\":{\"operation\":\"add\",\"a\":5,\"b\":3}}";
+static cJSON *response_json;
+
+static uint64_t clock_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t cycles_now(void)
+{
+#if HAVE_RDTSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+static cJSON *noop_handler(cJSON *params)
+{
+    (void)params;
+    return NULL;
+}
+
+static void lookup_first(size_t iterations)
+{
+    for (size_t i = 0; i < iterations; i++)
+        sink += (uintptr_t)find_method(bench_server, "method_0");
+}
+
+static void lookup_last(size_t iterations)
+{
+    for (size_t i = 0; i < iterations; i++)
+        sink += (uintptr_t)find_method(bench_server, "method_63");
+}
+
+static void lookup_miss(size_t iterations)
+{
+    for (size_t i = 0; i < iterations; i++)
+        sink += (uintptr_t)find_method(bench_server, "no_such_method");
+}
+
+static void worker_selection(size_t iterations)
+{
+    for (size_t i = 0; i < iterations; i++)
+        sink += (uintptr_t)select_worker(bench_server);
+}
+
+static void frame_header(size_t iterations)
+{
+    unsigned char header[FRAME_HEADER_SIZE];
+    for (size_t i = 0; i < iterations; i++)
+    {
+        size_t len;
+        uint32_t flags;
+        frame_encode_header(header, 100 + (i & 63), 0);
+        sink += (uintptr_t)frame_decode_header(header, &len, &flags) + len;
+    }
+}
+
+static void frame_roundtrip(size_t iterations)
+{
+    for (size_t i = 0; i < iterations; i++)
+    {
+        size_t len;
+        uint32_t flags;
+        frame_status status;
+        frame_send(pair[0], SOCK_STREAM, request_text, sizeof(request_text) - 1, 0);
+        char *payload = frame_recv(pair[1], SOCK_STREAM, &len, &flags, &status);
+        sink += len;
+        free(payload);
+    }
+}
+
+static void json_parse_request(size_t iterations)
+{
+    for (size_t i = 0; i < iterations; i++)
+    {
+        cJSON *request = cJSON_Parse(request_text);
+        sink += (uintptr_t)cJSON_GetObjectItem(request, "method");
+        cJSON_Delete(request);
+    }
+}
+
+static void json_print_response(size_t iterations)
+{
+    for (size_t i = 0; i < iterations; i++)
+    {
+        char *text = cJSON_PrintUnformatted(response_json);
+        sink += (uintptr_t)text[0];
+        free(text);
+    }
+}
+
+static void json_print_pooled(size_t iterations)
+{
+    for (size_t i = 0; i < iterations; i++)
+    {
+        size_t capacity;
+        char *text = pool_acquire(&bench_pool, POOL_MIN_SIZE, &capacity);
+        sink += (uintptr_t)cJSON_PrintPreallocated(response_json, text, (int)capacity, 0);
+        pool_release(&bench_pool, text, capacity);
+    }
+}
+
+static void pool_small(size_t iterations)
+{
+    for (size_t i = 0; i < iterations; i++)
+    {
+        size_t capacity;
+        char *buffer = pool_acquire(&bench_pool, 4096, &capacity);
+        sink += (uintptr_t)buffer;
+        pool_release(&bench_pool, buffer, capacity);
+    }
+}
+
+static void pool_medium(size_t iterations)
+{
+    for (size_t i = 0; i < iterations; i++)
+    {
+        size_t capacity;
+        char *buffer = pool_acquire(&bench_pool, 65536, &capacity);
+        sink += (uintptr_t)buffer;
+        pool_release(&bench_pool, buffer, capacity);
+    }
+}
+
+static void slab_cycle(size_t iterations)
+{
+    for (size_t i = 0; i < iterations; i++)
+    {
+        uint64_t handle;
+        sink += (uintptr_t)slab_alloc(&bench_slab, &handle);
+        slab_free(&bench_slab, handle);
+    }
+}
+
+static void slab_lookups(size_t iterations)
+{
+    uint64_t handle;
+    slab_alloc(&bench_slab, &handle);
+    for (size_t i = 0; i < iterations; i++)
+        sink += (uintptr_t)slab_lookup(&bench_slab, handle);
+    slab_free(&bench_slab, handle);
+}
+
+static void recorder_records(size_t iterations)
+{
+    recorder_sample sample = {.method = "calculate", .start_ns = 1000, .handler_ns = 2000,
+                              .handler_end_ns = 3000, .end_ns = 4000, .request_bytes = 80,
+                              .response_bytes = 40};
+    for (size_t i = 0; i < iterations; i++)
+    {
+        sample.end_ns += i;
+        recorder_record(bench_ring, &sample);
+    }
+}
+
+static const micro_case cases[] = {
+    {"lookup hit first/64", lookup_first},
+    {"lookup hit last/64", lookup_last},
+    {"lookup miss/64", lookup_miss},
+    {"select_worker", worker_selection},
+    {"frame header enc+dec", frame_header},
+    {"frame send+recv 71B", frame_roundtrip},
+    {"json parse request", json_parse_request},
+    {"json print response", json_print_response},
+    {"json print pooled", json_print_pooled},
+    {"pool 4KiB acq+rel", pool_small},
+    {"pool 64KiB acq+rel", pool_medium},
+    {"slab alloc+free", slab_cycle},
+    {"slab lookup", slab_lookups},
+    {"recorder record", recorder_records},
+};
+
+static int compare_double(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static void setup(void)
+{
+    // Not started: only the method table and worker contexts are used
+    bench_server = sockrpc_server_create("/tmp/sockrpc_micro_bench.sock");
+    for (int i = 0; i < 64; i++)
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "method_%d", i);
+        sockrpc_server_register(bench_server, name, noop_handler);
+    }
+
+    pool_init(&bench_pool);
+    slab_init(&bench_slab, sizeof(connection));
+    recorder_init(&bench_recorder);
+    bench_ring = recorder_attach(&bench_recorder, 0);
+    socketpair(AF_UNIX, SOCK_STREAM, 0, pair);
+
+    response_json = cJSON_CreateObject();
+    cJSON_AddNumberToObject(response_json, "id", 42);
+    cJSON *result = cJSON_AddObjectToObject(response_json, "result");
+    cJSON_AddNumberToObject(result, "result", 8);
+    cJSON_AddStringToObject(result, "operation", "add");
+}
+
+static void teardown(void)
+{
+    cJSON_Delete(response_json);
+    close(pair[0]);
+    close(pair[1]);
+    recorder_cleanup(&bench_recorder);
+    slab_cleanup(&bench_slab);
+    pool_cleanup(&bench_pool);
+    sockrpc_server_destroy(bench_server);
+}
+
+static size_t calibrate(const micro_case *mc)
+{
+    size_t iterations = 1;
+    while (iterations < (1ull << 30))
+    {
+        uint64_t start = clock_now_ns();
+        mc->run(iterations);
+        if (clock_now_ns() - start >= CALIBRATION_NS)
+            break;
+        iterations *= 2;
+    }
+    return iterations;
+}
+
+static void run_case(const micro_case *mc, int repetitions)
+{
+    size_t iterations = calibrate(mc);
+    for (int i = 0; i < WARMUP_REPETITIONS; i++)
+        mc->run(iterations);
+
+    double ns[MAX_REPETITIONS], cycles[MAX_REPETITIONS];
+    double sum = 0;
+    for (int r = 0; r < repetitions; r++)
+    {
+        uint64_t start = clock_now_ns();
+        uint64_t start_cycles = cycles_now();
+        mc->run(iterations);
+        uint64_t end_cycles = cycles_now();
+        ns[r] = (double)(clock_now_ns() - start) / iterations;
+        cycles[r] = (double)(end_cycles - start_cycles) / iterations;
+        sum += ns[r];
+    }
+
+    double mean = sum / repetitions;
+    double variance = 0;
+    for (int r = 0; r < repetitions; r++)
+        variance += (ns[r] - mean) * (ns[r] - mean);
+    double stddev = repetitions > 1 ? sqrt(variance / (repetitions - 1)) : 0;
+
+    qsort(ns, repetitions, sizeof(double), compare_double);
+    qsort(cycles, repetitions, sizeof(double), compare_double);
+    printf("%-22s %10zu %9.1f %9.1f %9.1f %8.1f", mc->name, iterations, ns[0],
+           ns[repetitions / 2], mean, stddev);
+    if (HAVE_RDTSC)
+        printf(" %9.0f\n", cycles[repetitions / 2]);
+    else
+        printf(" %9s\n", "-");
+}
+
+int main(int argc, char **argv)
+{
+    int repetitions = DEFAULT_REPETITIONS;
+    int opt;
+    while ((opt = getopt(argc, argv, "r:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'r':
+            repetitions = atoi(optarg);
+            if (repetitions < 1 || repetitions > MAX_REPETITIONS)
+            {
+                fprintf(stderr, "Repetitions must be between 1 and %d\n", MAX_REPETITIONS);
+                return 1;
+            }
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-r repetitions] [name filter]\n", argv[0]);
+            return 1;
+        }
+    }
+    const char *filter = optind < argc ? argv[optind] : NULL;
+
+    signal(SIGPIPE, SIG_IGN);
+    setup();
+
+    printf("%-22s %10s %9s %9s %9s %8s %9s\n", "case", "iters/rep", "min ns", "median ns",
+           "mean ns", "stddev", "cycles");
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++)
+    {
+        if (!filter || strstr(cases[c].name, filter))
+            run_case(&cases[c], repetitions);
+    }
+
+    teardown();
+    return 0;
+}
@@ -0,0 +1,151 @@
+#!/bin/sh
+#
+# Performance regression check: runs the fixed workloads of perf_workload
+# and compares instructions and heap allocations per call against
+# tests/perf_baseline.txt. Fails when a count grows by more than
+# PERF_THRESHOLD percent (default 5).
+#
+# Instructions are counted for the whole process (client and server
+# threads) with callgrind, or with "perf stat" when PERF_TOOL=perf. Each
+# workload runs twice, with N and 2N iterations, and the difference is
+# divided by the extra calls, so startup and shutdown do not count.
+#
+# The check fails when a workload has no instruction count, in the
+# baseline or measured: record the baseline with "make perf-baseline" on
+# a machine with valgrind or perf. PERF_ALLOW_NO_INSTRUCTIONS=1 checks
+# allocations only, for machines without either tool. A missing baseline
+# always fails.
+#
+# Usage: perf_check.sh [--update]
+#   --update  write the measured counts to the baseline instead
+
+cd "$(dirname "$0")" || exit 1
+
+BASELINE=perf_baseline.txt
+THRESHOLD=${PERF_THRESHOLD:-5}
+PERF_TOOL=${PERF_TOOL:-callgrind}
+UPDATE=0
+[ "$1" = "--update" ] && UPDATE=1
+
+ALLOW_NO_INSTRUCTIONS=${PERF_ALLOW_NO_INSTRUCTIONS:-0}
+
+# Workload and iterations of the shorter run
+WORKLOADS="sync:500 batch:5 large:50"
+
+case $PERF_TOOL in
+callgrind) command -v valgrind >/dev/null 2>&1 || PERF_TOOL=none ;;
+perf) command -v perf >/dev/null 2>&1 || PERF_TOOL=none ;;
+*) echo "PERF_TOOL must be callgrind or perf" >&2; exit 1 ;;
+esac
+if [ $PERF_TOOL = none ]; then
+    if [ "$ALLOW_NO_INSTRUCTIONS" != 1 ]; then
+        echo "valgrind/perf not found: install one or set PERF_ALLOW_NO_INSTRUCTIONS=1" >&2
+        exit 1
+    fi
+    echo "valgrind/perf not found: checking allocations only"
+fi
+
+if [ $UPDATE -eq 0 ] && [ ! -f $BASELINE ]; then
+    echo "tests/$BASELINE not found: record one with \"make perf-baseline\"" >&2
+    exit 1
+fi
+
+# Prints the instructions of one run, or nothing on failure
+count_instructions()
+{
+    case $PERF_TOOL in
+    callgrind)
+        valgrind --tool=callgrind --callgrind-out-file=/dev/null ./perf_workload "$@" 2>&1 >/dev/null |
+            sed -n 's/.*Collected : *\([0-9]*\).*/\1/p'
+        ;;
+    perf)
+        perf stat -x, -e instructions:u ./perf_workload "$@" 2>&1 >/dev/null |
+            awk -F, '/instructions/ { print $1 }'
+        ;;
+    esac
+}
+
+# Prints "<calls> <allocations>" of one run, or nothing on failure
+count_allocations()
+{
+    ./perf_workload "$@" 2>&1 >/dev/null |
+        sed -n 's/^calls=\([0-9]*\) allocations=\([0-9]*\).*/\1 \2/p'
+}
+
+# Prints the baseline field (2 = instructions, 3 = allocations) of a workload
+baseline_value()
+{
+    [ -f $BASELINE ] && awk -v w="$1" -v f="$2" '$1 == w { print $f }' $BASELINE
+}
+
+# Compares a measurement with its baseline; returns 1 on regression, or
+# when either is missing unless the fifth argument is 1
+compare()
+{
+    awk -v name="$1" -v metric="$2" -v now="$3" -v base="$4" -v t="$THRESHOLD" -v allow="$5" 'BEGIN {
+        if (now == "-" || base == "" || base == "-") {
+            printf "%-6s %-13s %12s   (%s)\n", name, metric, now, now == "-" ? "not measured" : "no baseline"
+            exit allow != 1
+        }
+        change = base > 0 ? (now - base) * 100 / base : 0
+        status = change > t ? "REGRESSION" : change < -t ? "improved" : "ok"
+        printf "%-6s %-13s %12s   baseline %12s  %+6.1f%%  %s\n", name, metric, now, base, change, status
+        exit change > t
+    }'
+}
+
+failed=0
+results=""
+for entry in $WORKLOADS; do
+    name=${entry%%:*}
+    n=${entry#*:}
+
+    set -- $(count_allocations $name $n)
+    if [ $# -ne 2 ] || [ "$1" -eq 0 ]; then
+        echo "$name: workload failed" >&2
+        exit 1
+    fi
+    allocations=$(awk -v a="$2" -v c="$1" 'BEGIN { printf "%.1f", a / c }')
+
+    instructions=-
+    if [ $PERF_TOOL != none ]; then
+        calls=$1
+        short=$(count_instructions $name $n)
+        long=$(count_instructions $name $((n * 2)))
+        if [ -z "$short" ] || [ -z "$long" ]; then
+            echo "$name: $PERF_TOOL run failed" >&2
+            exit 1
+        fi
+        instructions=$(awk -v s="$short" -v l="$long" -v c="$calls" 'BEGIN { printf "%.0f", (l - s) / c }')
+    fi
+
+    results="$results$name $instructions $allocations
+"
+    if [ $UPDATE -eq 0 ]; then
+        compare $name instructions $instructions "$(baseline_value $name 2)" \
+            "$ALLOW_NO_INSTRUCTIONS" || failed=1
+        compare $name allocations $allocations "$(baseline_value $name 3)" 0 || failed=1
+    fi
+done
+
+if [ $UPDATE -eq 1 ]; then
+    {
+        echo "# workload instructions/call allocations/call (- = not recorded)"
+        echo "# Written by \"make perf-baseline\""
+        printf "%s" "$results" | while read -r name instructions allocations; do
+            # Keep a recorded instruction count when this machine cannot measure it
+            [ "$instructions" = "-" ] && instructions=$(baseline_value $name 2)
+            echo "$name ${instructions:--} $allocations"
+        done
+    } > $BASELINE.new && mv $BASELINE.new $BASELINE
+    echo "Baseline written to tests/$BASELINE:"
+    cat $BASELINE
+    exit 0
+fi
+
+if [ $failed -eq 1 ]; then
+    echo "Performance regression above ${THRESHOLD}% or missing counts"
+    awk '!/^#/ && $2 == "-" { missing = 1 } END { exit !missing }' $BASELINE &&
+        echo "tests/$BASELINE lacks instruction counts: run \"make perf-baseline\" with valgrind"
+fi
+exit $failed
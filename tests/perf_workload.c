@@ -0,0 +1,242 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <link.h>
+#include "sockrpc/sockrpc.h"
+
+/*
+ * Fixed workloads for the instruction-count regression suite
+ * (tests/perf_check.sh). Each run starts a server and a client in this
+ * process, warms up, then makes the requested number of iterations:
+ *
+ *   sync   one synchronous call with small params
+ *   batch  1000 asynchronous calls, then waits for all of them
+ *   large  one synchronous echo of a 64 KiB string
+ *
+ * Heap allocations of every thread in the process are counted by the
+ * malloc wrappers below, which take precedence over the C library's for
+ * libsockrpc and libcjson too. Allocations made by libcjson's own code
+ * are left out: how often a cJSON build reallocates while parsing or
+ * printing is not sockrpc's cost, and differs between versions. Only
+ * the measured iterations are counted. Instructions are counted from outside (callgrind or perf),
+ * by comparing runs with different iteration counts, so setup and
+ * teardown cancel out.
+ *
+ * Usage: perf_workload <sync|batch|large> <iterations>
+ * Prints: calls=<n> allocations=<n> bytes=<n>
+ */
+
+#define WARMUP_ITERATIONS 20
+#define BATCH_CALLS 1000
+#define LARGE_PAYLOAD 65536
+#define PERF_SOCKET "/tmp/sockrpc_perf.sock"
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+#define MAX_CJSON_SEGMENTS 4
+
+static int counting;
+static unsigned long allocations;
+static unsigned long allocated_bytes;
+
+// Executable segments of libcjson, found before counting starts
+static uintptr_t cjson_start[MAX_CJSON_SEGMENTS];
+static uintptr_t cjson_end[MAX_CJSON_SEGMENTS];
+static int cjson_segments;
+
+static int find_cjson(struct dl_phdr_info *info, size_t size, void *data)
+{
+    (void)size;
+    (void)data;
+    if (!strstr(info->dlpi_name, "libcjson"))
+        return 0;
+
+    for (int i = 0; i < info->dlpi_phnum && cjson_segments < MAX_CJSON_SEGMENTS; i++)
+    {
+        const ElfW(Phdr) *phdr = &info->dlpi_phdr[i];
+        if (phdr->p_type == PT_LOAD && (phdr->p_flags & PF_X))
+        {
+            cjson_start[cjson_segments] = info->dlpi_addr + phdr->p_vaddr;
+            cjson_end[cjson_segments] = cjson_start[cjson_segments] + phdr->p_memsz;
+            cjson_segments++;
+        }
+    }
+    return 1;
+}
+
+static int called_from_cjson(const void *caller)
+{
+    uintptr_t address = (uintptr_t)caller;
+    for (int i = 0; i < cjson_segments; i++)
+    {
+        if (address >= cjson_start[i] && address < cjson_end[i])
+            return 1;
+    }
+    return 0;
+}
+
+static void count_allocation(size_t size, const void *caller)
+{
+    if (__atomic_load_n(&counting, __ATOMIC_RELAXED) && !called_from_cjson(caller))
+    {
+        __atomic_add_fetch(&allocations, 1, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&allocated_bytes, size, __ATOMIC_RELAXED);
+    }
+}
+
+void *malloc(size_t size)
+{
+    count_allocation(size, __builtin_return_address(0));
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size)
+{
+    count_allocation(count * size, __builtin_return_address(0));
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    count_allocation(size, __builtin_return_address(0));
+    return __libc_realloc(ptr, size);
+}
+
+static pthread_mutex_t batch_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t batch_cond = PTHREAD_COND_INITIALIZER;
+static int batch_pending;
+
+static cJSON *add_handler(cJSON *params)
+{
+    int a = cJSON_GetObjectItem(params, "a")->valueint;
+    int b = cJSON_GetObjectItem(params, "b")->valueint;
+    return cJSON_CreateNumber(a + b);
+}
+
+static cJSON *echo_handler(cJSON *params)
+{
+    return cJSON_Duplicate(params, 1);
+}
+
+static cJSON *small_params(void)
+{
+    cJSON *params = cJSON_CreateObject();
+    cJSON_AddNumberToObject(params, "a", 20);
+    cJSON_AddNumberToObject(params, "b", 22);
+    return params;
+}
+
+static void batch_callback(cJSON *result)
+{
+    cJSON_Delete(result);
+    pthread_mutex_lock(&batch_mutex);
+    if (--batch_pending == 0)
+        pthread_cond_signal(&batch_cond);
+    pthread_mutex_unlock(&batch_mutex);
+}
+
+static int run_sync(sockrpc_client *client)
+{
+    cJSON *result = sockrpc_client_call_sync(client, "add", small_params());
+    int ok = result && result->valueint == 42;
+    cJSON_Delete(result);
+    return ok ? 1 : -1;
+}
+
+static int run_batch(sockrpc_client *client)
+{
+    batch_pending = BATCH_CALLS;
+    for (int i = 0; i < BATCH_CALLS; i++)
+        sockrpc_client_call_async(client, "add", small_params(), batch_callback);
+
+    pthread_mutex_lock(&batch_mutex);
+    while (batch_pending)
+        pthread_cond_wait(&batch_cond, &batch_mutex);
+    pthread_mutex_unlock(&batch_mutex);
+    return BATCH_CALLS;
+}
+
+static char *large_text;
+
+static int run_large(sockrpc_client *client)
+{
+    cJSON *result = sockrpc_client_call_sync(client, "echo", cJSON_CreateString(large_text));
+    int ok = cJSON_IsString(result) && strlen(result->valuestring) == LARGE_PAYLOAD;
+    cJSON_Delete(result);
+    return ok ? 1 : -1;
+}
+
+int main(int argc, char **argv)
+{
+    int (*run)(sockrpc_client *) = NULL;
+    if (argc == 3 && strcmp(argv[1], "sync") == 0)
+        run = run_sync;
+    else if (argc == 3 && strcmp(argv[1], "batch") == 0)
+        run = run_batch;
+    else if (argc == 3 && strcmp(argv[1], "large") == 0)
+        run = run_large;
+    long iterations = argc == 3 ? atol(argv[2]) : 0;
+    if (!run || iterations < 0)
+    {
+        fprintf(stderr, "Usage: %s <sync|batch|large> <iterations>\n", argv[0]);
+        return 1;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    if (!dl_iterate_phdr(find_cjson, NULL))
+    {
+        fprintf(stderr, "libcjson is not loaded as a shared library\n");
+        return 1;
+    }
+    large_text = malloc(LARGE_PAYLOAD + 1);
+    memset(large_text, 'x', LARGE_PAYLOAD);
+    large_text[LARGE_PAYLOAD] = '\0';
+
+    // Server logging goes to stdout, results to stderr
+    sockrpc_server *server = sockrpc_server_create(PERF_SOCKET);
+    sockrpc_server_register(server, "add", add_handler);
+    sockrpc_server_register(server, "echo", echo_handler);
+    sockrpc_server_start(server);
+    usleep(100000); // Give server time to start
+
+    sockrpc_client *client = sockrpc_client_create(PERF_SOCKET);
+    if (!client)
+    {
+        fprintf(stderr, "Cannot connect to %s\n", PERF_SOCKET);
+        sockrpc_server_destroy(server);
+        return 1;
+    }
+
+    int status = 0;
+    for (int i = 0; i < WARMUP_ITERATIONS && status == 0; i++)
+        status = run(client) < 0;
+
+    long calls = 0;
+    __atomic_store_n(&counting, 1, __ATOMIC_RELAXED);
+    for (long i = 0; i < iterations && status == 0; i++)
+    {
+        int made = run(client);
+        status = made < 0;
+        calls += made;
+    }
+    __atomic_store_n(&counting, 0, __ATOMIC_RELAXED);
+
+    sockrpc_client_destroy(client);
+    sockrpc_server_destroy(server);
+    free(large_text);
+
+    if (status)
+    {
+        fprintf(stderr, "%s: call failed\n", argv[1]);
+        return 1;
+    }
+    fprintf(stderr, "calls=%ld allocations=%lu bytes=%lu\n", calls, allocations, allocated_bytes);
+    return 0;
+}
@@ -0,0 +1,327 @@
+#include <cassert>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <poll.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "sockrpc/sockrpc.hpp"
+
+// Unit tests of the C++ bindings in sockrpc/sockrpc.hpp
+
+static cJSON *add_handler(cJSON *params)
+{
+    int a = cJSON_GetArrayItem(params, 0)->valueint;
+    int b = cJSON_GetArrayItem(params, 1)->valueint;
+    return cJSON_CreateNumber(a + b);
+}
+
+// Returns the traceparent the request arrived with, null if untraced
+static cJSON *traceparent_handler(cJSON *)
+{
+    char parent[SOCKRPC_TRACEPARENT_SIZE];
+    if (sockrpc_trace_current(parent, sizeof(parent)) == -1)
+        return cJSON_CreateNull();
+    return cJSON_CreateString(parent);
+}
+
+static sockrpc::json pair(int a, int b)
+{
+    int values[2] = {a, b};
+    return sockrpc::json(cJSON_CreateIntArray(values, 2));
+}
+
+// Threads that resumed a coroutine other than the one that started it
+static int foreign_resumes;
+
+// Adds the params twice through two downstream calls in flight at once
+static sockrpc::task sum_twice(sockrpc::context ctx, cJSON *params)
+{
+    pthread_t self = pthread_self();
+    auto first = ctx.call("/tmp/test_cpp1.sock", "add", sockrpc::json(cJSON_Duplicate(params, 1)));
+    auto second = ctx.call("/tmp/test_cpp1.sock", "add", sockrpc::json(cJSON_Duplicate(params, 1)));
+
+    sockrpc::json a = co_await second;
+    sockrpc::json b = co_await first;
+    if (!pthread_equal(self, pthread_self()))
+        __atomic_add_fetch(&foreign_resumes, 1, __ATOMIC_RELAXED);
+    if (!a || !b)
+        co_return nullptr;
+    co_return sockrpc::json(cJSON_CreateNumber(a->valueint + b->valueint));
+}
+
+// Completes without suspending
+static sockrpc::task echo(sockrpc::context, cJSON *params)
+{
+    co_return sockrpc::json(cJSON_Duplicate(params, 1));
+}
+
+static sockrpc::task unreachable(sockrpc::context ctx, cJSON *params)
+{
+    sockrpc::json result =
+        co_await ctx.call("/tmp/test_cpp_missing.sock", "add", sockrpc::json(cJSON_Duplicate(params, 1)));
+    co_return result;
+}
+
+static sockrpc::task throws(sockrpc::context ctx, cJSON *params)
+{
+    sockrpc::json result =
+        co_await ctx.call("/tmp/test_cpp1.sock", "add", sockrpc::json(cJSON_Duplicate(params, 1)));
+    throw std::runtime_error("handler error");
+    co_return result;
+}
+
+// Submits the second call from the first one's completion, off the handler
+static sockrpc::task chained_trace(sockrpc::context ctx, cJSON *)
+{
+    sockrpc::json first = co_await ctx.call("/tmp/test_cpp1.sock", "traceparent");
+    sockrpc::json second = co_await ctx.call("/tmp/test_cpp1.sock", "traceparent");
+    if (!first || !second)
+        co_return nullptr;
+    sockrpc::json both(cJSON_CreateArray());
+    cJSON_AddItemToArray(both.get(), first.release());
+    cJSON_AddItemToArray(both.get(), second.release());
+    co_return both;
+}
+
+// Chains two calls on a client-side event-driven client
+static sockrpc::job chain(sockrpc::client &client, int start, int *out)
+{
+    sockrpc::json first = co_await client.call("add", pair(start, 1));
+    sockrpc::json second = co_await client.call("add", pair(first->valueint, 1));
+    *out = second->valueint;
+}
+
+static void test_method_coroutines()
+{
+    printf("Testing method coroutines...\n");
+    sockrpc_server *backend = sockrpc_server_create("/tmp/test_cpp1.sock");
+    sockrpc_server_register(backend, "add", add_handler);
+    sockrpc_server_register(backend, "traceparent", traceparent_handler);
+    sockrpc_server_start(backend);
+
+    // Every request to the front starts a trace, none is exported
+    sockrpc_trace_config tracing = {};
+    tracing.path = "/tmp/test_cpp_trace.jsonl";
+    sockrpc_server *front = sockrpc_server_create("/tmp/test_cpp2.sock");
+    assert(sockrpc_server_set_tracing(front, &tracing) == 0);
+    assert(sockrpc::register_coroutine<sum_twice>(front, "sum_twice") == 0);
+    assert(sockrpc::register_coroutine<echo>(front, "echo") == 0);
+    assert(sockrpc::register_coroutine<unreachable>(front, "unreachable") == 0);
+    assert(sockrpc::register_coroutine<throws>(front, "throws") == 0);
+    assert(sockrpc::register_coroutine<chained_trace>(front, "chained_trace") == 0);
+    sockrpc_server_start(front);
+    usleep(100000); // Give servers time to start
+
+    sockrpc_client *client = sockrpc_client_create("/tmp/test_cpp2.sock");
+    for (int i = 0; i < 200; i++)
+    {
+        cJSON *result = sockrpc_client_call_sync(client, "sum_twice", pair(i, 4).release());
+        assert(result && result->valueint == 2 * (i + 4));
+        cJSON_Delete(result);
+    }
+    assert(foreign_resumes == 0);
+
+    cJSON *result = sockrpc_client_call_sync(client, "echo", cJSON_CreateString("hello"));
+    assert(cJSON_IsString(result) && strcmp(result->valuestring, "hello") == 0);
+    cJSON_Delete(result);
+    assert(sockrpc_client_call_sync(client, "unreachable", pair(1, 2).release()) == NULL);
+    assert(sockrpc_client_call_sync(client, "throws", pair(1, 2).release()) == NULL);
+
+    // Both downstream calls continue the front call's trace
+    result = sockrpc_client_call_sync(client, "chained_trace", NULL);
+    assert(cJSON_GetArraySize(result) == 2);
+    const char *first = cJSON_GetArrayItem(result, 0)->valuestring;
+    const char *second = cJSON_GetArrayItem(result, 1)->valuestring;
+    assert(first && second && strncmp(first, second, 35) == 0);
+    cJSON_Delete(result);
+
+    sockrpc_client_destroy(client);
+    sockrpc_server_destroy(front);
+    sockrpc_server_destroy(backend);
+    unlink("/tmp/test_cpp_trace.jsonl");
+    printf("Method coroutines test passed\n");
+}
+
+static void test_client_coroutines()
+{
+    printf("Testing client coroutines...\n");
+    sockrpc_server *server = sockrpc_server_create("/tmp/test_cpp1.sock");
+    sockrpc_server_register(server, "add", add_handler);
+    sockrpc_server_start(server);
+    usleep(100000); // Give server time to start
+
+    bool refused = false;
+    try
+    {
+        sockrpc::client missing("/tmp/test_cpp_missing.sock");
+    }
+    catch (const std::runtime_error &)
+    {
+        refused = true;
+    }
+    assert(refused);
+
+    enum { JOBS = 100 };
+    static int results[JOBS];
+    {
+        sockrpc::client client("/tmp/test_cpp1.sock");
+        for (int i = 0; i < JOBS; i++)
+        {
+            results[i] = 0;
+            chain(client, i, &results[i]);
+        }
+
+        int completed = 0;
+        while (completed < 2 * JOBS)
+        {
+            struct pollfd pfd = {client.fd(), short(POLLIN | (client.wants_write() ? POLLOUT : 0)), 0};
+            assert(poll(&pfd, 1, 5000) == 1);
+            if (pfd.revents & POLLOUT)
+                assert(client.on_writable() >= 0);
+            if (pfd.revents & POLLIN)
+            {
+                int n = client.on_readable();
+                assert(n >= 0);
+                completed += n;
+            }
+        }
+        for (int i = 0; i < JOBS; i++)
+            assert(results[i] == i + 2);
+
+        // An abandoned call's result is discarded when the client goes away
+        auto abandoned = client.call("add", pair(1, 2));
+        (void)abandoned;
+    }
+
+    sockrpc_server_destroy(server);
+    printf("Client coroutines test passed\n");
+}
+
+static int typed_add(int a, int b)
+{
+    return a + b;
+}
+
+static std::string greet(std::string_view name, std::optional<int> times)
+{
+    std::string text = "hi";
+    for (int i = 0; i < times.value_or(1); i++)
+        text.append(" ").append(name);
+    return text;
+}
+
+static std::vector<double> scale(const std::vector<double> &values, double factor)
+{
+    std::vector<double> scaled;
+    for (double value : values)
+        scaled.push_back(value * factor);
+    return scaled;
+}
+
+static bool touched;
+
+static void touch(bool flag)
+{
+    touched = flag;
+}
+
+static sockrpc::json wrap(const cJSON *value)
+{
+    sockrpc::json result(cJSON_CreateObject());
+    cJSON_AddItemToObject(result.get(), "value", cJSON_Duplicate(value, 1));
+    return result;
+}
+
+static int checked(int x)
+{
+    if (x < 0)
+        throw std::invalid_argument("negative");
+    return x;
+}
+
+static constexpr rpc_method typed_methods[] = {
+    sockrpc::typed_method<"add", typed_add, "a", "b">(),
+    sockrpc::typed_method<"greet", greet, "name", "times">(),
+    sockrpc::typed_method<"scale", scale, "values", "factor">(),
+    sockrpc::typed_method<"touch", touch, "flag">(),
+    sockrpc::typed_method<"wrap", wrap, "value">(),
+    {nullptr, nullptr}};
+
+static_assert(typed_methods[1].name[0] == 'g' && !typed_methods[5].name);
+static_assert(sockrpc::hash_name("a") != sockrpc::hash_name("b"));
+
+// Calls method with params given as JSON text
+static cJSON *call_text(sockrpc_client *client, const char *method, const char *params)
+{
+    return sockrpc_client_call_sync(client, method, cJSON_Parse(params));
+}
+
+// Calls method and compares the printed result with expected, NULL for failure
+static void expect(sockrpc_client *client, const char *method, const char *params,
+                   const char *expected)
+{
+    cJSON *result = call_text(client, method, params);
+    char *text = result ? cJSON_PrintUnformatted(result) : NULL;
+    assert(expected ? text && strcmp(text, expected) == 0 : text == NULL);
+    free(text);
+    cJSON_Delete(result);
+}
+
+static void test_typed_methods()
+{
+    printf("Testing typed methods...\n");
+    sockrpc_server *server = sockrpc_server_create("/tmp/test_cpp3.sock");
+    assert(sockrpc::register_methods(server, typed_methods) == 0);
+    assert((sockrpc::register_typed<checked, "x">(server, "checked")) == 0);
+    assert((sockrpc::register_typed<typed_add, "a", "b">(server, "grouped", "missing")) == -1);
+    sockrpc_server_start(server);
+    usleep(100000); // Give server time to start
+
+    sockrpc_client *client = sockrpc_client_create("/tmp/test_cpp3.sock");
+
+    // Fields by name in any order, or by position; unknown names ignored
+    expect(client, "add", "{\"a\":2,\"b\":3}", "5");
+    expect(client, "add", "{\"c\":9,\"b\":3,\"a\":2}", "5");
+    expect(client, "add", "[2,3]", "5");
+
+    // Missing, mistyped, fractional, out of range and extra fields fail
+    expect(client, "add", "{\"a\":2}", NULL);
+    expect(client, "add", "{\"a\":2,\"B\":3}", NULL);
+    expect(client, "add", "{\"a\":\"2\",\"b\":3}", NULL);
+    expect(client, "add", "{\"a\":1.5,\"b\":3}", NULL);
+    expect(client, "add", "{\"a\":1e12,\"b\":3}", NULL);
+    expect(client, "add", "[1,2,3]", NULL);
+    expect(client, "add", "\"text\"", NULL);
+
+    expect(client, "greet", "{\"name\":\"bob\"}", "\"hi bob\"");
+    expect(client, "greet", "{\"name\":\"bob\",\"times\":2}", "\"hi bob bob\"");
+    expect(client, "greet", "{\"name\":\"bob\",\"times\":null}", "\"hi bob\"");
+    expect(client, "greet", "{\"name\":\"bob\",\"times\":\"x\"}", NULL);
+    expect(client, "scale", "{\"values\":[1,2.5],\"factor\":2}", "[2,5]");
+    expect(client, "scale", "{\"values\":[1,\"x\"],\"factor\":2}", NULL);
+    expect(client, "touch", "[true]", "null");
+    assert(touched);
+    expect(client, "wrap", "{\"value\":{\"x\":[1]}}", "{\"value\":{\"x\":[1]}}");
+    expect(client, "checked", "{\"x\":4}", "4");
+    expect(client, "checked", "{\"x\":-4}", NULL);
+
+    sockrpc_client_destroy(client);
+    sockrpc_server_destroy(server);
+    printf("Typed methods test passed\n");
+}
+
+int main()
+{
+    // Ignore SIGPIPE to prevent crashes when writing to closed sockets
+    signal(SIGPIPE, SIG_IGN);
+
+    test_method_coroutines();
+    test_client_coroutines();
+    test_typed_methods();
+
+    printf("\nAll C++ tests passed successfully!\n");
+    return 0;
+}
@@ -0,0 +1,53 @@
+#include <stdio.h>
+#include <unistd.h>
+#include "sockrpc/sockrpc.h"
+
+/*
+ * Handler module used by test_handler_modules. Built once per
+ * MODULE_VERSION; each version reports its number and leaves a marker
+ * file when unloaded so the test can tell when the old code is gone.
+ */
+
+#ifndef MODULE_VERSION
+#define MODULE_VERSION 1
+#endif
+
+static cJSON *version_handler(cJSON *params)
+{
+    (void)params;
+    return cJSON_CreateNumber(MODULE_VERSION);
+}
+
+static cJSON *slow_version_handler(cJSON *params)
+{
+    (void)params;
+    usleep(300000);
+    return cJSON_CreateNumber(MODULE_VERSION);
+}
+
+#if MODULE_VERSION == 1
+static cJSON *legacy_handler(cJSON *params)
+{
+    (void)params;
+    return cJSON_CreateString("legacy");
+}
+#endif
+
+__attribute__((destructor)) static void mark_unloaded(void)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/sockrpc_test_module_v%d.unloaded", MODULE_VERSION);
+    FILE *f = fopen(path, "w");
+    if (f)
+        fclose(f);
+}
+
+static const rpc_method methods[] = {
+    {"mod.version", version_handler},
+    {"mod.slow_version", slow_version_handler},
+#if MODULE_VERSION == 1
+    {"mod.legacy", legacy_handler},
+#endif
+    {NULL, NULL}};
+
+SOCKRPC_MODULE(methods);
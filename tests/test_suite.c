@@ -1,13 +1,20 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <assert.h>
 #include <signal.h>
 #include <sys/socket.h>
 #include <sys/un.h>
 #include <sys/wait.h>
+#include <arpa/inet.h>
 #include <ctype.h>
+#include <time.h>
+#include <dirent.h>
+#include <poll.h>
+#include <pthread.h>
 #include "sockrpc/sockrpc.h"
 
 // Test handlers
@@ -36,6 +43,34 @@ static cJSON *string_handler(cJSON *params)
     return result;
 }
 
+static cJSON *null_handler(cJSON *params)
+{
+    (void)params;
+    return NULL;
+}
+
+static cJSON *slow_handler(cJSON *params)
+{
+    usleep(300000);
+    return cJSON_Duplicate(params, 1);
+}
+
+static cJSON *listing_handler(cJSON *params)
+{
+    int count = params ? params->valueint : 0;
+    cJSON *list = cJSON_CreateArray();
+    for (int i = 0; i < count; i++)
+    {
+        char key[32];
+        snprintf(key, sizeof(key), "user:%d", i);
+        cJSON *entry = cJSON_CreateObject();
+        cJSON_AddStringToObject(entry, "key", key);
+        cJSON_AddStringToObject(entry, "value", "active");
+        cJSON_AddItemToArray(list, entry);
+    }
+    return list;
+}
+
 // Test callback for async calls
 static void async_callback(cJSON *result)
 {
@@ -347,6 +382,2142 @@ static void test_dynamic_registration()
     printf("Dynamic method registration test passed\n");
 }
 
+// Test starting on a socket pre-created by a supervisor
+static void test_start_from_fd()
+{
+    printf("Testing start from inherited socket...\n");
+
+    const char *path = "/tmp/test7.sock";
+    unlink(path);
+
+    struct sockaddr_un addr = {
+        .sun_family = AF_UNIX};
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    assert(listen_fd != -1);
+    assert(bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+    assert(listen(listen_fd, SOMAXCONN) == 0);
+
+    sockrpc_server *server = sockrpc_server_create(path);
+    sockrpc_server_register(server, "add", add_handler);
+
+    // Not a listening socket
+    int plain_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    assert(sockrpc_server_start_from_fd(server, plain_fd) == -1);
+    close(plain_fd);
+
+    // Connect before the server runs: the connections wait in the backlog
+    sockrpc_client *client = sockrpc_client_create(path);
+    sockrpc_client *second = sockrpc_client_create(path);
+    assert(client != NULL && second != NULL);
+
+    // The supervisor's copy shares the file description with the server's
+    int supervisor_fd = dup(listen_fd);
+    assert(sockrpc_server_start_from_fd(server, listen_fd) == 0);
+    assert(!(fcntl(supervisor_fd, F_GETFL) & O_NONBLOCK));
+
+    cJSON *params = cJSON_CreateArray();
+    cJSON_AddItemToArray(params, cJSON_CreateNumber(40));
+    cJSON_AddItemToArray(params, cJSON_CreateNumber(2));
+    cJSON *result = sockrpc_client_call_sync(client, "add", cJSON_Duplicate(params, 1));
+    assert(result != NULL);
+    assert(result->valuedouble == 42);
+    cJSON_Delete(result);
+
+    // The blocking listener is drained without waiting, none is lost
+    result = sockrpc_client_call_sync(second, "add", params);
+    assert(result != NULL);
+    assert(result->valuedouble == 42);
+    cJSON_Delete(result);
+
+    sockrpc_client_destroy(client);
+    sockrpc_client_destroy(second);
+    sockrpc_server_destroy(server);
+    assert(!(fcntl(supervisor_fd, F_GETFL) & O_NONBLOCK));
+    close(supervisor_fd);
+
+    // The socket file belongs to the supervisor
+    assert(access(path, F_OK) == 0);
+    unlink(path);
+
+    printf("Start from inherited socket test passed\n");
+}
+
+// Test abstract-namespace names and SOCK_SEQPACKET connections
+static void test_abstract_seqpacket()
+{
+    printf("Testing abstract namespace and seqpacket sockets...\n");
+
+    sockrpc_server *server = sockrpc_server_create("@sockrpc_test8");
+    sockrpc_server_set_socket_type(server, SOCKRPC_SOCK_SEQPACKET);
+    sockrpc_server_register(server, "echo", echo_handler);
+    sockrpc_server_start(server);
+    usleep(100000); // Give server time to start
+
+    // No socket file is created for abstract names
+    assert(access("@sockrpc_test8", F_OK) == -1);
+
+    // Socket types must match
+    assert(sockrpc_client_create("@sockrpc_test8") == NULL);
+
+    sockrpc_client *client = sockrpc_client_create_ex("@sockrpc_test8", SOCKRPC_SOCK_SEQPACKET);
+    assert(client != NULL);
+
+    // Larger than the stream buffer: one message per recv, no truncation
+    char *text = malloc(16384);
+    memset(text, 'x', 16383);
+    text[16383] = '\0';
+
+    cJSON *params = cJSON_CreateObject();
+    cJSON_AddStringToObject(params, "text", text);
+    cJSON *result = sockrpc_client_call_sync(client, "echo", params);
+    assert(result != NULL);
+    assert(strcmp(cJSON_GetObjectItem(result, "text")->valuestring, text) == 0);
+    cJSON_Delete(result);
+
+    // Several messages on the same connection keep their boundaries
+    for (int i = 0; i < 10; i++)
+    {
+        params = cJSON_CreateObject();
+        cJSON_AddNumberToObject(params, "seq", i);
+        result = sockrpc_client_call_sync(client, "echo", params);
+        assert(result != NULL);
+        assert(cJSON_GetObjectItem(result, "seq")->valueint == i);
+        cJSON_Delete(result);
+    }
+
+    free(text);
+    sockrpc_client_destroy(client);
+    sockrpc_server_destroy(server);
+    printf("Abstract namespace and seqpacket test passed\n");
+}
+
+// Test TCP transport and URL addressing
+static void test_tcp_transport()
+{
+    printf("Testing TCP transport...\n");
+
+    sockrpc_server *server = sockrpc_server_create("tcp://127.0.0.1:19053");
+    sockrpc_server_register(server, "echo", echo_handler);
+    sockrpc_server_register(server, "add", add_handler);
+    sockrpc_server_start(server);
+    usleep(100000); // Give server time to start
+
+    // Unknown schemes and malformed endpoints are rejected
+    assert(sockrpc_client_create("udp://127.0.0.1:19053") == NULL);
+    assert(sockrpc_client_create("tcp://127.0.0.1") == NULL);
+
+    // Several connections, spread across the sharded listeners
+    sockrpc_client *clients[8];
+    for (int i = 0; i < 8; i++)
+    {
+        clients[i] = sockrpc_client_create("tcp://127.0.0.1:19053");
+        assert(clients[i] != NULL);
+    }
+
+    for (int i = 0; i < 8; i++)
+    {
+        cJSON *params = cJSON_CreateArray();
+        cJSON_AddItemToArray(params, cJSON_CreateNumber(i));
+        cJSON_AddItemToArray(params, cJSON_CreateNumber(100));
+        cJSON *result = sockrpc_client_call_sync(clients[i], "add", params);
+        assert(result != NULL);
+        assert(result->valuedouble == 100 + i);
+        cJSON_Delete(result);
+    }
+
+    // Payload spanning many TCP segments is reassembled by the framing
+    size_t size = 256 * 1024;
+    char *text = malloc(size);
+    memset(text, 'y', size - 1);
+    text[size - 1] = '\0';
+
+    cJSON *params = cJSON_CreateObject();
+    cJSON_AddStringToObject(params, "text", text);
+    cJSON *result = sockrpc_client_call_sync(clients[0], "echo", params);
+    assert(result != NULL);
+    assert(strcmp(cJSON_GetObjectItem(result, "text")->valuestring, text) == 0);
+    cJSON_Delete(result);
+    free(text);
+
+    for (int i = 0; i < 8; i++)
+        sockrpc_client_destroy(clients[i]);
+    sockrpc_server_destroy(server);
+
+    // unix:// URLs are equivalent to plain paths
+    server = sockrpc_server_create("unix:///tmp/test9.sock");
+    sockrpc_server_register(server, "add", add_handler);
+    sockrpc_server_start(server);
+    usleep(100000);
+    assert(test_socket_exists("/tmp/test9.sock"));
+
+    sockrpc_client *client = sockrpc_client_create("/tmp/test9.sock");
+    assert(client != NULL);
+    params = cJSON_CreateArray();
+    cJSON_AddItemToArray(params, cJSON_CreateNumber(1));
+    cJSON_AddItemToArray(params, cJSON_CreateNumber(2));
+    result = sockrpc_client_call_sync(client, "add", params);
+    assert(result != NULL && result->valuedouble == 3);
+    cJSON_Delete(result);
+
+    sockrpc_client_destroy(client);
+    sockrpc_server_destroy(server);
+    assert(access("/tmp/test9.sock", F_OK) == -1);
+
+    printf("TCP transport test passed\n");
+}
+
+// Test that failed calls get an error response and keep the connection usable
+static void test_error_responses()
+{
+    printf("Testing error responses...\n");
+
+    sockrpc_server *server = sockrpc_server_create("/tmp/test10.sock");
+    sockrpc_server_register(server, "add", add_handler);
+    sockrpc_server_register(server, "null", null_handler);
+    sockrpc_server_start(server);
+    usleep(100000); // Give server time to start
+
+    sockrpc_client *client = sockrpc_client_create("/tmp/test10.sock");
+    assert(client != NULL);
+
+    for (int i = 0; i < 3; i++)
+    {
+        // Unknown methods and handlers returning NULL come back as NULL
+        assert(sockrpc_client_call_sync(client, "missing", cJSON_CreateObject()) == NULL);
+        assert(sockrpc_client_call_sync(client, "null", cJSON_CreateObject()) == NULL);
+
+        // ...without leaving a response behind for the next call
+        cJSON *params = cJSON_CreateArray();
+        cJSON_AddItemToArray(params, cJSON_CreateNumber(i));
+        cJSON_AddItemToArray(params, cJSON_CreateNumber(1));
+        cJSON *result = sockrpc_client_call_sync(client, "add", params);
+        assert(result != NULL && result->valuedouble == i + 1);
+        cJSON_Delete(result);
+    }
+
+    sockrpc_client_destroy(client);
+    sockrpc_server_destroy(server);
+
+    printf("Error responses test passed\n");
+}
+
+static int busy_results = 0;
+static int slow_results = 0;
+
+static void group_callback(cJSON *result)
+{
+    if (result)
+        __atomic_add_fetch(&slow_results, 1, __ATOMIC_RELAXED);
+    else
+        __atomic_add_fetch(&busy_results, 1, __ATOMIC_RELAXED);
+    cJSON_Delete(result);
+}
+
+static long elapsed_ms(const struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1000 + (now.tv_nsec - start->tv_nsec) / 1000000;
+}
+
+// Test methods bound to dedicated worker groups
+static void test_worker_groups()
+{
+    printf("Testing worker groups...\n");
+
+    sockrpc_server *server = sockrpc_server_create("/tmp/test11.sock");
+    int cpus[] = {0};
+    sockrpc_group_config heavy = {.threads = 1, .cpus = cpus, .num_cpus = 1, .queue_limit = 1};
+    sockrpc_group_config invalid = {.threads = 0};
+
+    assert(sockrpc_server_add_group(server, "heavy", &heavy) == 0);
+    assert(sockrpc_server_add_group(server, "heavy", &heavy) == -1);
+    assert(sockrpc_server_add_group(server, "none", &invalid) == -1);
+    assert(sockrpc_server_register_in_group(server, "slow", slow_handler, "missing") == -1);
+    assert(sockrpc_server_register_in_group(server, "slow", slow_handler, "heavy") == 0);
+    sockrpc_server_register(server, "add", add_handler);
+    sockrpc_server_start(server);
+    usleep(100000); // Give server time to start
+
+    // One slow call running, one queued, the third exceeds the queue limit
+    sockrpc_client *slow_clients[3];
+    for (int i = 0; i < 3; i++)
+    {
+        slow_clients[i] = sockrpc_client_create("/tmp/test11.sock");
+        assert(slow_clients[i] != NULL);
+        sockrpc_client_call_async(slow_clients[i], "slow", cJSON_CreateNumber(i), group_callback);
+        usleep(50000);
+    }
+
+    // Methods outside the group are not held up by the busy group
+    sockrpc_client *client = sockrpc_client_create("/tmp/test11.sock");
+    assert(client != NULL);
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    cJSON *params = cJSON_CreateArray();
+    cJSON_AddItemToArray(params, cJSON_CreateNumber(2));
+    cJSON_AddItemToArray(params, cJSON_CreateNumber(3));
+    cJSON *result = sockrpc_client_call_sync(client, "add", params);
+    assert(result != NULL && result->valuedouble == 5);
+    assert(elapsed_ms(&start) < 200);
+    cJSON_Delete(result);
+
+    usleep(800000); // Let the queued slow call finish
+    assert(__atomic_load_n(&slow_results, __ATOMIC_RELAXED) == 2);
+    assert(__atomic_load_n(&busy_results, __ATOMIC_RELAXED) == 1);
+
+    // Re-registering without a group moves the method to the I/O workers
+    sockrpc_server_register(server, "slow", echo_handler);
+    result = sockrpc_client_call_sync(client, "slow", cJSON_CreateNumber(7));
+    assert(result != NULL && result->valuedouble == 7);
+    cJSON_Delete(result);
+
+    for (int i = 0; i < 3; i++)
+        sockrpc_client_destroy(slow_clients[i]);
+    sockrpc_client_destroy(client);
+    sockrpc_server_destroy(server);
+
+    printf("Worker groups test passed\n");
+}
+
+static int module_slow_result = 0;
+
+static void module_callback(cJSON *result)
+{
+    assert(result != NULL);
+    __atomic_store_n(&module_slow_result, result->valueint, __ATOMIC_RELAXED);
+    cJSON_Delete(result);
+}
+
+// Copies a test module next to the test binary over dest, in place
+static void install_module(const char *name, const char *dest)
+{
+    char exe[512];
+    ssize_t len = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+    assert(len > 0);
+    exe[len] = '\0';
+    char src[600];
+    snprintf(src, sizeof(src), "%.*s/%s", (int)(strrchr(exe, '/') - exe), exe, name);
+
+    FILE *in = fopen(src, "rb");
+    FILE *out = fopen(dest, "wb");
+    assert(in && out);
+    char buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), in)) > 0)
+        assert(fwrite(buffer, 1, n, out) == n);
+    fclose(in);
+    fclose(out);
+}
+
+// Test loading, hot-reloading and unloading handler modules
+static void test_handler_modules()
+{
+    printf("Testing handler modules...\n");
+
+    const char *path = "/tmp/sockrpc_test_module.so";
+    unlink("/tmp/sockrpc_test_module_v1.unloaded");
+    unlink("/tmp/sockrpc_test_module_v2.unloaded");
+    install_module("test_module_v1.so", path);
+
+    sockrpc_server *server = sockrpc_server_create("/tmp/test12.sock");
+    assert(sockrpc_server_load_module(server, "/tmp/missing_module.so") == -1);
+    assert(sockrpc_server_load_module(server, path) == 0);
+    sockrpc_server_start(server);
+    usleep(100000); // Give server time to start
+
+    sockrpc_client *client = sockrpc_client_create("/tmp/test12.sock");
+    sockrpc_client *slow_client = sockrpc_client_create("/tmp/test12.sock");
+    assert(client != NULL && slow_client != NULL);
+
+    cJSON *result = sockrpc_client_call_sync(client, "mod.version", NULL);
+    assert(result != NULL && result->valueint == 1);
+    cJSON_Delete(result);
+    result = sockrpc_client_call_sync(client, "mod.legacy", NULL);
+    assert(result != NULL && strcmp(result->valuestring, "legacy") == 0);
+    cJSON_Delete(result);
+
+    // Start a call on version 1, then overwrite the file and reload
+    sockrpc_client_call_async(slow_client, "mod.slow_version", NULL, module_callback);
+    usleep(50000);
+    install_module("test_module_v2.so", path);
+    assert(sockrpc_server_load_module(server, path) == 0);
+
+    // New calls reach version 2, which no longer exports mod.legacy
+    result = sockrpc_client_call_sync(client, "mod.version", NULL);
+    assert(result != NULL && result->valueint == 2);
+    cJSON_Delete(result);
+    assert(sockrpc_client_call_sync(client, "mod.legacy", NULL) == NULL);
+
+    // Version 1 stays loaded until its running call returns
+    assert(access("/tmp/sockrpc_test_module_v1.unloaded", F_OK) == -1);
+    usleep(500000);
+    assert(__atomic_load_n(&module_slow_result, __ATOMIC_RELAXED) == 1);
+    assert(access("/tmp/sockrpc_test_module_v1.unloaded", F_OK) == 0);
+
+    assert(sockrpc_server_unload_module(server, path) == 0);
+    assert(sockrpc_server_unload_module(server, path) == -1);
+    assert(sockrpc_client_call_sync(client, "mod.version", NULL) == NULL);
+    assert(access("/tmp/sockrpc_test_module_v2.unloaded", F_OK) == 0);
+
+    // A name the application registers over a module stays its own
+    assert(sockrpc_server_load_module(server, path) == 0);
+    sockrpc_server_register(server, "mod.version", echo_handler);
+    assert(sockrpc_server_load_module(server, path) == 0);
+    assert(sockrpc_server_unload_module(server, path) == 0);
+    result = sockrpc_client_call_sync(client, "mod.version", cJSON_CreateNumber(7));
+    assert(result != NULL && result->valueint == 7);
+    cJSON_Delete(result);
+
+    sockrpc_client_destroy(client);
+    sockrpc_client_destroy(slow_client);
+    sockrpc_server_destroy(server);
+    unlink(path);
+    unlink("/tmp/sockrpc_test_module_v1.unloaded");
+    unlink("/tmp/sockrpc_test_module_v2.unloaded");
+
+    printf("Handler modules test passed\n");
+}
+
+// Test negotiated compression and its metrics
+static void test_compression()
+{
+    printf("Testing compression...\n");
+
+    static const char dictionary[] = "{\"key\":\"user:\",\"value\":\"active\"}";
+
+    sockrpc_server *server = sockrpc_server_create("/tmp/test13.sock");
+    sockrpc_server_register(server, "list", listing_handler);
+    sockrpc_server_register(server, "echo", echo_handler);
+    assert(sockrpc_server_set_compression(server, "missing", 0) == -1);
+    assert(sockrpc_server_set_compression(server, "echo", 0) == 0);
+    // Fails only in builds without Zstandard, which then negotiate LZ4 or nothing
+    sockrpc_server_set_compression_dictionary(server, dictionary, sizeof(dictionary));
+    sockrpc_server_start(server);
+    usleep(100000); // Give server time to start
+
+    sockrpc_client *plain = sockrpc_client_create("/tmp/test13.sock");
+    sockrpc_client *packed = sockrpc_client_create("/tmp/test13.sock");
+    sockrpc_client *other_dict = sockrpc_client_create("/tmp/test13.sock");
+    assert(plain && packed && other_dict);
+
+    // Negotiation fails only when no codec is built in
+    int negotiated = sockrpc_client_enable_compression(packed, dictionary, sizeof(dictionary)) == 0;
+    assert((sockrpc_client_enable_compression(other_dict, "other", 5) == 0) == negotiated);
+
+    sockrpc_client *clients[] = {plain, packed, other_dict};
+    for (int c = 0; c < 3; c++)
+    {
+        cJSON *result = sockrpc_client_call_sync(clients[c], "list", cJSON_CreateNumber(2000));
+        assert(result != NULL && cJSON_GetArraySize(result) == 2000);
+        assert(strcmp(cJSON_GetArrayItem(result, 1999)->child->valuestring, "user:1999") == 0);
+        cJSON_Delete(result);
+
+        // Large requests are compressed by the client
+        char text[8192];
+        memset(text, 'z', sizeof(text) - 1);
+        text[sizeof(text) - 1] = '\0';
+        cJSON *params = cJSON_CreateObject();
+        cJSON_AddStringToObject(params, "text", text);
+        result = sockrpc_client_call_sync(clients[c], "echo", params);
+        assert(result != NULL);
+        assert(strcmp(cJSON_GetObjectItem(result, "text")->valuestring, text) == 0);
+        cJSON_Delete(result);
+    }
+
+    usleep(50000); // Metrics are updated just after the response is sent
+    cJSON *stats = sockrpc_server_get_stats(server);
+    assert(stats != NULL);
+    cJSON *compression = cJSON_GetObjectItem(stats, "compression");
+    cJSON *requests = cJSON_GetObjectItem(compression, "requests");
+    cJSON *list_stats = cJSON_GetObjectItem(cJSON_GetObjectItem(compression, "methods"), "list");
+    cJSON *echo_stats = cJSON_GetObjectItem(cJSON_GetObjectItem(compression, "methods"), "echo");
+    if (negotiated)
+    {
+        assert(cJSON_GetObjectItem(requests, "compressed")->valueint == 2);
+        assert(cJSON_GetObjectItem(list_stats, "compressed")->valueint == 2);
+        assert(cJSON_GetObjectItem(list_stats, "ratio")->valuedouble > 4);
+        assert(cJSON_GetObjectItem(echo_stats, "responses")->valueint == 2);
+        assert(cJSON_GetObjectItem(echo_stats, "compressed")->valueint == 0);
+    }
+    else
+    {
+        assert(cJSON_GetObjectItem(requests, "compressed")->valueint == 0);
+        assert(list_stats == NULL && echo_stats == NULL);
+    }
+    cJSON_Delete(stats);
+
+    sockrpc_client_destroy(plain);
+    sockrpc_client_destroy(packed);
+    sockrpc_client_destroy(other_dict);
+    sockrpc_server_destroy(server);
+
+    printf("Compression test passed (%s)\n", negotiated ? "negotiated" : "no codecs built in");
+}
+
+static char blob[256 * 1024];
+static int blob_releases = 0;
+
+static void release_blob(void *ctx)
+{
+    assert(ctx == blob);
+    __atomic_add_fetch(&blob_releases, 1, __ATOMIC_RELAXED);
+}
+
+// Returns {"size": n, "data": "<blob>"} with the blob borrowed
+static sockrpc_response *blob_handler(cJSON *params)
+{
+    (void)params;
+    cJSON *size = cJSON_CreateNumber(sizeof(blob) - 1);
+    sockrpc_response *response = sockrpc_response_create();
+    sockrpc_response_add_static(response, "{\"size\":", 8);
+    sockrpc_response_add_json(response, size);
+    sockrpc_response_add_static(response, ",\"data\":\"", 9);
+    sockrpc_response_add_borrowed(response, blob, sizeof(blob) - 1, release_blob, blob);
+    sockrpc_response_add_static(response, "\"}", 2);
+    cJSON_Delete(size);
+    return response;
+}
+
+// Returns an array of more fragments than one sendmsg call accepts
+static sockrpc_response *many_fragments_handler(cJSON *params)
+{
+    (void)params;
+    sockrpc_response *response = sockrpc_response_create();
+    sockrpc_response_add_static(response, "[", 1);
+    for (int i = 0; i < 2000; i++)
+    {
+        sockrpc_response_add_static(response, i ? ",7" : "7", i ? 2 : 1);
+    }
+    sockrpc_response_add_static(response, "]", 1);
+    return response;
+}
+
+// Fails to append a fragment but returns the response anyway
+static sockrpc_response *broken_response_handler(cJSON *params)
+{
+    (void)params;
+    sockrpc_response *response = sockrpc_response_create();
+    sockrpc_response_add_static(response, "1", 1);
+    assert(sockrpc_response_add_borrowed(response, NULL, 0, release_blob, blob) == -1);
+    return response;
+}
+
+static void test_response_fragments()
+{
+    printf("Testing fragment responses...\n");
+
+    memset(blob, 'b', sizeof(blob) - 1);
+    blob[sizeof(blob) - 1] = '\0';
+
+    sockrpc_server *server = sockrpc_server_create("/tmp/test14.sock");
+    sockrpc_group_config config = {.threads = 1};
+    assert(sockrpc_server_add_group(server, "blobs", &config) == 0);
+    assert(sockrpc_server_register_response(server, "blob", blob_handler, NULL) == 0);
+    assert(sockrpc_server_register_response(server, "grouped_blob", blob_handler, "blobs") == 0);
+    assert(sockrpc_server_register_response(server, "many", many_fragments_handler, NULL) == 0);
+    assert(sockrpc_server_register_response(server, "broken", broken_response_handler, NULL) == 0);
+    assert(sockrpc_server_register_response(server, "x", blob_handler, "missing") == -1);
+    assert(sockrpc_server_register_response(server, "x", NULL, NULL) == -1);
+    sockrpc_server_start(server);
+    usleep(100000); // Give server time to start
+
+    sockrpc_client *plain = sockrpc_client_create("/tmp/test14.sock");
+    sockrpc_client *packed = sockrpc_client_create("/tmp/test14.sock");
+    assert(plain && packed);
+    sockrpc_client_enable_compression(packed, NULL, 0); // Either path must work
+
+    const char *methods[] = {"blob", "grouped_blob"};
+    sockrpc_client *clients[] = {plain, packed};
+    for (int c = 0; c < 2; c++)
+    {
+        for (int m = 0; m < 2; m++)
+        {
+            cJSON *result = sockrpc_client_call_sync(clients[c], methods[m], NULL);
+            assert(result != NULL);
+            assert(cJSON_GetObjectItem(result, "size")->valueint == (int)sizeof(blob) - 1);
+            assert(strcmp(cJSON_GetObjectItem(result, "data")->valuestring, blob) == 0);
+            cJSON_Delete(result);
+        }
+
+        cJSON *result = sockrpc_client_call_sync(clients[c], "many", NULL);
+        assert(result != NULL && cJSON_GetArraySize(result) == 2000);
+        assert(cJSON_GetArrayItem(result, 1999)->valueint == 7);
+        cJSON_Delete(result);
+
+        result = sockrpc_client_call_sync(clients[c], "broken", NULL);
+        assert(result == NULL);
+    }
+
+    // Each blob was released once after sending, the failed append at once
+    assert(__atomic_load_n(&blob_releases, __ATOMIC_RELAXED) == 6);
+
+    sockrpc_client_destroy(plain);
+    sockrpc_client_destroy(packed);
+    sockrpc_server_destroy(server);
+
+    printf("Fragment response test passed\n");
+}
+
+// Reads one response frame from a raw connection
+static cJSON *read_raw_frame(int fd)
+{
+    unsigned char header[8];
+    size_t got = 0;
+    while (got < sizeof(header))
+    {
+        ssize_t n = read(fd, header + got, sizeof(header) - got);
+        assert(n > 0);
+        got += n;
+    }
+
+    uint32_t len;
+    memcpy(&len, header, 4);
+    len = ntohl(len);
+    char *payload = malloc(len + 1);
+    for (got = 0; got < len;)
+    {
+        ssize_t n = read(fd, payload + got, len - got);
+        assert(n > 0);
+        got += n;
+    }
+    payload[len] = '\0';
+
+    cJSON *response = cJSON_Parse(payload);
+    free(payload);
+    return response;
+}
+
+// Appends a frame to buffer and returns its size
+static size_t encode_raw_frame(char *buffer, const char *json)
+{
+    uint32_t words[2] = {htonl(strlen(json)), 0};
+    memcpy(buffer, words, 8);
+    memcpy(buffer + 8, json, strlen(json));
+    return 8 + strlen(json);
+}
+
+static void test_buffer_pool()
+{
+    printf("Testing buffer pool...\n");
+
+    sockrpc_server *server = sockrpc_server_create("/tmp/test15.sock");
+    sockrpc_server_register(server, "echo", echo_handler);
+    sockrpc_server_start(server);
+    usleep(100000); // Give server time to start
+
+    // A frame split across writes, then two frames in one write
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    strcpy(addr.sun_path, "/tmp/test15.sock");
+    assert(connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+
+    char frames[256];
+    size_t len = encode_raw_frame(frames, "{\"id\":1,\"method\":\"echo\",\"params\":{\"n\":1}}");
+    for (size_t i = 0; i < len; i += 5)
+    {
+        assert(write(fd, frames + i, len - i < 5 ? len - i : 5) > 0);
+        usleep(2000);
+    }
+    cJSON *response = read_raw_frame(fd);
+    assert(cJSON_GetObjectItem(cJSON_GetObjectItem(response, "result"), "n")->valueint == 1);
+    cJSON_Delete(response);
+
+    len = encode_raw_frame(frames, "{\"id\":2,\"method\":\"echo\",\"params\":{\"n\":2}}");
+    len += encode_raw_frame(frames + len, "{\"id\":3,\"method\":\"echo\",\"params\":{\"n\":3}}");
+    assert(write(fd, frames, len) == (ssize_t)len);
+    for (int id = 2; id <= 3; id++)
+    {
+        response = read_raw_frame(fd);
+        assert(cJSON_GetObjectItem(response, "id")->valueint == id);
+        cJSON_Delete(response);
+    }
+
+    // Requests larger than the biggest size class use a huge buffer
+    sockrpc_client *client = sockrpc_client_create("/tmp/test15.sock");
+    assert(client != NULL);
+    size_t big = 3 * 1024 * 1024;
+    char *text = malloc(big + 1);
+    memset(text, 'p', big);
+    text[big] = '\0';
+    cJSON *params = cJSON_CreateObject();
+    cJSON_AddStringToObject(params, "text", text);
+    cJSON *result = sockrpc_client_call_sync(client, "echo", params);
+    assert(result != NULL);
+    assert(strcmp(cJSON_GetObjectItem(result, "text")->valuestring, text) == 0);
+    cJSON_Delete(result);
+    free(text);
+
+    for (int i = 0; i < 50; i++)
+    {
+        result = sockrpc_client_call_sync(client, "echo", cJSON_CreateObject());
+        assert(result != NULL);
+        cJSON_Delete(result);
+    }
+
+    // Idle connections hold no buffers; small messages reuse cached ones
+    usleep(50000); // Buffers are returned just after the response is sent
+    cJSON *stats = sockrpc_server_get_stats(server);
+    cJSON *buffers = cJSON_GetObjectItem(stats, "buffers");
+    assert(cJSON_GetObjectItem(buffers, "in_use_bytes")->valuedouble == 0);
+    assert(cJSON_GetObjectItem(buffers, "huge")->valueint >= 1);
+    assert(cJSON_GetObjectItem(buffers, "hit_rate")->valuedouble > 0.9);
+    assert(cJSON_GetObjectItem(buffers, "resident_bytes")->valuedouble ==
+           cJSON_GetObjectItem(buffers, "cached_bytes")->valuedouble);
+    cJSON_Delete(stats);
+
+    close(fd);
+    sockrpc_client_destroy(client);
+    sockrpc_server_destroy(server);
+
+    printf("Buffer pool test passed\n");
+}
+
+// Returns a "connections" counter from the server stats
+static int connection_stat(sockrpc_server *server, const char *name)
+{
+    cJSON *stats = sockrpc_server_get_stats(server);
+    int value = cJSON_GetObjectItem(cJSON_GetObjectItem(stats, "connections"), name)->valueint;
+    cJSON_Delete(stats);
+    return value;
+}
+
+static void test_connection_lifecycle()
+{
+    printf("Testing connection lifecycle...\n");
+
+    sockrpc_server *server = sockrpc_server_create("/tmp/test16.sock");
+    sockrpc_server_register(server, "echo", echo_handler);
+    sockrpc_server_start(server);
+    usleep(100000); // Give server time to start
+
+    // More clients than one slab chunk holds, half of them closed again
+    sockrpc_client *clients[100];
+    for (int i = 0; i < 100; i++)
+    {
+        clients[i] = sockrpc_client_create("/tmp/test16.sock");
+        assert(clients[i] != NULL);
+    }
+    for (int i = 0; i < 100; i += 2)
+    {
+        sockrpc_client_destroy(clients[i]);
+        clients[i] = NULL;
+    }
+    usleep(100000);
+    assert(connection_stat(server, "open") == 50);
+    assert(connection_stat(server, "accepted") == 100);
+
+    // Reused slots serve new connections while the old ones keep working
+    for (int i = 0; i < 100; i += 2)
+    {
+        clients[i] = sockrpc_client_create("/tmp/test16.sock");
+        assert(clients[i] != NULL);
+    }
+    for (int i = 0; i < 100; i++)
+    {
+        cJSON *params = cJSON_CreateObject();
+        cJSON_AddNumberToObject(params, "n", i);
+        cJSON *result = sockrpc_client_call_sync(clients[i], "echo", params);
+        assert(result != NULL && cJSON_GetObjectItem(result, "n")->valueint == i);
+        cJSON_Delete(result);
+    }
+
+    // A peer that shuts down its write side still gets its answer
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    strcpy(addr.sun_path, "/tmp/test16.sock");
+    assert(connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+    char frame[128];
+    size_t len = encode_raw_frame(frame, "{\"id\":7,\"method\":\"echo\",\"params\":{}}");
+    assert(write(fd, frame, len) == (ssize_t)len);
+    shutdown(fd, SHUT_WR);
+    cJSON *response = read_raw_frame(fd);
+    assert(cJSON_GetObjectItem(response, "id")->valueint == 7);
+    cJSON_Delete(response);
+    assert(read(fd, frame, sizeof(frame)) == 0);
+    close(fd);
+
+    for (int i = 0; i < 100; i++)
+    {
+        sockrpc_client_destroy(clients[i]);
+    }
+    usleep(100000);
+    assert(connection_stat(server, "open") == 0);
+    assert(connection_stat(server, "accepted") == 151);
+
+    sockrpc_server_destroy(server);
+
+    printf("Connection lifecycle test passed\n");
+}
+
+static void test_busy_poll()
+{
+    printf("Testing busy polling...\n");
+
+    sockrpc_server *server = sockrpc_server_create("/tmp/test17.sock");
+    sockrpc_server_register(server, "echo", echo_handler);
+    assert(sockrpc_server_set_busy_poll(server, 200) == 0);
+    sockrpc_server_start(server);
+    assert(sockrpc_server_set_busy_poll(server, 100) == -1);
+    usleep(100000); // Give server time to start
+
+    sockrpc_client *client = sockrpc_client_create("/tmp/test17.sock");
+    assert(client != NULL);
+    assert(sockrpc_client_set_busy_poll(client, 200) == 0);
+
+    for (int i = 0; i < 200; i++)
+    {
+        cJSON *params = cJSON_CreateObject();
+        cJSON_AddNumberToObject(params, "n", i);
+        cJSON *result = sockrpc_client_call_sync(client, "echo", params);
+        assert(result != NULL && cJSON_GetObjectItem(result, "n")->valueint == i);
+        cJSON_Delete(result);
+    }
+
+    // Every wait spun first; how often it paid off depends on the cores
+    cJSON *stats = sockrpc_client_get_stats(client);
+    cJSON *spin = cJSON_GetObjectItem(stats, "busy_poll");
+    assert(cJSON_GetObjectItem(spin, "spins")->valueint == 200);
+    assert(cJSON_GetObjectItem(spin, "hits")->valueint <= 200);
+    assert(cJSON_GetObjectItem(spin, "wasted_us")->valuedouble <=
+           cJSON_GetObjectItem(spin, "spin_us")->valuedouble);
+    cJSON_Delete(stats);
+
+    stats = sockrpc_server_get_stats(server);
+    spin = cJSON_GetObjectItem(stats, "busy_poll");
+    assert(cJSON_GetObjectItem(spin, "spins")->valueint > 0);
+    cJSON_Delete(stats);
+
+    sockrpc_client_destroy(client);
+    sockrpc_server_destroy(server);
+
+    printf("Busy polling test passed\n");
+}
+
+// Context switches of every thread except the main one, from /proc
+static unsigned long background_switches()
+{
+    unsigned long total = 0;
+    char path[300], line[128];
+    DIR *dir = opendir("/proc/self/task");
+    assert(dir != NULL);
+
+    struct dirent *entry;
+    while ((entry = readdir(dir)))
+    {
+        if (entry->d_name[0] == '.' || atoi(entry->d_name) == getpid())
+            continue;
+
+        snprintf(path, sizeof(path), "/proc/self/task/%s/status", entry->d_name);
+        FILE *status = fopen(path, "r");
+        if (!status)
+            continue;
+        while (fgets(line, sizeof(line), status))
+        {
+            unsigned long count;
+            if (sscanf(line, "voluntary_ctxt_switches: %lu", &count) == 1 ||
+                sscanf(line, "nonvoluntary_ctxt_switches: %lu", &count) == 1)
+                total += count;
+        }
+        fclose(status);
+    }
+    closedir(dir);
+    return total;
+}
+
+static void test_idle_wakeups()
+{
+    printf("Testing idle wakeups...\n");
+
+    sockrpc_server *server = sockrpc_server_create("/tmp/test18.sock");
+    sockrpc_group_config slow = {.threads = 2};
+    assert(sockrpc_server_add_group(server, "slow", &slow) == 0);
+    sockrpc_server_register(server, "echo", echo_handler);
+    sockrpc_server_register_in_group(server, "add", add_handler, "slow");
+    sockrpc_server_start(server);
+    usleep(100000); // Give server time to start
+
+    // An idle connection must not wake anything either
+    sockrpc_client *client = sockrpc_client_create("/tmp/test18.sock");
+    assert(client != NULL);
+    cJSON *params = cJSON_CreateArray();
+    cJSON_AddItemToArray(params, cJSON_CreateNumber(1));
+    cJSON_AddItemToArray(params, cJSON_CreateNumber(2));
+    cJSON *result = sockrpc_client_call_sync(client, "add", params);
+    assert(result != NULL && result->valueint == 3);
+    cJSON_Delete(result);
+    usleep(100000);
+
+    unsigned long before = background_switches();
+    sleep(1);
+    unsigned long after = background_switches();
+    printf("Background wakeups while idle: %lu/s\n", after - before);
+    assert(after == before);
+
+    sockrpc_client_destroy(client);
+
+    // Shutdown must still wake every thread
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    sockrpc_server_destroy(server);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    assert(end.tv_sec - start.tv_sec < 1);
+
+    printf("Idle wakeups test passed\n");
+}
+
+// Events received by a subscription callback
+typedef struct
+{
+    int count;
+    int last;
+    int in_order;
+} event_log;
+
+static void record_event(const char *topic, cJSON *event, void *ctx)
+{
+    event_log *log = ctx;
+    int n = cJSON_GetObjectItem(event, "n")->valueint;
+    assert(topic != NULL);
+    if (n <= log->last)
+        log->in_order = 0;
+    log->last = n;
+    log->count++;
+    cJSON_Delete(event);
+}
+
+static cJSON *numbered_event(int n, size_t padding)
+{
+    cJSON *event = cJSON_CreateObject();
+    cJSON_AddNumberToObject(event, "n", n);
+    if (padding)
+    {
+        char *text = malloc(padding + 1);
+        memset(text, 'x', padding);
+        text[padding] = '\0';
+        cJSON_AddStringToObject(event, "padding", text);
+        free(text);
+    }
+    return event;
+}
+
+// Processes events until none arrive for 200ms
+static void drain_events(sockrpc_client *client)
+{
+    while (sockrpc_client_process_events(client, 200) > 0)
+        ;
+}
+
+static void test_pubsub()
+{
+    printf("Testing publish/subscribe...\n");
+
+    sockrpc_server *server = sockrpc_server_create("/tmp/test19.sock");
+    sockrpc_server_register(server, "echo", echo_handler);
+    assert(sockrpc_server_set_subscriber_queue(server, 0) == -1);
+    assert(sockrpc_server_set_subscriber_queue(server, 4) == 0);
+    assert(sockrpc_server_set_topic_policy(server, "config", SOCKRPC_OVERFLOW_COALESCE) == 0);
+    sockrpc_server_start(server);
+    assert(sockrpc_server_set_subscriber_queue(server, 8) == -1);
+    usleep(100000); // Give server time to start
+
+    sockrpc_client *clients[3];
+    event_log logs[3];
+    for (int i = 0; i < 3; i++)
+    {
+        clients[i] = sockrpc_client_create("/tmp/test19.sock");
+        assert(clients[i] != NULL);
+        logs[i] = (event_log){0, -1, 1};
+        assert(sockrpc_client_subscribe(clients[i], "news", record_event, &logs[i]) == 0);
+    }
+
+    // Fan-out to every subscriber, in order
+    for (int n = 0; n < 3; n++)
+    {
+        cJSON *event = numbered_event(n, 0);
+        assert(sockrpc_server_publish(server, "news", event) == 3);
+        cJSON_Delete(event);
+    }
+    cJSON *event = numbered_event(0, 0);
+    assert(sockrpc_server_publish(server, "nobody", event) == 0);
+    cJSON_Delete(event);
+
+    for (int i = 0; i < 3; i++)
+    {
+        while (logs[i].count < 3)
+            assert(sockrpc_client_process_events(clients[i], 1000) >= 0);
+        assert(logs[i].count == 3 && logs[i].last == 2 && logs[i].in_order);
+    }
+
+    // Events arriving while a call waits are delivered after it
+    usleep(10000);
+    event = numbered_event(3, 0);
+    sockrpc_server_publish(server, "news", event);
+    cJSON_Delete(event);
+    usleep(50000);
+    cJSON *params = cJSON_CreateObject();
+    cJSON_AddStringToObject(params, "message", "hello");
+    cJSON *result = sockrpc_client_call_sync(clients[0], "echo", params);
+    assert(result != NULL);
+    cJSON_Delete(result);
+    assert(logs[0].count == 4);
+
+    // Unsubscribed and closed connections stop receiving
+    assert(sockrpc_client_unsubscribe(clients[1], "news") == 0);
+    assert(sockrpc_client_unsubscribe(clients[1], "news") == -1);
+    sockrpc_client_destroy(clients[2]);
+    usleep(100000);
+    event = numbered_event(4, 0);
+    assert(sockrpc_server_publish(server, "news", event) == 1);
+    cJSON_Delete(event);
+
+    // A subscriber that does not read fills its socket, then its queue
+    event_log config = {0, -1, 1};
+    assert(sockrpc_client_subscribe(clients[1], "config", record_event, &config) == 0);
+    for (int n = 0; n < 50; n++)
+    {
+        event = numbered_event(n, 64 * 1024);
+        assert(sockrpc_server_publish(server, "config", event) == 1);
+        cJSON_Delete(event);
+    }
+    drain_events(clients[1]);
+    assert(config.in_order && config.count < 50 && config.last == 49);
+
+    for (int n = 5; n < 55; n++)
+    {
+        event = numbered_event(n, 64 * 1024);
+        sockrpc_server_publish(server, "news", event);
+        cJSON_Delete(event);
+    }
+    drain_events(clients[0]);
+    assert(logs[0].in_order && logs[0].count < 55 && logs[0].last == 54);
+
+    cJSON *stats = sockrpc_server_get_stats(server);
+    cJSON *pubsub = cJSON_GetObjectItem(stats, "pubsub");
+    assert(cJSON_GetObjectItem(pubsub, "subscriptions")->valueint == 2);
+    assert(cJSON_GetObjectItem(pubsub, "coalesced")->valueint > 0);
+    assert(cJSON_GetObjectItem(pubsub, "dropped")->valueint > 0);
+    // Plus the events of the closed client and event 3 ignored by clients 1 and 2
+    assert(cJSON_GetObjectItem(pubsub, "sent")->valueint ==
+           logs[0].count + logs[1].count + config.count + 3 + 2);
+    cJSON_Delete(stats);
+
+    sockrpc_client_destroy(clients[0]);
+    sockrpc_client_destroy(clients[1]);
+    sockrpc_server_destroy(server);
+
+    printf("Publish/subscribe test passed\n");
+}
+
+// Uploads seen failing by stream handlers
+static int stream_failures = 0;
+
+static cJSON *sum_stream(cJSON *params, sockrpc_stream *stream)
+{
+    // Starting late lets a client that ignores acks overrun the window
+    if (cJSON_IsNumber(cJSON_GetObjectItem(params, "delay_ms")))
+        usleep(cJSON_GetObjectItem(params, "delay_ms")->valueint * 1000);
+
+    double total = 0;
+    int chunks = 0;
+    cJSON *chunk;
+    while ((chunk = sockrpc_stream_next(stream)))
+    {
+        cJSON *n;
+        cJSON_ArrayForEach(n, chunk)
+        {
+            total += n->valuedouble;
+        }
+        cJSON_Delete(chunk);
+        if (++chunks % 50 == 0)
+            usleep(1000); // Fall behind so the client has to wait for acks
+    }
+
+    if (sockrpc_stream_failed(stream))
+    {
+        __atomic_add_fetch(&stream_failures, 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+    cJSON *result = cJSON_CreateObject();
+    cJSON_AddNumberToObject(result, "total", total);
+    cJSON_AddNumberToObject(result, "chunks", chunks);
+    return result;
+}
+
+// Returns the first chunk, leaving the rest of the upload unread
+static cJSON *first_stream(cJSON *params, sockrpc_stream *stream)
+{
+    (void)params;
+    return sockrpc_stream_next(stream);
+}
+
+static void test_streaming()
+{
+    printf("Testing client-streaming uploads...\n");
+
+    sockrpc_server *server = sockrpc_server_create("/tmp/test20.sock");
+    sockrpc_group_config uploads = {.threads = 2};
+    assert(sockrpc_server_add_group(server, "uploads", &uploads) == 0);
+    assert(sockrpc_server_register_stream(server, "sum", sum_stream, NULL) == -1);
+    assert(sockrpc_server_register_stream(server, "sum", sum_stream, "none") == -1);
+    assert(sockrpc_server_register_stream(server, "sum", sum_stream, "uploads") == 0);
+    assert(sockrpc_server_register_stream(server, "first", first_stream, "uploads") == 0);
+    sockrpc_server_register(server, "echo", echo_handler);
+    sockrpc_server_start(server);
+    usleep(100000); // Give server time to start
+
+    sockrpc_client *client = sockrpc_client_create("/tmp/test20.sock");
+    assert(client != NULL);
+
+    // A long upload, paced by acknowledgements
+    sockrpc_upload *upload = sockrpc_client_upload_begin(client, "sum", NULL);
+    assert(upload != NULL);
+    double expected = 0;
+    for (int c = 0; c < 500; c++)
+    {
+        cJSON *chunk = cJSON_CreateArray();
+        for (int i = 0; i < 10; i++)
+        {
+            cJSON_AddItemToArray(chunk, cJSON_CreateNumber(c * 10 + i));
+            expected += c * 10 + i;
+        }
+        assert(sockrpc_upload_send(upload, chunk) == 0);
+    }
+    cJSON *result = sockrpc_upload_finish(upload);
+    assert(result != NULL);
+    assert(cJSON_GetObjectItem(result, "total")->valuedouble == expected);
+    assert(cJSON_GetObjectItem(result, "chunks")->valueint == 500);
+    cJSON_Delete(result);
+
+    // A handler may answer before the upload ends
+    upload = sockrpc_client_upload_begin(client, "first", NULL);
+    int sent = 0;
+    for (int c = 0; c < 200; c++)
+    {
+        if (sockrpc_upload_send(upload, cJSON_CreateNumber(c)) == -1)
+            break;
+        sent++;
+    }
+    assert(sent < 200);
+    result = sockrpc_upload_finish(upload);
+    assert(cJSON_IsNumber(result) && result->valueint == 0);
+    cJSON_Delete(result);
+
+    // Plain calls of stream methods see an empty upload
+    result = sockrpc_client_call_sync(client, "sum", NULL);
+    assert(cJSON_GetObjectItem(result, "chunks")->valueint == 0);
+    cJSON_Delete(result);
+
+    // Unknown and non-stream methods reject uploads
+    upload = sockrpc_client_upload_begin(client, "missing", NULL);
+    assert(upload != NULL);
+    sockrpc_upload_send(upload, cJSON_CreateNumber(1));
+    assert(sockrpc_upload_finish(upload) == NULL);
+    upload = sockrpc_client_upload_begin(client, "echo", NULL);
+    sockrpc_upload_send(upload, cJSON_CreateNumber(1));
+    assert(sockrpc_upload_finish(upload) == NULL);
+
+    // The connection is still in sync
+    result = sockrpc_client_call_sync(client, "echo", cJSON_CreateString("after"));
+    assert(cJSON_IsString(result) && strcmp(result->valuestring, "after") == 0);
+    cJSON_Delete(result);
+
+    // Overrunning the window, then disconnecting mid-upload, fail the stream
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    strcpy(addr.sun_path, "/tmp/test20.sock");
+    assert(connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+    char frames[128 * 40];
+    size_t len = encode_raw_frame(
+        frames, "{\"id\":7,\"method\":\"sum\",\"params\":{\"delay_ms\":200},\"stream\":true}");
+    assert(write(fd, frames, len) == (ssize_t)len);
+    len = 0;
+    for (int c = 0; c < 40; c++)
+        len += encode_raw_frame(frames + len, "{\"id\":7,\"chunk\":[1]}");
+    assert(write(fd, frames, len) == (ssize_t)len);
+    cJSON *response = read_raw_frame(fd);
+    while (cJSON_HasObjectItem(response, "ack"))
+    {
+        cJSON_Delete(response);
+        response = read_raw_frame(fd);
+    }
+    assert(cJSON_GetObjectItem(response, "error") != NULL);
+    cJSON_Delete(response);
+    assert(__atomic_load_n(&stream_failures, __ATOMIC_RELAXED) == 1);
+
+    len = encode_raw_frame(frames, "{\"id\":8,\"method\":\"sum\",\"stream\":true}");
+    len += encode_raw_frame(frames + len, "{\"id\":8,\"chunk\":[1]}");
+    assert(write(fd, frames, len) == (ssize_t)len);
+    usleep(50000);
+    close(fd);
+    for (int i = 0; i < 100 && __atomic_load_n(&stream_failures, __ATOMIC_RELAXED) < 2; i++)
+        usleep(10000);
+    assert(__atomic_load_n(&stream_failures, __ATOMIC_RELAXED) == 2);
+
+    sockrpc_client_destroy(client);
+    sockrpc_server_destroy(server);
+
+    printf("Client-streaming test passed\n");
+}
+
+// Client the "front" handler uses to call the downstream server
+static sockrpc_client *downstream = NULL;
+
+// Returns the traceparent the handler runs under, or null
+static cJSON *leaf_handler(cJSON *params)
+{
+    (void)params;
+    char parent[SOCKRPC_TRACEPARENT_SIZE];
+    if (sockrpc_trace_current(parent, sizeof(parent)) == -1)
+        return cJSON_CreateNull();
+    return cJSON_CreateString(parent);
+}
+
+// Reports its own traceparent and the one seen downstream
+static cJSON *front_handler(cJSON *params)
+{
+    cJSON *result = cJSON_CreateObject();
+    cJSON_AddItemToObject(result, "front", leaf_handler(params));
+    cJSON_AddItemToObject(result, "leaf", sockrpc_client_call_sync(downstream, "leaf", NULL));
+    return result;
+}
+
+// Reads the spans of an exported file, keyed by span name
+static cJSON *read_spans(const char *path)
+{
+    cJSON *spans = cJSON_CreateObject();
+    FILE *fp = fopen(path, "r");
+    assert(fp != NULL);
+    char line[16384];
+    while (fgets(line, sizeof(line), fp))
+    {
+        cJSON *request = cJSON_Parse(line);
+        assert(request != NULL);
+        cJSON *resource = cJSON_GetArrayItem(cJSON_GetObjectItem(request, "resourceSpans"), 0);
+        cJSON *scope = cJSON_GetArrayItem(cJSON_GetObjectItem(resource, "scopeSpans"), 0);
+        cJSON *span;
+        cJSON_ArrayForEach(span, cJSON_GetObjectItem(scope, "spans"))
+        {
+            const char *name = cJSON_GetObjectItem(span, "name")->valuestring;
+            cJSON_AddItemToObject(spans, name, cJSON_Duplicate(span, 1));
+        }
+        cJSON_Delete(request);
+    }
+    fclose(fp);
+    return spans;
+}
+
+// Looks up an integer attribute of an exported span
+static long span_attribute(cJSON *span, const char *key)
+{
+    cJSON *attribute;
+    cJSON_ArrayForEach(attribute, cJSON_GetObjectItem(span, "attributes"))
+    {
+        if (strcmp(cJSON_GetObjectItem(attribute, "key")->valuestring, key) == 0)
+            return atol(cJSON_GetObjectItem(cJSON_GetObjectItem(attribute, "value"),
+                                            "intValue")->valuestring);
+    }
+    return -1;
+}
+
+static void test_tracing()
+{
+    printf("Testing trace propagation...\n");
+    unlink("/tmp/test21a.spans");
+    unlink("/tmp/test21b.spans");
+
+    // Front samples every new trace; leaf samples none of its own
+    sockrpc_trace_config front_trace = {.path = "/tmp/test21a.spans", .service = "front",
+                                        .sample_rate = 1.0};
+    sockrpc_trace_config leaf_trace = {.path = "/tmp/test21b.spans", .sample_rate = 0};
+    sockrpc_trace_config invalid = {.path = "/tmp/test21a.spans", .sample_rate = 2};
+
+    sockrpc_server *front = sockrpc_server_create("/tmp/test21a.sock");
+    sockrpc_group_config calls = {.threads = 1};
+    assert(sockrpc_server_add_group(front, "calls", &calls) == 0);
+    sockrpc_server_register_in_group(front, "front", front_handler, "calls");
+    sockrpc_server_register(front, "leaf", leaf_handler);
+    assert(sockrpc_server_set_tracing(front, &invalid) == -1);
+    assert(sockrpc_server_set_tracing(front, &front_trace) == 0);
+    assert(sockrpc_server_set_tracing(front, &front_trace) == -1);
+
+    sockrpc_server *leaf = sockrpc_server_create("/tmp/test21b.sock");
+    sockrpc_server_register(leaf, "leaf", leaf_handler);
+    assert(sockrpc_server_set_tracing(leaf, &leaf_trace) == 0);
+
+    sockrpc_server *plain = sockrpc_server_create("/tmp/test21c.sock");
+    sockrpc_server_register(plain, "leaf", leaf_handler);
+
+    sockrpc_server_start(front);
+    sockrpc_server_start(leaf);
+    sockrpc_server_start(plain);
+    usleep(100000); // Give servers time to start
+
+    // Untraced requests to a server without tracing start nothing
+    sockrpc_client *client = sockrpc_client_create("/tmp/test21c.sock");
+    cJSON *result = sockrpc_client_call_sync(client, "leaf", NULL);
+    assert(cJSON_IsNull(result));
+    cJSON_Delete(result);
+    sockrpc_client_destroy(client);
+    char parent[SOCKRPC_TRACEPARENT_SIZE];
+    assert(sockrpc_trace_current(parent, sizeof(parent)) == -1);
+
+    // A new trace crosses into the leaf server on the handler's thread
+    downstream = sockrpc_client_create("/tmp/test21b.sock");
+    client = sockrpc_client_create("/tmp/test21a.sock");
+    result = sockrpc_client_call_sync(client, "front", NULL);
+    const char *front_parent = cJSON_GetObjectItem(result, "front")->valuestring;
+    const char *leaf_parent = cJSON_GetObjectItem(result, "leaf")->valuestring;
+    assert(strlen(front_parent) == SOCKRPC_TRACEPARENT_SIZE - 1);
+    assert(strncmp(front_parent, leaf_parent, 35) == 0);        // Same trace id
+    assert(strcmp(front_parent + 35, leaf_parent + 35) != 0);   // New span
+    assert(strcmp(leaf_parent + 52, "-01") == 0);               // Still sampled
+    char trace_id[33], front_span[17];
+    memcpy(trace_id, front_parent + 3, 32);
+    trace_id[32] = '\0';
+    memcpy(front_span, front_parent + 36, 16);
+    front_span[16] = '\0';
+    cJSON_Delete(result);
+
+    for (int i = 0; i < 9; i++)
+        cJSON_Delete(sockrpc_client_call_sync(client, "leaf", NULL));
+    usleep(50000);
+    cJSON *stats = sockrpc_server_get_stats(front);
+    assert(cJSON_GetObjectItem(cJSON_GetObjectItem(stats, "tracing"), "spans")->valueint == 10);
+    cJSON_Delete(stats);
+
+    sockrpc_client_destroy(client);
+    sockrpc_client_destroy(downstream);
+    sockrpc_server_destroy(front);
+    sockrpc_server_destroy(leaf);
+    sockrpc_server_destroy(plain);
+
+    // The leaf span is a child of the front span, with phase timings
+    cJSON *front_spans = read_spans("/tmp/test21a.spans");
+    cJSON *leaf_spans = read_spans("/tmp/test21b.spans");
+    assert(cJSON_GetArraySize(front_spans) == 10);
+    assert(cJSON_GetArraySize(leaf_spans) == 1);
+    cJSON *front_span_json = cJSON_GetObjectItem(front_spans, "front");
+    cJSON *leaf_span_json = cJSON_GetObjectItem(leaf_spans, "leaf");
+    assert(strcmp(cJSON_GetObjectItem(front_span_json, "traceId")->valuestring, trace_id) == 0);
+    assert(strcmp(cJSON_GetObjectItem(front_span_json, "spanId")->valuestring, front_span) == 0);
+    assert(!cJSON_HasObjectItem(front_span_json, "parentSpanId"));
+    assert(strcmp(cJSON_GetObjectItem(leaf_span_json, "traceId")->valuestring, trace_id) == 0);
+    assert(strcmp(cJSON_GetObjectItem(leaf_span_json, "parentSpanId")->valuestring,
+                  front_span) == 0);
+    assert(span_attribute(front_span_json, "sockrpc.queue_ns") >= 0);
+    assert(span_attribute(front_span_json, "sockrpc.handler_ns") >=
+           span_attribute(leaf_span_json, "sockrpc.handler_ns"));
+    assert(span_attribute(front_span_json, "sockrpc.send_ns") >= 0);
+    cJSON_Delete(front_spans);
+    cJSON_Delete(leaf_spans);
+
+    unlink("/tmp/test21a.spans");
+    unlink("/tmp/test21b.spans");
+    printf("Trace propagation test passed\n");
+}
+
+// Reads a flight recorder dump and counts its entries by status. Layout
+// (src/recorder.h): a 40-byte header with the entry count at offset 32,
+// then 64-byte entries with the status at offset 40 and the method at 44.
+static int read_dump(const char *path, int statuses[4], int *adds)
+{
+    FILE *fp = fopen(path, "rb");
+    if (!fp)
+        return -1;
+
+    unsigned char header[40], entry[64];
+    assert(fread(header, sizeof(header), 1, fp) == 1);
+    assert(memcmp(header, "SRPCFR1", 8) == 0);
+    uint32_t count;
+    memcpy(&count, header + 32, sizeof(count));
+
+    uint64_t last = 0;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        assert(fread(entry, sizeof(entry), 1, fp) == 1);
+        uint64_t start;
+        uint16_t status;
+        memcpy(&start, entry + 8, sizeof(start));
+        memcpy(&status, entry + 40, sizeof(status));
+        assert(start >= last && status < 4);
+        last = start;
+        statuses[status]++;
+        if (strncmp((char *)entry + 44, "add", 20) == 0)
+            (*adds)++;
+    }
+    assert(fread(entry, 1, 1, fp) == 0);
+    fclose(fp);
+    return (int)count;
+}
+
+static void test_flight_recorder()
+{
+    printf("Testing flight recorder...\n");
+    unlink("/tmp/test22.dump");
+
+    sockrpc_server *server = sockrpc_server_create("/tmp/test22.sock");
+    sockrpc_group_config config = {.threads = 1};
+    assert(sockrpc_server_add_group(server, "math", &config) == 0);
+    sockrpc_server_register(server, "echo", echo_handler);
+    sockrpc_server_register(server, "null", null_handler);
+    sockrpc_server_register_in_group(server, "add", add_handler, "math");
+    assert(sockrpc_server_set_dump_signal(server, "/tmp/test22.dump") == 0);
+    assert(sockrpc_server_set_dump_signal(server, "/tmp/test22.dump") == -1);
+    assert(sockrpc_server_dump_requests(server, NULL) == -1);
+    sockrpc_server_start(server);
+    assert(sockrpc_server_set_dump_signal(server, "/tmp/test22.other") == -1);
+    usleep(100000); // Give server time to start
+
+    sockrpc_client *client = sockrpc_client_create("/tmp/test22.sock");
+    for (int i = 0; i < 5; i++)
+        cJSON_Delete(sockrpc_client_call_sync(client, "echo", cJSON_CreateNumber(i)));
+    cJSON *params = cJSON_CreateIntArray((int[]){2, 3}, 2);
+    for (int i = 0; i < 2; i++)
+        cJSON_Delete(sockrpc_client_call_sync(client, "add", cJSON_Duplicate(params, 1)));
+    cJSON_Delete(params);
+    assert(sockrpc_client_call_sync(client, "null", NULL) == NULL);
+    assert(sockrpc_client_call_sync(client, "missing", NULL) == NULL);
+    usleep(50000); // Requests are recorded just after their response is sent
+
+    // Every completed request is in the dump, sorted by start time
+    int statuses[4] = {0}, adds = 0;
+    assert(sockrpc_server_dump_requests(server, "/tmp/test22.fr") == 9);
+    assert(read_dump("/tmp/test22.fr", statuses, &adds) == 9);
+    assert(statuses[0] == 7 && statuses[1] == 1 && statuses[3] == 1);
+    assert(adds == 2);
+
+    cJSON *stats = sockrpc_server_get_stats(server);
+    cJSON *recorder = cJSON_GetObjectItem(stats, "recorder");
+    assert(cJSON_GetObjectItem(recorder, "recorded")->valueint == 9);
+    assert(cJSON_GetObjectItem(recorder, "threads")->valueint >= 2);
+    cJSON_Delete(stats);
+
+    // SIGUSR2 makes a worker write the dump path
+    cJSON_Delete(sockrpc_client_call_sync(client, "echo", cJSON_CreateNumber(5)));
+    usleep(50000);
+    raise(SIGUSR2);
+    int written = -1;
+    for (int i = 0; i < 100 && written == -1; i++)
+    {
+        usleep(10000);
+        memset(statuses, 0, sizeof(statuses));
+        adds = 0;
+        written = read_dump("/tmp/test22.dump", statuses, &adds);
+    }
+    assert(written == 10 && statuses[0] == 8);
+
+    sockrpc_client_destroy(client);
+    sockrpc_server_destroy(server);
+
+    // A signal after the server is gone is ignored
+    raise(SIGUSR2);
+    unlink("/tmp/test22.fr");
+    unlink("/tmp/test22.dump");
+    printf("Flight recorder test passed\n");
+}
+
+// Reads a capture file: a 24-byte header ("SRPCCAP"), then records of a
+// 24-byte header (offset_ns, connection, length at 16, worker at 20) and
+// the payload. Connections are told apart by handle and worker.
+static int read_capture(const char *path, int *echoes, uint64_t connections[2])
+{
+    FILE *fp = fopen(path, "rb");
+    assert(fp);
+
+    unsigned char header[24], record[24];
+    assert(fread(header, sizeof(header), 1, fp) == 1);
+    assert(memcmp(header, "SRPCCAP", 8) == 0);
+
+    int count = 0;
+    uint64_t last = 0;
+    while (fread(record, sizeof(record), 1, fp) == 1)
+    {
+        uint64_t offset, connection;
+        uint32_t length;
+        uint16_t worker;
+        memcpy(&offset, record, sizeof(offset));
+        memcpy(&connection, record + 8, sizeof(connection));
+        memcpy(&length, record + 16, sizeof(length));
+        memcpy(&worker, record + 20, sizeof(worker));
+        connection = connection * 64 + worker;
+        assert(offset >= last);
+        last = offset;
+
+        char *payload = malloc(length + 1);
+        assert(fread(payload, 1, length, fp) == length);
+        payload[length] = '\0';
+        cJSON *request = cJSON_Parse(payload);
+        assert(request);
+        if (strcmp(cJSON_GetObjectItem(request, "method")->valuestring, "echo") == 0)
+        {
+            (*echoes)++;
+            connections[0] = connection;
+        }
+        else
+            connections[1] = connection;
+        cJSON_Delete(request);
+        free(payload);
+        count++;
+    }
+    fclose(fp);
+    return count;
+}
+
+static void test_capture()
+{
+    printf("Testing traffic capture...\n");
+    sockrpc_capture_config config = {.path = "/tmp/test23.cap", .buffer_size = 256};
+    sockrpc_capture_config unwritable = {.path = "/nonexistent/test23.cap"};
+
+    sockrpc_server *server = sockrpc_server_create("/tmp/test23.sock");
+    sockrpc_server_register(server, "echo", echo_handler);
+    sockrpc_server_register(server, "add", add_handler);
+    assert(sockrpc_server_set_capture(server, &unwritable) == -1);
+    assert(sockrpc_server_set_capture(server, &config) == 0);
+    assert(sockrpc_server_set_capture(server, &config) == -1);
+    sockrpc_server_start(server);
+    usleep(100000); // Give server time to start
+
+    // Requests of both connections, more than one small buffer holds
+    sockrpc_client *first = sockrpc_client_create("/tmp/test23.sock");
+    sockrpc_client *second = sockrpc_client_create("/tmp/test23.sock");
+    for (int i = 0; i < 5; i++)
+    {
+        cJSON_Delete(sockrpc_client_call_sync(first, "echo", cJSON_CreateString("captured")));
+        cJSON *params = cJSON_CreateIntArray((int[]){i, 1}, 2);
+        cJSON *result = sockrpc_client_call_sync(second, "add", params);
+        assert(result && result->valueint == i + 1);
+        cJSON_Delete(result);
+    }
+
+    cJSON *stats = sockrpc_server_get_stats(server);
+    cJSON *capture = cJSON_GetObjectItem(stats, "capture");
+    assert(cJSON_GetObjectItem(capture, "requests")->valueint == 10);
+    assert(cJSON_GetObjectItem(capture, "dropped")->valueint == 0);
+    cJSON_Delete(stats);
+
+    sockrpc_client_destroy(first);
+    sockrpc_client_destroy(second);
+    sockrpc_server_destroy(server);
+
+    // Destroying the server writes what was still buffered
+    int echoes = 0;
+    uint64_t connections[2] = {0};
+    assert(read_capture("/tmp/test23.cap", &echoes, connections) == 10);
+    assert(echoes == 5);
+    assert(connections[0] != connections[1]);
+
+    unlink("/tmp/test23.cap");
+    printf("Traffic capture test passed\n");
+}
+
+// Runs on the thread driving the embedded server
+static pthread_t handler_thread;
+
+static cJSON *thread_add_handler(cJSON *params)
+{
+    handler_thread = pthread_self();
+    return add_handler(params);
+}
+
+typedef struct
+{
+    const char *path;
+    int results[3];
+    int done; // Written by the client thread, accessed atomically
+} embedded_calls;
+
+static void *embedded_client(void *arg)
+{
+    embedded_calls *calls = arg;
+    sockrpc_client *client = sockrpc_client_create(calls->path);
+    for (int i = 0; client && i < 3; i++)
+    {
+        cJSON *result = sockrpc_client_call_sync(client, "add",
+                                                 cJSON_CreateIntArray((int[]){i, 10}, 2));
+        calls->results[i] = result ? result->valueint : -1;
+        cJSON_Delete(result);
+    }
+    sockrpc_client_destroy(client);
+    __atomic_store_n(&calls->done, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+// The application's loop: poll the descriptor, then process one event at a time
+static void serve_embedded(sockrpc_server *server, const char *path)
+{
+    embedded_calls calls = {path, {0}, 0};
+    pthread_t client_thread;
+    pthread_create(&client_thread, NULL, embedded_client, &calls);
+    while (!__atomic_load_n(&calls.done, __ATOMIC_ACQUIRE))
+    {
+        struct pollfd pfd = {.fd = sockrpc_server_get_fd(server), .events = POLLIN};
+        if (poll(&pfd, 1, 100) > 0)
+            assert(sockrpc_server_process(server, 1) == 1);
+    }
+    pthread_join(client_thread, NULL);
+
+    for (int i = 0; i < 3; i++)
+        assert(calls.results[i] == i + 10);
+}
+
+static void test_embedded_server()
+{
+    printf("Testing embedded server...\n");
+    sockrpc_server *server = sockrpc_server_create("/tmp/test24.sock");
+    sockrpc_server_register(server, "add", thread_add_handler);
+    assert(sockrpc_server_get_fd(server) == -1);
+    assert(sockrpc_server_process(server, 1) == -1);
+
+    assert(sockrpc_server_start_embedded(server) == 0);
+    assert(sockrpc_server_start_embedded(server) == -1);
+    int fd = sockrpc_server_get_fd(server);
+    assert(fd >= 0);
+    assert(sockrpc_server_process(server, 0) == -1);
+    assert(sockrpc_server_process(server, 8) == 0);
+
+    // A second server driven by the same thread, gone before the first is used
+    sockrpc_server *other = sockrpc_server_create("/tmp/test30.sock");
+    sockrpc_server_register(other, "add", thread_add_handler);
+    assert(sockrpc_server_start_embedded(other) == 0);
+    serve_embedded(other, "/tmp/test30.sock");
+    sockrpc_server_destroy(other);
+
+    serve_embedded(server, "/tmp/test24.sock");
+    assert(pthread_equal(handler_thread, pthread_self()));
+
+    // Each server recorded its own requests in its own ring
+    cJSON *stats = sockrpc_server_get_stats(server);
+    cJSON *connections = cJSON_GetObjectItem(stats, "connections");
+    assert(cJSON_GetObjectItem(connections, "accepted")->valueint == 1);
+    cJSON *recorder = cJSON_GetObjectItem(stats, "recorder");
+    assert(cJSON_GetObjectItem(recorder, "threads")->valueint == 1);
+    assert(cJSON_GetObjectItem(recorder, "recorded")->valueint == 3);
+    cJSON_Delete(stats);
+
+    sockrpc_server_destroy(server);
+    assert(access("/tmp/test24.sock", F_OK) == -1);
+    printf("Embedded server test passed\n");
+}
+
+// Stores the result of a non-blocking call in the int ctx points to, -1 for NULL
+static void store_completion(cJSON *result, void *ctx)
+{
+    *(int *)ctx = result ? result->valueint : -1;
+    cJSON_Delete(result);
+}
+
+// Submits add(1, 2) on a new non-blocking client and runs the loop until it completes
+static int drive_nonblocking(const char *address)
+{
+    sockrpc_client *client = sockrpc_client_create_nonblocking(address);
+    if (!client)
+        return -1;
+
+    int result = 0;
+    assert(sockrpc_client_submit(client, "add", cJSON_CreateIntArray((int[]){1, 2}, 2),
+                                 store_completion, &result) == 0);
+    assert(sockrpc_client_wants_write(client));
+    while (result == 0)
+    {
+        struct pollfd pfd = {.fd = sockrpc_client_fd(client),
+                             .events = POLLIN | (sockrpc_client_wants_write(client) ? POLLOUT : 0)};
+        assert(poll(&pfd, 1, 5000) == 1);
+        if (pfd.revents & POLLOUT)
+            sockrpc_client_on_writable(client);
+        if (result == 0 && (pfd.revents & (POLLIN | POLLHUP | POLLERR)))
+            sockrpc_client_on_readable(client);
+    }
+    sockrpc_client_destroy(client);
+    return result;
+}
+
+static void test_nonblocking_client()
+{
+    printf("Testing non-blocking client...\n");
+    sockrpc_server *server = sockrpc_server_create("/tmp/test25.sock");
+    sockrpc_server_register(server, "add", add_handler);
+    sockrpc_server_start(server);
+    usleep(100000); // Give server time to start
+
+    assert(sockrpc_client_create_nonblocking("unixpacket:///tmp/test25.sock") == NULL);
+    sockrpc_client *blocking = sockrpc_client_create("/tmp/test25.sock");
+    assert(sockrpc_client_fd(blocking) == -1);
+    assert(sockrpc_client_submit(blocking, "add", cJSON_CreateIntArray((int[]){1, 2}, 2),
+                                 store_completion, NULL) == -1);
+    sockrpc_client_destroy(blocking);
+
+    sockrpc_client *client = sockrpc_client_create_nonblocking("/tmp/test25.sock");
+    assert(client);
+    int fd = sockrpc_client_fd(client);
+    assert(fd >= 0);
+    assert(!sockrpc_client_wants_write(client));
+    assert(sockrpc_client_call_sync(client, "add", cJSON_CreateIntArray((int[]){1, 2}, 2)) == NULL);
+
+    // Many calls outstanding at once, more than the socket buffers hold
+    enum { CALLS = 5000 };
+    static int results[CALLS + 1];
+    for (int i = 0; i < CALLS; i++)
+    {
+        results[i] = 0;
+        assert(sockrpc_client_submit(client, "add", cJSON_CreateIntArray((int[]){i, 1}, 2),
+                                     store_completion, &results[i]) == 0);
+    }
+    results[CALLS] = 0;
+    assert(sockrpc_client_submit(client, "missing", NULL, store_completion, &results[CALLS]) == 0);
+    assert(sockrpc_client_wants_write(client));
+
+    int completed = 0;
+    while (completed < CALLS + 1)
+    {
+        struct pollfd pfd = {.fd = fd,
+                             .events = POLLIN | (sockrpc_client_wants_write(client) ? POLLOUT : 0)};
+        assert(poll(&pfd, 1, 5000) == 1);
+        if (pfd.revents & POLLOUT)
+            assert(sockrpc_client_on_writable(client) >= 0);
+        if (pfd.revents & POLLIN)
+        {
+            int n = sockrpc_client_on_readable(client);
+            assert(n >= 0);
+            completed += n;
+        }
+    }
+    for (int i = 0; i < CALLS; i++)
+        assert(results[i] == i + 1);
+    assert(results[CALLS] == -1);
+    assert(!sockrpc_client_wants_write(client));
+
+    // Calls still outstanding complete with NULL when the client goes away
+    int pending = 0;
+    assert(sockrpc_client_submit(client, "add", cJSON_CreateIntArray((int[]){1, 2}, 2),
+                                 store_completion, &pending) == 0);
+    sockrpc_client_destroy(client);
+    assert(pending == -1);
+    sockrpc_server_destroy(server);
+
+    // A TCP connect completes in the loop, calls submitted meanwhile go out after it
+    server = sockrpc_server_create("tcp://127.0.0.1:19054");
+    sockrpc_server_register(server, "add", add_handler);
+    sockrpc_server_start(server);
+    usleep(100000); // Give server time to start
+    assert(drive_nonblocking("tcp://127.0.0.1:19054") == 3);
+    sockrpc_server_destroy(server);
+
+    // ...and one that fails completes them with NULL, without blocking the caller
+    int closed = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = {.sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK)};
+    socklen_t len = sizeof(addr);
+    assert(bind(closed, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+    assert(getsockname(closed, (struct sockaddr *)&addr, &len) == 0);
+    char url[64];
+    snprintf(url, sizeof(url), "tcp://127.0.0.1:%d", ntohs(addr.sin_port));
+    assert(drive_nonblocking(url) == -1);
+    close(closed);
+
+    printf("Non-blocking client test passed\n");
+}
+
+// Fan-out state of one deferred "sum_twice" call
+typedef struct
+{
+    sockrpc_call *call;
+    pthread_t thread;
+    int remaining;
+    int total;
+    int failed;
+} fan_out;
+
+// Counts completions that ran on a thread other than their handler's
+static int foreign_completions;
+
+static void fan_out_done(cJSON *result, void *ctx)
+{
+    fan_out *state = ctx;
+    if (!pthread_equal(state->thread, pthread_self()))
+        __atomic_add_fetch(&foreign_completions, 1, __ATOMIC_RELAXED);
+    if (result)
+        state->total += result->valueint;
+    else
+        state->failed = 1;
+    cJSON_Delete(result);
+
+    if (--state->remaining == 0)
+    {
+        sockrpc_call_complete(state->call, state->failed ? NULL : cJSON_CreateNumber(state->total));
+        free(state);
+    }
+}
+
+// Adds the params twice through two concurrent calls to the backend in ctx
+static void sum_twice_handler(cJSON *params, sockrpc_call *call, void *ctx)
+{
+    sockrpc_client *backend = sockrpc_call_client(call, ctx);
+    if (!backend)
+    {
+        sockrpc_call_complete(call, NULL);
+        return;
+    }
+
+    fan_out *state = calloc(1, sizeof(fan_out));
+    state->call = call;
+    state->thread = pthread_self();
+    state->remaining = 2;
+    for (int i = 0; i < 2; i++)
+    {
+        if (sockrpc_call_submit(call, backend, "add", cJSON_Duplicate(params, 1), fan_out_done,
+                                state) == -1)
+            fan_out_done(NULL, state);
+    }
+}
+
+static void immediate_handler(cJSON *params, sockrpc_call *call, void *ctx)
+{
+    (void)ctx;
+    sockrpc_call_complete(call, cJSON_Duplicate(params, 1));
+}
+
+static void test_deferred_calls()
+{
+    printf("Testing deferred calls...\n");
+    sockrpc_server *backend = sockrpc_server_create("/tmp/test26.sock");
+    sockrpc_server_register(backend, "add", add_handler);
+    sockrpc_server_start(backend);
+
+    sockrpc_server *front = sockrpc_server_create("/tmp/test27.sock");
+    assert(sockrpc_server_register_deferred(front, "sum_twice", NULL, NULL) == -1);
+    assert(sockrpc_server_register_deferred(front, "sum_twice", sum_twice_handler,
+                                            "/tmp/test26.sock") == 0);
+    assert(sockrpc_server_register_deferred(front, "unreachable", sum_twice_handler,
+                                            "/tmp/test_missing.sock") == 0);
+    assert(sockrpc_server_register_deferred(front, "immediate", immediate_handler, NULL) == 0);
+
+    // A refused TCP connect fails after the handler returns; names are not looked up
+    int closed = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = {.sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK)};
+    socklen_t len = sizeof(addr);
+    assert(bind(closed, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+    assert(getsockname(closed, (struct sockaddr *)&addr, &len) == 0);
+    char refused[64];
+    snprintf(refused, sizeof(refused), "tcp://127.0.0.1:%d", ntohs(addr.sin_port));
+    assert(sockrpc_server_register_deferred(front, "refused", sum_twice_handler, refused) == 0);
+    assert(sockrpc_server_register_deferred(front, "named", sum_twice_handler,
+                                            "tcp://localhost:1") == 0);
+    sockrpc_server_start(front);
+    usleep(100000); // Give servers time to start
+
+    sockrpc_client *client = sockrpc_client_create("/tmp/test27.sock");
+    for (int i = 0; i < 200; i++)
+    {
+        cJSON *result =
+            sockrpc_client_call_sync(client, "sum_twice", cJSON_CreateIntArray((int[]){i, 3}, 2));
+        assert(result && result->valueint == 2 * (i + 3));
+        cJSON_Delete(result);
+    }
+    assert(foreign_completions == 0);
+
+    cJSON *result = sockrpc_client_call_sync(client, "immediate", cJSON_CreateString("now"));
+    assert(cJSON_IsString(result) && strcmp(result->valuestring, "now") == 0);
+    cJSON_Delete(result);
+    assert(sockrpc_client_call_sync(client, "unreachable",
+                                    cJSON_CreateIntArray((int[]){1, 2}, 2)) == NULL);
+    assert(sockrpc_client_call_sync(client, "refused",
+                                    cJSON_CreateIntArray((int[]){1, 2}, 2)) == NULL);
+    assert(sockrpc_client_call_sync(client, "named",
+                                    cJSON_CreateIntArray((int[]){1, 2}, 2)) == NULL);
+    close(closed);
+    assert(sockrpc_call_client(NULL, "/tmp/test26.sock") == NULL);
+
+    // A backend going away fails the calls in flight; the next call reconnects
+    sockrpc_server_destroy(backend);
+    assert(sockrpc_client_call_sync(client, "sum_twice",
+                                    cJSON_CreateIntArray((int[]){1, 2}, 2)) == NULL);
+    backend = sockrpc_server_create("/tmp/test26.sock");
+    sockrpc_server_register(backend, "add", add_handler);
+    sockrpc_server_start(backend);
+    usleep(100000); // Give server time to start
+    result = sockrpc_client_call_sync(client, "sum_twice", cJSON_CreateIntArray((int[]){1, 2}, 2));
+    assert(result && result->valueint == 6);
+    cJSON_Delete(result);
+
+    sockrpc_client_destroy(client);
+    sockrpc_server_destroy(front);
+    sockrpc_server_destroy(backend);
+    printf("Deferred calls test passed\n");
+}
+
+// Returns a "corking" counter from the server stats
+static int corking_stat(sockrpc_server *server, const char *name)
+{
+    cJSON *stats = sockrpc_server_get_stats(server);
+    int value = cJSON_GetObjectItem(cJSON_GetObjectItem(stats, "corking"), name)->valueint;
+    cJSON_Delete(stats);
+    return value;
+}
+
+// Writes the requests in one write and checks every id is answered once
+static void pipeline_requests(int fd, const char *method, int first, int count, int param)
+{
+    char *frames = malloc((size_t)count * 128);
+    size_t len = 0;
+    for (int id = first; id < first + count; id++)
+    {
+        char json[96];
+        snprintf(json, sizeof(json), "{\"id\":%d,\"method\":\"%s\",\"params\":%d}", id, method,
+                 param);
+        len += encode_raw_frame(frames + len, json);
+    }
+    assert(write(fd, frames, len) == (ssize_t)len);
+    free(frames);
+
+    char *seen = calloc(count, 1);
+    for (int i = 0; i < count; i++)
+    {
+        cJSON *response = read_raw_frame(fd);
+        int id = cJSON_GetObjectItem(response, "id")->valueint;
+        assert(id >= first && id < first + count && !seen[id - first]);
+        assert(cJSON_GetObjectItem(response, "result"));
+        seen[id - first] = 1;
+        cJSON_Delete(response);
+    }
+    free(seen);
+}
+
+static void test_response_corking()
+{
+    printf("Testing response corking...\n");
+    sockrpc_server *server = sockrpc_server_create("/tmp/test28.sock");
+    assert(sockrpc_server_set_cork_deadline(server, 0) == 0); // Slow runs must not flush early
+    sockrpc_server_register(server, "echo", echo_handler);
+    sockrpc_server_register(server, "listing", listing_handler);
+    sockrpc_server_start(server);
+    usleep(100000); // Give server time to start
+    assert(sockrpc_server_set_cork_deadline(server, 200) == -1);
+
+    // A lone request is answered directly
+    sockrpc_client *client = sockrpc_client_create("/tmp/test28.sock");
+    cJSON *result = sockrpc_client_call_sync(client, "echo", cJSON_CreateNumber(7));
+    assert(result && result->valueint == 7);
+    cJSON_Delete(result);
+    sockrpc_client_destroy(client);
+    assert(corking_stat(server, "responses") == 0);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    strcpy(addr.sun_path, "/tmp/test28.sock");
+    assert(connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+
+    // Pipelined requests are answered with far fewer writes
+    pipeline_requests(fd, "echo", 0, 500, 1);
+    int responses = corking_stat(server, "responses");
+    int writes = corking_stat(server, "writes");
+    assert(responses >= 490);
+    assert(writes > 0 && writes * 10 < responses);
+
+    // Responses beyond the cork's size are written as it fills, or directly
+    pipeline_requests(fd, "listing", 1000, 8, 1500);
+    pipeline_requests(fd, "listing", 2000, 4, 5000);
+    assert(corking_stat(server, "writes") > writes + 2);
+
+    // The cork buffer is back in the pool once the batch is out
+    usleep(50000);
+    cJSON *stats = sockrpc_server_get_stats(server);
+    assert(cJSON_GetObjectItem(cJSON_GetObjectItem(stats, "buffers"), "in_use_bytes")->valuedouble ==
+           0);
+    cJSON_Delete(stats);
+
+    close(fd);
+    sockrpc_server_destroy(server);
+    printf("Response corking test passed\n");
+}
+
+static void test_slow_reader()
+{
+    printf("Testing a client that stops reading...\n");
+    sockrpc_server *server = sockrpc_server_create("/tmp/test31.sock");
+    sockrpc_server_register(server, "echo", echo_handler);
+    sockrpc_server_register_response(server, "blob", blob_handler, NULL);
+    sockrpc_server_start(server);
+    usleep(100000); // Give server time to start
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    int rcvbuf = 4096;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    strcpy(addr.sun_path, "/tmp/test31.sock");
+    assert(connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+
+    // Far more response bytes than the socket holds, none of them read yet
+    char frames[32 * 64];
+    size_t len = 0;
+    for (int id = 0; id < 32; id++)
+    {
+        char json[64];
+        snprintf(json, sizeof(json), "{\"id\":%d,\"method\":\"blob\"}", id);
+        len += encode_raw_frame(frames + len, json);
+    }
+    assert(write(fd, frames, len) == (ssize_t)len);
+    usleep(100000);
+
+    // One of these shares the stalled connection's worker; none waits for it
+    for (int i = 0; i < 4; i++)
+    {
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        sockrpc_client *client = sockrpc_client_create("/tmp/test31.sock");
+        cJSON *result = sockrpc_client_call_sync(client, "echo", cJSON_CreateNumber(i));
+        assert(result && result->valueint == i);
+        cJSON_Delete(result);
+        sockrpc_client_destroy(client);
+        assert(elapsed_ms(&start) < 2500);
+    }
+
+    // The queued responses arrive intact once the client reads again
+    for (int id = 0; id < 32; id++)
+    {
+        cJSON *response = read_raw_frame(fd);
+        assert(cJSON_GetObjectItem(response, "id")->valueint == id);
+        cJSON *result = cJSON_GetObjectItem(response, "result");
+        assert(strcmp(cJSON_GetObjectItem(result, "data")->valuestring, blob) == 0);
+        cJSON_Delete(response);
+    }
+
+    close(fd);
+    sockrpc_server_destroy(server);
+    printf("Slow reader test passed\n");
+}
+
+static int coalesced_results = 0;
+static long coalesced_sum = 0;
+
+static void coalesced_callback(cJSON *result)
+{
+    if (result)
+        __atomic_add_fetch(&coalesced_sum, (long)result->valuedouble, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&coalesced_results, 1, __ATOMIC_RELAXED);
+    cJSON_Delete(result);
+}
+
+static sockrpc_client *coalescing_client = NULL;
+static int stop_in_callback = 0;
+static int gate_open = 0;
+
+// Answers once the test opens the gate
+static cJSON *gated_handler(cJSON *params)
+{
+    while (!__atomic_load_n(&gate_open, __ATOMIC_ACQUIRE))
+        usleep(1000);
+    return cJSON_Duplicate(params, 1);
+}
+
+// Tries to stop coalescing from the coalescing thread
+static void stopping_callback(cJSON *result)
+{
+    stop_in_callback = sockrpc_client_set_coalescing(coalescing_client, 0, 0, 0);
+    coalesced_callback(result);
+}
+
+// Waits up to ten seconds for count coalesced callbacks
+static int wait_coalesced(int count)
+{
+    for (int i = 0; i < 10000 && __atomic_load_n(&coalesced_results, __ATOMIC_RELAXED) < count; i++)
+        usleep(1000);
+    return __atomic_load_n(&coalesced_results, __ATOMIC_RELAXED) == count;
+}
+
+// Returns a "coalescing" counter from the client stats
+static double coalescing_stat(sockrpc_client *client, const char *name)
+{
+    cJSON *stats = sockrpc_client_get_stats(client);
+    cJSON *section = cJSON_GetObjectItem(stats, "coalescing");
+    double value = section ? cJSON_GetObjectItem(section, name)->valuedouble : -1;
+    cJSON_Delete(stats);
+    return value;
+}
+
+static void test_call_coalescing()
+{
+    printf("Testing call coalescing...\n");
+    sockrpc_server *server = sockrpc_server_create("/tmp/test29.sock");
+    sockrpc_group_config heavy = {.threads = 1};
+    assert(sockrpc_server_add_group(server, "heavy", &heavy) == 0);
+    assert(sockrpc_server_register_in_group(server, "gated", gated_handler, "heavy") == 0);
+    sockrpc_server_register(server, "echo", echo_handler);
+    sockrpc_server_start(server);
+    usleep(100000); // Give server time to start
+
+    sockrpc_client *nonblocking = sockrpc_client_create_nonblocking("/tmp/test29.sock");
+    assert(sockrpc_client_set_coalescing(nonblocking, 100, 0, 0) == -1);
+    sockrpc_client_destroy(nonblocking);
+    assert(sockrpc_client_set_coalescing(NULL, 100, 0, 0) == -1);
+
+    sockrpc_client *client = sockrpc_client_create("/tmp/test29.sock");
+    assert(coalescing_stat(client, "calls") == -1);
+
+    // A burst of async calls leaves in a few writes, every result delivered
+    assert(sockrpc_client_set_coalescing(client, 2000, 0, 0) == 0);
+    enum { CALLS = 500 };
+    long expected = 0;
+    for (int i = 0; i < CALLS; i++)
+    {
+        sockrpc_client_call_async(client, "echo", cJSON_CreateNumber(i), coalesced_callback);
+        expected += i;
+    }
+    assert(wait_coalesced(CALLS));
+    assert(coalesced_sum == expected);
+    assert(coalescing_stat(client, "calls") == CALLS);
+    assert(coalescing_stat(client, "calls_per_write") >= 10);
+
+    // Sync calls still work in between
+    cJSON *result = sockrpc_client_call_sync(client, "echo", cJSON_CreateNumber(5));
+    assert(result && result->valueint == 5);
+    cJSON_Delete(result);
+
+    // A call limit sends the batch, the minute-long window would outlast the wait
+    assert(sockrpc_client_set_coalescing(client, 60000000, 0, 8) == 0);
+    for (int i = 0; i < 8; i++)
+        sockrpc_client_call_async(client, "echo", cJSON_CreateNumber(1), coalesced_callback);
+    assert(wait_coalesced(CALLS + 8));
+
+    // ...and so does a byte limit
+    assert(sockrpc_client_set_coalescing(client, 60000000, 64, 0) == 0);
+    cJSON *params = cJSON_CreateObject();
+    cJSON_AddStringToObject(params, "text", "longer than the byte limit of this batch, "
+                                            "so it is written at once");
+    sockrpc_client_call_async(client, "echo", params, coalesced_callback);
+    assert(wait_coalesced(CALLS + 9));
+
+    // A call in flight does not hold up the batches written after it
+    assert(sockrpc_client_set_coalescing(client, 100, 0, 0) == 0);
+    long sum = __atomic_load_n(&coalesced_sum, __ATOMIC_RELAXED);
+    sockrpc_client_call_async(client, "gated", cJSON_CreateNumber(1000), coalesced_callback);
+    usleep(20000); // Let it leave in a batch of its own
+    sockrpc_client_call_async(client, "echo", cJSON_CreateNumber(1), coalesced_callback);
+    assert(wait_coalesced(CALLS + 10));
+    assert(__atomic_load_n(&coalesced_sum, __ATOMIC_RELAXED) == sum + 1);
+    __atomic_store_n(&gate_open, 1, __ATOMIC_RELEASE);
+    assert(wait_coalesced(CALLS + 11));
+    assert(__atomic_load_n(&coalesced_sum, __ATOMIC_RELAXED) == sum + 1001);
+
+    // Callbacks run on the coalescing thread, which cannot stop itself
+    coalescing_client = client;
+    sockrpc_client_call_async(client, "echo", cJSON_CreateNumber(0), stopping_callback);
+    assert(wait_coalesced(CALLS + 12));
+    assert(stop_in_callback == -1);
+
+    // Gathered calls are answered before the client goes away
+    assert(sockrpc_client_set_coalescing(client, 1000000, 0, 0) == 0);
+    for (int i = 0; i < 3; i++)
+        sockrpc_client_call_async(client, "echo", cJSON_CreateNumber(1), coalesced_callback);
+    sockrpc_client_destroy(client);
+    assert(coalesced_results == CALLS + 15);
+
+    sockrpc_server_destroy(server);
+    printf("Call coalescing test passed\n");
+}
+
 int main()
 {
     // Ignore SIGPIPE to prevent crashes when writing to closed sockets
@@ -358,6 +2529,29 @@ int main()
     test_async_calls();
     test_multiple_methods();
     test_dynamic_registration();
+    test_start_from_fd();
+    test_abstract_seqpacket();
+    test_tcp_transport();
+    test_error_responses();
+    test_worker_groups();
+    test_handler_modules();
+    test_compression();
+    test_response_fragments();
+    test_buffer_pool();
+    test_connection_lifecycle();
+    test_busy_poll();
+    test_idle_wakeups();
+    test_pubsub();
+    test_streaming();
+    test_tracing();
+    test_flight_recorder();
+    test_capture();
+    test_embedded_server();
+    test_nonblocking_client();
+    test_deferred_calls();
+    test_response_corking();
+    test_slow_reader();
+    test_call_coalescing();
 
     printf("\nAll tests passed successfully!\n");
     return 0;
@@ -0,0 +1,188 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/wait.h>
+#include "sockrpc/sockrpc.h"
+
+/*
+ * Round-trip latency of synchronous calls over each transport:
+ * Unix stream, Unix seqpacket and loopback TCP. Answers "what does
+ * going remote cost" before moving a service off-host.
+ *
+ * The last case goes through tools/sockrpc_proxy (override with the
+ * SOCKRPC_PROXY environment variable) to show the cost of the extra
+ * hop; it is skipped if the proxy has not been built. The busy-poll
+ * case spins on both sides and only pays off with spare cores.
+ */
+
+#define WARMUP_CALLS 1000
+#define MEASURED_CALLS 20000
+
+typedef struct
+{
+    const char *name;
+    const char *address;
+    sockrpc_socket_type type;
+    const char *backend; /**< Server address when address is a proxy */
+    unsigned int busy_poll_us; /**< Spin budget of server and client */
+} transport_case;
+
+static const transport_case cases[] = {
+    {"unix stream", "/tmp/sockrpc_bench.sock", SOCKRPC_SOCK_STREAM, NULL, 0},
+    {"unix seqpacket", "@sockrpc_bench", SOCKRPC_SOCK_SEQPACKET, NULL, 0},
+    {"tcp loopback", "tcp://127.0.0.1:19500", SOCKRPC_SOCK_STREAM, NULL, 0},
+    {"unix via proxy", "/tmp/sockrpc_bench_proxy.sock", SOCKRPC_SOCK_STREAM,
+     "/tmp/sockrpc_bench.sock", 0},
+    {"unix busy-poll", "/tmp/sockrpc_bench.sock", SOCKRPC_SOCK_STREAM, NULL, 50},
+};
+
+static pid_t start_proxy(const transport_case *tc)
+{
+    const char *proxy = getenv("SOCKRPC_PROXY");
+    if (!proxy)
+        proxy = "tools/sockrpc_proxy";
+    if (access(proxy, X_OK) != 0)
+        return -1;
+
+    char route[256];
+    snprintf(route, sizeof(route), "=%s", tc->backend);
+
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        execl(proxy, proxy, tc->address, route, (char *)NULL);
+        _exit(1);
+    }
+    usleep(100000); // Give proxy time to start
+    return pid;
+}
+
+typedef struct
+{
+    size_t bytes;
+    int calls;
+} payload_case;
+
+// Fewer calls for big payloads keep the run time reasonable
+static const payload_case payloads[] = {
+    {16, MEASURED_CALLS},
+    {4096, MEASURED_CALLS / 4},
+    {65536, MEASURED_CALLS / 20},
+};
+
+static cJSON *echo_handler(cJSON *params)
+{
+    return cJSON_Duplicate(params, 1);
+}
+
+static double now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static int compare_double(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static cJSON *make_params(const char *text)
+{
+    cJSON *params = cJSON_CreateObject();
+    cJSON_AddStringToObject(params, "data", text);
+    return params;
+}
+
+static void run_case(const transport_case *tc, const payload_case *pc, double *latencies)
+{
+    sockrpc_client *client = sockrpc_client_create_ex(tc->address, tc->type);
+    if (!client)
+    {
+        fprintf(stderr, "%s: cannot connect to %s\n", tc->name, tc->address);
+        return;
+    }
+    sockrpc_client_set_busy_poll(client, tc->busy_poll_us);
+
+    size_t payload_size = pc->bytes;
+    int calls = pc->calls;
+    char *text = malloc(payload_size + 1);
+    memset(text, 'a', payload_size);
+    text[payload_size] = '\0';
+
+    for (int i = 0; i < WARMUP_CALLS; i++)
+        cJSON_Delete(sockrpc_client_call_sync(client, "echo", make_params(text)));
+
+    int failures = 0;
+    double start = now_us();
+    for (int i = 0; i < calls; i++)
+    {
+        double t0 = now_us();
+        cJSON *result = sockrpc_client_call_sync(client, "echo", make_params(text));
+        latencies[i] = now_us() - t0;
+        if (!result)
+            failures++;
+        cJSON_Delete(result);
+    }
+    double elapsed = now_us() - start;
+
+    qsort(latencies, calls, sizeof(double), compare_double);
+    fprintf(stderr, "%-16s %8zu %10.1f %8.1f %8.1f %8.1f %6d\n",
+            tc->name, payload_size,
+            calls / (elapsed / 1e6),
+            latencies[calls / 2],
+            latencies[calls * 99 / 100],
+            latencies[calls - 1],
+            failures);
+
+    free(text);
+    sockrpc_client_destroy(client);
+}
+
+int main()
+{
+    signal(SIGPIPE, SIG_IGN);
+
+    double *latencies = malloc(MEASURED_CALLS * sizeof(double));
+
+    // Results go to stderr so they stay readable next to server logging
+    fprintf(stderr, "%-16s %8s %10s %8s %8s %8s %6s\n",
+            "transport", "bytes", "calls/s", "p50 us", "p99 us", "max us", "fails");
+
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++)
+    {
+        const transport_case *tc = &cases[c];
+        sockrpc_server *server = sockrpc_server_create(tc->backend ? tc->backend : tc->address);
+        sockrpc_server_set_socket_type(server, tc->type);
+        sockrpc_server_set_busy_poll(server, tc->busy_poll_us);
+        sockrpc_server_register(server, "echo", echo_handler);
+        sockrpc_server_start(server);
+        usleep(100000); // Give server time to start
+
+        pid_t proxy = -1;
+        if (tc->backend && (proxy = start_proxy(tc)) == -1)
+        {
+            fprintf(stderr, "%-16s skipped (proxy not built)\n", tc->name);
+            sockrpc_server_destroy(server);
+            continue;
+        }
+
+        for (size_t p = 0; p < sizeof(payloads) / sizeof(payloads[0]); p++)
+            run_case(tc, &payloads[p], latencies);
+
+        if (proxy > 0)
+        {
+            kill(proxy, SIGTERM);
+            waitpid(proxy, NULL, 0);
+        }
+        sockrpc_server_destroy(server);
+    }
+
+    free(latencies);
+    return 0;
+}
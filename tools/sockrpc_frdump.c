@@ -0,0 +1,372 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "../src/recorder.h"
+
+/**
+ * @file sockrpc_frdump.c
+ * @brief Decoder of flight recorder dumps
+ *
+ * Usage:
+ *   sockrpc_frdump [-n count] [-w ms] <dump-file>
+ *
+ * Reads a file written by sockrpc_server_dump_requests or on SIGUSR2
+ * and prints:
+ * 1. The slowest requests with the time spent in each phase
+ * 2. A per-method breakdown: calls, failures, latency percentiles and
+ *    the average time before the handler, in it and sending
+ * 3. With -w, the same breakdown restricted to the window of that many
+ *    milliseconds on either side of the slowest request, to show what
+ *    else the server was doing around the spike
+ *
+ * Times are relative to the dump, e.g. -1.250s is 1.25 seconds before it.
+ */
+
+/**
+ * @brief Default number of slowest requests printed
+ */
+#define DEFAULT_SLOWEST 10
+
+/**
+ * @brief Per-method aggregate of one breakdown
+ */
+typedef struct
+{
+    char method[RECORDER_METHOD_LEN + 1]; /**< NUL-terminated method name */
+    unsigned long count;                  /**< Requests */
+    unsigned long failed;                 /**< Requests not answered with a result */
+    uint64_t *totals;                     /**< Total time of each request */
+    uint64_t queue_ns;                    /**< Sum of queue times */
+    uint64_t handler_ns;                  /**< Sum of handler times */
+    uint64_t send_ns;                     /**< Sum of send times */
+} method_summary;
+
+/**
+ * @brief Total time of a request
+ * @param entry Request
+ * @return Nanoseconds from dispatch to response sent
+ */
+static uint64_t total_ns(const recorder_entry *entry)
+{
+    return (uint64_t)entry->queue_ns + entry->handler_ns + entry->send_ns;
+}
+
+/**
+ * @brief Orders entries by decreasing total time
+ * @param a First entry
+ * @param b Second entry
+ * @return Negative, zero or positive
+ */
+static int compare_slowest(const void *a, const void *b)
+{
+    uint64_t x = total_ns(*(const recorder_entry *const *)a);
+    uint64_t y = total_ns(*(const recorder_entry *const *)b);
+    return x > y ? -1 : x < y;
+}
+
+/**
+ * @brief Orders durations increasingly
+ * @param a First duration
+ * @param b Second duration
+ * @return Negative, zero or positive
+ */
+static int compare_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+/**
+ * @brief Orders summaries by decreasing request count
+ * @param a First summary
+ * @param b Second summary
+ * @return Negative, zero or positive
+ */
+static int compare_count(const void *a, const void *b)
+{
+    unsigned long x = ((const method_summary *)a)->count;
+    unsigned long y = ((const method_summary *)b)->count;
+    return x > y ? -1 : x < y;
+}
+
+/**
+ * @brief Names a record_status
+ * @param status Status of an entry
+ * @return Short name
+ */
+static const char *status_name(uint16_t status)
+{
+    switch (status)
+    {
+    case RECORD_OK:
+        return "ok";
+    case RECORD_FAILED:
+        return "failed";
+    case RECORD_BUSY:
+        return "busy";
+    case RECORD_NOT_FOUND:
+        return "not-found";
+    default:
+        return "?";
+    }
+}
+
+/**
+ * @brief Formats the thread that completed a request
+ * @param thread Thread id of the entry
+ * @param text Buffer of at least 16 bytes
+ */
+static void format_thread(uint8_t thread, char *text)
+{
+    if (thread == RECORDER_OTHER_THREAD)
+        snprintf(text, 16, "other");
+    else if (thread >= RECORDER_GROUP_THREAD)
+        snprintf(text, 16, "group%d", thread - RECORDER_GROUP_THREAD);
+    else
+        snprintf(text, 16, "worker%d", thread);
+}
+
+/**
+ * @brief Converts nanoseconds to microseconds for printing
+ * @param ns Nanoseconds
+ * @return Microseconds
+ */
+static double us(uint64_t ns)
+{
+    return ns / 1000.0;
+}
+
+/**
+ * @brief Prints the slowest requests
+ * @param header Dump header
+ * @param order Entries sorted slowest first
+ * @param count Number of entries
+ * @param limit Requests to print
+ */
+static void print_slowest(const recorder_header *header, recorder_entry **order, size_t count,
+                          size_t limit)
+{
+    printf("Slowest requests:\n");
+    printf("  %10s  %-20s %-9s %-9s %6s %10s %10s %10s %10s %8s %8s\n", "at", "method",
+           "status", "thread", "conn", "total_us", "queue_us", "handler_us", "send_us", "req_B",
+           "resp_B");
+    for (size_t i = 0; i < count && i < limit; i++)
+    {
+        const recorder_entry *e = order[i];
+        char method[RECORDER_METHOD_LEN + 1] = {0};
+        char thread[16];
+        memcpy(method, e->method, RECORDER_METHOD_LEN);
+        format_thread(e->thread, thread);
+        double at = ((double)e->start_ns - (double)header->dump_ns) / 1e9;
+        printf("  %9.3fs  %-20s %-9s %-9s %6u %10.1f %10.1f %10.1f %10.1f %8u %8u\n", at, method,
+               status_name(e->status), thread, e->connection, us(total_ns(e)), us(e->queue_ns),
+               us(e->handler_ns), us(e->send_ns), e->request_bytes, e->response_bytes);
+    }
+}
+
+/**
+ * @brief Prints per-method statistics of a range of entries
+ * @param entries Entries sorted by start time
+ * @param count Number of entries
+ * @param from First start time included
+ * @param to Last start time included
+ * @return 0 on success, -1 on allocation failure
+ */
+static int print_methods(const recorder_entry *entries, size_t count, uint64_t from, uint64_t to)
+{
+    method_summary *summaries = calloc(count ? count : 1, sizeof(method_summary));
+    uint64_t *totals = malloc((count ? count : 1) * sizeof(uint64_t));
+    if (!summaries || !totals)
+    {
+        free(summaries);
+        free(totals);
+        return -1;
+    }
+
+    // Group the range's durations by method, each method's slice of totals is contiguous
+    size_t methods = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        const recorder_entry *e = &entries[i];
+        if (e->start_ns < from || e->start_ns > to)
+            continue;
+
+        size_t m = 0;
+        while (m < methods && strncmp(summaries[m].method, e->method, RECORDER_METHOD_LEN) != 0)
+            m++;
+        if (m == methods)
+            memcpy(summaries[methods++].method, e->method, RECORDER_METHOD_LEN);
+
+        method_summary *s = &summaries[m];
+        s->count++;
+        s->failed += e->status != RECORD_OK;
+        s->queue_ns += e->queue_ns;
+        s->handler_ns += e->handler_ns;
+        s->send_ns += e->send_ns;
+    }
+
+    size_t offset = 0;
+    for (size_t m = 0; m < methods; m++)
+    {
+        summaries[m].totals = totals + offset;
+        offset += summaries[m].count;
+        summaries[m].count = 0;
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        const recorder_entry *e = &entries[i];
+        if (e->start_ns < from || e->start_ns > to)
+            continue;
+
+        size_t m = 0;
+        while (strncmp(summaries[m].method, e->method, RECORDER_METHOD_LEN) != 0)
+            m++;
+        summaries[m].totals[summaries[m].count++] = total_ns(e);
+    }
+    qsort(summaries, methods, sizeof(method_summary), compare_count);
+
+    printf("  %-20s %8s %7s %10s %10s %10s %10s %10s %10s\n", "method", "calls", "failed",
+           "p50_us", "p99_us", "max_us", "queue_us", "handler_us", "send_us");
+    for (size_t m = 0; m < methods; m++)
+    {
+        method_summary *s = &summaries[m];
+        qsort(s->totals, s->count, sizeof(uint64_t), compare_u64);
+        printf("  %-20s %8lu %7lu %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f\n", s->method,
+               s->count, s->failed, us(s->totals[(s->count - 1) / 2]),
+               us(s->totals[(s->count - 1) * 99 / 100]), us(s->totals[s->count - 1]),
+               us(s->queue_ns / s->count), us(s->handler_ns / s->count),
+               us(s->send_ns / s->count));
+    }
+    if (!methods)
+        printf("  (no requests)\n");
+
+    free(summaries);
+    free(totals);
+    return 0;
+}
+
+/**
+ * @brief Reads a dump file
+ * @param path Dump file
+ * @param header Filled with the file's header
+ * @return Entries (caller frees) or NULL on error, reported on stderr
+ */
+static recorder_entry *read_dump(const char *path, recorder_header *header)
+{
+    FILE *fp = fopen(path, "rb");
+    if (!fp)
+    {
+        perror(path);
+        return NULL;
+    }
+
+    recorder_entry *entries = NULL;
+    if (fread(header, sizeof(*header), 1, fp) != 1 ||
+        memcmp(header->magic, RECORDER_MAGIC, sizeof(RECORDER_MAGIC)) != 0)
+        fprintf(stderr, "%s: not a flight recorder dump\n", path);
+    else if (header->version != RECORDER_VERSION || header->entry_size != sizeof(recorder_entry))
+        fprintf(stderr, "%s: unsupported dump version %u\n", path, header->version);
+    else if (!(entries = malloc((header->count ? header->count : 1) * sizeof(recorder_entry))))
+        fprintf(stderr, "Out of memory\n");
+    else if (fread(entries, sizeof(recorder_entry), header->count, fp) != header->count)
+    {
+        fprintf(stderr, "%s: truncated dump\n", path);
+        free(entries);
+        entries = NULL;
+    }
+    fclose(fp);
+    return entries;
+}
+
+/**
+ * @brief Prints command line usage
+ * @param prog Program name
+ */
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [-n count] [-w ms] <dump-file>\n"
+            "\n"
+            "Prints the slowest requests of a flight recorder dump (default %d)\n"
+            "and per-method statistics. -w also breaks down the requests started\n"
+            "within ms milliseconds of the slowest one.\n",
+            prog, DEFAULT_SLOWEST);
+}
+
+int main(int argc, char **argv)
+{
+    size_t limit = DEFAULT_SLOWEST;
+    double window_ms = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:w:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n':
+            limit = (size_t)atol(optarg);
+            break;
+        case 'w':
+            window_ms = atof(optarg);
+            if (window_ms <= 0)
+            {
+                fprintf(stderr, "Window must be positive\n");
+                return 1;
+            }
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (argc - optind != 1)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    recorder_header header;
+    recorder_entry *entries = read_dump(argv[optind], &header);
+    if (!entries)
+        return 1;
+
+    recorder_entry **order = malloc((header.count ? header.count : 1) * sizeof(*order));
+    if (!order)
+    {
+        fprintf(stderr, "Out of memory\n");
+        free(entries);
+        return 1;
+    }
+    for (size_t i = 0; i < header.count; i++)
+    {
+        order[i] = &entries[i];
+    }
+    qsort(order, header.count, sizeof(*order), compare_slowest);
+
+    double span = header.count ? (header.dump_ns - entries[0].start_ns) / 1e9 : 0;
+    printf("%u requests from %u threads over the %.3fs before the dump\n\n", header.count,
+           header.threads, span);
+
+    int status = 0;
+    print_slowest(&header, order, header.count, limit);
+    printf("\nPer method:\n");
+    status |= print_methods(entries, header.count, 0, UINT64_MAX);
+
+    if (window_ms && header.count)
+    {
+        uint64_t center = order[0]->start_ns;
+        uint64_t window = (uint64_t)(window_ms * 1e6);
+        uint64_t from = center > window ? center - window : 0;
+        printf("\nPer method within %.1fms of the slowest request:\n", window_ms);
+        status |= print_methods(entries, header.count, from, center + window);
+    }
+
+    free(order);
+    free(entries);
+    if (status)
+        fprintf(stderr, "Out of memory\n");
+    return status ? 1 : 0;
+}
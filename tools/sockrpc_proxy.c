@@ -0,0 +1,1196 @@
+#define _GNU_SOURCE
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <errno.h>
+#include <math.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <cjson/cJSON.h>
+#include "../src/compress.h"
+#include "../src/frame.h"
+#include "../src/transport.h"
+
+/**
+ * @file sockrpc_proxy.c
+ * @brief Local RPC router that multiplexes clients onto backend servers
+ *
+ * Usage:
+ *   sockrpc_proxy [-c connections] [-t timeout-ms] <listen-address> <prefix>=<backend> ...
+ *
+ * Clients connect to the proxy exactly as they would to a server. Each
+ * request is routed by the longest matching method-name prefix to a
+ * backend address (an empty prefix is the default route). Calls from
+ * all clients share a small number of persistent connections per
+ * backend and are pipelined: the proxy rewrites request ids so that
+ * responses can be matched regardless of order, then restores the
+ * client's id on the way back. Calls left without a response for the
+ * timeout fail with an error, so a stuck backend cannot hold proxy ids
+ * forever.
+ *
+ * The proxy answers the "proxy.stats" method itself with per-route call
+ * counts, errors, in-flight calls and latency percentiles. It also
+ * answers compression negotiation, always with "none": backend
+ * connections are shared, so compression cannot be agreed per client.
+ *
+ * Everything runs on a single thread with one epoll loop. Output for
+ * each connection is buffered during an iteration and flushed once at
+ * its end, so a burst of pipelined calls costs one write per socket.
+ * Backend connections are opened without blocking the loop: calls
+ * routed to one still connecting wait in its output buffer.
+ *
+ * Only stream transports (Unix SOCK_STREAM and TCP) are supported.
+ */
+
+/**
+ * @brief Default number of persistent connections per backend
+ */
+#define DEFAULT_BACKEND_CONNECTIONS 2
+
+/**
+ * @brief Maximum number of backend connections per route
+ */
+#define MAX_BACKEND_CONNECTIONS 16
+
+/**
+ * @brief Maximum number of routes on the command line
+ */
+#define MAX_ROUTES 64
+
+/**
+ * @brief Maximum number of calls in flight across all backends
+ * @note Must be a power of two
+ */
+#define MAX_PENDING 65536
+
+/**
+ * @brief Default time a forwarded call may wait for its response
+ */
+#define DEFAULT_CALL_TIMEOUT_MS 30000
+
+/**
+ * @brief Maximum number of epoll events handled per iteration
+ */
+#define MAX_EVENTS 64
+
+/**
+ * @brief Bytes requested from the kernel per read
+ */
+#define READ_CHUNK 65536
+
+/**
+ * @brief Latency histogram resolution: buckets per power of two
+ */
+#define LATENCY_SUBBUCKETS 4
+
+/**
+ * @brief Number of latency buckets (1us .. ~18h)
+ */
+#define LATENCY_BUCKETS (36 * LATENCY_SUBBUCKETS)
+
+/**
+ * @brief Growable byte buffer with a consumed-prefix offset
+ */
+typedef struct
+{
+    char *data;   /**< Buffer storage */
+    size_t start; /**< Offset of the first unconsumed byte */
+    size_t len;   /**< Offset one past the last valid byte */
+    size_t cap;   /**< Allocated size */
+} byte_buffer;
+
+/**
+ * @brief Kind of a proxy connection
+ */
+typedef enum
+{
+    CONN_LISTENER, /**< Proxy listening socket */
+    CONN_CLIENT,   /**< Connection from an RPC client */
+    CONN_BACKEND   /**< Persistent connection to a backend server */
+} conn_kind;
+
+struct route;
+
+/**
+ * @brief State of one socket handled by the event loop
+ */
+typedef struct conn
+{
+    int fd;               /**< Socket file descriptor */
+    conn_kind kind;       /**< Listener, client or backend */
+    uint64_t serial;      /**< Unique id, detects reuse of fd slots */
+    byte_buffer in;       /**< Received, not yet parsed bytes */
+    byte_buffer out;      /**< Frames waiting to be written */
+    int want_write;       /**< EPOLLOUT currently requested */
+    int connecting;       /**< Backend connect not completed yet */
+    int dirty;            /**< Queued in the flush list */
+    struct route *route;  /**< Owning route (backend connections) */
+} conn;
+
+/**
+ * @brief A call forwarded to a backend and awaiting its response
+ *
+ * Calls in flight are also linked in forwarding order, which is their
+ * order of expiry since every call gets the same timeout.
+ */
+typedef struct pending_call
+{
+    uint64_t proxy_id;     /**< Id used on the backend connection, 0 if free */
+    int client_fd;         /**< Client connection the call came from */
+    uint64_t client_serial;/**< Serial of that client connection */
+    char *client_id;       /**< Client's request id as JSON text (may be NULL) */
+    conn *backend;         /**< Backend connection carrying the call */
+    struct route *route;   /**< Route used */
+    double start_us;       /**< Forward time, for latency stats and expiry */
+    struct pending_call *older; /**< Previous call in forwarding order */
+    struct pending_call *newer; /**< Next call in forwarding order */
+} pending_call;
+
+/**
+ * @brief A method-name prefix mapped to a backend address
+ */
+typedef struct route
+{
+    char *prefix;                           /**< Method name prefix */
+    size_t prefix_len;                      /**< strlen(prefix) */
+    char *address;                          /**< Backend address as given */
+    transport_address resolved;             /**< Resolved backend address */
+    conn *backends[MAX_BACKEND_CONNECTIONS];/**< Persistent connections */
+    int next_backend;                       /**< Round-robin cursor */
+    uint64_t calls;                         /**< Calls routed */
+    uint64_t errors;                        /**< Calls failed by the proxy */
+    uint64_t timeouts;                      /**< Calls failed for lack of a response */
+    uint64_t in_flight;                     /**< Calls awaiting a response */
+    uint64_t latency[LATENCY_BUCKETS];      /**< Round-trip histogram */
+} route;
+
+static route routes[MAX_ROUTES];
+static int route_count = 0;
+static int backend_connections = DEFAULT_BACKEND_CONNECTIONS;
+
+static conn **conns_by_fd = NULL;
+static int conns_capacity = 0;
+static uint64_t next_serial = 1;
+
+static pending_call pending[MAX_PENDING];
+static uint64_t next_proxy_id = 1;
+static int pending_count = 0;
+static pending_call *oldest_call = NULL;
+static pending_call *newest_call = NULL;
+static double call_timeout_us = DEFAULT_CALL_TIMEOUT_MS * 1e3;
+
+static conn **flush_list = NULL;
+static int flush_count = 0;
+static int flush_capacity = 0;
+
+static int epoll_fd = -1;
+static uint64_t unrouted_calls = 0;
+static uint64_t client_connections = 0;
+static double start_time_us = 0;
+static volatile sig_atomic_t running = 1;
+
+static double now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static void handle_signal(int sig)
+{
+    (void)sig;
+    running = 0;
+}
+
+/* Byte buffers */
+
+static int buffer_reserve(byte_buffer *buf, size_t extra)
+{
+    // Reclaim the consumed prefix before growing
+    if (buf->start > 0 && buf->start == buf->len)
+    {
+        buf->start = buf->len = 0;
+    }
+    else if (buf->start > buf->cap / 2)
+    {
+        memmove(buf->data, buf->data + buf->start, buf->len - buf->start);
+        buf->len -= buf->start;
+        buf->start = 0;
+    }
+
+    if (buf->cap - buf->len >= extra)
+        return 0;
+
+    size_t cap = buf->cap ? buf->cap : 4096;
+    while (cap - buf->len < extra)
+        cap *= 2;
+
+    char *data = realloc(buf->data, cap);
+    if (!data)
+        return -1;
+    buf->data = data;
+    buf->cap = cap;
+    return 0;
+}
+
+/**
+ * @brief A borrowed piece of a message
+ */
+typedef struct
+{
+    const char *data; /**< First byte */
+    size_t len;       /**< Number of bytes */
+} slice;
+
+/**
+ * @brief Appends one frame whose payload is the concatenation of parts
+ */
+static int buffer_append_frame(byte_buffer *buf, const slice *parts, int count)
+{
+    size_t len = 0;
+    for (int i = 0; i < count; i++)
+        len += parts[i].len;
+
+    if (buffer_reserve(buf, FRAME_HEADER_SIZE + len) == -1)
+        return -1;
+
+    frame_encode_header((unsigned char *)buf->data + buf->len, len, 0);
+    buf->len += FRAME_HEADER_SIZE;
+    for (int i = 0; i < count; i++)
+    {
+        memcpy(buf->data + buf->len, parts[i].data, parts[i].len);
+        buf->len += parts[i].len;
+    }
+    return 0;
+}
+
+/* Connections */
+
+static conn *conn_create(int fd, conn_kind kind)
+{
+    if (fd >= conns_capacity)
+    {
+        int capacity = conns_capacity ? conns_capacity : 256;
+        while (capacity <= fd)
+            capacity *= 2;
+        conn **grown = realloc(conns_by_fd, capacity * sizeof(conn *));
+        if (!grown)
+            return NULL;
+        memset(grown + conns_capacity, 0, (capacity - conns_capacity) * sizeof(conn *));
+        conns_by_fd = grown;
+        conns_capacity = capacity;
+    }
+
+    conn *c = calloc(1, sizeof(conn));
+    if (!c)
+        return NULL;
+
+    c->fd = fd;
+    c->kind = kind;
+    c->serial = next_serial++;
+
+    struct epoll_event ev = {.events = EPOLLIN, .data.fd = fd};
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1)
+    {
+        free(c);
+        return NULL;
+    }
+
+    conns_by_fd[fd] = c;
+    return c;
+}
+
+static void mark_dirty(conn *c)
+{
+    if (c->dirty)
+        return;
+
+    if (flush_count == flush_capacity)
+    {
+        int capacity = flush_capacity ? flush_capacity * 2 : 64;
+        conn **grown = realloc(flush_list, capacity * sizeof(conn *));
+        if (!grown)
+            return;
+        flush_list = grown;
+        flush_capacity = capacity;
+    }
+
+    c->dirty = 1;
+    flush_list[flush_count++] = c;
+}
+
+static void send_parts(conn *c, const slice *parts, int count)
+{
+    if (buffer_append_frame(&c->out, parts, count) == 0)
+        mark_dirty(c);
+}
+
+static void send_json(conn *c, cJSON *message)
+{
+    char *payload = cJSON_PrintUnformatted(message);
+    if (payload)
+    {
+        slice part = {payload, strlen(payload)};
+        send_parts(c, &part, 1);
+        free(payload);
+    }
+}
+
+/**
+ * @brief Sends a response to a client, restoring the client's id
+ * @param client Client connection
+ * @param id_text Client request id as JSON text (may be NULL)
+ * @param body Response members without id, e.g. "\"result\":5"
+ * @param body_len Length of body
+ */
+static void send_with_id(conn *client, const char *id_text, const char *body, size_t body_len)
+{
+    if (id_text)
+    {
+        slice parts[4] = {
+            {"{\"id\":", 6},
+            {id_text, strlen(id_text)},
+            {",", 1},
+            {body, body_len}};
+        send_parts(client, parts, 4);
+    }
+    else
+    {
+        slice parts[2] = {{"{", 1}, {body, body_len}};
+        send_parts(client, parts, 2);
+    }
+}
+
+/**
+ * @brief Sends an error response to a client
+ * @param client Client connection
+ * @param id_text Client request id as JSON text (may be NULL)
+ * @param error Error message (plain text, no characters needing escapes)
+ */
+static void send_error(conn *client, const char *id_text, const char *error)
+{
+    char body[128];
+    int len = snprintf(body, sizeof(body), "\"error\":\"%s\"}", error);
+    send_with_id(client, id_text, body, len);
+}
+
+static void conn_close(conn *c);
+
+/* Calls in flight */
+
+/**
+ * @brief Claims a free pending slot for a new call
+ * @return Slot with proxy_id set and linked as the newest call, or NULL
+ *         if every slot is taken
+ *
+ * Ids keep increasing so a late response never matches a newer call;
+ * ids whose slot is still taken by a slow call are skipped.
+ */
+static pending_call *pending_claim(void)
+{
+    if (pending_count == MAX_PENDING)
+        return NULL;
+
+    while (pending[next_proxy_id & (MAX_PENDING - 1)].proxy_id != 0)
+        next_proxy_id++;
+
+    pending_call *call = &pending[next_proxy_id & (MAX_PENDING - 1)];
+    call->proxy_id = next_proxy_id++;
+    call->older = newest_call;
+    call->newer = NULL;
+    if (newest_call)
+        newest_call->newer = call;
+    else
+        oldest_call = call;
+    newest_call = call;
+    pending_count++;
+    return call;
+}
+
+/**
+ * @brief Frees a pending slot once its call is answered or failed
+ * @param call Call in flight
+ */
+static void pending_release(pending_call *call)
+{
+    if (call->older)
+        call->older->newer = call->newer;
+    else
+        oldest_call = call->newer;
+    if (call->newer)
+        call->newer->older = call->older;
+    else
+        newest_call = call->older;
+
+    call->route->in_flight--;
+    pending_count--;
+    free(call->client_id);
+    memset(call, 0, sizeof(*call));
+}
+
+/**
+ * @brief Answers a call in flight with an error and frees its slot
+ * @param call Call in flight
+ * @param error Error message sent to the client, if it is still there
+ */
+static void pending_fail(pending_call *call, const char *error)
+{
+    conn *client = call->client_fd < conns_capacity ? conns_by_fd[call->client_fd] : NULL;
+    if (client && client->serial == call->client_serial)
+        send_error(client, call->client_id, error);
+
+    call->route->errors++;
+    pending_release(call);
+}
+
+/**
+ * @brief Fails every call in flight on a backend connection
+ * @param backend Backend connection that went away
+ */
+static void fail_pending(conn *backend)
+{
+    pending_call *call = oldest_call;
+    while (call)
+    {
+        pending_call *newer = call->newer;
+        if (call->backend == backend)
+            pending_fail(call, "Backend unavailable");
+        call = newer;
+    }
+}
+
+/**
+ * @brief Fails the calls that waited longer than the timeout
+ * @param now Current time in microseconds
+ * @return Milliseconds until the next call expires, -1 if none will
+ *
+ * A response arriving after its call expired no longer matches a slot
+ * and is dropped.
+ */
+static int expire_pending(double now)
+{
+    if (call_timeout_us <= 0)
+        return -1;
+
+    while (oldest_call && now - oldest_call->start_us >= call_timeout_us)
+    {
+        oldest_call->route->timeouts++;
+        pending_fail(oldest_call, "Backend timeout");
+    }
+
+    if (!oldest_call)
+        return -1;
+    return (int)((oldest_call->start_us + call_timeout_us - now) / 1e3) + 1;
+}
+
+static void conn_close(conn *c)
+{
+    if (c->kind == CONN_BACKEND)
+    {
+        for (int i = 0; i < backend_connections; i++)
+        {
+            if (c->route->backends[i] == c)
+                c->route->backends[i] = NULL;
+        }
+        fail_pending(c);
+    }
+    else if (c->kind == CONN_CLIENT)
+    {
+        client_connections--;
+    }
+
+    // Drop it from the flush list, the slot is reused by later conns
+    for (int i = 0; i < flush_count; i++)
+    {
+        if (flush_list[i] == c)
+            flush_list[i] = NULL;
+    }
+
+    conns_by_fd[c->fd] = NULL;
+    close(c->fd);
+    free(c->in.data);
+    free(c->out.data);
+    free(c);
+}
+
+/**
+ * @brief Writes as much buffered output as the socket accepts
+ * @param c Connection
+ * @return 0 if the connection is still usable, -1 if it was closed
+ */
+static int conn_flush(conn *c)
+{
+    // Queued frames go out once the connect completes
+    if (c->connecting)
+        return 0;
+
+    while (c->out.start < c->out.len)
+    {
+        ssize_t n = send(c->fd, c->out.data + c->out.start, c->out.len - c->out.start,
+                         MSG_NOSIGNAL);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            conn_close(c);
+            return -1;
+        }
+        c->out.start += n;
+    }
+
+    int want_write = c->out.start < c->out.len;
+    if (!want_write)
+        c->out.start = c->out.len = 0;
+
+    if (want_write != c->want_write)
+    {
+        struct epoll_event ev = {
+            .events = EPOLLIN | (want_write ? EPOLLOUT : 0),
+            .data.fd = c->fd};
+        epoll_ctl(epoll_fd, EPOLL_CTL_MOD, c->fd, &ev);
+        c->want_write = want_write;
+    }
+    return 0;
+}
+
+/* Routing */
+
+static route *find_route(const char *method, size_t method_len)
+{
+    route *best = NULL;
+    for (int i = 0; i < route_count; i++)
+    {
+        if (routes[i].prefix_len <= method_len &&
+            memcmp(method, routes[i].prefix, routes[i].prefix_len) == 0 &&
+            (!best || routes[i].prefix_len > best->prefix_len))
+        {
+            best = &routes[i];
+        }
+    }
+    return best;
+}
+
+/**
+ * @brief Completes a backend connect once its socket reports progress
+ * @param c Backend connection
+ * @return 0 if connected, -1 if the connect failed and c was closed
+ */
+static int conn_finish_connect(conn *c)
+{
+    int error = 0;
+    socklen_t len = sizeof(error);
+    if (getsockopt(c->fd, SOL_SOCKET, SO_ERROR, &error, &len) == -1 || error)
+    {
+        conn_close(c);
+        return -1;
+    }
+
+    c->connecting = 0;
+    return 0;
+}
+
+/**
+ * @brief Picks a backend connection for a route, connecting if needed
+ * @param r Route
+ * @return Backend, possibly still connecting, or NULL if the backend
+ *         is unreachable
+ *
+ * Connects never block: a TCP connect in progress completes when its
+ * socket turns writable, and calls routed to it meanwhile are queued.
+ */
+static conn *select_backend(route *r)
+{
+    for (int attempt = 0; attempt < backend_connections; attempt++)
+    {
+        int slot = r->next_backend;
+        r->next_backend = (r->next_backend + 1) % backend_connections;
+
+        if (r->backends[slot])
+            return r->backends[slot];
+
+        int in_progress;
+        int fd = transport_connect_nonblocking(&r->resolved, &in_progress);
+        if (fd == -1)
+            continue;
+
+        conn *c = conn_create(fd, CONN_BACKEND);
+        if (!c)
+        {
+            close(fd);
+            continue;
+        }
+        c->route = r;
+        if (in_progress)
+        {
+            struct epoll_event ev = {.events = EPOLLIN | EPOLLOUT, .data.fd = fd};
+            epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &ev);
+            c->connecting = 1;
+            c->want_write = 1;
+        }
+        r->backends[slot] = c;
+        return c;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Upper bound of a latency bucket in microseconds
+ */
+static double bucket_limit(int bucket)
+{
+    return exp2((double)(bucket + 1) / LATENCY_SUBBUCKETS);
+}
+
+static void add_latency(route *r, double us)
+{
+    int bucket = us <= 1 ? 0 : (int)(log2(us) * LATENCY_SUBBUCKETS);
+    if (bucket >= LATENCY_BUCKETS)
+        bucket = LATENCY_BUCKETS - 1;
+    r->latency[bucket]++;
+}
+
+/**
+ * @brief Approximate latency percentile from the histogram
+ * @return Upper bound of the bucket holding the percentile, in us
+ *         (within 19% of the true value)
+ */
+static double latency_percentile(const route *r, double fraction)
+{
+    uint64_t total = 0;
+    for (int i = 0; i < LATENCY_BUCKETS; i++)
+        total += r->latency[i];
+    if (total == 0)
+        return 0;
+
+    uint64_t target = (uint64_t)(total * fraction);
+    uint64_t seen = 0;
+    for (int i = 0; i < LATENCY_BUCKETS; i++)
+    {
+        seen += r->latency[i];
+        if (seen > target)
+            return bucket_limit(i);
+    }
+    return bucket_limit(LATENCY_BUCKETS - 1);
+}
+
+static cJSON *build_stats(void)
+{
+    cJSON *stats = cJSON_CreateObject();
+    cJSON_AddNumberToObject(stats, "uptime_s", (now_us() - start_time_us) / 1e6);
+    cJSON_AddNumberToObject(stats, "clients", client_connections);
+    cJSON_AddNumberToObject(stats, "unrouted", unrouted_calls);
+
+    cJSON *list = cJSON_AddArrayToObject(stats, "routes");
+    for (int i = 0; i < route_count; i++)
+    {
+        route *r = &routes[i];
+        int connected = 0;
+        for (int j = 0; j < backend_connections; j++)
+            connected += r->backends[j] != NULL;
+
+        cJSON *item = cJSON_CreateObject();
+        cJSON_AddStringToObject(item, "prefix", r->prefix);
+        cJSON_AddStringToObject(item, "backend", r->address);
+        cJSON_AddNumberToObject(item, "connections", connected);
+        cJSON_AddNumberToObject(item, "calls", r->calls);
+        cJSON_AddNumberToObject(item, "errors", r->errors);
+        cJSON_AddNumberToObject(item, "timeouts", r->timeouts);
+        cJSON_AddNumberToObject(item, "in_flight", r->in_flight);
+        cJSON_AddNumberToObject(item, "p50_us", latency_percentile(r, 0.50));
+        cJSON_AddNumberToObject(item, "p99_us", latency_percentile(r, 0.99));
+        cJSON_AddItemToArray(list, item);
+    }
+    return stats;
+}
+
+/**
+ * @brief Finds a leading numeric id in a message
+ * @param payload Message text
+ * @param len Message length
+ * @param id_len Set to the length of the number token
+ * @return Non-zero if payload starts with {"id":<number>,
+ *
+ * The number token starts at offset 6 and the remaining members start
+ * after the comma at offset 6 + id_len.
+ */
+static int scan_leading_id(const char *payload, size_t len, size_t *id_len)
+{
+    if (len < 8 || memcmp(payload, "{\"id\":", 6) != 0)
+        return 0;
+
+    size_t i = 6;
+    while (i < len && strchr("-+.0123456789eE", payload[i]) && payload[i] != '\0')
+        i++;
+
+    *id_len = i - 6;
+    return *id_len > 0 && i < len && payload[i] == ',';
+}
+
+/**
+ * @brief Extracts id text and method name from a request
+ * @param payload Request text
+ * @param len Request length
+ * @param id_text Set to the id as JSON text (caller frees, may be NULL)
+ * @param method Set to the method name (points into payload or into
+ *        *parsed)
+ * @param method_len Set to the method name length
+ * @param parsed Set to the parsed request when the slow path was used
+ * @param body Set to the members after the id (fast path only)
+ * @return 0 on success, -1 if the request is malformed
+ */
+static int parse_request(const char *payload, size_t len, char **id_text, const char **method,
+                         size_t *method_len, cJSON **parsed, const char **body)
+{
+    size_t id_len;
+    *id_text = NULL;
+    *parsed = NULL;
+    *body = NULL;
+
+    // Fast path: {"id":N,"method":"name",... with no escapes in name
+    if (scan_leading_id(payload, len, &id_len))
+    {
+        const char *rest = payload + 6 + id_len + 1;
+        size_t rest_len = len - (6 + id_len + 1);
+        if (rest_len > 10 && memcmp(rest, "\"method\":\"", 10) == 0)
+        {
+            const char *name = rest + 10;
+            const char *end = memchr(name, '"', rest_len - 10);
+            if (end && !memchr(name, '\\', end - name))
+            {
+                *id_text = strndup(payload + 6, id_len);
+                *method = name;
+                *method_len = end - name;
+                *body = rest;
+                return 0;
+            }
+        }
+    }
+
+    cJSON *request = cJSON_ParseWithLength(payload, len);
+    if (!request)
+        return -1;
+
+    cJSON *id = cJSON_DetachItemFromObject(request, "id");
+    if (id)
+    {
+        *id_text = cJSON_PrintUnformatted(id);
+        cJSON_Delete(id);
+    }
+
+    cJSON *method_item = cJSON_GetObjectItem(request, "method");
+    if (!cJSON_IsString(method_item))
+    {
+        cJSON_Delete(request);
+        return -1;
+    }
+
+    *method = method_item->valuestring;
+    *method_len = strlen(method_item->valuestring);
+    *parsed = request;
+    return 0;
+}
+
+/**
+ * @brief Routes one request from a client
+ * @param client Client connection
+ * @param payload Request payload
+ * @param len Payload length
+ */
+static void handle_client_frame(conn *client, const char *payload, size_t len)
+{
+    char *id_text;
+    const char *method;
+    size_t method_len;
+    cJSON *parsed;
+    const char *body;
+
+    if (parse_request(payload, len, &id_text, &method, &method_len, &parsed, &body) == -1)
+    {
+        send_error(client, NULL, "Invalid request");
+        return;
+    }
+
+    if (method_len == 11 && memcmp(method, "proxy.stats", 11) == 0)
+    {
+        cJSON *response = cJSON_CreateObject();
+        cJSON_AddItemToObject(response, "result", build_stats());
+        char *text = cJSON_PrintUnformatted(response);
+        send_with_id(client, id_text, text + 1, strlen(text + 1));
+        free(text);
+        cJSON_Delete(response);
+        goto done;
+    }
+
+    if (method_len == strlen(COMPRESS_NEGOTIATE_METHOD) &&
+        memcmp(method, COMPRESS_NEGOTIATE_METHOD, method_len) == 0)
+    {
+        static const char declined[] = "\"result\":{\"compression\":\"none\",\"dictionary\":0}}";
+        send_with_id(client, id_text, declined, sizeof(declined) - 1);
+        goto done;
+    }
+
+    route *r = find_route(method, method_len);
+    if (!r)
+    {
+        unrouted_calls++;
+        send_error(client, id_text, "Method not found");
+        goto done;
+    }
+
+    r->calls++;
+    conn *backend = select_backend(r);
+    pending_call *call = backend ? pending_claim() : NULL;
+    if (!call)
+    {
+        r->errors++;
+        send_error(client, id_text, backend ? "Proxy overloaded" : "Backend unavailable");
+        goto done;
+    }
+
+    call->client_fd = client->fd;
+    call->client_serial = client->serial;
+    call->client_id = id_text;
+    call->backend = backend;
+    call->route = r;
+    call->start_us = now_us();
+    r->in_flight++;
+    id_text = NULL;
+
+    char proxy_id[24];
+    int proxy_id_len = snprintf(proxy_id, sizeof(proxy_id), "%llu",
+                                (unsigned long long)call->proxy_id);
+
+    if (parsed)
+    {
+        cJSON_AddNumberToObject(parsed, "id", (double)call->proxy_id);
+        send_json(backend, parsed);
+    }
+    else
+    {
+        slice parts[4] = {
+            {"{\"id\":", 6},
+            {proxy_id, proxy_id_len},
+            {",", 1},
+            {body, len - (body - payload)}};
+        send_parts(backend, parts, 4);
+    }
+
+done:
+    free(id_text);
+    cJSON_Delete(parsed);
+}
+
+/**
+ * @brief Returns one backend response to the client that asked for it
+ * @param backend Backend connection
+ * @param payload Response payload
+ * @param len Payload length
+ */
+static void handle_backend_frame(conn *backend, const char *payload, size_t len)
+{
+    uint64_t proxy_id;
+    const char *body;
+    size_t body_len;
+    char *printed = NULL;
+    size_t id_len;
+
+    if (scan_leading_id(payload, len, &id_len))
+    {
+        proxy_id = strtoull(payload + 6, NULL, 10);
+        body = payload + 6 + id_len + 1;
+        body_len = len - (6 + id_len + 1);
+    }
+    else
+    {
+        // Slow path: id elsewhere in the object
+        cJSON *response = cJSON_ParseWithLength(payload, len);
+        cJSON *id = cJSON_GetObjectItem(response, "id");
+        if (!cJSON_IsNumber(id))
+        {
+            cJSON_Delete(response);
+            return;
+        }
+        proxy_id = (uint64_t)id->valuedouble;
+        cJSON_DeleteItemFromObject(response, "id");
+        printed = cJSON_PrintUnformatted(response);
+        cJSON_Delete(response);
+        if (!printed)
+            return;
+        body = printed + 1;
+        body_len = strlen(body);
+    }
+
+    pending_call *call = &pending[proxy_id & (MAX_PENDING - 1)];
+    if (call->proxy_id != proxy_id || call->backend != backend)
+    {
+        free(printed);
+        return;
+    }
+
+    add_latency(call->route, now_us() - call->start_us);
+
+    // The client may have left while its call was in flight
+    conn *client = call->client_fd < conns_capacity ? conns_by_fd[call->client_fd] : NULL;
+    if (client && client->serial == call->client_serial)
+        send_with_id(client, call->client_id, body, body_len);
+
+    free(printed);
+    pending_release(call);
+}
+
+/**
+ * @brief Reads from a client or backend and handles complete frames
+ * @param c Connection
+ */
+static void conn_read(conn *c)
+{
+    while (1)
+    {
+        if (buffer_reserve(&c->in, READ_CHUNK) == -1)
+        {
+            conn_close(c);
+            return;
+        }
+
+        ssize_t n = read(c->fd, c->in.data + c->in.len, c->in.cap - c->in.len);
+        if (n == 0)
+        {
+            conn_close(c);
+            return;
+        }
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            conn_close(c);
+            return;
+        }
+        c->in.len += n;
+
+        if ((size_t)n < READ_CHUNK)
+            break;
+    }
+
+    while (c->in.len - c->in.start >= FRAME_HEADER_SIZE)
+    {
+        size_t len;
+        uint32_t flags;
+        if (frame_decode_header((unsigned char *)c->in.data + c->in.start, &len, &flags) == -1 ||
+            flags != 0)
+        {
+            conn_close(c);
+            return;
+        }
+        if (c->in.len - c->in.start < FRAME_HEADER_SIZE + len)
+            break;
+
+        const char *payload = c->in.data + c->in.start + FRAME_HEADER_SIZE;
+        c->in.start += FRAME_HEADER_SIZE + len;
+
+        if (c->kind == CONN_CLIENT)
+            handle_client_frame(c, payload, len);
+        else
+            handle_backend_frame(c, payload, len);
+    }
+}
+
+static void accept_clients(conn *listener)
+{
+    while (1)
+    {
+        int fd = accept4(listener->fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+        {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            return;
+        }
+
+        transport_tune(fd);
+        if (!conn_create(fd, CONN_CLIENT))
+        {
+            close(fd);
+            continue;
+        }
+        client_connections++;
+    }
+}
+
+static int parse_route(const char *spec)
+{
+    const char *eq = strchr(spec, '=');
+    if (!eq || route_count == MAX_ROUTES)
+        return -1;
+
+    route *r = &routes[route_count];
+    r->prefix = strndup(spec, eq - spec);
+    r->prefix_len = eq - spec;
+    r->address = strdup(eq + 1);
+
+    if (transport_resolve(r->address, SOCK_STREAM, &r->resolved) == -1 ||
+        r->resolved.socktype != SOCK_STREAM)
+    {
+        fprintf(stderr, "Invalid backend address: %s\n", r->address);
+        return -1;
+    }
+
+    route_count++;
+    return 0;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [-c connections] [-t timeout-ms] <listen-address> <prefix>=<backend> ...\n"
+            "\n"
+            "Routes each call by the longest matching method-name prefix.\n"
+            "An empty prefix (\"=/tmp/default.sock\") is the default route.\n"
+            "Calls without a response after timeout-ms (default %d, 0 for\n"
+            "none) fail with \"Backend timeout\".\n"
+            "Call \"proxy.stats\" on the proxy for routing and latency stats.\n",
+            prog, DEFAULT_CALL_TIMEOUT_MS);
+}
+
+int main(int argc, char **argv)
+{
+    int opt;
+    while ((opt = getopt(argc, argv, "c:t:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'c':
+            backend_connections = atoi(optarg);
+            if (backend_connections < 1 || backend_connections > MAX_BACKEND_CONNECTIONS)
+            {
+                fprintf(stderr, "Connections must be between 1 and %d\n", MAX_BACKEND_CONNECTIONS);
+                return 1;
+            }
+            break;
+        case 't':
+            if (atoi(optarg) < 0)
+            {
+                fprintf(stderr, "Timeout must not be negative\n");
+                return 1;
+            }
+            call_timeout_us = atoi(optarg) * 1e3;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (argc - optind < 2)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    for (int i = optind + 1; i < argc; i++)
+    {
+        if (parse_route(argv[i]) == -1)
+        {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    transport_address listen_address;
+    if (transport_resolve(argv[optind], SOCK_STREAM, &listen_address) == -1 ||
+        listen_address.socktype != SOCK_STREAM)
+    {
+        fprintf(stderr, "Invalid listen address: %s\n", argv[optind]);
+        return 1;
+    }
+
+    signal(SIGINT, handle_signal);
+    signal(SIGTERM, handle_signal);
+    signal(SIGPIPE, SIG_IGN);
+
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    int listen_fd = transport_listen(&listen_address, 0);
+    if (epoll_fd == -1 || listen_fd == -1 || !conn_create(listen_fd, CONN_LISTENER))
+    {
+        fprintf(stderr, "Cannot listen on %s: %s\n", argv[optind], strerror(errno));
+        return 1;
+    }
+
+    start_time_us = now_us();
+    printf("Proxy listening on %s with %d route(s)\n", argv[optind], route_count);
+    fflush(stdout);
+
+    struct epoll_event events[MAX_EVENTS];
+    int wait_ms = -1;
+    while (running)
+    {
+        int nfds = epoll_wait(epoll_fd, events, MAX_EVENTS, wait_ms);
+        if (nfds == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+
+        for (int i = 0; i < nfds; i++)
+        {
+            conn *c = conns_by_fd[events[i].data.fd];
+            if (!c)
+                continue;
+
+            if (c->kind == CONN_LISTENER)
+            {
+                accept_clients(c);
+                continue;
+            }
+
+            if (c->connecting && conn_finish_connect(c) == -1)
+                continue;
+
+            if ((events[i].events & EPOLLOUT) && conn_flush(c) == -1)
+                continue;
+
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+                conn_read(c);
+        }
+
+        wait_ms = expire_pending(now_us());
+
+        // One write per connection per iteration
+        for (int i = 0; i < flush_count; i++)
+        {
+            conn *c = flush_list[i];
+            if (!c)
+                continue;
+            c->dirty = 0;
+            conn_flush(c);
+        }
+        flush_count = 0;
+    }
+
+    printf("Proxy shutting down\n");
+    for (int fd = 0; fd < conns_capacity; fd++)
+    {
+        if (conns_by_fd[fd])
+            conn_close(conns_by_fd[fd]);
+    }
+    if (!listen_address.abstract && listen_address.kind == TRANSPORT_UNIX)
+        unlink(listen_address.path);
+
+    free(conns_by_fd);
+    free(flush_list);
+    for (int i = 0; i < route_count; i++)
+    {
+        free(routes[i].prefix);
+        free(routes[i].address);
+    }
+    close(epoll_fd);
+    return 0;
+}
@@ -0,0 +1,728 @@
+#define _GNU_SOURCE
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <cjson/cJSON.h>
+#include "../src/capture.h"
+#include "../src/compress.h"
+#include "../src/frame.h"
+#include "../src/stream.h"
+#include "../src/transport.h"
+
+/**
+ * @file sockrpc_replay.c
+ * @brief Drives a server with traffic captured by sockrpc_server_set_capture
+ *
+ * Usage:
+ *   sockrpc_replay [-s speed | -x] [-c connections] [-n requests] <capture> <address>
+ *
+ * Each captured client connection is replayed on a connection of its
+ * own (at most -c, captured connections are folded onto them beyond
+ * that), keeping the order of its requests. Pacing:
+ * - default: every request is sent at its captured arrival time
+ * - -s speed: captured times are divided by speed (2 replays twice as
+ *   fast), an open-loop load like the original one
+ * - -x: as fast as possible, closed loop: each connection waits for a
+ *   response before sending its next call
+ *
+ * Request ids are rewritten so responses can be matched to requests;
+ * upload chunks follow the id of their upload and, in any pacing, wait
+ * for the server's acknowledgements like a client would. Compression
+ * negotiation is not replayed, the connections stay uncompressed.
+ *
+ * Reports the achieved rate, response latency percentiles overall and
+ * per method and, for paced replays, how late requests were sent
+ * compared to the schedule, which shows whether the tool kept up.
+ */
+
+/**
+ * @brief Default maximum number of replay connections
+ */
+#define DEFAULT_CONNECTIONS 256
+
+/**
+ * @brief Longest wait for a response before a connection gives up, in seconds
+ */
+#define RESPONSE_TIMEOUT_S 10
+
+/**
+ * @brief One request of the capture
+ */
+typedef struct
+{
+    uint64_t offset_ns;   /**< Captured arrival, relative to the first request */
+    char *payload;        /**< Request with its id rewritten */
+    size_t len;           /**< Payload length */
+    char *method;         /**< Method name, NULL for upload chunks */
+    int conn;             /**< Replay connection */
+    int expect;           /**< A response answers this request */
+    uint64_t sent_ns;     /**< Monotonic send time, 0 if not sent (atomic) */
+    uint64_t late_ns;     /**< Send time after the scheduled time */
+    uint64_t latency_ns;  /**< Send to response, 0 if unanswered */
+    int error;            /**< Answered with an error */
+    long upload;          /**< Upload a chunk belongs to, -1 if not a chunk */
+    unsigned long chunks; /**< Chunks sent, for an upload (sender only) */
+    unsigned long acked;  /**< Chunks acknowledged, for an upload (under mutex) */
+} replay_request;
+
+/**
+ * @brief Connection of the capture, mapped to a replay connection
+ */
+typedef struct
+{
+    uint16_t worker; /**< Captured worker */
+    uint64_t handle; /**< Captured connection handle */
+    int conn;        /**< Replay connection */
+    cJSON *uploads;  /**< Open uploads: captured id text -> request index */
+} captured_connection;
+
+/**
+ * @brief Replay connection with its sender and receiver threads
+ */
+typedef struct
+{
+    int fd;                /**< Connected socket */
+    size_t *requests;      /**< Request indices in sending order */
+    size_t count;          /**< Number of requests */
+    size_t capacity;       /**< Allocated indices */
+    size_t expected;       /**< Requests answered by a response */
+    size_t answered;       /**< Responses received (under mutex) */
+    size_t waited;         /**< Responses the sender has waited for */
+    int receiving;         /**< Receiver still running (under mutex) */
+    pthread_mutex_t mutex; /**< Protects answered, receiving and upload acks */
+    pthread_cond_t cond;   /**< Signals responses and acknowledgements */
+    pthread_t sender;      /**< Sender thread */
+    pthread_t receiver;    /**< Receiver thread */
+} replay_connection;
+
+/**
+ * @brief Per-method latency summary
+ */
+typedef struct
+{
+    const char *method;  /**< Method name */
+    size_t count;        /**< Answered requests */
+    size_t errors;       /**< Error responses */
+    uint64_t *latencies; /**< Latencies of the answered requests */
+} method_summary;
+
+static replay_request *requests;       /**< Requests of the capture */
+static size_t request_count;           /**< Number of requests */
+static replay_connection *connections; /**< Replay connections */
+static int connection_count;           /**< Number of replay connections */
+static transport_address target;       /**< Server to replay against */
+static double speed = 1.0;             /**< Pacing divisor, 0 for closed loop */
+static uint64_t start_ns;              /**< Monotonic start of the replay */
+
+/**
+ * @brief Returns the monotonic clock in nanoseconds
+ * @return Nanoseconds
+ */
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief Sleeps until a monotonic time
+ * @param when Nanoseconds
+ */
+static void sleep_until(uint64_t when)
+{
+    struct timespec ts = {.tv_sec = (time_t)(when / 1000000000ull),
+                          .tv_nsec = (long)(when % 1000000000ull)};
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+        ;
+}
+
+/**
+ * @brief Finds or adds the connection a captured record came from
+ * @param captured Captured connections (grown as needed)
+ * @param count Number of captured connections
+ * @param record Record
+ * @param limit Maximum number of replay connections
+ * @return Index in captured, or -1 on allocation failure
+ */
+static int find_captured(captured_connection **captured, size_t *count,
+                         const capture_record *record, int limit)
+{
+    for (size_t i = 0; i < *count; i++)
+    {
+        if ((*captured)[i].worker == record->worker && (*captured)[i].handle == record->connection)
+            return (int)i;
+    }
+
+    captured_connection *grown = realloc(*captured, (*count + 1) * sizeof(captured_connection));
+    if (!grown)
+        return -1;
+    *captured = grown;
+    grown[*count] = (captured_connection){.worker = record->worker,
+                                          .handle = record->connection,
+                                          .conn = (int)(*count % (size_t)limit),
+                                          .uploads = cJSON_CreateObject()};
+    return (int)(*count)++;
+}
+
+/**
+ * @brief Converts a captured request for replay
+ * @param request Request to fill in (index request_count)
+ * @param from Connection the request was captured on
+ * @param payload Captured JSON
+ * @return 1 if the request is replayed, 0 if it is skipped
+ */
+static int prepare_request(replay_request *request, captured_connection *from, const char *payload)
+{
+    cJSON *json = cJSON_Parse(payload);
+    if (!json)
+        return 0;
+
+    const cJSON *method = cJSON_GetObjectItem(json, "method");
+    cJSON *id = cJSON_GetObjectItem(json, "id");
+    char *id_text = id ? cJSON_PrintUnformatted(id) : NULL;
+    int keep = 1;
+    request->upload = -1;
+
+    if (cJSON_IsString(method))
+    {
+        // Responses are read uncompressed, so the connection must stay so
+        keep = strcmp(method->valuestring, COMPRESS_NEGOTIATE_METHOD) != 0;
+        request->method = keep ? strdup(method->valuestring) : NULL;
+        request->expect = id != NULL;
+        if (keep && id_text && cJSON_IsTrue(cJSON_GetObjectItem(json, "stream")))
+        {
+            cJSON_DeleteItemFromObject(from->uploads, id_text);
+            cJSON_AddNumberToObject(from->uploads, id_text, (double)request_count);
+        }
+        if (id)
+            cJSON_ReplaceItemInObject(json, "id", cJSON_CreateNumber((double)request_count));
+    }
+    else
+    {
+        // Upload chunks and ends carry the id of their upload
+        const cJSON *upload = id_text ? cJSON_GetObjectItem(from->uploads, id_text) : NULL;
+        keep = upload != NULL;
+        if (keep)
+            cJSON_ReplaceItemInObject(json, "id", cJSON_CreateNumber(upload->valuedouble));
+        if (keep && cJSON_HasObjectItem(json, "chunk"))
+            request->upload = (long)upload->valuedouble;
+        if (keep && cJSON_HasObjectItem(json, "end"))
+            cJSON_DeleteItemFromObject(from->uploads, id_text);
+    }
+
+    request->payload = keep ? cJSON_PrintUnformatted(json) : NULL;
+    request->len = request->payload ? strlen(request->payload) : 0;
+    request->conn = from->conn;
+    free(id_text);
+    cJSON_Delete(json);
+    if (keep && !request->payload)
+        keep = 0;
+    if (!keep)
+        free(request->method);
+    return keep;
+}
+
+/**
+ * @brief Reads a capture file into requests and connections
+ * @param path Capture file
+ * @param limit Maximum number of replay connections
+ * @param max_requests Requests to read, 0 for all
+ * @return 0 on success, -1 on error (reported on stderr)
+ */
+static int load_capture(const char *path, int limit, size_t max_requests)
+{
+    FILE *fp = fopen(path, "rb");
+    if (!fp)
+    {
+        perror(path);
+        return -1;
+    }
+
+    capture_header header;
+    if (fread(&header, sizeof(header), 1, fp) != 1 ||
+        memcmp(header.magic, CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC)) != 0 ||
+        header.version != CAPTURE_VERSION || header.record_size != sizeof(capture_record))
+    {
+        fprintf(stderr, "%s: not a supported capture file\n", path);
+        fclose(fp);
+        return -1;
+    }
+
+    captured_connection *captured = NULL;
+    size_t captured_count = 0, capacity = 0;
+    uint64_t first = 0;
+    capture_record record;
+    int status = 0;
+    while ((!max_requests || request_count < max_requests) &&
+           fread(&record, sizeof(record), 1, fp) == 1)
+    {
+        char *payload = malloc((size_t)record.length + 1);
+        if (!payload || fread(payload, 1, record.length, fp) != record.length)
+        {
+            fprintf(stderr, "%s: truncated capture\n", path);
+            free(payload);
+            status = -1;
+            break;
+        }
+        payload[record.length] = '\0';
+
+        int from = find_captured(&captured, &captured_count, &record, limit);
+        if (request_count == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 1024;
+            replay_request *grown = realloc(requests, capacity * sizeof(replay_request));
+            if (grown)
+                requests = grown;
+            else
+                from = -1;
+        }
+        if (from == -1)
+        {
+            fprintf(stderr, "Out of memory\n");
+            free(payload);
+            status = -1;
+            break;
+        }
+
+        replay_request *request = &requests[request_count];
+        memset(request, 0, sizeof(*request));
+        if (!request_count)
+            first = record.offset_ns;
+        request->offset_ns = record.offset_ns - first;
+        if (prepare_request(request, &captured[from], payload))
+            request_count++;
+        free(payload);
+    }
+    fclose(fp);
+
+    for (size_t i = 0; i < captured_count; i++)
+    {
+        cJSON_Delete(captured[i].uploads);
+    }
+    connection_count = captured_count < (size_t)limit ? (int)captured_count : limit;
+    free(captured);
+    return status;
+}
+
+/**
+ * @brief Sender thread: sends a connection's requests on schedule
+ * @param arg Replay connection
+ * @return NULL
+ */
+static void *sender_routine(void *arg)
+{
+    replay_connection *conn = arg;
+
+    for (size_t i = 0; i < conn->count; i++)
+    {
+        replay_request *request = &requests[conn->requests[i]];
+        if (speed > 0)
+        {
+            uint64_t scheduled = start_ns + (uint64_t)(request->offset_ns / speed);
+            sleep_until(scheduled);
+            request->late_ns = now_ns() - scheduled;
+        }
+
+        // Closed loop: the previous call must be answered first. Upload
+        // chunks wait for acknowledgements in any pacing.
+        int closed_loop = speed == 0 && request->method;
+        replay_request *upload = request->upload == -1 ? NULL : &requests[request->upload];
+        if (closed_loop || upload)
+        {
+            int blocked;
+            pthread_mutex_lock(&conn->mutex);
+            while ((blocked = (closed_loop && conn->answered < conn->waited) ||
+                              (upload && upload->chunks - upload->acked >= STREAM_WINDOW)) &&
+                   conn->receiving)
+                pthread_cond_wait(&conn->cond, &conn->mutex);
+            pthread_mutex_unlock(&conn->mutex);
+            if (blocked)
+                break;
+        }
+
+        __atomic_store_n(&request->sent_ns, now_ns(), __ATOMIC_RELEASE);
+        if (frame_send(conn->fd, target.socktype, request->payload, request->len, 0) == -1)
+            break;
+        conn->waited += request->expect;
+        if (upload)
+            upload->chunks++;
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Receiver thread: matches responses to requests
+ * @param arg Replay connection
+ * @return NULL
+ *
+ * Upload acknowledgements release the sender; frames without a known
+ * id (events) are skipped. Stops once every expected response arrived,
+ * or on timeout or disconnect.
+ */
+static void *receiver_routine(void *arg)
+{
+    replay_connection *conn = arg;
+    size_t answered = 0;
+
+    while (answered < conn->expected)
+    {
+        size_t len;
+        uint32_t flags;
+        frame_status status;
+        char *payload = frame_recv(conn->fd, target.socktype, &len, &flags, &status);
+        if (status != FRAME_OK)
+            break;
+
+        cJSON *response = flags == 0 ? cJSON_Parse(payload) : NULL;
+        uint64_t received = now_ns();
+        free(payload);
+        const cJSON *id = cJSON_GetObjectItem(response, "id");
+        const cJSON *ack = cJSON_GetObjectItem(response, "ack");
+        int answer = cJSON_HasObjectItem(response, "result") ||
+                     cJSON_HasObjectItem(response, "error");
+        int known = cJSON_IsNumber(id) && id->valuedouble >= 0 &&
+                    id->valuedouble < (double)request_count;
+        if (known && cJSON_IsNumber(ack))
+        {
+            pthread_mutex_lock(&conn->mutex);
+            requests[(size_t)id->valuedouble].acked = (unsigned long)ack->valuedouble;
+            pthread_cond_signal(&conn->cond);
+            pthread_mutex_unlock(&conn->mutex);
+        }
+        else if (known && answer)
+        {
+            replay_request *request = &requests[(size_t)id->valuedouble];
+            uint64_t sent = __atomic_load_n(&request->sent_ns, __ATOMIC_ACQUIRE);
+            if (request->expect && !request->latency_ns && sent)
+            {
+                request->latency_ns = received > sent ? received - sent : 1;
+                request->error = cJSON_HasObjectItem(response, "error");
+                answered++;
+                pthread_mutex_lock(&conn->mutex);
+                conn->answered = answered;
+                pthread_cond_signal(&conn->cond);
+                pthread_mutex_unlock(&conn->mutex);
+            }
+        }
+        cJSON_Delete(response);
+    }
+
+    pthread_mutex_lock(&conn->mutex);
+    conn->receiving = 0;
+    pthread_cond_signal(&conn->cond);
+    pthread_mutex_unlock(&conn->mutex);
+    return NULL;
+}
+
+/**
+ * @brief Assigns requests to connections and connects them
+ * @return 0 on success, -1 on error (reported on stderr)
+ */
+static int open_connections(void)
+{
+    connections = calloc((size_t)(connection_count ? connection_count : 1),
+                         sizeof(replay_connection));
+    if (!connections)
+        return -1;
+
+    for (size_t i = 0; i < request_count; i++)
+    {
+        replay_connection *conn = &connections[requests[i].conn];
+        if (conn->count == conn->capacity)
+        {
+            conn->capacity = conn->capacity ? conn->capacity * 2 : 64;
+            size_t *grown = realloc(conn->requests, conn->capacity * sizeof(size_t));
+            if (!grown)
+                return -1;
+            conn->requests = grown;
+        }
+        conn->requests[conn->count++] = i;
+        conn->expected += requests[i].expect;
+    }
+
+    struct timeval timeout = {.tv_sec = RESPONSE_TIMEOUT_S};
+    for (int i = 0; i < connection_count; i++)
+    {
+        replay_connection *conn = &connections[i];
+        conn->fd = transport_connect(&target);
+        if (conn->fd == -1)
+        {
+            fprintf(stderr, "Cannot connect: %s\n", strerror(errno));
+            return -1;
+        }
+        transport_tune(conn->fd);
+        setsockopt(conn->fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        conn->receiving = 1;
+        pthread_mutex_init(&conn->mutex, NULL);
+        pthread_cond_init(&conn->cond, NULL);
+    }
+    return 0;
+}
+
+/**
+ * @brief Orders durations increasingly
+ * @param a First duration
+ * @param b Second duration
+ * @return Negative, zero or positive
+ */
+static int compare_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+/**
+ * @brief Orders method summaries by decreasing count
+ * @param a First summary
+ * @param b Second summary
+ * @return Negative, zero or positive
+ */
+static int compare_count(const void *a, const void *b)
+{
+    size_t x = ((const method_summary *)a)->count;
+    size_t y = ((const method_summary *)b)->count;
+    return x > y ? -1 : x < y;
+}
+
+/**
+ * @brief Returns a percentile of sorted durations in microseconds
+ * @param sorted Durations in increasing order
+ * @param count Number of durations, at least 1
+ * @param percentile Percentile between 0 and 100
+ * @return Microseconds
+ */
+static double percentile_us(const uint64_t *sorted, size_t count, double percentile)
+{
+    size_t index = (size_t)((count - 1) * percentile / 100.0);
+    return sorted[index] / 1000.0;
+}
+
+/**
+ * @brief Prints latency percentiles and per-method breakdowns
+ * @param elapsed_ns Duration of the replay
+ * @return 0 on success, -1 on allocation failure
+ */
+static int print_report(uint64_t elapsed_ns)
+{
+    uint64_t *latencies = malloc((request_count ? request_count : 1) * sizeof(uint64_t));
+    uint64_t *late = malloc((request_count ? request_count : 1) * sizeof(uint64_t));
+    method_summary *methods = calloc(request_count ? request_count : 1, sizeof(method_summary));
+    if (!latencies || !late || !methods)
+    {
+        free(latencies);
+        free(late);
+        free(methods);
+        return -1;
+    }
+
+    size_t sent = 0, expected = 0, answered = 0, errors = 0, method_count = 0;
+    uint64_t total = 0;
+    for (size_t i = 0; i < request_count; i++)
+    {
+        replay_request *request = &requests[i];
+        if (request->sent_ns)
+            late[sent++] = request->late_ns;
+        expected += request->expect;
+        if (!request->latency_ns)
+            continue;
+
+        latencies[answered++] = request->latency_ns;
+        total += request->latency_ns;
+        errors += request->error;
+
+        size_t m = 0;
+        while (m < method_count && strcmp(methods[m].method, request->method) != 0)
+            m++;
+        if (m == method_count)
+            methods[method_count++].method = request->method;
+        methods[m].count++;
+        methods[m].errors += request->error;
+    }
+
+    // Each method's latencies form a contiguous slice of one array
+    uint64_t *by_method = malloc((answered ? answered : 1) * sizeof(uint64_t));
+    if (!by_method)
+    {
+        free(latencies);
+        free(late);
+        free(methods);
+        return -1;
+    }
+    size_t offset = 0;
+    for (size_t m = 0; m < method_count; m++)
+    {
+        methods[m].latencies = by_method + offset;
+        offset += methods[m].count;
+        methods[m].count = 0;
+    }
+    for (size_t i = 0; i < request_count; i++)
+    {
+        if (!requests[i].latency_ns)
+            continue;
+        size_t m = 0;
+        while (strcmp(methods[m].method, requests[i].method) != 0)
+            m++;
+        methods[m].latencies[methods[m].count++] = requests[i].latency_ns;
+    }
+
+    double seconds = elapsed_ns / 1e9;
+    printf("Sent %zu requests on %d connections in %.3fs (%.0f req/s)\n", sent, connection_count,
+           seconds, seconds > 0 ? sent / seconds : 0);
+    printf("Responses: %zu ok, %zu errors, %zu missing\n", answered - errors, errors,
+           expected - answered);
+
+    if (answered)
+    {
+        qsort(latencies, answered, sizeof(uint64_t), compare_u64);
+        printf("Latency (us): mean %.1f  p50 %.1f  p90 %.1f  p99 %.1f  p99.9 %.1f  max %.1f\n",
+               total / 1000.0 / answered, percentile_us(latencies, answered, 50),
+               percentile_us(latencies, answered, 90), percentile_us(latencies, answered, 99),
+               percentile_us(latencies, answered, 99.9), latencies[answered - 1] / 1000.0);
+    }
+    if (speed > 0 && sent)
+    {
+        qsort(late, sent, sizeof(uint64_t), compare_u64);
+        printf("Send lag behind schedule (us): p50 %.1f  p99 %.1f  max %.1f\n",
+               percentile_us(late, sent, 50), percentile_us(late, sent, 99),
+               late[sent - 1] / 1000.0);
+    }
+
+    qsort(methods, method_count, sizeof(method_summary), compare_count);
+    printf("\n  %-24s %8s %7s %10s %10s %10s\n", "method", "calls", "errors", "p50_us", "p99_us",
+           "max_us");
+    for (size_t m = 0; m < method_count; m++)
+    {
+        method_summary *s = &methods[m];
+        qsort(s->latencies, s->count, sizeof(uint64_t), compare_u64);
+        printf("  %-24s %8zu %7zu %10.1f %10.1f %10.1f\n", s->method, s->count, s->errors,
+               percentile_us(s->latencies, s->count, 50), percentile_us(s->latencies, s->count, 99),
+               s->latencies[s->count - 1] / 1000.0);
+    }
+
+    free(by_method);
+    free(latencies);
+    free(late);
+    free(methods);
+    return 0;
+}
+
+/**
+ * @brief Prints command line usage
+ * @param prog Program name
+ */
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [-s speed | -x] [-c connections] [-n requests] <capture> <address>\n"
+            "\n"
+            "Replays a capture written by sockrpc_server_set_capture against a server.\n"
+            "  -s speed        scale the captured pacing (2 = twice as fast, default 1)\n"
+            "  -x              send as fast as possible, one call in flight per connection\n"
+            "  -c connections  fold captured connections onto at most this many (default %d)\n"
+            "  -n requests     replay only the first requests of the capture\n",
+            prog, DEFAULT_CONNECTIONS);
+}
+
+int main(int argc, char **argv)
+{
+    int limit = DEFAULT_CONNECTIONS;
+    size_t max_requests = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "s:xc:n:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 's':
+            speed = atof(optarg);
+            if (speed <= 0)
+            {
+                fprintf(stderr, "Speed must be positive\n");
+                return 1;
+            }
+            break;
+        case 'x':
+            speed = 0;
+            break;
+        case 'c':
+            limit = atoi(optarg);
+            if (limit < 1)
+            {
+                fprintf(stderr, "Connections must be at least 1\n");
+                return 1;
+            }
+            break;
+        case 'n':
+            max_requests = (size_t)atol(optarg);
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (argc - optind != 2)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (transport_resolve(argv[optind + 1], SOCK_STREAM, &target) == -1)
+    {
+        fprintf(stderr, "Invalid address: %s\n", argv[optind + 1]);
+        return 1;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    if (load_capture(argv[optind], limit, max_requests) == -1 || open_connections() == -1)
+        return 1;
+
+    if (speed > 0)
+        printf("Replaying %zu requests at %.2fx captured pacing\n", request_count, speed);
+    else
+        printf("Replaying %zu requests at full speed\n", request_count);
+    fflush(stdout);
+
+    start_ns = now_ns();
+    for (int i = 0; i < connection_count; i++)
+    {
+        pthread_create(&connections[i].receiver, NULL, receiver_routine, &connections[i]);
+        pthread_create(&connections[i].sender, NULL, sender_routine, &connections[i]);
+    }
+    for (int i = 0; i < connection_count; i++)
+    {
+        pthread_join(connections[i].sender, NULL);
+        pthread_join(connections[i].receiver, NULL);
+    }
+    uint64_t elapsed = now_ns() - start_ns;
+
+    int status = print_report(elapsed);
+    if (status == -1)
+        fprintf(stderr, "Out of memory\n");
+
+    for (int i = 0; i < connection_count; i++)
+    {
+        close(connections[i].fd);
+        pthread_mutex_destroy(&connections[i].mutex);
+        pthread_cond_destroy(&connections[i].cond);
+        free(connections[i].requests);
+    }
+    for (size_t i = 0; i < request_count; i++)
+    {
+        free(requests[i].payload);
+        free(requests[i].method);
+    }
+    free(connections);
+    free(requests);
+    return status ? 1 : 0;
+}